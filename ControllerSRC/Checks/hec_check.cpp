@@ -0,0 +1,89 @@
+/*
+ *  hec_check.cpp
+ *  check of the table-driven IT header CRCs (<AddHec>, <CheckHecs>) against
+ *		the bit-by-bit calculation (<AddHecBitwise>)
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// Standalone program, not part of either build; see README.txt for the
+//		command line
+// <AddHec> is compared with <AddHecBitwise> for all 8192 13-bit values, and
+//		for values with bits above the 13 set (which both should ignore);
+//		then every 16-bit header value is passed to <CheckHecs>, in batches
+//		of varying sizes, and must be accepted exactly when it's what
+//		<AddHecBitwise> gives for its top 13 bits
+// <HecTableOK>, which the Windows build calls in an ASSERT at startup, is
+//		also checked to agree
+
+#include "../Common/string_extras.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HEC_VALUES	0x2000		// 13-bit values
+#define HDR_VALUES	0x10000		// 16-bit header halves
+
+
+int main()
+{
+	int errors = 0;
+	int n;
+
+	for (n = 0; n < HEC_VALUES; n++) {
+		int h = AddHecBitwise(n);
+		if (AddHec(n) != h || AddHec(n | (1 << 13) | (5 << 20)) != h) {
+			if (errors < 10) printf("AddHec(%d) is %04X, expected %04X\n",
+															n, AddHec(n), h);
+			errors += 1;
+		}
+	}
+	printf("AddHec: %d values checked\n", HEC_VALUES);
+
+	static uint16_t h[HDR_VALUES];
+	static uint8_t ok[HDR_VALUES];
+	for (n = 0; n < HDR_VALUES; n++) h[n] = (uint16_t)n;
+	int batch = 1;
+	int good = 0;
+	n = 0;
+	while (n < HDR_VALUES) {
+			// batches of 1, 2, 3, ... so that any unrolling is exercised
+			//		with every remainder
+		int k = HDR_VALUES - n < batch ? HDR_VALUES - n : batch;
+		memset(ok, 0xEE, k);
+		int r = CheckHecs(h + n, ok, k);
+		int expected = 0;
+		int i;
+		for (i = 0; i < k; i++) {
+			int e = (AddHecBitwise(h[n + i] >> 3) == h[n + i]);
+			expected += e;
+			if (ok[i] != e) {
+				if (errors < 10) printf("CheckHecs: %04X gave %d, expected %d\n",
+															h[n + i], ok[i], e);
+				errors += 1;
+			}
+		}
+		if (r != expected) {
+			if (errors < 10) printf("CheckHecs: returned %d for a batch of %d at %04X, "
+											"expected %d\n", r, k, n, expected);
+			errors += 1;
+		}
+		good += r;
+		n += k;
+		batch += 1;
+	}
+		// each 13-bit value has exactly one correct CRC
+	if (good != HEC_VALUES) {
+		printf("CheckHecs: accepted %d header values, expected %d\n", good, HEC_VALUES);
+		errors += 1;
+	}
+	printf("CheckHecs: %d header values checked\n", HDR_VALUES);
+
+	unless (HecTableOK()) {
+		printf("HecTableOK returned false\n");
+		errors += 1;
+	}
+
+	printf(errors ? "%d errors\n" : "OK\n", errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+/*
+ *  link_loopback.cpp
+ *  check of the batched link I/O (<LinkIoPosix>, <DatagramRing> and
+ *		<CheckItPackets>) against a stand-in unit on the loopback interface
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// Standalone program, not part of either build; see README.txt for the
+//		command line
+// The stand-in unit is a second UDP socket on 127.0.0.1 which sends bursts
+//		of IT packets as a gateway unit would, some with padding, some with
+//		a corrupted "length" field and some that aren't normal data; the
+//		controller's side reads them with ReceiveBatch() into a ring that is
+//		smaller than a burst, so that the ring wraps round and a burst takes
+//		several calls, as in <Daemon::LinkReceive>, then checks the headers
+//		with CheckItPackets() and compares what's left with what was sent
+// It also sends bursts the other way with SendBatch() and checks that the
+//		stand-in receives all of them, in order
+
+#include "../Common/link_posix.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BURSTS		50
+#define BURST_LEN	100		// datagrams in each
+#define RING_SLOTS	16		// for the controller's receive ring
+
+
+// what the controller should see for one datagram sent by the stand-in
+struct Expected {
+	int len;		// after CheckItPackets(), -1 if to be ignored
+	int seq;		// first 2 bytes of payload; -1 if not an IT packet
+};
+
+
+static uint16_t LocalPort(LinkIoPosix& s)
+{
+	struct sockaddr_in sa;
+	socklen_t n = sizeof(sa);
+	getsockname(s.Handle(), (struct sockaddr *)&sa, &n);
+	return ntohs(sa.sin_port);
+}
+
+
+// wait up to a second for something to read
+static bool Readable(LinkIoPosix& s)
+{
+	struct pollfd p;
+	p.fd = s.Handle();
+	p.events = POLLIN;
+	return poll(&p, 1, 1000) > 0;
+}
+
+
+// build datagram <seq> of a burst from the stand-in in <d>, and say what the
+//		controller should make of it
+static Expected MakeDatagram(Datagram& d, int seq, bool standard_format)
+{
+	Expected e;
+	int pl = 2 + rand() % 300;	// payload length
+	BuildItHeader(d.b, pl, 0x1238, standard_format);
+	d.b[LINK_HDR_LEN] = (uint8_t)(seq >> 8);
+	d.b[LINK_HDR_LEN + 1] = (uint8_t)seq;
+	memset(d.b + LINK_HDR_LEN + 2, 0x5A, pl - 2);
+	d.len = LINK_HDR_LEN + pl;
+	e.len = d.len;
+	e.seq = seq;
+
+	switch (rand() % 8) {
+case 0:		// padded, e.g. to the Ethernet minimum
+		d.len += 1 + rand() % 20;
+		break;
+
+case 1:		// padded, with the CRC corrupted
+		d.len += 1 + rand() % 20;
+		d.b[7] ^= 1 << (rand() % 3);
+		e.len = -1;
+		break;
+
+case 2:		// truncated
+		d.len -= 1 + rand() % (pl - 1);
+		e.len = -1;
+		break;
+
+case 3:		// not normal data
+		d.b[6] |= 0x40;
+		e.len = -1;
+		break;
+
+case 4:		// keepalive (not an IT packet; left alone)
+		BuildAes51Header(d.b, AES51_TYPE_LINK_KEEPALIVE);
+		d.len = 6;
+		e.len = 6;
+		e.seq = -1;
+	}
+	return e;
+}
+
+
+int main()
+{
+	LinkIoPosix unit, ctlr;
+	uint32_t loopback = htonl(INADDR_LOOPBACK);
+	if (!unit.Open() || !ctlr.Open()) {
+		printf("can't open sockets: %s\n", strerror(unit.error ? unit.error : ctlr.error));
+		return 1;
+	}
+		// enough buffer space for a whole burst, as a busy link would have
+	int buf = 1 << 20;
+	setsockopt(ctlr.Handle(), SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+	setsockopt(unit.Handle(), SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+	if (!unit.Connect(loopback, LocalPort(ctlr)) ||
+							!ctlr.Connect(loopback, LocalPort(unit))) {
+		printf("can't connect sockets: %s\n", strerror(unit.error ? unit.error : ctlr.error));
+		return 1;
+	}
+
+	DatagramRing tx(BURST_LEN);
+	DatagramRing rx(RING_SLOTS);
+	Expected e[BURST_LEN];
+	int errors = 0;
+	int calls = 0;		// ReceiveBatch() calls that returned datagrams
+	int received = 0;
+	int burst, i;
+	srand(62379);
+
+		// stand-in unit to controller
+	for (burst = 0; burst < BURSTS; burst++) {
+		bool sf = (burst & 1) != 0;
+		for (i = 0; i < BURST_LEN; i++) e[i] = MakeDatagram(tx.NewSlot(i), i, sf);
+		tx.Added(BURST_LEN);
+		while (tx.Count() > 0) {
+			if (unit.SendBatch(tx) < 0) {
+				printf("SendBatch: %s\n", strerror(unit.error));
+				return 1;
+			}
+		}
+
+		i = 0;
+		while (i < BURST_LEN) {
+			unless (Readable(ctlr)) {
+				printf("burst %d: only %d of %d received\n", burst, i, BURST_LEN);
+				errors += 1;
+				break;
+			}
+			int n = ctlr.ReceiveBatch(rx);
+			if (n < 0) {
+				printf("ReceiveBatch: %s\n", strerror(ctlr.error));
+				return 1;
+			}
+			if (n > 0) calls += 1;
+			CheckItPackets(rx, rx.Count(), sf);
+			while (rx.Count() > 0) {
+				Datagram& d = rx.OldSlot(0);
+				int seq = (d.len >= LINK_HDR_LEN + 2 && d.b[1] == AES51_TYPE_IT_PACKET) ?
+									(d.b[LINK_HDR_LEN] << 8) | d.b[LINK_HDR_LEN + 1] : -1;
+				if (i >= BURST_LEN || d.len != e[i].len ||
+								(e[i].len > 0 && seq != e[i].seq) ||
+								d.addr != loopback || d.port != LocalPort(unit)) {
+					if (errors < 10) printf("burst %d datagram %d: len %d, expected %d\n",
+												burst, i, d.len, i < BURST_LEN ? e[i].len : 0);
+					errors += 1;
+				}
+				rx.Removed(1);
+				i += 1;
+				received += 1;
+			}
+		}
+	}
+	printf("unit to controller: %d datagrams in %d ReceiveBatch calls "
+					"(ring of %d slots)\n", received, calls, RING_SLOTS);
+
+		// controller to stand-in unit
+	received = 0;
+	for (burst = 0; burst < BURSTS; burst++) {
+		for (i = 0; i < BURST_LEN; i++) {
+			Datagram& d = tx.NewSlot(i);
+			BuildItHeader(d.b, 2, 0x1238, true);
+			d.b[LINK_HDR_LEN] = (uint8_t)burst;
+			d.b[LINK_HDR_LEN + 1] = (uint8_t)i;
+			d.len = LINK_HDR_LEN + 2;
+		}
+		tx.Added(BURST_LEN);
+		while (tx.Count() > 0) {
+			if (ctlr.SendBatch(tx) < 0) {
+				printf("SendBatch: %s\n", strerror(ctlr.error));
+				return 1;
+			}
+		}
+		i = 0;
+		while (i < BURST_LEN && Readable(unit)) {
+			if (unit.ReceiveBatch(rx) < 0) break;
+			while (rx.Count() > 0) {
+				Datagram& d = rx.OldSlot(0);
+				if (d.len != LINK_HDR_LEN + 2 || d.b[LINK_HDR_LEN] != burst ||
+												d.b[LINK_HDR_LEN + 1] != i) {
+					errors += 1;
+				}
+				rx.Removed(1);
+				i += 1;
+				received += 1;
+			}
+		}
+		if (i != BURST_LEN) {
+			printf("burst %d: %d of %d received by the unit\n", burst, i, BURST_LEN);
+			errors += 1;
+		}
+	}
+	printf("controller to unit: %d datagrams\n", received);
+
+	printf(errors ? "%d errors\n" : "OK\n", errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/*
+ *  sha3_check.cpp
+ *  check and timing of the multi-lane Keccak kernels (<KeccakfLanes>)
+ *		against the one-state permutation (<Keccakf>)
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// Standalone program, not part of either build; see README.txt for the
+//		command line
+// <Keccakf> is first checked against the published SHA3-512 hash of the
+//		empty string; then, for each instruction set up to the one the
+//		processor has, random states are permuted 1 to KECCAK_MAX_LANES at
+//		a time by <KeccakfLanes> and each must be bit-for-bit the same as
+//		<Keccakf> gives for it alone
+// The timing is per state, for a full batch of KECCAK_MAX_LANES as
+//		<EndHashBatch> does when several requests are sent together
+
+#include "../Common/keccak.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS		2000	// random batches for each level and lane count
+#define BENCH_REPS	200000	// batches timed for each level
+
+static const char * const level_names[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+
+	// SHA3-512 of "" (FIPS 202 example)
+static const uint8_t empty_hash[64] = {
+	0xa6, 0x9f, 0x73, 0xcc, 0xa2, 0x3a, 0x9a, 0xc5, 0xc8, 0xb5, 0x67, 0xdc,
+	0x18, 0x5a, 0x75, 0x6e, 0x97, 0xc9, 0x82, 0x16, 0x4f, 0xe2, 0x58, 0x59,
+	0xe0, 0xd1, 0xdc, 0xc1, 0x47, 0x5c, 0x80, 0xa6, 0x15, 0xb2, 0x12, 0x3a,
+	0xf1, 0xf5, 0xf9, 0x4c, 0x11, 0xe3, 0xe9, 0x40, 0x2c, 0x3a, 0xc5, 0x58,
+	0xf5, 0x00, 0x19, 0x9d, 0x95, 0xb6, 0xd3, 0xe3, 0x01, 0x75, 0x85, 0x86,
+	0x28, 0x1d, 0xcd, 0x26
+};
+
+
+static uint64_t Random64()
+{
+	uint64_t r = 0;
+	int i = 0;
+	for (; i < 4; i++) r = (r << 16) ^ (uint64_t)(rand() & 0xFFFF);
+	return r;
+}
+
+
+// the padded empty message fills one 72-byte block, and the hash is the first
+//		8 words of the state, least significant byte first
+static bool KnownAnswer()
+{
+	uint64_t s[KECCAK_WORDS];
+	memset(s, 0, sizeof(s));
+	s[0] ^= 0x06;
+	s[8] ^= 0x8000000000000000ULL;
+	Keccakf(s);
+	int i = 0;
+	for (; i < 64; i++) {
+		if ((uint8_t)(s[i >> 3] >> ((i & 7) * 8)) != empty_hash[i]) return false;
+	}
+	return true;
+}
+
+
+// returns the number of states that differ from <Keccakf>'s result
+static int Compare(int level)
+{
+	uint64_t s[KECCAK_WORDS][KECCAK_MAX_LANES];
+	uint64_t t[KECCAK_MAX_LANES][KECCAK_WORDS];
+	int errors = 0;
+	int r, n, i, j;
+	for (r = 0; r < ROUNDS; r++) {
+		for (n = 1; n <= KECCAK_MAX_LANES; n++) {
+			for (i = 0; i < KECCAK_WORDS; i++) {
+				for (j = 0; j < KECCAK_MAX_LANES; j++) s[i][j] = Random64();
+			}
+			for (j = 0; j < n; j++) {
+				for (i = 0; i < KECCAK_WORDS; i++) t[j][i] = s[i][j];
+				Keccakf(t[j]);
+			}
+			KeccakfLanes(s, n, level);
+			for (j = 0; j < n; j++) {
+				for (i = 0; i < KECCAK_WORDS; i++) {
+					if (s[i][j] != t[j][i]) break;
+				}
+				if (i < KECCAK_WORDS) {
+					if (errors < 10) printf("%s: state %d of %d differs at word %d\n",
+												level_names[level], j, n, i);
+					errors += 1;
+				}
+			}
+		}
+	}
+	return errors;
+}
+
+
+static double Seconds()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+int main()
+{
+	int errors = 0;
+	if (KnownAnswer()) printf("SHA3-512(\"\") OK\n");
+	else {
+		printf("SHA3-512(\"\") wrong\n");
+		errors += 1;
+	}
+
+	int max_level = KeccakSimdLevel();
+	printf("processor supports %s\n", level_names[max_level]);
+	srand(1600);
+	int level;
+	for (level = KECCAK_SIMD_NONE; level <= max_level; level++) {
+		int e = Compare(level);
+		printf("%-8s %d batches of 1 to %d states: %s\n", level_names[level],
+						ROUNDS * KECCAK_MAX_LANES, KECCAK_MAX_LANES, e ? "DIFFERENT" : "same");
+		errors += e;
+	}
+
+	static uint64_t s[KECCAK_WORDS][KECCAK_MAX_LANES];
+	double scalar_ns = 0;
+	for (level = KECCAK_SIMD_NONE; level <= max_level; level++) {
+		int i;
+		double t0 = Seconds();
+		for (i = 0; i < BENCH_REPS; i++) KeccakfLanes(s, KECCAK_MAX_LANES, level);
+		double ns = (Seconds() - t0) * 1e9 / ((double)BENCH_REPS * KECCAK_MAX_LANES);
+		if (level == KECCAK_SIMD_NONE) scalar_ns = ns;
+		printf("%-8s %6.1f ns/permutation (%.1fx)\n", level_names[level], ns,
+																scalar_ns / ns);
+	}
+
+	printf(errors ? "%d errors\n" : "OK\n", errors);
+	return errors ? 1 : 0;
+}
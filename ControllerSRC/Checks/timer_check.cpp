@@ -0,0 +1,268 @@
+/*
+ *  timer_check.cpp
+ *  check of <TimerWheel> against a reference list of timers, and of the
+ *		serial numbers, timeouts and backoff of <RequestTable>
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// Standalone program, not part of either build; see README.txt for the
+//		command line
+// The wheel is checked in two ways:
+//		- timers are set at distances either side of each level boundary
+//			(64 ms, 4096 ms, etc) and beyond what the wheel covers, and each
+//			must expire exactly at its time, after cascading down through
+//			the levels
+//		- random Set (including re-arming timers that are running), Cancel
+//			and CancelAll operations are interleaved with advancing the
+//			time by steps from 1 ms to several hours; the timers returned by
+//			<Expired> must be the ones in the reference list that are due,
+//			in order of expiry time, and <When>, <Count> and <NextExpiry>
+//			must agree with the list
+// The request table is checked for serial number allocation when it fills
+//		up, matching of replies, the RFC 6298 timeout calculation, Karn's
+//		algorithm, and the doubling of the interval up to REQ_GIVE_UP
+
+#include "../Common/timer_wheel.h"
+#include "../Common/request_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OWNERS		50
+#define KINDS		 4
+#define STEPS	200000		// random operations
+
+typedef std::map<std::pair<void *, int>, uint64_t> RefTimers;
+
+static int errors = 0;
+
+static void Fail(const char * what, uint64_t a, uint64_t b)
+{
+	if (errors < 20) printf("%s: %llu, expected %llu\n", what,
+								(unsigned long long)a, (unsigned long long)b);
+	errors += 1;
+}
+
+
+static void * Owner(int i) { return (void *)(intptr_t)(i + 1); }
+
+
+// advance <w> to <now>, checking what expires against <ref>
+static void Advance(TimerWheel& w, RefTimers& ref, uint64_t now)
+{
+	void * o;
+	int k;
+	uint64_t last = 0;
+	while (w.Expired(now, o, k)) {
+		RefTimers::iterator p = ref.find(std::make_pair(o, k));
+		if (p == ref.end()) {
+			Fail("expired timer not running", (uint64_t)(intptr_t)o, k);
+			continue;
+		}
+		if (p->second > now) Fail("timer expired early", p->second, now);
+		if (p->second < last) Fail("timers out of order", p->second, last);
+		last = p->second;
+		ref.erase(p);
+	}
+	RefTimers::iterator p = ref.begin();
+	for (; p != ref.end(); p++) {
+		if (p->second <= now) Fail("timer not expired", p->second, now);
+	}
+}
+
+
+static void CheckBoundaries()
+{
+	static const uint64_t d[] = { 1, 2, 63, 64, 65, 127, 128, 4095, 4096,
+			4097, 262143, 262144, 262145, 16777215, 16777216, 16777217,
+			30000000, 100000000 };
+	const int n = sizeof(d) / sizeof(d[0]);
+	uint64_t start = 987654321;
+	int i;
+	for (i = 0; i < n; i++) {
+		TimerWheel w;
+		RefTimers ref;
+		void * o;
+		int k;
+		w.Expired(start, o, k);		// sets the wheel's time
+		w.Set(Owner(0), 0, start + d[i]);
+		ref[std::make_pair(Owner(0), 0)] = start + d[i];
+			// some others that expire earlier, so there's cascading to do
+		w.Set(Owner(1), 0, start + d[i] / 2);
+		ref[std::make_pair(Owner(1), 0)] = start + d[i] / 2;
+		w.Set(Owner(2), 0, start + d[i] / 3 + 1);
+		ref[std::make_pair(Owner(2), 0)] = start + d[i] / 3 + 1;
+
+			// in big steps, then 1 ms at a time for the last few
+		uint64_t now = start;
+		uint64_t step = d[i] / 7 + 1;
+		while (now + step + 3 < start + d[i]) {
+			now += step;
+			Advance(w, ref, now);
+		}
+		while (now < start + d[i] - 1) Advance(w, ref, ++now);
+		if (w.When(Owner(0), 0) != start + d[i])
+				Fail("timer lost before expiry", w.When(Owner(0), 0), start + d[i]);
+		Advance(w, ref, start + d[i]);
+		if (w.Count() != 0) Fail("timers left", w.Count(), 0);
+	}
+	printf("TimerWheel: %d level boundaries checked\n", n);
+}
+
+
+static void CheckRandom()
+{
+	TimerWheel w;
+	RefTimers ref;
+	uint64_t now = 123456789;
+	int sets = 0, rearms = 0, cancels = 0, expired = 0;
+	int i;
+	srand(1);
+	{ void * o; int k; w.Expired(now, o, k); }
+	for (i = 0; i < STEPS; i++) {
+		int op = rand() % 10;
+		void * o = Owner(rand() % OWNERS);
+		int k = rand() % KINDS;
+		std::pair<void *, int> key = std::make_pair(o, k);
+		if (op < 4) {
+				// mostly short, as retransmit and keepalive timers are, but
+				//		some on each level of the wheel and beyond it
+			uint64_t d;
+			switch (rand() % 4) {
+		case 0:		d = rand() % 100; break;
+		case 1:		d = rand() % 5000; break;
+		case 2:		d = rand() % 300000; break;
+		default:	d = ((uint64_t)rand() << 8) % 40000000; break;
+			}
+			if (ref.count(key)) rearms += 1;
+			w.Set(o, k, now + d);
+			ref[key] = now + d;
+			sets += 1;
+		}
+		else if (op == 4) {
+			w.Cancel(o, k);
+			ref.erase(key);
+			cancels += 1;
+		}
+		else if (op == 5) {
+			w.CancelAll(o);
+			int j = 0;
+			for (; j < KINDS; j++) ref.erase(std::make_pair(o, j));
+			cancels += 1;
+		}
+		else {
+			uint64_t next = w.NextExpiry();
+			uint64_t first = 0;
+			RefTimers::iterator p = ref.begin();
+			for (; p != ref.end(); p++) {
+				if (first == 0 || p->second < first) first = p->second;
+			}
+			if ((next == 0) != (first == 0) || next > first)
+										Fail("NextExpiry", next, first);
+			switch (rand() % 3) {
+		case 0:		now += rand() % 100000; break;
+		case 1:		now += 1 + rand() % 300; break;
+		default:	if (first > now) now = first; break;
+			}
+			int before = (int)ref.size();
+			Advance(w, ref, now);
+			expired += before - (int)ref.size();
+		}
+		if (w.Count() != (int)ref.size()) Fail("Count", w.Count(), ref.size());
+		if (w.When(o, k) != (ref.count(key) ? ref[key] : 0))
+							Fail("When", w.When(o, k), ref.count(key) ? ref[key] : 0);
+	}
+		// let everything expire
+	Advance(w, ref, now + 100000000);
+	if (w.Count() != 0) Fail("timers left", w.Count(), 0);
+	printf("TimerWheel: %d sets (%d re-armed), %d cancels, %d expired\n",
+											sets, rearms, cancels, expired);
+}
+
+
+static void CheckRequests()
+{
+	RequestTable t;
+	PendingRequest r;
+	uint8_t m[4] = { 0x30, 0, 0, 0 };
+	uint64_t now = 1000000;
+	int i;
+
+		// fill the table: 255 serials, all different, then none
+	bool used[256] = { false };
+	for (i = 0; i < 255; i++) {
+		int s = t.NextSerial();
+		if (s < 1 || s > 255 || used[s]) Fail("NextSerial", s, i + 1);
+		used[s & 255] = true;
+		m[1] = (uint8_t)s;
+		t.Add(m, 4, true, 0, i, now + i);
+	}
+	if (t.NextSerial() != 0) Fail("NextSerial when full", t.NextSerial(), 0);
+	if (t.Oldest() != 1) Fail("Oldest", t.Oldest(), 1);
+		// a reply of the wrong type isn't taken as the reply
+	if (t.Complete(7, 0x20, now, r)) Fail("Complete with wrong type", 1, 0);
+	unless (t.Complete(7, 0x30, now + 300, r) && r.ref == 6)
+										Fail("Complete", r.ref, 6);
+	if (t.NextSerial() != 7) Fail("NextSerial after Complete", t.NextSerial(), 7);
+	t.Clear();
+
+		// RFC 6298: first sample sets SRTT = R, RTTVAR = R/2
+	RequestTable u;
+	if (u.Rto() != REQ_INITIAL_RTO) Fail("initial RTO", u.Rto(), REQ_INITIAL_RTO);
+	m[1] = (uint8_t)u.NextSerial();
+	u.Add(m, 4, true, 0, 0, now);
+	u.Complete(m[1], 0x30, now + 400, r);
+	if (u.Srtt() != 400 || u.Rto() != 400 + 4 * 200) Fail("RTO after one sample",
+															u.Rto(), 1200);
+	for (i = 0; i < 200; i++) u.Sample(100);
+	if (u.Srtt() > 110 || u.Rto() != REQ_MIN_RTO) Fail("RTO after steady samples",
+														u.Rto(), REQ_MIN_RTO);
+
+		// Karn: no sample from a request that was repeated
+	int rto = u.Rto();
+	m[1] = (uint8_t)u.NextSerial();
+	u.Add(m, 4, true, 0, 0, now);
+	u.Resent(m[1], now + rto);
+	u.Complete(m[1], 0x30, now + 5000, r);
+	if (u.Rto() != rto) Fail("RTO after repeated request", u.Rto(), rto);
+
+		// each repeat doubles the interval, up to REQ_MAX_RTO, but the
+		//		request is due to be given up REQ_GIVE_UP after first sent
+	m[1] = (uint8_t)u.NextSerial();
+	u.Add(m, 4, true, 0, 0, now);
+	uint64_t t0 = now;
+	int expect = rto;
+	if (u.Find(m[1])->due != now + rto) Fail("first due", u.Find(m[1])->due, now + rto);
+	while (u.Due(now + expect) == m[1]) {
+		now += expect;
+		u.Resent(m[1], now);
+		expect = expect * 2 > REQ_MAX_RTO ? REQ_MAX_RTO : expect * 2;
+		uint64_t due = now + expect;
+		if (due > t0 + REQ_GIVE_UP) due = t0 + REQ_GIVE_UP;
+		if (u.Find(m[1])->due != due) Fail("due after repeat", u.Find(m[1])->due, due);
+		if (u.NextDue() != due) Fail("NextDue", u.NextDue(), due);
+		if (due == t0 + REQ_GIVE_UP) break;
+		expect = (int)(due - now);
+	}
+	if (u.Find(m[1])->due != t0 + REQ_GIVE_UP)
+					Fail("not given up", u.Find(m[1])->due, t0 + REQ_GIVE_UP);
+	u.Remove(m[1]);
+
+		// one that isn't to be repeated is only due when it's given up
+	m[1] = (uint8_t)u.NextSerial();
+	u.Add(m, 4, false, 0, 0, now);
+	if (u.Due(now + REQ_GIVE_UP - 1) >= 0) Fail("non-repeat due early", 1, 0);
+	if (u.Due(now + REQ_GIVE_UP) != m[1]) Fail("non-repeat not due", 0, 1);
+	printf("RequestTable: serials, RTO and backoff checked\n");
+}
+
+
+int main()
+{
+	CheckBoundaries();
+	CheckRandom();
+	CheckRequests();
+	printf(errors ? "%d errors\n" : "OK\n", errors);
+	return errors ? 1 : 0;
+}
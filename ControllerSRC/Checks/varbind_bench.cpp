@@ -0,0 +1,191 @@
+/*
+ *  varbind_bench.cpp
+ *  timing of <VarBindReader> against the way VarBinds were read before it
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// Standalone program, not part of either build; see README.txt for the
+//		command line
+// The payloads are status reports of the shape the units send (unitUpTime,
+//		the unit scalars, and the audio port, network port and flow tables),
+//		built here because there are no recorded captures in the repository;
+//		each VarBind is read as ReceiveData() reads it:
+//		- before: a <MibObject> is allocated for each, holding a copy of the
+//			OID, the OID as text, and a copy of the value, and the text is
+//			compared against the flash map prefix
+//		- now: <VarBindReader> points into the message and <ClassifyOid> looks
+//			the OID up in the prefix table
+// Both are checked to have seen the same number of VarBinds and the same
+//		number of recognised objects
+
+#include "../Common/mgt_core.h"
+#include <stdio.h>
+#include <time.h>
+
+
+// the MibObject fields that the old constructor filled in
+struct LegacyObject {
+	ByteString val;
+	ByteString oid_ber;
+	std::string oid;
+	int tag;
+	int value;
+};
+
+
+// as the old MibObject::GetAsn1Value, reading into <b>
+static bool LegacyValue(uint8_t * &p, int &len, ByteString& b, int& tag,
+																int& value)
+{
+	ValueSizes sz = ParseLength(p, len);
+	if (sz.hd_len < 0) return false;
+	tag = p[0];
+	uint8_t * v = p + sz.hd_len;
+	b.resize(sz.len);
+	int i = 0;
+	while (i < sz.len) { b[i] = v[i]; i += 1; }
+	if (tag == ASN1_TAG_INTEGER && !Asn1IntegerValue(v, sz.len, value))
+											tag = TAG_INTEGER_OUT_OF_RANGE;
+	p = v + sz.len;
+	len -= sz.hd_len + sz.len;
+	return true;
+}
+
+
+// returns the number of VarBinds read; <known> is set to the number that the
+//		old code recognised (by comparing text)
+static int ReadLegacy(uint8_t * p, int len, int& known)
+{
+	int n = 0;
+	known = 0;
+	while (len > 0) {
+		LegacyObject * m = new LegacyObject;
+		int tag, value;
+		if (!LegacyValue(p, len, m->oid_ber, tag, value) || tag != ASN1_TAG_OID) {
+			delete m;
+			break;
+		}
+		m->oid = OidToText(m->oid_ber);
+		if (!LegacyValue(p, len, m->val, m->tag, m->value)) {
+			delete m;
+			break;
+		}
+		n += 1;
+		if (m->oid.compare(0, 16, "1.0.62379.1.1.5.") != 0 &&
+						m->oid.compare(0, 10, "1.0.62379.") == 0) known += 1;
+		delete m;
+	}
+	return n;
+}
+
+
+static int ReadNew(uint8_t * p, int len, int& known)
+{
+	VarBindReader r(p, len);
+	VarBindView v;
+	int n = 0;
+	known = 0;
+	while (r.Next(v)) {
+		n += 1;
+		int posn;
+		ClassifyOid(v.oid, v.oid_len, posn);
+		if (v.oid_len > 3 && v.oid[0] == 0x28 && v.oid[1] == 0x83 &&
+												v.oid[2] == 0xE7) known += 1;
+	}
+	return n;
+}
+
+
+static void AddVarBind(ByteString& m, const char * oid, int tag,
+												const uint8_t * val, int len)
+{
+	ByteString o = OidFromText(oid);
+	m.push_back(ASN1_TAG_OID);
+	m.push_back((uint8_t)o.size());
+	APPEND(m, o);
+	m.push_back((uint8_t)tag);
+	m.push_back((uint8_t)len);
+	m.insert(m.end(), val, val + len);
+}
+
+
+// a status report for a unit with <ports> audio ports and <flows> flows
+static ByteString StatusReport(int ports, int flows)
+{
+	ByteString m;
+	char oid[64];
+	uint8_t v[16] = { 0, 0, 0x2A, 0x17, 0, 0x90, 0xA8, 0x99, 0, 0, 0, 0x0D,
+																1, 2, 3, 4 };
+	AddVarBind(m, "1.0.62379.1.1.1.9.0", ASN1_TAG_INTEGER, v + 1, 3);
+	AddVarBind(m, "1.0.62379.1.1.1.1.0", ASN1_TAG_OCTET_STRING,
+											(const uint8_t *)"Studio 3 rack", 13);
+	AddVarBind(m, "1.0.62379.1.1.1.16.0", ASN1_TAG_OCTET_STRING, v + 4, 8);
+	AddVarBind(m, "1.0.62379.1.1.4.7.0", ASN1_TAG_INTEGER, v + 12, 1);
+	int i = 0;
+	while (++i <= ports) {
+		snprintf(oid, sizeof(oid), "1.0.62379.2.1.1.1.1.2.%d", i);
+		AddVarBind(m, oid, ASN1_TAG_INTEGER, v + 12 + (i & 1), 1);
+		snprintf(oid, sizeof(oid), "1.0.62379.2.1.1.1.1.5.%d", i);
+		AddVarBind(m, oid, ASN1_TAG_OCTET_STRING, (const uint8_t *)"Mic 1", 5);
+		snprintf(oid, sizeof(oid), "1.0.62379.2.1.1.4.1.3.%d", i);
+		AddVarBind(m, oid, ASN1_TAG_INTEGER, v + 14, 2);
+	}
+	i = 0;
+	while (++i <= 4) {
+		snprintf(oid, sizeof(oid), "1.0.62379.5.1.1.1.1.1.3.%d", i);
+		AddVarBind(m, oid, ASN1_TAG_INTEGER, v + 14, 1);
+		snprintf(oid, sizeof(oid), "1.0.62379.5.1.1.1.1.1.7.%d", i);
+		AddVarBind(m, oid, ASN1_TAG_OCTET_STRING, v + 4, 8);
+	}
+	i = 0;
+	while (++i <= flows) {
+		snprintf(oid, sizeof(oid), "1.0.62379.5.1.1.3.3.1.2.%d.%d", i, i + 400);
+		AddVarBind(m, oid, ASN1_TAG_INTEGER, v + 13, 2);
+		snprintf(oid, sizeof(oid), "1.0.62379.5.1.1.3.3.1.9.%d.%d", i, i + 400);
+		AddVarBind(m, oid, ASN1_TAG_INTEGER, v + 12, 1);
+	}
+	return m;
+}
+
+
+static double Seconds()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+int main()
+{
+	static const int sizes[][2] = { { 2, 2 }, { 8, 12 }, { 16, 40 } };
+	int ok = 1;
+	int k = 0;
+	for (; k < 3; k++) {
+		ByteString m = StatusReport(sizes[k][0], sizes[k][1]);
+		int len = (int)m.size();
+		int known_old, known_new;
+		int n = ReadLegacy(m.data(), len, known_old);
+		if (ReadNew(m.data(), len, known_new) != n || known_new != known_old) {
+			printf("mismatch for payload %d\n", k);
+			ok = 0;
+			continue;
+		}
+
+		int reps = 2000000 / len + 1;
+		volatile int total = 0;	// so the loops aren't optimised away
+		int i;
+		double t0 = Seconds();
+		for (i = 0; i < reps; i++) total += ReadLegacy(m.data(), len, known_old);
+		double t1 = Seconds();
+		for (i = 0; i < reps; i++) total += ReadNew(m.data(), len, known_new);
+		double t2 = Seconds();
+		double vbs = (double)n * reps;
+		printf("%5d bytes, %3d VarBinds: before %6.1f ns/VarBind, "
+				"now %6.1f ns/VarBind (%.1fx)\n", len, n,
+				(t1 - t0) * 1e9 / vbs, (t2 - t1) * 1e9 / vbs, (t1 - t0) / (t2 - t1));
+	}
+	return ok ? 0 : 1;
+}
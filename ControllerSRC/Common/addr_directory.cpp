@@ -0,0 +1,159 @@
+/*
+ *  addr_directory.cpp
+ *  hash table keyed by a binary address
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "addr_directory.h"
+#include <string.h>
+
+
+AddrDirectory::AddrDirectory()
+{
+	used = 0;
+	removed = 0;
+	Resize(ADDR_DIR_MIN_SIZE);
+}
+
+
+// FNV-1a; the keys are short, and for units most of the bits are the EUI-64
+//		which is already fairly random
+uint64_t AddrDirectory::Hash(const uint8_t * k, int len)
+{
+	uint64_t h = 0xCBF29CE484222325ULL;
+	int i = -1;
+	while (++i < len) {
+		h ^= k[i];
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+
+int AddrDirectory::Lookup(const uint8_t * k, int len, uint64_t h) const
+{
+	uint64_t i = h & mask;
+	while (true) {
+		const Slot& s = slots[(size_t)i];
+		if (s.state == ADDR_DIR_EMPTY) return -1;
+		if (s.state == ADDR_DIR_USED && s.hash == h &&
+					(int)s.key.size() == len && memcmp(s.key.data(), k, len) == 0)
+															return (int)i;
+		i = (i + 1) & mask;
+	}
+}
+
+
+void * AddrDirectory::Find(const uint8_t * k, int len) const
+{
+	int i = Lookup(k, len, Hash(k, len));
+	return (i < 0) ? NULL : slots[i].p;
+}
+
+
+void AddrDirectory::Set(const ByteString& k, void * p, uint32_t stamp)
+{
+	uint64_t h = Hash(k.data(), (int)k.size());
+	int i = Lookup(k.data(), (int)k.size(), h);
+	if (i >= 0) {
+		slots[i].p = p;
+		slots[i].stamp = stamp;
+		return;
+	}
+
+	if ((used + removed + 1) * 4 > (int)slots.size() * 3) {
+			// rebuild, at twice the size unless most of the slots in use
+			//		are for entries that have been removed
+		size_t n = slots.size();
+		if ((used + 1) * 2 > (int)n) n *= 2;
+		Resize(n);
+	}
+	uint64_t j = h & mask;
+	until (slots[(size_t)j].state != ADDR_DIR_USED) j = (j + 1) & mask;
+	Slot& s = slots[(size_t)j];
+	if (s.state == ADDR_DIR_REMOVED) removed -= 1;
+	s.hash = h;
+	s.key = k;
+	s.p = p;
+	s.stamp = stamp;
+	s.state = ADDR_DIR_USED;
+	used += 1;
+}
+
+
+void AddrDirectory::Erase(Slot& s)
+{
+	s.state = ADDR_DIR_REMOVED;
+	s.key.clear();
+	s.p = NULL;
+	used -= 1;
+	removed += 1;
+}
+
+
+bool AddrDirectory::Remove(const uint8_t * k, int len)
+{
+	int i = Lookup(k, len, Hash(k, len));
+	if (i < 0) return false;
+	Erase(slots[i]);
+	return true;
+}
+
+
+int AddrDirectory::RemoveValue(void * p)
+{
+	int n = 0;
+	std::vector<Slot>::iterator s = slots.begin();
+	for (; s != slots.end(); s++) {
+		unless (s->state == ADDR_DIR_USED && s->p == p) continue;
+		Erase(*s);
+		n += 1;
+	}
+	return n;
+}
+
+
+int AddrDirectory::Prune(uint32_t oldest)
+{
+	int n = 0;
+	std::vector<Slot>::iterator s = slots.begin();
+	for (; s != slots.end(); s++) {
+		unless (s->state == ADDR_DIR_USED && (int32_t)(s->stamp - oldest) < 0)
+																	continue;
+		Erase(*s);
+		n += 1;
+	}
+	return n;
+}
+
+
+// move the entries into a new array of <n> slots
+void AddrDirectory::Resize(size_t n)
+{
+	std::vector<Slot> old;
+	old.swap(slots);
+	Slot e;
+	e.hash = 0;
+	e.p = NULL;
+	e.stamp = 0;
+	e.state = ADDR_DIR_EMPTY;
+	slots.resize(n, e);
+	mask = n - 1;
+	removed = 0;
+	std::vector<Slot>::iterator s = old.begin();
+	for (; s != old.end(); s++) {
+		unless (s->state == ADDR_DIR_USED) continue;
+		uint64_t j = s->hash & mask;
+		until (slots[(size_t)j].state == ADDR_DIR_EMPTY) j = (j + 1) & mask;
+		slots[(size_t)j].hash = s->hash;
+		slots[(size_t)j].key.swap(s->key);
+		slots[(size_t)j].p = s->p;
+		slots[(size_t)j].stamp = s->stamp;
+		slots[(size_t)j].state = ADDR_DIR_USED;
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ *  addr_directory.h
+ *  hash table keyed by a binary address, used to find the unit with a
+ *		given Flexilink address and the unit sending a given flow
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+
+// Keys are kept in binary, as they appear in messages: for units the
+//		Flexilink address (FlAddrTypeUnitId followed by the EUI-64), and for
+//		flows the BER coding of the flow id's arcs (see <IndexFromText>)
+// The table uses open addressing with linear probing; each slot holds the
+//		hash of its key so that most probes don't need to compare keys, and
+//		the table is rebuilt at twice the size when it's more than 3/4 full
+//		(including slots whose entries have been removed)
+// Each entry has a time stamp, so that entries that haven't been
+//		confirmed recently can be removed (see <Prune>)
+// Values are pointers, as for <MibBus>
+
+
+class AddrDirectory
+{
+public:
+	AddrDirectory();
+
+		// the value for key <k>, NULL if none
+	void * Find(const uint8_t * k, int len) const;
+	void * Find(const ByteString& k) const { return Find(k.data(), (int)k.size()); }
+		// set the value for <k>, adding an entry if there isn't one;
+		//		<stamp> is any value that increases with time (it may wrap)
+	void Set(const ByteString& k, void * p, uint32_t stamp = 0);
+		// remove the entry for <k>; returns whether there was one
+	bool Remove(const uint8_t * k, int len);
+	bool Remove(const ByteString& k) { return Remove(k.data(), (int)k.size()); }
+		// remove all the entries whose value is <p>; returns how many
+	int RemoveValue(void * p);
+		// remove entries whose stamp is before <oldest>; returns how many
+	int Prune(uint32_t oldest);
+		// number of entries
+	int Count() const { return used; }
+
+private:
+#define ADDR_DIR_EMPTY		0
+#define ADDR_DIR_USED		1
+#define ADDR_DIR_REMOVED	2	// still part of a probe sequence
+#define ADDR_DIR_MIN_SIZE	64	// slots; a power of 2
+	struct Slot {
+		uint64_t hash;
+		ByteString key;
+		void * p;
+		uint32_t stamp;
+		int state;			// one of the ADDR_DIR_ codes
+	};
+	std::vector<Slot> slots;
+	uint64_t mask;		// number of slots - 1
+	int used;			// slots in ADDR_DIR_USED state
+	int removed;		// slots in ADDR_DIR_REMOVED state
+
+	static uint64_t Hash(const uint8_t * k, int len);
+		// index of the slot holding <k>, or -1 if not found
+	int Lookup(const uint8_t * k, int len, uint64_t h) const;
+	void Resize(size_t n);
+	void Erase(Slot& s);
+};
@@ -0,0 +1,106 @@
+/*
+ *  console_log.cpp
+ *  console output from a unit or SCP session
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "console_log.h"
+#include <string.h>
+
+
+ConsoleLog::ConsoleLog(int lines, int chunks)
+{
+	n_lines = lines < 1 ? 1 : lines;
+	n_chunks = chunks < 2 ? 2 : chunks;
+	first = 0;
+	count = 0;
+	chunk = 0;
+	used = 0;
+}
+
+
+void ConsoleLog::NewLine()
+{
+	if (lines.empty()) {
+		lines.resize(n_lines);
+		text.resize(n_chunks * CONSOLE_LOG_CHUNK);
+	}
+	if (count >= n_lines) DropLine();
+	count += 1;
+	LineRef& l = Back();
+	l.chunk = chunk;
+	l.offset = used;
+	l.len = 0;
+}
+
+
+// move on to the next chunk, discarding the lines in the one it replaces,
+//		which are the oldest
+void ConsoleLog::NewChunk()
+{
+	chunk += 1;
+	used = 0;
+	while (count > 0 && lines[first].chunk + (uint32_t)n_chunks <= chunk)
+																	DropLine();
+}
+
+
+void ConsoleLog::Append(char c)
+{
+	if (c == '\n') {
+		NewLine();
+		return;
+	}
+	if (count == 0) NewLine();
+	if (used >= CONSOLE_LOG_CHUNK) {
+		if (Back().len >= CONSOLE_LOG_CHUNK) NewLine();
+			// move the last line to the start of the next chunk; there are
+			//		at least 2 chunks so it isn't overwritten
+		const char * p = Chunk(Back().chunk) + Back().offset;
+		NewChunk();
+		LineRef& l = Back();
+		memcpy(Chunk(chunk), p, l.len);
+		l.chunk = chunk;
+		l.offset = 0;
+		used = l.len;
+	}
+	LineRef& l = Back();
+	Chunk(chunk)[l.offset + l.len] = c;
+	l.len += 1;
+	used += 1;
+}
+
+
+void ConsoleLog::Append(const char * b, int len)
+{
+	int i = -1;
+	while (++i < len) Append(b[i]);
+}
+
+
+const char * ConsoleLog::Line(int i, int& len) const
+{
+	const LineRef& l = lines[(first + i) % n_lines];
+	len = l.len;
+	return text.data() + (l.chunk % (uint32_t)n_chunks) * CONSOLE_LOG_CHUNK +
+																	l.offset;
+}
+
+
+void ConsoleLog::Visible(int y, int line_height, int top, int bottom,
+												int& start, int& end) const
+{
+	start = 0;
+	end = count;
+	if (line_height <= 0) return;
+	if (top > y) start = (top - y) / line_height;
+	if (bottom < y + count * line_height)
+							end = (bottom - y + line_height - 1) / line_height;
+	if (end < 0) end = 0;
+	if (start > end) start = end;
+}
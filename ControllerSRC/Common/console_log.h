@@ -0,0 +1,70 @@
+/*
+ *  console_log.h
+ *  the most recent console output from a unit or SCP session, held so
+ *		that adding text and discarding old lines take constant time
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+
+// The text is held in fixed-size chunks which are used as a ring; a line
+//		never spans two chunks, so when the line being added to reaches the
+//		end of a chunk it is moved to the start of the next one, and when
+//		a chunk is reused the lines in it are discarded
+// A line that would fill a whole chunk is continued on a new line
+// The index of lines is also a ring, so the oldest line is discarded when
+//		it is full
+// Nothing is allocated after the first text has been added
+
+
+class ConsoleLog
+{
+public:
+		// defaults keep about the last 2000 lines (HyperTerminal saves about
+		//		500)
+#define CONSOLE_LOG_LINES	2000
+#define CONSOLE_LOG_CHUNK	4096
+#define CONSOLE_LOG_CHUNKS	64		// at least 2
+	ConsoleLog(int lines = CONSOLE_LOG_LINES, int chunks = CONSOLE_LOG_CHUNKS);
+
+		// start a new line, which becomes the one that text is added to
+	void NewLine();
+		// add text to the last line; a '\n' starts a new line
+	void Append(char c);
+	void Append(const char * b, int len);
+	void Append(const std::string& s) { Append(s.data(), (int)s.size()); }
+
+		// number of lines, including the one being added to
+	int Count() const { return count; }
+		// the <i>th line, oldest first, and its length (not terminated)
+	const char * Line(int i, int& len) const;
+
+		// the lines that are at least partly between <top> and <bottom> if
+		//		line 0 is at <y> and each line is <line_height> high; sets
+		//		<start> and <end> to the first line and one past the last
+	void Visible(int y, int line_height, int top, int bottom,
+											int& start, int& end) const;
+
+private:
+	struct LineRef {
+		uint32_t chunk;		// sequence number of the chunk it's in
+		int offset;			// in the chunk
+		int len;
+	};
+	std::vector<LineRef> lines;	// ring
+	std::vector<char> text;		// the chunks
+	int n_lines;		// sizes to allocate when the first line is added
+	int n_chunks;
+	int first;			// index in <lines> of the oldest line
+	int count;			// number of lines
+	uint32_t chunk;		// sequence number of the chunk being filled
+	int used;			// bytes used in it
+
+	char * Chunk(uint32_t n) { return text.data() +
+								(n % (uint32_t)n_chunks) * CONSOLE_LOG_CHUNK; }
+	LineRef& Back() { return lines[(first + count - 1) % n_lines]; }
+	void DropLine() { first = (first + 1) % n_lines; count -= 1; }
+	void NewChunk();
+};
@@ -0,0 +1,146 @@
+/*
+ *  crosspoint_model.cpp
+ *  the lines shown in a "crosspoint" window
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "crosspoint_model.h"
+#include <string.h>
+#include <algorithm>
+
+
+bool XptKey::operator==(const XptKey& k) const
+{
+	if (always || k.always) return false;
+	return unit_rev == k.unit_rev && global_rev == k.global_rev &&
+									memcmp(state, k.state, sizeof(state)) == 0;
+}
+
+
+bool CrosspointModel::IsCurrent(int i, void * u, const XptKey& k) const
+{
+	if (i < 0 || i >= (int)blocks.size()) return false;
+	const Block& b = blocks[i];
+	return b.unit != NULL && b.unit == u && b.key == k;
+}
+
+
+std::vector<XptRow>& CrosspointModel::NewRows(int i, void * u, const XptKey& k)
+{
+	if (i >= (int)blocks.size()) {
+		Block b;
+		b.unit = NULL;
+		b.top = b.bottom = -1;
+		blocks.resize(i + 1, b);
+	}
+	Block& b = blocks[i];
+	b.unit = u;
+	b.key = k;
+	b.rows.clear();
+	return b.rows;
+}
+
+
+void CrosspointModel::Clear(int i)
+{
+	if (i < 0 || i >= (int)blocks.size()) return;
+	blocks[i].unit = NULL;
+	blocks[i].rows.clear();
+}
+
+
+void CrosspointModel::Truncate(int n)
+{
+	if (n < (int)blocks.size()) blocks.resize(n);
+}
+
+
+// the rows are left in place (without their <unit>) so that <lines> is
+//		still valid until the next <Layout>
+void CrosspointModel::RemoveUnit(void * u)
+{
+	if (u == NULL) return;
+	std::vector<Block>::iterator p = blocks.begin();
+	for (; p != blocks.end(); p++) {
+		unless (p->unit == u) continue;
+		p->unit = NULL;
+		std::vector<XptRow>::iterator q = p->rows.begin();
+		for (; q != p->rows.end(); q++) q->unit = NULL;
+	}
+}
+
+
+int CrosspointModel::Layout(int top, int h)
+{
+	line_height = h;
+	lines.clear();
+	clickable.clear();
+	moved = false;
+	int y = top;
+	std::vector<Block>::iterator p = blocks.begin();
+	for (; p != blocks.end(); p++) {
+		if (p->top != y) moved = true;
+		p->top = y;
+		std::vector<XptRow>::iterator q = p->rows.begin();
+		for (; q != p->rows.end(); q++) {
+			q->y = y;
+			y += h + (q->gap * h) / 2;
+			lines.push_back(&*q);
+			if (q->unit) clickable.push_back(&*q);
+		}
+		if (p->bottom != y) moved = true;
+		p->bottom = y;
+	}
+	if (end != y) moved = true;
+	end = y;
+	return y;
+}
+
+
+bool CrosspointModel::Extent(void * u, int& top, int& bottom) const
+{
+	if (u == NULL) return false;
+	std::vector<Block>::const_iterator p = blocks.begin();
+	for (; p != blocks.end(); p++) {
+		unless (p->unit == u) continue;
+		top = p->top;
+		bottom = p->bottom;
+		return top >= 0;
+	}
+	return false;
+}
+
+
+static bool RowAbove(const XptRow * r, int y) { return r->y < y; }
+
+
+int CrosspointModel::FirstVisible(int y) const
+{
+		// the row before the first one that starts at or below <y> may
+		//		overlap it
+	int i = (int)(std::lower_bound(lines.begin(), lines.end(), y, RowAbove) -
+																lines.begin());
+	if (i > 0 && lines[i - 1]->y + line_height > y) i -= 1;
+	return i;
+}
+
+
+// binary search for the first clickable row with <y> not less than the
+//		given value; if the point is between two rows and nearer to the row
+//		above, select the row above
+const XptRow * CrosspointModel::Nearest(int y) const
+{
+	int n = (int)clickable.size();
+	if (n <= 0) return NULL;
+	int i = (int)(std::lower_bound(clickable.begin(), clickable.end(), y,
+												RowAbove) - clickable.begin());
+	if (i >= n) return clickable[n - 1];
+	if (i > 0 && (clickable[i - 1]->y + clickable[i]->y) / 2 >= y)
+														return clickable[i - 1];
+	return clickable[i];
+}
@@ -0,0 +1,135 @@
+/*
+ *  crosspoint_model.h
+ *  the lines shown in a "crosspoint" (sources or destinations) window, kept
+ *		between repaints so that only the units whose information has
+ *		changed need to be reformatted
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+#include "mib_bus.h"
+
+// The window shows a block of lines for each unit; the view formats a
+//		unit's block (see CCrosspointView::BuildUnitRows) only when something
+//		it depends on has changed, which it detects by comparing an <XptKey>
+//		with the one recorded when the block was built
+// Nothing here knows about units other than as pointers, so it doesn't
+//		depend on MFC or GDI; colours are Windows COLORREF values (0x00BBGGRR)
+
+
+// the objects the lines depend on, for subscriptions to <MibBus>: those
+//		shown in both windows, and those for the ports in each window
+// changes to the objects in XPT_BITS_GLOBAL can affect lines for units
+//		other than the one whose object has changed, e.g. the name of the
+//		port that is sending a flow
+#define XPT_BITS_GLOBAL	(MIB_BIT(MIB_COL_UNIT_NAME) | \
+			MIB_BIT(MIB_COL_UNIT_LOCATION) | MIB_BIT(MIB_COL_A_PORT_NAME) | \
+			MIB_BIT(MIB_COL_V_PORT_NAME) | MIB_BIT(MIB_COL_UD_NET_BLOCK_ID))
+#define XPT_BITS_UNIT	(XPT_BITS_GLOBAL | MIB_BIT(MIB_COL_UNIT_ADDRESS) | \
+			MIB_BIT(MIB_COL_PRODUCT_NAME) | MIB_BIT(MIB_COL_UNIT_IDENTIFIER) | \
+			MIB_BIT(MIB_COL_A_PORT_DIRECTION) | \
+			MIB_BIT(MIB_COL_V_PORT_DIRECTION) | MIB_BIT_UNIT_STATE)
+#define XPT_BITS_INPUTS	(MIB_BIT(MIB_COL_A_PORT_FORMAT) | \
+			MIB_BIT(MIB_COL_V_PORT_FORMAT) | MIB_BIT(MIB_COL_UD_STATE) | \
+			MIB_BIT(MIB_COL_UD_IMPORTANCE) | MIB_BIT(MIB_COL_N_PORT_ADDR_TYPE) | \
+			MIB_BIT(MIB_COL_N_PORT_PARTNER_ADDR) | \
+			MIB_BIT(MIB_COL_N_PORT_SCP_DEVICE) | MIB_BIT(MIB_COL_N_PORT_VM_STATE))
+#define XPT_BITS_OUTPUTS	(MIB_BIT(MIB_COL_UNIT_TIMING) | \
+			MIB_BIT(MIB_COL_UNIT_SYNC) | MIB_BIT(MIB_COL_UNIT_FRAMING) | \
+			MIB_BIT(MIB_COL_A_PORT_IMPORTANCE) | MIB_BIT(MIB_COL_A_LOCKED_TIME) | \
+			MIB_BIT(MIB_COL_A_LOCKED_INSERTED) | \
+			MIB_BIT(MIB_COL_A_LOCKED_DROPPED) | MIB_BIT(MIB_COL_US_STATE) | \
+			MIB_BIT(MIB_COL_N_PORT_STATE) | MIB_BIT(MIB_COL_N_PORT_PARTNER))
+
+
+// one line in the window
+struct XptRow {
+	void * unit;		// the unit it describes; NULL if not clickable
+	int port;			// -1 for the header line with the unit's name
+	std::string text;
+	int indent;			// in units of 5 characters
+	uint32_t colour;
+	uint32_t bk_colour;
+	int gap;			// extra space after the line, in half lines
+	bool media;			// a media port, which is highlighted if selected
+	int y;				// top of the line, set by <CrosspointModel::Layout>
+
+	XptRow() { unit = NULL; port = -1; indent = 0; colour = 0;
+						bk_colour = 0xFFFFFF; gap = 0; media = false; y = 0; }
+};
+
+
+// everything a unit's block depends on apart from what is in its own MIB
+//		and the MIBs of other units, which are represented by revision
+//		counts (see <MgtSocket::xpt_revision> and <theApp.xpt_revision>)
+#define XPT_KEY_STATES	5
+struct XptKey {
+	unsigned unit_rev;
+	unsigned global_rev;
+	int state[XPT_KEY_STATES];
+	bool always;		// the block depends on things that aren't counted
+
+	bool operator==(const XptKey& k) const;
+};
+
+
+class CrosspointModel
+{
+public:
+	CrosspointModel() { line_height = 0; moved = false; end = -1; }
+
+		// whether the block for slot <i> (index in <theApp.units>) was built
+		//		for unit <u> with key <k>
+	bool IsCurrent(int i, void * u, const XptKey& k) const;
+		// empty the block for slot <i> and record <u> and <k> for it; the
+		//		caller then adds the rows
+	std::vector<XptRow>& NewRows(int i, void * u, const XptKey& k);
+		// empty the block for slot <i>, e.g. because the slot is unused
+	void Clear(int i);
+		// forget the blocks for slots <n> onwards
+	void Truncate(int n);
+		// set to NULL any pointers to <u>, so that its rows are no longer
+		//		clickable and its block will be rebuilt
+	void RemoveUnit(void * u);
+		// forget everything, e.g. if the privilege level has changed
+	void RemoveAll() { blocks.clear(); lines.clear(); clickable.clear(); 
+																end = -1; }
+
+		// set <y> for each row, starting at <top>, and rebuild the index;
+		//		<line_height> is the height of one line in pixels
+		// returns the y value below the last row
+	int Layout(int top, int line_height);
+		// whether any unit's block has moved or changed size, or the end of 
+		//		the list has moved, in the most recent <Layout>
+	bool Moved() const { return moved; }
+		// the top and bottom of the block for unit <u> after the most recent 
+		//		<Layout>; false if it isn't shown
+	bool Extent(void * u, int& top, int& bottom) const;
+
+		// the rows in the order they are shown, after <Layout>
+	const std::vector<const XptRow *>& Lines() const { return lines; }
+		// index in <Lines()> of the first row whose bottom is below <y>
+	int FirstVisible(int y) const;
+		// the clickable row nearest to <y>, which is the click position
+		//		less half a line so that clicking on the middle of a line
+		//		gives the <y> for that line; NULL if there are no clickable
+		//		rows
+	const XptRow * Nearest(int y) const;
+
+private:
+	struct Block {
+		void * unit;
+		XptKey key;
+		std::vector<XptRow> rows;
+		int top;			// as set by <Layout>
+		int bottom;
+	};
+	std::vector<Block> blocks;	// indexed by slot
+	int line_height;
+	bool moved;
+	int end;			// y value returned by the most recent <Layout>
+	std::vector<const XptRow *> lines;
+	std::vector<const XptRow *> clickable;	// those with <unit> not NULL
+};
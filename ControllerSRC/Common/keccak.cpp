@@ -0,0 +1,326 @@
+/* -------------------------------------------------------------------------
+* Works when compiled for either 32-bit or 64-bit targets, optimized for 
+* 64 bit.
+*
+* Canonical implementation of Init/Update/Finalize for SHA-3 byte input. 
+*
+* SHA3-256, SHA3-384, SHA-512 are implemented. SHA-224 can easily be added.
+*
+* Based on code from http://keccak.noekeon.org/ .
+*
+* I place the code that I wrote into public domain, free to use. 
+*
+* I would appreciate if you give credits to this work if you used it to 
+* write or test * your code.
+*
+* Aug 2015. Andrey Jivsov. crypto@brainhub.org
+* ---------------------------------------------------------------------- */
+
+/* Ported to C++ and tailored to Aubergine passwords
+* 
+* Modifications (c)2022 Nine Tiles */
+
+/*
+ *  keccak.cpp
+ *  Keccak-f[1600] permutation, formerly in SHA3.cpp in the Windows project;
+ *		here so that it can be checked outside the Windows build
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "keccak.h"
+
+#if defined(_MSC_VER)
+#define SHA3_CONST(x) x
+#else
+#define SHA3_CONST(x) x##L
+#endif
+
+#ifndef SHA3_ROTL64
+#define SHA3_ROTL64(x, y) \
+	(((x) << (y)) | ((x) >> ((sizeof(uint64_t)*8) - (y))))
+#endif
+
+static const uint64_t keccakf_rndc[24] = {
+    SHA3_CONST(0x0000000000000001UL), SHA3_CONST(0x0000000000008082UL),
+    SHA3_CONST(0x800000000000808aUL), SHA3_CONST(0x8000000080008000UL),
+    SHA3_CONST(0x000000000000808bUL), SHA3_CONST(0x0000000080000001UL),
+    SHA3_CONST(0x8000000080008081UL), SHA3_CONST(0x8000000000008009UL),
+    SHA3_CONST(0x000000000000008aUL), SHA3_CONST(0x0000000000000088UL),
+    SHA3_CONST(0x0000000080008009UL), SHA3_CONST(0x000000008000000aUL),
+    SHA3_CONST(0x000000008000808bUL), SHA3_CONST(0x800000000000008bUL),
+    SHA3_CONST(0x8000000000008089UL), SHA3_CONST(0x8000000000008003UL),
+    SHA3_CONST(0x8000000000008002UL), SHA3_CONST(0x8000000000000080UL),
+    SHA3_CONST(0x000000000000800aUL), SHA3_CONST(0x800000008000000aUL),
+    SHA3_CONST(0x8000000080008081UL), SHA3_CONST(0x8000000000008080UL),
+    SHA3_CONST(0x0000000080000001UL), SHA3_CONST(0x8000000080008008UL)
+};
+
+static const unsigned keccakf_rotc[24] = {
+    1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62,
+    18, 39, 61, 20, 44
+};
+
+static const unsigned keccakf_piln[24] = {
+    10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20,
+    14, 22, 9, 6, 1
+};
+
+
+/* generally called after KECCAK_WORDS-ctx->capacityWords words 
+* are XORed into the state s 
+*/
+void Keccakf(uint64_t s[KECCAK_WORDS])
+{
+    int i, j, round;
+    uint64_t t, bc[5];
+#define KECCAK_ROUNDS 24
+
+    for(round = 0; round < KECCAK_ROUNDS; round++) {
+
+        /* Theta */
+        for(i = 0; i < 5; i++)
+            bc[i] = s[i] ^ s[i + 5] ^ s[i + 10] ^ s[i + 15] ^ s[i + 20];
+
+        for(i = 0; i < 5; i++) {
+            t = bc[(i + 4) % 5] ^ SHA3_ROTL64(bc[(i + 1) % 5], 1);
+            for(j = 0; j < 25; j += 5)
+                s[j + i] ^= t;
+        }
+
+        /* Rho Pi */
+        t = s[1];
+        for(i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            bc[0] = s[j];
+            s[j] = SHA3_ROTL64(t, keccakf_rotc[i]);
+            t = bc[0];
+        }
+
+        /* Chi */
+        for(j = 0; j < 25; j += 5) {
+            for(i = 0; i < 5; i++)
+                bc[i] = s[j + i];
+            for(i = 0; i < 5; i++)
+                s[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        }
+
+        /* Iota */
+        s[0] ^= keccakf_rndc[round];
+    }
+}
+
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#define KECCAK_USE_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KECCAK_TARGET(x)
+#else
+    /* each kernel is compiled for its own instruction set, whatever -m 
+    * options the rest of the program has, and is only called if 
+    * <KeccakSimdLevel> says the processor has it 
+    */
+#define KECCAK_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+
+/* the processor must support the instructions and the OS must save the 
+* registers (XCR0 bits 1-2 for YMM, 5-7 as well for ZMM) 
+*/
+int KeccakSimdLevel()
+{
+#if !defined(KECCAK_USE_SIMD)
+    return KECCAK_SIMD_NONE;
+#elif defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    if (r[0] < 1) return KECCAK_SIMD_NONE;
+    int max_leaf = r[0];
+    __cpuid(r, 1);
+    int level = (r[3] & (1 << 26)) ? KECCAK_SIMD_SSE2 : KECCAK_SIMD_NONE;
+    if (level == KECCAK_SIMD_NONE || max_leaf < 7 || 
+                (r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0) return level;
+    unsigned __int64 xcr0 = _xgetbv(0);
+    if ((xcr0 & 6) != 6) return level;
+    __cpuidex(r, 7, 0);
+    unless (r[1] & (1 << 5)) return level;
+    level = KECCAK_SIMD_AVX2;
+    if ((r[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6) level = KECCAK_SIMD_AVX512;
+    return level;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return KECCAK_SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return KECCAK_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return KECCAK_SIMD_SSE2;
+    return KECCAK_SIMD_NONE;
+#endif
+}
+
+#ifdef KECCAK_USE_SIMD
+
+/* the kernels all follow the same steps as <Keccakf>, on states <o> to 
+* <o> + (width - 1) 
+*/
+KECCAK_TARGET("sse2")
+static void keccakf_sse2(uint64_t s[KECCAK_WORDS][KECCAK_MAX_LANES], 
+                                                                        int o)
+{
+#define SSE2_ROTL64(x, y) _mm_or_si128(_mm_slli_epi64((x), (y)), \
+                                            _mm_srli_epi64((x), 64 - (y)))
+    __m128i a[25], bc[5], t, u;
+    int i, j, round;
+    for(i = 0; i < 25; i++) a[i] = _mm_loadu_si128((const __m128i *)&s[i][o]);
+
+    for(round = 0; round < KECCAK_ROUNDS; round++) {
+        for(i = 0; i < 5; i++)
+            bc[i] = _mm_xor_si128(_mm_xor_si128(a[i], a[i + 5]), 
+                    _mm_xor_si128(_mm_xor_si128(a[i + 10], a[i + 15]), a[i + 20]));
+        for(i = 0; i < 5; i++) {
+            t = _mm_xor_si128(bc[(i + 4) % 5], SSE2_ROTL64(bc[(i + 1) % 5], 1));
+            for(j = 0; j < 25; j += 5)
+                a[j + i] = _mm_xor_si128(a[j + i], t);
+        }
+        t = a[1];
+        for(i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            u = a[j];
+            a[j] = SSE2_ROTL64(t, keccakf_rotc[i]);
+            t = u;
+        }
+        for(j = 0; j < 25; j += 5) {
+            for(i = 0; i < 5; i++)
+                bc[i] = a[j + i];
+            for(i = 0; i < 5; i++)
+                a[j + i] = _mm_xor_si128(bc[i], 
+                        _mm_andnot_si128(bc[(i + 1) % 5], bc[(i + 2) % 5]));
+        }
+        a[0] = _mm_xor_si128(a[0], 
+                        _mm_set1_epi64x((long long)keccakf_rndc[round]));
+    }
+
+    for(i = 0; i < 25; i++) _mm_storeu_si128((__m128i *)&s[i][o], a[i]);
+}
+
+
+KECCAK_TARGET("avx2")
+static void keccakf_avx2(uint64_t s[KECCAK_WORDS][KECCAK_MAX_LANES], 
+                                                                        int o)
+{
+#define AVX2_ROTL64(x, y) _mm256_or_si256(_mm256_slli_epi64((x), (y)), \
+                                            _mm256_srli_epi64((x), 64 - (y)))
+    __m256i a[25], bc[5], t, u;
+    int i, j, round;
+    for(i = 0; i < 25; i++) a[i] = _mm256_loadu_si256((const __m256i *)&s[i][o]);
+
+    for(round = 0; round < KECCAK_ROUNDS; round++) {
+        for(i = 0; i < 5; i++)
+            bc[i] = _mm256_xor_si256(_mm256_xor_si256(a[i], a[i + 5]), 
+                _mm256_xor_si256(_mm256_xor_si256(a[i + 10], a[i + 15]), a[i + 20]));
+        for(i = 0; i < 5; i++) {
+            t = _mm256_xor_si256(bc[(i + 4) % 5], AVX2_ROTL64(bc[(i + 1) % 5], 1));
+            for(j = 0; j < 25; j += 5)
+                a[j + i] = _mm256_xor_si256(a[j + i], t);
+        }
+        t = a[1];
+        for(i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            u = a[j];
+            a[j] = AVX2_ROTL64(t, keccakf_rotc[i]);
+            t = u;
+        }
+        for(j = 0; j < 25; j += 5) {
+            for(i = 0; i < 5; i++)
+                bc[i] = a[j + i];
+            for(i = 0; i < 5; i++)
+                a[j + i] = _mm256_xor_si256(bc[i], 
+                        _mm256_andnot_si256(bc[(i + 1) % 5], bc[(i + 2) % 5]));
+        }
+        a[0] = _mm256_xor_si256(a[0], 
+                        _mm256_set1_epi64x((long long)keccakf_rndc[round]));
+    }
+
+    for(i = 0; i < 25; i++) _mm256_storeu_si256((__m256i *)&s[i][o], a[i]);
+}
+
+
+/* AVX-512 has a rotate instruction, and "ternary logic" does Chi in one; the 
+* rotates are the zero-masking forms (with all lanes selected) because GCC 
+* warns about the unmasked ones in a function with a target attribute 
+*/
+#define AVX512_ALL ((__mmask8)0xFF)
+KECCAK_TARGET("avx512f")
+static void keccakf_avx512(uint64_t s[KECCAK_WORDS][KECCAK_MAX_LANES])
+{
+    __m512i a[25], bc[5], t, u;
+    int i, j, round;
+    for(i = 0; i < 25; i++) a[i] = _mm512_loadu_si512((const void *)&s[i][0]);
+
+    for(round = 0; round < KECCAK_ROUNDS; round++) {
+        for(i = 0; i < 5; i++)
+            bc[i] = _mm512_ternarylogic_epi64(_mm512_xor_si512(a[i], a[i + 5]), 
+                    _mm512_xor_si512(a[i + 10], a[i + 15]), a[i + 20], 0x96);
+        for(i = 0; i < 5; i++) {
+            t = _mm512_xor_si512(bc[(i + 4) % 5], 
+                        _mm512_maskz_rol_epi64(AVX512_ALL, bc[(i + 1) % 5], 1));
+            for(j = 0; j < 25; j += 5)
+                a[j + i] = _mm512_xor_si512(a[j + i], t);
+        }
+        t = a[1];
+        for(i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            u = a[j];
+            a[j] = _mm512_maskz_rolv_epi64(AVX512_ALL, t, 
+                                        _mm512_set1_epi64(keccakf_rotc[i]));
+            t = u;
+        }
+        for(j = 0; j < 25; j += 5) {
+            for(i = 0; i < 5; i++)
+                bc[i] = a[j + i];
+                /* 0xD2 is a ^ (~b & c) */
+            for(i = 0; i < 5; i++)
+                a[j + i] = _mm512_ternarylogic_epi64(bc[i], bc[(i + 1) % 5], 
+                                                    bc[(i + 2) % 5], 0xD2);
+        }
+        a[0] = _mm512_xor_si512(a[0], 
+                        _mm512_set1_epi64((long long)keccakf_rndc[round]));
+    }
+
+    for(i = 0; i < 25; i++) _mm512_storeu_si512((void *)&s[i][0], a[i]);
+}
+#endif
+
+
+/* states left over (e.g. the 5th of 5 with AVX2) are done with a narrower 
+* kernel 
+*/
+void KeccakfLanes(uint64_t s[KECCAK_WORDS][KECCAK_MAX_LANES], int n, 
+                                                            int max_level)
+{
+    ASSERT(n >= 0 && n <= KECCAK_MAX_LANES);
+    int o = 0;
+#ifdef KECCAK_USE_SIMD
+    static int simd = -1;
+    if (simd < 0) simd = KeccakSimdLevel();
+    int level = simd < max_level ? simd : max_level;
+    if (n > 4 && level >= KECCAK_SIMD_AVX512) {
+        keccakf_avx512(s);
+        return;
+    }
+    if (level >= KECCAK_SIMD_AVX2) 
+        for(; n - o > 2; o += 4) keccakf_avx2(s, o);
+    if (level >= KECCAK_SIMD_SSE2) 
+        for(; n - o > 1; o += 2) keccakf_sse2(s, o);
+#endif
+    uint64_t t[KECCAK_WORDS];
+    int i;
+    for(; o < n; o++) {
+        for(i = 0; i < KECCAK_WORDS; i++) t[i] = s[i][o];
+        Keccakf(t);
+        for(i = 0; i < KECCAK_WORDS; i++) s[i][o] = t[i];
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ *  keccak.h
+ *  Keccak-f[1600] permutation for the SHA-3 password hashes, for one state
+ *		or several at once
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+
+// A state is 25 64-bit words; <KeccakfLanes> permutes up to KECCAK_MAX_LANES
+//		states at once, word <i> of state <j> being in <s[i][j]>, so that
+//		the same word of each state is in consecutive locations and can be
+//		loaded into one SIMD register
+// The instruction set is chosen on the first call from what the processor
+//		supports (each kernel is compiled for its own instruction set, so
+//		the rest of the program doesn't need e.g. -mavx512f); all give
+//		exactly the same results as <Keccakf>
+
+#define KECCAK_WORDS		25
+#define KECCAK_MAX_LANES	 8
+
+	// values for <KeccakSimdLevel> and <max_level>
+#define KECCAK_SIMD_NONE	0
+#define KECCAK_SIMD_SSE2	1
+#define KECCAK_SIMD_AVX2	2
+#define KECCAK_SIMD_AVX512	3
+
+void Keccakf(uint64_t s[KECCAK_WORDS]);
+	// <max_level> is for checks which compare the kernels
+void KeccakfLanes(uint64_t s[KECCAK_WORDS][KECCAK_MAX_LANES], int n,
+										int max_level = KECCAK_SIMD_AVX512);
+	// the highest that the processor and OS support
+int KeccakSimdLevel();
@@ -0,0 +1,85 @@
+/*
+ *  label_registry.cpp
+ *  allocation of flow labels to management sockets
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "label_registry.h"
+
+
+LabelRegistry::LabelRegistry()
+{
+	Entry e;
+	e.p = NULL;
+	e.next = -1;
+	e.gen = 0;
+	slab.push_back(e);	// the signalling flow
+	free_head = -1;
+	free_tail = -1;
+}
+
+
+// a new entry is only added to the slab if there are no free ones
+int LabelRegistry::Allocate(void * p)
+{
+	int n = free_head;
+	if (n >= 0) {
+		free_head = slab[n].next;
+		if (free_head < 0) free_tail = -1;
+	}
+	else {
+		n = (int)slab.size();
+		if (n > LABEL_MAX) return -1;
+		Entry e;
+		e.gen = 0;
+		slab.push_back(e);
+	}
+	slab[n].p = p;
+	slab[n].next = -1;
+	return n;
+}
+
+
+void LabelRegistry::Free(int label)
+{
+	if (label <= 0 || label >= (int)slab.size()) return;
+	Entry& e = slab[label];
+	if (e.p == NULL) return;
+	e.p = NULL;
+	e.gen = (e.gen + 1) & ((1 << LABEL_GEN_BITS) - 1);
+	e.next = -1;
+	if (free_tail >= 0) slab[free_tail].next = label;
+	else free_head = label;
+	free_tail = label;
+}
+
+
+void * LabelRegistry::Find(int label) const
+{
+	if (label <= 0 || label >= (int)slab.size()) return NULL;
+	return slab[label].p;
+}
+
+
+void * LabelRegistry::FindRef(int ref) const
+{
+	if (ref < 0) return NULL;
+	int label = ref & LABEL_MAX;
+	if (label == 0 || label >= (int)slab.size()) return NULL;
+	const Entry& e = slab[label];
+	unless (((ref >> LABEL_BITS) & ((1 << LABEL_GEN_BITS) - 1)) == e.gen)
+																return NULL;
+	return e.p;
+}
+
+
+int LabelRegistry::CallRef(int label) const
+{
+	if (label <= 0 || label >= (int)slab.size()) return 0;
+	return (slab[label].gen << LABEL_BITS) | label;
+}
@@ -0,0 +1,66 @@
+/*
+ *  label_registry.h
+ *  allocation of the flow labels on the link to the management sockets
+ *		(units and SCP sessions) that use them
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+
+// Each socket is given a label in the range 1 to LABEL_MAX, which is the
+//		label (without the CRC) on the packets it receives; label 0 is the
+//		signalling flow
+// Labels are held in a slab: an entry for each label up to the highest
+//		that has been used, with those not in use chained in a free list
+//		so that allocating and freeing take constant time; labels are
+//		reused oldest-freed first, to make it less likely that a late
+//		packet for a previous user of the label is taken as being for the
+//		current user
+// Each entry has a generation count which is incremented when the label
+//		is freed; the call reference (the low 16 bits of which are in the
+//		Route IE of signalling messages) carries the label in the bottom
+//		13 bits and the generation in the next 3, so a message for a
+//		previous call on the same label is rejected
+// Sockets are identified by pointers, as for <MibBus>
+
+#define LABEL_BITS		13
+#define LABEL_MAX		((1 << LABEL_BITS) - 1)
+#define LABEL_GEN_BITS	3
+
+
+class LabelRegistry
+{
+public:
+	LabelRegistry();
+
+		// allocate a label for <p>, which must not be NULL; returns -1 if
+		//		they are all in use
+	int Allocate(void * p);
+		// release <label>; does nothing if it isn't in use
+	void Free(int label);
+
+		// the socket using <label>, or NULL if none
+	void * Find(int label) const;
+		// the socket whose call reference has <ref> (which may have more
+		//		bits than the label and generation) in its ls 16 bits, NULL
+		//		if none
+	void * FindRef(int ref) const;
+		// the ls 16 bits of the call reference for the current user of
+		//		<label>
+	int CallRef(int label) const;
+
+		// one more than the highest label that has been allocated
+	int Limit() const { return (int)slab.size(); }
+
+private:
+	struct Entry {
+		void * p;			// NULL if free
+		int next;			// next in the free list, -1 if none
+		unsigned gen;
+	};
+	std::vector<Entry> slab;	// indexed by label; entry 0 not used
+	int free_head;		// oldest freed label, -1 if none
+	int free_tail;		// most recently freed
+};
@@ -0,0 +1,113 @@
+/*
+ *  link_core.cpp
+ *  platform-independent parts of the link to the gateway unit
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "link_core.h"
+
+
+// write the AES51 and IT headers for a data packet, see header
+void BuildItHeader(uint8_t * b, int len, int label, bool standard_format)
+{
+	BuildAes51Header(b, AES51_TYPE_IT_PACKET);
+	int n = AddHec(len + (standard_format ? -1 : 3));	// packet length
+	b[6] = (uint8_t)(n >> 8);
+	b[7] = (uint8_t)n;
+	b[8] = (uint8_t)(label >> 8);
+	b[9] = (uint8_t)label;
+}
+
+
+// write the AES51 header for a link control message
+void BuildAes51Header(uint8_t * b, uint8_t type)
+{
+	b[0] = 2;
+	b[1] = type;
+	b[2] = 0xFF;
+	b[3] = 0xFF;
+	b[4] = 0xFF;
+	b[5] = 0xFF;
+}
+
+
+// the CRCs are only needed where the length in the IT header is different 
+//		from the UDP length, but checking them all in one pass is cheaper 
+//		than deciding which to check; the datagrams are taken LINK_HEC_BATCH 
+//		at a time so that the arrays can be on the stack
+#define LINK_HEC_BATCH	32
+void CheckItPackets(DatagramRing& r, int n, bool standard_format)
+{
+	uint16_t h[LINK_HEC_BATCH];	// "length" field of each
+	uint8_t ok[LINK_HEC_BATCH];
+	int i = 0;
+	while (i < n) {
+		int k = n - i;
+		if (k > LINK_HEC_BATCH) k = LINK_HEC_BATCH;
+		int j;
+		for (j = 0; j < k; j++) {
+			Datagram& d = r.OldSlot(i + j);
+			h[j] = (d.len >= LINK_HDR_LEN) ? (uint16_t)((d.b[6] << 8) | d.b[7]) : 0;
+		}
+		CheckHecs(h, ok, k);
+
+		for (j = 0; j < k; j++) {
+			Datagram& d = r.OldSlot(i + j);
+			if (d.len < 6 || d.len >= LINK_DATAGRAM_SIZE || d.b[0] != 2 || 
+									d.b[1] != AES51_TYPE_IT_PACKET) continue;
+			if (d.len < LINK_HDR_LEN || (d.b[6] & 0xC0)) {
+					// too short, or not normal data
+					// +++ maybe should allow a preamble? spec doesn't say
+				d.len = -1;
+				continue;
+			}
+				// set <m> to length including AES51 header & IT header
+			int m = (h[j] >> 3) + (standard_format ? 11 : 7);
+			if (d.len == m) continue;
+				// length in IT header is different from UDP length
+			if (d.len < m || !ok[j]) d.len = -1;	// truncated or CRC error
+			else d.len = m;	// remove padding
+		}
+		i += k;
+	}
+}
+
+
+// ------------------------ class DatagramRing
+
+DatagramRing::DatagramRing(int n)
+{
+	size = 1;
+	while (size < n) size <<= 1;
+	mask = size - 1;
+	head = 0;
+	tail = 0;
+	slots = new Datagram[size];
+}
+
+
+DatagramRing::~DatagramRing()
+{
+	delete [] slots;
+}
+
+
+int DatagramRing::ContiguousSpace()
+{
+	int n = size - (int)(head & mask);	// slots before end of array
+	int k = Space();
+	return k < n ? k : n;
+}
+
+
+int DatagramRing::ContiguousCount()
+{
+	int n = size - (int)(tail & mask);
+	int k = Count();
+	return k < n ? k : n;
+}
@@ -0,0 +1,115 @@
+/*
+ *  link_core.h
+ *  platform-independent parts of the link to the gateway unit: AES51 and
+ *		IT packet framing, and a ring of preallocated datagram buffers
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "string_extras.h"
+
+// largest datagram we send or accept; same as MAX_REPLY_LENGTH in MgtSocket.h
+#define LINK_DATAGRAM_SIZE	1512
+// AES51 header (6 bytes) plus IT packet header (length and flow label)
+#define LINK_HDR_LEN		10
+// AES51 packet types
+#define AES51_TYPE_LINK_REQUEST		0x80
+#define AES51_TYPE_LINK_ACCEPT		0x81
+#define AES51_TYPE_LINK_REJECT		0x82
+#define AES51_TYPE_LINK_KEEPALIVE	0x84
+#define AES51_TYPE_IT_PACKET		0x26
+// UDP port number for AES51
+#define AES51_PORT	 35037
+// timeouts, in ms (see <CControllerApp::timers> and <Daemon::timers>)
+#define LINK_RCV_TIMEOUT_MS		7000
+#define LINK_KEEPALIVE_MS		2000
+// times to wait before sending a new Link Request
+// +++ TEMP: these are twice what was intended, as are the timeouts for the 
+//		management sessions (see mgt_core.h)
+#define LINK_RETRY_FAILED	10000	// after a failure in the sockets stack
+#define LINK_RETRY_WAIT		 2000	// after other failures
+#define LINK_ACCEPT_TIMEOUT	14000	// with no reply to the Link Request
+// state of the link (<LinkSocket::state>)
+#define LINK_ST_BEGIN	 0	// nothing done yet
+#define LINK_ST_REQ		 1	// Link Request sent
+#define LINK_ST_ACTIVE	 2	// Link Accept has been received
+#define LINK_ST_MAX_OK	 5	// codes above this are for "failed" states
+#define LINK_ST_CLOSED	 8	// target has disconnected
+#define LINK_ST_FAILED	 9	// call to base class (Create, Connect, Send) failed
+#define LINK_ST_ERROR	10	// any kind of protocol error
+
+
+// write the AES51 and IT headers for a data packet into <b>[0..9]
+// <len> is the number of bytes of payload, which should follow at <b>[10];
+//		<label> is the flow label including the CRC
+// if <standard_format> the IT length is coded as in ETSI GS NIN 005, else
+//		as used by legacy units (see <LinkSocket::standard_format>)
+extern void BuildItHeader(uint8_t * b, int len, int label, bool standard_format);
+
+// write the 6-byte AES51 header for a link control message (Link Reject,
+//		Link Keepalive, etc) of type <type> into <b>[0..5]
+extern void BuildAes51Header(uint8_t * b, uint8_t type);
+
+
+
+// a buffer for one datagram, big enough for the largest we accept plus a
+//		few bytes so that parsing code which overruns the end of a malformed
+//		message reads bytes within the buffer
+struct Datagram {
+	int len;			// bytes in <b>
+	uint32_t addr;		// IPv4 address (receive only; network byte order)
+	uint16_t port;		// UDP port (receive only; host byte order)
+	uint8_t b[LINK_DATAGRAM_SIZE + 16];
+};
+
+// ring of preallocated datagram buffers: the producer (e.g. a batched
+//		receive) fills slots starting at NewSlot(0) and then calls Added();
+//		the consumer processes slots starting at OldSlot(0) and then calls
+//		Removed()
+// no allocation takes place after construction, and slots are handed out
+//		in order so that a batch can be passed to a single system call
+class DatagramRing
+{
+public:
+		// <n> is rounded up to a power of 2
+#define LINK_RING_SIZE	64	// default number of slots
+	DatagramRing(int n = LINK_RING_SIZE);
+	~DatagramRing();
+
+		// number of slots holding datagrams, and number free
+	int Count() { return (int)(head - tail); }
+	int Space() { return size - (int)(head - tail); }
+
+		// the <i>th free slot (0 <= i < Space())
+	Datagram& NewSlot(int i) { return slots[(head + i) & mask]; }
+		// mark the first <n> free slots as holding datagrams
+	void Added(int n) { head += n; }
+		// the <i>th datagram (0 <= i < Count()), oldest first
+	Datagram& OldSlot(int i) { return slots[(tail + i) & mask]; }
+		// free the oldest <n> datagrams
+	void Removed(int n) { tail += n; }
+		// number of free slots that can be filled before wrapping round to
+		//		the start of the array, and similarly for datagrams waiting
+		//		to be processed; useful where a batch must be contiguous
+	int ContiguousSpace();
+	int ContiguousCount();
+
+private:
+	Datagram * slots;
+	int size;			// number of slots (a power of 2)
+	uint32_t mask;		// <size> - 1
+	uint32_t head;		// counts slots filled (wraps round)
+	uint32_t tail;		// counts slots freed (wraps round)
+};
+
+// check the IT headers of the AES51 type 0x26 packets among the first <n> 
+//		datagrams in <r> (starting with OldSlot(0)), with the CRCs for the 
+//		batch checked together by <CheckHecs>
+// the <len> of each is set to the length of the packet with any padding 
+//		removed, or to -1 if it should be ignored (not normal data, 
+//		truncated, or bad CRC on the length field); the flow label is not 
+//		checked, and other datagrams are left unchanged
+extern void CheckItPackets(DatagramRing& r, int n, bool standard_format);
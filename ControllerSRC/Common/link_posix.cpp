@@ -0,0 +1,244 @@
+/*
+ *  link_posix.cpp
+ *  POSIX sockets backend for the link to the gateway unit
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// Not part of the Windows build, which uses <CAsyncSocket> (see LinkSocket
+//		in MgtSocket.cpp)
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		// for recvmmsg and sendmmsg
+#endif
+#include "link_posix.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+LinkIoPosix::LinkIoPosix()
+{
+	fd = -1;
+	error = 0;
+}
+
+
+LinkIoPosix::~LinkIoPosix()
+{
+	Close();
+}
+
+
+bool LinkIoPosix::Open(uint16_t local_port, bool broadcast)
+{
+	struct sockaddr_in sa;
+	int opt = 1;
+
+	Close();
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) goto failed;
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) goto failed;
+	if (broadcast &&
+			setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &opt, sizeof(opt)) < 0)
+																goto failed;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_ANY);
+	sa.sin_port = htons(local_port);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) goto failed;
+	return true;
+
+failed:
+	error = errno;
+	Close();
+	return false;
+}
+
+
+void LinkIoPosix::Close()
+{
+	if (fd >= 0) close(fd);
+	fd = -1;
+}
+
+
+bool LinkIoPosix::Connect(uint32_t addr, uint16_t port)
+{
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = addr;
+	sa.sin_port = htons(port);
+	if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0) return true;
+	error = errno;
+	return false;
+}
+
+
+bool LinkIoPosix::SendTo(uint8_t * b, int len, uint32_t addr, uint16_t port)
+{
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = addr;
+	sa.sin_port = htons(port);
+	if (sendto(fd, b, len, 0, (struct sockaddr *)&sa, sizeof(sa)) == len)
+																return true;
+	error = errno;
+	return false;
+}
+
+
+// receive datagrams into the free slots of <r>; the ring may wrap round,
+//		so we fill up to the end of the array first and then, if that was
+//		filled, carry on from the start
+int LinkIoPosix::ReceiveBatch(DatagramRing& r)
+{
+	int total = 0;
+	int k, n;
+	while ((n = r.ContiguousSpace()) > 0) {
+		if (n > LINK_BATCH_MAX) n = LINK_BATCH_MAX;
+		k = ReceiveRun(r, n);
+		if (k < 0) return total > 0 ? total : -1;
+		total += k;
+		if (k < n) break;	// nothing more waiting
+	}
+	return total;
+}
+
+
+int LinkIoPosix::SendBatch(DatagramRing& r)
+{
+	int total = 0;
+	int k, n;
+	while ((n = r.ContiguousCount()) > 0) {
+		if (n > LINK_BATCH_MAX) n = LINK_BATCH_MAX;
+		k = SendRun(r, n);
+		if (k < 0) return -1;
+		total += k;
+		if (k < n) break;	// socket buffer full
+	}
+	return total;
+}
+
+
+#ifdef __linux__
+
+// receive up to <n> datagrams into contiguous free slots of <r>
+int LinkIoPosix::ReceiveRun(DatagramRing& r, int n)
+{
+	struct mmsghdr msgs[LINK_BATCH_MAX];
+	struct iovec iov[LINK_BATCH_MAX];
+	struct sockaddr_in sa[LINK_BATCH_MAX];
+	int i = 0;
+	memset(msgs, 0, sizeof(msgs[0]) * n);
+	while (i < n) {
+		Datagram& d = r.NewSlot(i);
+		iov[i].iov_base = d.b;
+		iov[i].iov_len = LINK_DATAGRAM_SIZE;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &sa[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(sa[i]);
+		i += 1;
+	}
+
+	int k = recvmmsg(fd, msgs, n, MSG_DONTWAIT, NULL);
+	if (k < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+		error = errno;
+		return -1;
+	}
+
+	i = 0;
+	while (i < k) {
+		Datagram& d = r.NewSlot(i);
+		d.len = (int)msgs[i].msg_len;
+		d.addr = sa[i].sin_addr.s_addr;
+		d.port = ntohs(sa[i].sin_port);
+		i += 1;
+	}
+	r.Added(k);
+	return k;
+}
+
+
+// send the oldest <n> datagrams in <r>, which must be contiguous
+int LinkIoPosix::SendRun(DatagramRing& r, int n)
+{
+	struct mmsghdr msgs[LINK_BATCH_MAX];
+	struct iovec iov[LINK_BATCH_MAX];
+	int i = 0;
+	memset(msgs, 0, sizeof(msgs[0]) * n);
+	while (i < n) {
+		Datagram& d = r.OldSlot(i);
+		iov[i].iov_base = d.b;
+		iov[i].iov_len = d.len;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		i += 1;
+	}
+
+	int k = sendmmsg(fd, msgs, n, MSG_DONTWAIT);
+	if (k < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+		error = errno;
+		return -1;
+	}
+	r.Removed(k);
+	return k;
+}
+
+#else
+
+// no recvmmsg or sendmmsg (e.g. macOS): one system call per datagram, but
+//		still no allocation or copying
+
+int LinkIoPosix::ReceiveRun(DatagramRing& r, int n)
+{
+	struct sockaddr_in sa;
+	socklen_t sa_len;
+	ssize_t len;
+	int i = 0;
+	while (i < n) {
+		Datagram& d = r.NewSlot(0);
+		sa_len = sizeof(sa);
+		len = recvfrom(fd, d.b, LINK_DATAGRAM_SIZE, MSG_DONTWAIT,
+										(struct sockaddr *)&sa, &sa_len);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+			error = errno;
+			return i > 0 ? i : -1;
+		}
+		d.len = (int)len;
+		d.addr = sa.sin_addr.s_addr;
+		d.port = ntohs(sa.sin_port);
+		r.Added(1);
+		i += 1;
+	}
+	return i;
+}
+
+
+int LinkIoPosix::SendRun(DatagramRing& r, int n)
+{
+	int i = 0;
+	while (i < n) {
+		Datagram& d = r.OldSlot(0);
+		if (send(fd, d.b, d.len, MSG_DONTWAIT) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+			error = errno;
+			return -1;
+		}
+		r.Removed(1);
+		i += 1;
+	}
+	return i;
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ *  link_posix.h
+ *  POSIX sockets backend for the link to the gateway unit: moves batches
+ *		of datagrams between a UDP socket and a <DatagramRing>, using
+ *		recvmmsg and sendmmsg where available (Linux) so that a burst of
+ *		packets needs only one system call
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "link_core.h"
+
+class LinkIoPosix
+{
+public:
+	LinkIoPosix();
+	~LinkIoPosix();
+
+		// open a non-blocking UDP socket bound to <local_port> (0 for any
+		//		port); if <broadcast> it is allowed to send broadcasts
+		// returns whether successful; if not, <error> holds the <errno> value
+	bool Open(uint16_t local_port = 0, bool broadcast = false);
+	void Close();
+		// send subsequent datagrams to, and only accept them from, the given
+		//		address (network byte order) and port (host byte order)
+	bool Connect(uint32_t addr, uint16_t port);
+		// send a single datagram, e.g. the Link Request, which may be
+		//		broadcast (<addr> = INADDR_BROADCAST)
+	bool SendTo(uint8_t * b, int len, uint32_t addr, uint16_t port);
+
+		// receive as many datagrams as are waiting, up to the space in <r>,
+		//		without blocking; <addr> and <port> are set in each
+		// returns the number received (0 if none waiting) or -1 if an error
+		//		occurred, in which case any received before the error are
+		//		still added to <r>
+	int ReceiveBatch(DatagramRing& r);
+		// send the datagrams in <r> on the connected socket, removing those
+		//		that have been sent; stops without error if the socket's
+		//		buffer is full
+		// returns the number sent or -1 if an error occurred
+	int SendBatch(DatagramRing& r);
+
+		// the file descriptor, e.g. for <poll> or <epoll>; -1 if not open
+	int Handle() { return fd; }
+
+	int error;		// <errno> from the last call that failed
+
+private:
+	int fd;
+#define LINK_BATCH_MAX	32	// max datagrams per system call
+	int ReceiveRun(DatagramRing& r, int n);
+	int SendRun(DatagramRing& r, int n);
+};
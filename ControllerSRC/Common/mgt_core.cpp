@@ -0,0 +1,494 @@
+/*
+ *  mgt_core.cpp
+ *  platform-independent parts of the management protocol
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "mgt_core.h"
+
+
+// return the length of the tag + length fields and of the value, given <b> 
+//		pointing to the tag; there are <len> bytes available in the message
+ValueSizes ParseLength(uint8_t * b, int len)
+{
+	ValueSizes v;
+	if (len < 2) goto error;
+	v.len = b[1];
+	if (v.len < 0x80) {
+			// "length" field is the 7-bit form
+		if (len < v.len + 2) goto error;
+		v.hd_len = 2;	// length of tag + length
+		return v;
+	}
+
+	switch (v.len) {
+			// the only others we support are the 8-bit and 16-bit forms
+case 0x81:
+		if (len < 3) break;
+		v.len = b[2];
+		if (len < v.len + 3) goto error;
+		v.hd_len = 3;
+		return v;
+
+case 0x82:
+		if (len < 4) break;
+		v.len = (b[2] << 8) | b[3];
+		if (len < v.len + 4) goto error;
+		v.hd_len = 4;
+		return v;
+	}
+
+error:	// here if can't parse
+	v.hd_len = -1;
+	v.len = -1;
+	return v;
+}
+
+
+// set <value> from the value part of an ASN.1 INTEGER, see header
+bool Asn1IntegerValue(uint8_t * b, int len, int& value)
+{
+	switch (len) {
+case 1:
+		value = (char)(b[0]); // cast to signed so will sign extend
+		return true;
+
+case 2:
+		value = ((char)(b[0]) << 8) | b[1];
+		return true;
+
+case 3:
+		value = ((char)(b[0]) << 16) | (b[1] << 8) | b[2];
+		return true;
+
+case 4:
+		value = (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+		return true;
+	}
+	return false;
+}
+
+
+// ------------------------ class VarBindReader
+
+// read the next VarBind; the checks are the same as when a <MibObject> is 
+//		constructed from a message, i.e. the OID must have the right tag and 
+//		the first and last bytes must have their top bits clear
+// nothing is copied, and <p> and <len> are only updated if it's OK
+bool VarBindReader::Next(VarBindView& v)
+{
+	ValueSizes sz = ParseLength(p, len);
+	if (sz.hd_len < 0 || p[0] != ASN1_TAG_OID || sz.len == 0) return false;
+	v.oid = p + sz.hd_len;
+	v.oid_len = sz.len;
+	if ((v.oid[0] & 0x80) || (v.oid[sz.len - 1] & 0x80)) return false;
+
+	uint8_t * q = v.oid + sz.len;	// -> tag of the value
+	int n = len - (sz.hd_len + sz.len);
+	sz = ParseLength(q, n);
+	if (sz.hd_len < 0) return false;
+	v.tag = q[0];
+	v.val = q + sz.hd_len;
+	v.val_len = sz.len;
+	v.value = 0;
+	if (v.tag == ASN1_TAG_INTEGER && 
+			!Asn1IntegerValue(v.val, v.val_len, v.value)) 
+										v.tag = TAG_INTEGER_OUT_OF_RANGE;
+
+	p = v.val + sz.len;
+	len = n - (sz.hd_len + sz.len);
+	return true;
+}
+
+
+// decode the arcs in the <len> bytes at <b> into <arcs>, see header
+int OidArcs(const uint8_t * b, int len, int * arcs, int max)
+{
+	int k = 0;	// counts arcs
+	int n;
+	int i = 0;
+	while (i < len) {
+		if (k >= max) return -1;
+		n = 0;
+		do {
+			if (n >= (1 << 24) || i >= len) return -1;	// would overflow
+			n = (n << 7) | (b[i] & 0x7F);
+		} while (b[i++] & 0x80);
+		arcs[k++] = n;
+	}
+	return k;
+}
+
+
+// arcs are coded in the fewest bytes, so a longer coding is a larger arc, 
+//		and codings of the same length compare as bytes; an OID comes before 
+//		any that it's a prefix of
+int OidCompare(const uint8_t * a, int a_len, const uint8_t * b, int b_len)
+{
+	int i = 0;
+	int j = 0;
+	while (i < a_len && j < b_len) {
+		int m = i;
+		int n = j;
+		while (m < a_len - 1 && (a[m] & 0x80)) m += 1;
+		while (n < b_len - 1 && (b[n] & 0x80)) n += 1;
+		if (m - i != n - j) return (m - i) - (n - j);
+		int c = memcmp(a + i, b + j, m - i + 1);
+		if (c != 0) return c;
+		i = m + 1;
+		j = n + 1;
+	}
+	return (a_len - i) - (b_len - j);
+}
+
+
+// the arcs from byte <i> onwards in dotted-decimal form (without a leading 
+//		dot), e.g. for use as a key in <output_flows>
+std::string VarBindView::IndexString(int i)
+{
+	std::string s;
+	uint32_t n;
+	while (i < oid_len) {
+		n = 0;
+		do n = (n << 7) | (oid[i] & 0x7F); while ((oid[i++] & 0x80) && i < oid_len);
+		unless (s.empty()) s += '.';
+		s += ToUnsigned(n);
+	}
+	return s;
+}
+
+
+// copy the OID into a message (including tag and length)
+// length uses the shortest form it can; assumes there is enough room
+// NB uses <memmove> in case <p> is in the message from which <oid> was read
+int VarBindView::CopyOid(uint8_t * p)
+{
+	uint8_t * p0 = p;
+	*p++ = ASN1_TAG_OID;
+	if (oid_len < 128) *p++ = (uint8_t)oid_len;
+	else if (oid_len < 256) { *p++ = 0x81; *p++ = (uint8_t)oid_len; }
+	else { *p++ = 0x82; *p++ = (uint8_t)(oid_len >> 8); *p++ = (uint8_t)oid_len; }
+	memmove(p, oid, oid_len);
+	return (int)(p - p0) + oid_len;
+}
+
+
+// append the value to <b> in the format for an index in an OID; returns 
+//		<true> if OK, <false> with <b> unchanged else
+// currently only copes with octet strings and positive 32-bit integers
+bool VarBindView::AppendAsIndexTo(ByteString & b, const uint8_t * extra, 
+																int extra_len) {
+	int i, n;
+	uint8_t c;
+	switch (tag) {
+case ASN1_TAG_INTEGER:
+		i = value;
+		if (i < 0) return false;
+			// set <n> to 7 * ((bytes to add) - 1)
+		n = 0;
+		while (i >= (128 << n) && n < 28) n += 7;
+		while (n > 0) { b.push_back((i >> n) | 0x80); n -= 7; }
+		b.push_back(i & 0x7F);
+		return true;
+
+case ASN1_TAG_OCTET_STRING:
+		n = val_len + extra_len;
+		if (n > 0x3FF) return false; // length is silly
+		if (n > 0x7F) b.push_back((n >> 7) | 0x80);
+		b.push_back(n & 0x7F);
+		i = 0;
+		while (i < n) {
+			c = (i < val_len) ? val[i] : extra[i - val_len];
+			if (c & 0x80) b.push_back(0x81);
+			b.push_back(c & 0x7F);
+			i += 1;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+// return the BER coding (excluding tag and length) of OID <s>, which is 
+//		in dotted-decimal form; result is empty if <s> isn't a valid OID
+// only used for OIDs supplied as text, e.g. by the display code, and not 
+//		when processing incoming messages
+ByteString OidFromText(const char * s)
+{
+	ByteString b;
+	uint64_t arc[2];
+	uint64_t n;
+	int i = 0;	// counts arcs
+	int k;
+
+	while (true) {
+		unless (*s >= '0' && *s <= '9') goto error;
+		n = 0;
+		do n = n * 10 + (*s++ - '0'); while (*s >= '0' && *s <= '9');
+
+		if (i < 2) {
+				// first two arcs go in a single subidentifier
+			arc[i] = n;
+			if (i == 1) {
+				if (arc[0] > 2 || (arc[0] < 2 && arc[1] > 39)) goto error;
+				n = arc[0] * 40 + arc[1];
+			}
+		}
+		unless (i == 0) {
+				// set <k> to 7 * ((bytes to add) - 1)
+			k = 0;
+			while (k < 63 && (n >> k) >= 128) k += 7;
+			while (k > 0) { b.push_back((uint8_t)((n >> k) | 0x80)); k -= 7; }
+			b.push_back((uint8_t)(n & 0x7F));
+		}
+		i += 1;
+
+		if (*s == 0) break;
+		unless (*s++ == '.') goto error;
+	}
+	if (i >= 2) return b;
+
+error:
+	b.clear();
+	return b;
+}
+
+
+// as above for index arcs, each of which has its own subidentifier
+ByteString IndexFromText(const char * s)
+{
+	ByteString b;
+	uint64_t n;
+	int k;
+
+	while (true) {
+		unless (*s >= '0' && *s <= '9') goto error;
+		n = 0;
+		do n = n * 10 + (*s++ - '0'); while (*s >= '0' && *s <= '9');
+			// set <k> to 7 * ((bytes to add) - 1)
+		k = 0;
+		while (k < 63 && (n >> k) >= 128) k += 7;
+		while (k > 0) { b.push_back((uint8_t)((n >> k) | 0x80)); k -= 7; }
+		b.push_back((uint8_t)(n & 0x7F));
+
+		if (*s == 0) return b;
+		unless (*s++ == '.') goto error;
+	}
+
+error:
+	b.clear();
+	return b;
+}
+
+
+// ------------------------ OID dispatch
+
+// the OIDs for the MIB_COL_ codes, as the BER coding after the 1.0.62379 
+//		prefix; all the arcs are less than 128, so each is a single byte
+// the entries are in order of their codings, and none is a prefix of 
+//		another, so the only one that can match an OID is the last one that 
+//		isn't greater than it; also entry n is for code n+1, so MibColumnOid() 
+//		can index straight into the table (both checked by the static_assert 
+//		below)
+// entries for scalars include the final 0 arc, and only match exactly
+struct OidPrefix {
+	int col;			// MIB_COL_ code
+	int len;			// bytes in <ber>
+	uint8_t ber[8];
+};
+
+static constexpr OidPrefix oid_prefixes[] = {
+	{ MIB_COL_UNIT_NAME,			5, { 1, 1, 1, 1, 0 } },
+	{ MIB_COL_UNIT_LOCATION,		5, { 1, 1, 1, 2, 0 } },
+	{ MIB_COL_UNIT_ADDRESS,			5, { 1, 1, 1, 3, 0 } },
+	{ MIB_COL_PRODUCT_NAME,			5, { 1, 1, 1, 6, 0 } },
+	{ MIB_COL_FIRMWARE_VERSION,		5, { 1, 1, 1, 8, 0 } },
+	{ MIB_COL_UNIT_IDENTIFIER,		5, { 1, 1, 1, 16, 0 } },
+	{ MIB_COL_UNIT_TIMING,			4, { 1, 1, 4, 6 } },
+	{ MIB_COL_UNIT_SYNC,			4, { 1, 1, 4, 7 } },
+	{ MIB_COL_UNIT_FRAMING,			4, { 1, 1, 4, 8 } },
+	{ MIB_COL_A_PORT_DIRECTION,		6, { 2, 1, 1, 1, 1, 2 } },
+	{ MIB_COL_A_PORT_FORMAT,		6, { 2, 1, 1, 1, 1, 3 } },
+	{ MIB_COL_A_PORT_NAME,			6, { 2, 1, 1, 1, 1, 5 } },
+	{ MIB_COL_A_PORT_IMPORTANCE,	6, { 2, 1, 1, 1, 1, 6 } },
+	{ MIB_COL_A_LOCKED_TIME,		6, { 2, 1, 1, 4, 1, 2 } },
+	{ MIB_COL_A_LOCKED_INSERTED,	6, { 2, 1, 1, 4, 1, 3 } },
+	{ MIB_COL_A_LOCKED_DROPPED,		6, { 2, 1, 1, 4, 1, 4 } },
+	{ MIB_COL_V_PORT_DIRECTION,		6, { 3, 1, 1, 1, 1, 2 } },
+	{ MIB_COL_V_PORT_FORMAT,		6, { 3, 1, 1, 1, 1, 3 } },
+	{ MIB_COL_V_PORT_NAME,			6, { 3, 1, 1, 1, 1, 5 } },
+	{ MIB_COL_V_PORT_IMPORTANCE,	6, { 3, 1, 1, 1, 1, 6 } },
+	{ MIB_COL_N_PORT_STATE,			7, { 5, 1, 1, 1, 1, 1, 3 } },
+	{ MIB_COL_N_PORT_ADDR_TYPE,		7, { 5, 1, 1, 1, 1, 1, 6 } },
+	{ MIB_COL_N_PORT_PARTNER_ADDR,	7, { 5, 1, 1, 1, 1, 1, 7 } },
+	{ MIB_COL_N_PORT_SCP_DEVICE,	7, { 5, 1, 1, 1, 1, 1, 9 } },
+	{ MIB_COL_N_PORT_VM_STATE,		7, { 5, 1, 1, 1, 1, 1, 10 } },
+	{ MIB_COL_N_PORT_PARTNER,		7, { 5, 1, 1, 1, 1, 1, 11 } },
+	{ MIB_COL_US_STATE,				7, { 5, 1, 1, 2, 1, 1, 7 } },
+	{ MIB_COL_UD_NET_BLOCK_ID,		7, { 5, 1, 1, 3, 3, 1, 2 } },
+	{ MIB_COL_UD_STATE,				7, { 5, 1, 1, 3, 3, 1, 9 } },
+	{ MIB_COL_UD_IMPORTANCE,		7, { 5, 1, 1, 3, 3, 1, 14 } },
+};
+#define OID_PREFIX_COUNT	((int)(sizeof(oid_prefixes) / sizeof(oid_prefixes[0])))
+static const uint8_t oid_prefix_62379[] = { 0x28, 0x83, 0xE7, 0x2B };
+
+// return whether <a> is before <b> and not a prefix of it
+static constexpr bool OidPrefixBefore(const OidPrefix& a, const OidPrefix& b)
+{
+	int i = 0;
+	while (i < a.len && i < b.len) {
+		if (a.ber[i] != b.ber[i]) return a.ber[i] < b.ber[i];
+		i += 1;
+	}
+	return false;
+}
+
+static constexpr bool OidPrefixesOK()
+{
+	int i = 0;
+	while (i < OID_PREFIX_COUNT) {
+		if (oid_prefixes[i].col != i + 1) return false;
+		if (oid_prefixes[i].len + (int)sizeof(oid_prefix_62379) > 
+										MIB_COL_MAX_OID_LEN) return false;
+		if (i > 0 && !OidPrefixBefore(oid_prefixes[i - 1], oid_prefixes[i])) 
+																return false;
+		i += 1;
+	}
+	return i + 1 == MIB_COL_COUNT;
+}
+
+static_assert(OidPrefixesOK(), "oid_prefixes[] out of order or doesn't match the MIB_COL_ codes");
+
+
+// return the MIB_COL_ code for <oid>, see header
+// binary search for the last entry that isn't greater than <oid>, then 
+//		check whether it's a prefix
+int ClassifyOid(const uint8_t * oid, int len, int& posn)
+{
+	int lo = 0;
+	int hi = OID_PREFIX_COUNT;
+	int i, n, c;
+	const int k = (int)sizeof(oid_prefix_62379);
+
+	if (len <= k || memcmp(oid, oid_prefix_62379, k) != 0) return MIB_COL_NONE;
+	oid += k;
+	len -= k;
+
+		// the entry we want is <lo> - 1, with all those from <hi> onwards 
+		//		greater than <oid>
+	while (lo < hi) {
+		i = (lo + hi) >> 1;
+		n = oid_prefixes[i].len;
+		c = memcmp(oid_prefixes[i].ber, oid, n < len ? n : len);
+		if (c < 0 || (c == 0 && n <= len)) lo = i + 1;
+		else hi = i;
+	}
+	if (lo == 0) return MIB_COL_NONE;
+
+	const OidPrefix& e = oid_prefixes[lo - 1];
+	if (e.len > len || memcmp(e.ber, oid, e.len) != 0) return MIB_COL_NONE;
+	if (e.ber[e.len - 1] == 0 && e.len != len) return MIB_COL_NONE;
+	posn = k + e.len;
+	return e.col;
+}
+
+
+// write the OID for code <col> to <b>, see header
+int MibColumnOid(int col, uint8_t * b)
+{
+	if (col <= MIB_COL_NONE || col >= MIB_COL_COUNT) return 0;
+	const OidPrefix& e = oid_prefixes[col - 1];
+	memcpy(b, oid_prefix_62379, sizeof(oid_prefix_62379));
+	memcpy(b + sizeof(oid_prefix_62379), e.ber, e.len);
+	return (int)sizeof(oid_prefix_62379) + e.len;
+}
+
+
+// build a FindRoute request, see header
+void BuildConnReq(ByteString& m, const char * owner, int call_ref, 
+					int privilege, const ByteString& called, const uint8_t * pw)
+{
+		// fixed part after the call ref, plus the DataType (for 
+		//		1.3.6.1.4.1.9940.2.2.4), PrivilegeLevel, AsyncAlloc (label 
+		//		filled in below), and FlowDescriptor IEs
+	static const uint8_t ies[] = { 2, 
+			5, 0, 10, 43, 6, 1, 4, 1, 0xCD, 0x54, 2, 2, 4, 
+			12, 0, 1, 0, 
+			20, 0, 2, 0, 0, 
+			4, 0, 4, 2, 0, 0, 1 };
+	int n = (int)called.size();
+	m.resize(14 + sizeof(ies) + (pw ? 15 : 0) + 3 + n);
+	m[0] = 8;		// FindRoute request
+	m[1] = 13;
+	memcpy(m.data() + 2, owner, 8);
+	m[10] = (uint8_t)(call_ref >> 24);
+	m[11] = (uint8_t)(call_ref >> 16);
+	m[12] = (uint8_t)(call_ref >> 8);
+	m[13] = (uint8_t)call_ref;
+	memcpy(m.data() + 14, ies, sizeof(ies));
+	m[31] = (uint8_t)privilege;
+	int rcv_label = AddHec(call_ref & 0x1FFF);
+	m[35] = (uint8_t)(rcv_label >> 8);
+	m[36] = (uint8_t)rcv_label;
+
+	int j = 14 + sizeof(ies);
+	if (pw) {
+			// Password IE
+		m[j++] = 13;
+		m[j++] = 0;
+		m[j++] = 12;
+		memcpy(m.data() + j, pw, 12);
+		j += 12;
+	}
+
+		// CalledAddress IE
+	m[j++] = 3;
+	m[j++] = 0;
+	m[j++] = (uint8_t)n;	// assumed < 256
+	memcpy(m.data() + j, called.data(), n);
+}
+
+
+// check unitIdentity, see header
+int CheckUnitIdentity(const uint8_t * b, int len, uint8_t * product_code)
+{
+	if (len < 9) return UPD_ST_NO_INFO;
+		// not a Nine Tiles product
+	if (b[0] != 0 || b[1] != 0x90 || b[2] != 0xA8) return UPD_ST_NOT_RECOGD;
+	if (product_code) memcpy(product_code, b + 5, 4);
+	return UPD_ST_BEGIN;
+}
+
+
+// ------------------------ class StatusCycle
+
+bool StatusCycle::Report(uint8_t seq, int64_t now)
+{
+	if (seq == 1) {
+			// first in a cycle
+		prev_report_time = now;
+		start_time = now - 2;
+		next_seq = 2;
+		return true;
+	}
+	if (seq == next_seq && next_seq > 1) {
+			// in-cycle Status report with the expected sequence number 
+			//		during an OK cycle
+			// check it's not so long after the previous packet that 
+			//		it might be part of a later cycle
+		if (now - prev_report_time > 10) next_seq = 0;
+		else {
+			prev_report_time = now;
+			if (next_seq == 0xFF) next_seq = 2;
+			else next_seq += 1;
+		}
+	}
+	else next_seq = 0;
+	return false;
+}
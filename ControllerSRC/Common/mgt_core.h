@@ -0,0 +1,310 @@
+/*
+ *  mgt_core.h
+ *  platform-independent parts of the management protocol: decoding the 
+ *		ASN.1 BER in management messages, recognising the objects that get 
+ *		special treatment, and the state codes for a management session
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "string_extras.h"
+
+#define PORT_TYPE_AUDIO		2
+#define PORT_TYPE_VIDEO		3
+
+// "direction" etc values for audio ports
+#define DIRECTION_IN	1
+#define DIRECTION_OUT	2
+#define AUDIO_FORMAT_UNKNOWN	 0	// not been reported or not recognised
+#define AUDIO_FORMAT_NONE		 1	// 1.0.62379.2.2.1.1
+#define AUDIO_FORMAT_ANALOGUE	 2	// 1.0.62379.2.2.1.2.a.c
+#define AUDIO_FORMAT_PCM		 3	// 1.0.62379.2.2.1.3.a.c.b.f
+#define AUDIO_FORMAT_INVALID	13	// 1.0.62379.2.2.1.13
+
+// values for the <tag> of an object
+#define TAG_INTEGER_OUT_OF_RANGE	-2 // tag was ASN1_TAG_INTEGER, length not 1-4
+#define TAG_INVALID					-1 // other fields not valid, byte array empty
+#define ASN1_TAG_INTEGER			 2
+#define ASN1_TAG_OCTET_STRING		 4
+#define ASN1_TAG_OID				 6
+
+
+// structure to hold the result of parsing the "length" field
+struct ValueSizes {
+	int hd_len;		// bytes of tag + length (-1 if invalid)
+	int len;		// bytes of value
+};
+
+extern ValueSizes ParseLength(uint8_t * b, int len);
+
+// set <value> from the <len> bytes at <b>, which are the value part of an 
+//		ASN.1 INTEGER; returns <false> (with <value> unchanged) if <len> is not 
+//		in the range 1 to 4
+extern bool Asn1IntegerValue(uint8_t * b, int len, int& value);
+
+// decode the arcs in the <len> bytes at <b> (which should be part of the BER 
+//		coding of an OID, not including the first two arcs) into <arcs>; 
+//		returns the number decoded, or -1 if any is too big for an <int> or 
+//		there are more than <max>
+extern int OidArcs(const uint8_t * b, int len, int * arcs, int max);
+
+// compare the BER codings (excluding tag and length) of two OIDs in the 
+//		"lexicographic order" used by GetNext; returns -ve, 0, or +ve as <a> 
+//		is before, the same as, or after <b>
+extern int OidCompare(const uint8_t * a, int a_len, const uint8_t * b, int b_len);
+
+// a VarBind in a received message; the pointers are into the message, so 
+//		the information is only valid while the message buffer is
+struct VarBindView {
+	uint8_t * oid;		// BER coding of the OID (excluding tag and length)
+	int oid_len;
+	uint8_t * val;		// the value (excluding tag and length)
+	int val_len;
+	int tag;			// as for <MibObject::tag>
+	int value;			// valid only if <tag> is ASN1_TAG_INTEGER
+
+		// value of an integer object (zero if not an integer)
+	int IntegerValue() { return (tag == ASN1_TAG_INTEGER) ? value : 0; }
+		// return whether the first <n> bytes of the OID are <prefix>
+	bool OidStartsWith(const uint8_t * prefix, int n) { 
+				return oid_len >= n && memcmp(oid, prefix, n) == 0; }
+		// return whether the OID is <o> (which is <n> bytes)
+	bool OidIs(const uint8_t * o, int n) { 
+				return oid_len == n && memcmp(oid, o, n) == 0; }
+		// decode up to <max> arcs of the OID starting at byte <i> into <arcs>, 
+		//		as OidArcs()
+	int IndexArcs(int i, int * arcs, int max) { 
+				return OidArcs(oid + i, oid_len - i, arcs, max); }
+		// the arcs starting at byte <i> in dotted-decimal form
+	std::string IndexString(int i);
+		// copy the OID into a message (including tag and length); <p> may be 
+		//		in the same buffer as long as it's before the OID
+		// returns the number of bytes written
+	int CopyOid(uint8_t * p);
+		// append the value to <b> in the format for an index in an OID, as 
+		//		<MibObject::AppendAsIndexTo>; if it's an octet string, the 
+		//		<extra_len> bytes at <extra> are treated as part of the value
+	bool AppendAsIndexTo(ByteString & b, const uint8_t * extra = NULL, 
+														int extra_len = 0);
+		// OID in dotted-decimal form, for display
+	std::string OidString() { return OidToText(ByteString(oid, oid + oid_len)); }
+#ifdef _MFC_VER
+		// the same, as <CString>s
+	CString IndexText(int i) { return IndexString(i).c_str(); }
+	CString OidText() { return OidString().c_str(); }
+#endif
+};
+
+// reads the VarBinds in a received message in turn, without copying them
+class VarBindReader {
+public:
+		// <p> points to the first VarBind, <len> is the number of bytes from 
+		//		there to the end of the message
+	VarBindReader(uint8_t * p, int len) { this->p = p; this->len = len; }
+		// read the next VarBind into <v>; returns <false> at the end of the 
+		//		message or if the VarBind is malformed, in which case 
+		//		Remaining() is nonzero
+	bool Next(VarBindView& v);
+		// bytes not yet read
+	int Remaining() { return len; }
+	uint8_t * Position() { return p; }
+
+private:
+	uint8_t * p;
+	int len;
+};
+
+// return the BER coding (excluding tag and length) of OID <s>, which is 
+//		in dotted-decimal form; result is empty if <s> isn't a valid OID
+extern ByteString OidFromText(const char * s);
+// the same for the arcs of an index, as they appear after a column's OID 
+//		(each arc is coded separately, unlike the first two arcs of an OID)
+extern ByteString IndexFromText(const char * s);
+
+// codes for the objects (scalars and table columns) that get special 
+//		treatment, e.g. because they're used to build the lists of ports and 
+//		flows or by the crosspoint display; the comment shows the OID after 
+//		the 1.0.62379 prefix
+// NOTE: the codes must be in the same order as the OIDs, see <oid_prefixes> 
+//		in MgtSocket.cpp
+#define MIB_COL_NONE				 0	// none of the below
+#define MIB_COL_UNIT_NAME			 1	// 1.1.1.1.0 unitName
+#define MIB_COL_UNIT_LOCATION		 2	// 1.1.1.2.0 unitLocation
+#define MIB_COL_UNIT_ADDRESS		 3	// 1.1.1.3.0 unitAddress (MAC address)
+#define MIB_COL_PRODUCT_NAME		 4	// 1.1.1.6.0
+#define MIB_COL_FIRMWARE_VERSION	 5	// 1.1.1.8.0 unitFirmwareVersion
+#define MIB_COL_UNIT_IDENTIFIER		 6	// 1.1.1.16.0 unitIdentifier
+#define MIB_COL_UNIT_TIMING			 7	// 1.1.4.6 timing source
+#define MIB_COL_UNIT_SYNC			 8	// 1.1.4.7 sync state
+#define MIB_COL_UNIT_FRAMING		 9	// 1.1.4.8 framing source
+#define MIB_COL_A_PORT_DIRECTION	10	// 2.1.1.1.1.2
+#define MIB_COL_A_PORT_FORMAT		11	// 2.1.1.1.1.3
+#define MIB_COL_A_PORT_NAME			12	// 2.1.1.1.1.5
+#define MIB_COL_A_PORT_IMPORTANCE	13	// 2.1.1.1.1.6
+#define MIB_COL_A_LOCKED_TIME		14	// 2.1.1.4.1.2
+#define MIB_COL_A_LOCKED_INSERTED	15	// 2.1.1.4.1.3 aLockedSamplesInserted
+#define MIB_COL_A_LOCKED_DROPPED	16	// 2.1.1.4.1.4 aLockedSamplesDropped
+#define MIB_COL_V_PORT_DIRECTION	17	// 3.1.1.1.1.2
+#define MIB_COL_V_PORT_FORMAT		18	// 3.1.1.1.1.3
+#define MIB_COL_V_PORT_NAME			19	// 3.1.1.1.1.5
+#define MIB_COL_V_PORT_IMPORTANCE	20	// 3.1.1.1.1.6
+#define MIB_COL_N_PORT_STATE		21	// 5.1.1.1.1.1.3
+#define MIB_COL_N_PORT_ADDR_TYPE	22	// 5.1.1.1.1.1.6 nPortPAddrType
+#define MIB_COL_N_PORT_PARTNER_ADDR	23	// 5.1.1.1.1.1.7 nPortPartnerAddress
+#define MIB_COL_N_PORT_SCP_DEVICE	24	// 5.1.1.1.1.1.9
+#define MIB_COL_N_PORT_VM_STATE		25	// 5.1.1.1.1.1.10 state of SCP server
+#define MIB_COL_N_PORT_PARTNER		26	// 5.1.1.1.1.1.11 nPortTransparentPartner
+#define MIB_COL_US_STATE			27	// 5.1.1.2.1.1.7
+#define MIB_COL_UD_NET_BLOCK_ID		28	// 5.1.1.3.3.1.2
+#define MIB_COL_UD_STATE			29	// 5.1.1.3.3.1.9
+#define MIB_COL_UD_IMPORTANCE		30	// 5.1.1.3.3.1.14
+#define MIB_COL_COUNT				31	// number of codes including _NONE
+
+// return the MIB_COL_ code for the object whose OID is the <len> bytes at 
+//		<oid> (BER coding, as in <MibObject::oid_ber>), and set <posn> to 
+//		the offset of the index arcs; MIB_COL_NONE (with <posn> unchanged) if 
+//		it isn't one of the above
+extern int ClassifyOid(const uint8_t * oid, int len, int& posn);
+// write the BER coding of the OID for code <col> (i.e. the column, or the 
+//		scalar including the final 0 arc) to <b>, and return its length; 
+//		returns zero if <col> isn't valid
+#define MIB_COL_MAX_OID_LEN		12	// max returned by MibColumnOid()
+extern int MibColumnOid(int col, uint8_t * b);
+
+
+// state of a management session (<FlexilinkSocket::state>)
+// +++ most of this is purely session layer state; the update process has 
+//		its own state (though I'm not convinced it will survive a change 
+//		of lower-layer connection) and I think everything else is 
+//		stateless at the protocol level; the link socket state also needs 
+//		to be checked if e.g. a reply fails to arrive
+// +++ however, states 3 and 4 are really layer 7
+#define MGT_ST_BEGIN	 0	// nothing done yet
+#define MGT_ST_CONN_REQ	 1	// FindRoute request sent
+#define MGT_ST_CONN_ACK	 2	// FindRoute request acknowledged
+#define MGT_ST_CONN_MADE 3	// <tx_flow> valid; initial GetNext sent
+#define MGT_ST_HAVE_INFO 4	// unitName etc valid; Status Request has been sent
+#define MGT_ST_ACTIVE	 5	// Status Response has been received (normal state)
+#define MGT_ST_MAX_OK	 5	// codes above this are for "failed" states
+#define MGT_ST_NOT_CONN	 6	// failed to connect
+#define MGT_ST_FAILED	 7	// call to base class (Create, Connect, Send) failed
+#define MGT_ST_TIMEOUT	 8	// any kind of timeout
+#define MGT_ST_MIN_RETRY 9	// wait before retry connection for codes below this
+#define MGT_ST_CLOSED	 9	// target has disconnected
+#define MGT_ST_ERROR	11	// any other kind of protocol error in flash map
+
+// state of the software update process (<MgtSocket::upd_state>)
+// when writing, also when setting to Valid, the reply doesn't come 
+//		until the operation is complete; erasing simply marks the 
+//		area(s) to be erased, and as each completes its status changes 
+//		to Empty; we don't get told when the last one finishes, so we 
+//		stick in "waiting" state until the user clicks on the status 
+//		message on the screen
+#define UPD_ST_NO_INFO		 0	// waiting for unitIdentity etc
+#define UPD_ST_BEGIN		 1	// have unitIdentity and unitFirmwareVersion
+#define UPD_ST_NOT_RECOGD	 2	// unitIdentity etc not as expected
+#define UPD_ST_HAVE_SW_VER	 3	// unitIdentity etc decoded
+#define UPD_ST_NO_P_FILE	 4	// couldn't open product file
+#define UPD_ST_BAD_P_FILE	 5	// couldn't find req'd info in product file
+#define UPD_ST_NO_ACTION	 6	// already up-to-date
+#define UPD_ST_FROM_ISE		 7	// software loaded by Impact and Compiler
+#define UPD_ST_COLLECT_MAP	 8	// reading contents of flash
+#define UPD_ST_HAVE_MAP		 9	// ready to check what needs updating
+#define UPD_ST_UP_TO_DATE	10	// flash OK; needs restart
+#define UPD_ST_NOT_MAINT	11	// privilege level forbids update
+#define UPD_ST_USER_REFUSED	12	// user replied refusing update
+#define UPD_ST_BAD_FLASH	13	// e.g. all 16 serial numbers used
+#define UPD_ST_NO_S_FILE	14	// no data read from image file
+#define UPD_ST_MIN_FILE_ERR	15	// first of the "file error" codes
+#define UPD_ST_NO_LOGIC		15	// couldn't open logic image file
+#define UPD_ST_BAD_LOGIC	16	// e.g. no sync word found in logic image file
+#define UPD_ST_NO_VM_FILE	17	// couldn't open VM software image file
+#define UPD_ST_BAD_VM_FILE	18	// e.g. VM software image file empty
+#define UPD_ST_MAX_FILE_ERR	18	// last of the "file error" codes
+#define UPD_ST_UPLOADING	19	// writing (see <upd_area> and <upd_offset>)
+#define UPD_ST_TIDY_UP		20	// check for areas that should be erased
+#define UPD_ST_MAKE_SPACE	21	// as _TIDY_UP when have run out of space
+#define UPD_ST_ERASING		22	// erasing (tidying up; see <erase_pending>)
+#define UPD_ST_WAITING		23	// for erases to complete
+#define UPD_ST_FAILED		24	// failure during uploading process
+#define UPD_ST_QUEUED		25	// ready to upload; waiting for <Rollout::MayStart>
+#define UPD_ST_VERIFYING	26	// checking data written before connection lost
+
+// privilege levels, as in 62379-1 (see <CControllerApp::privilege>)
+#define PRIV_LISTENER	 1 // min privilege, no password needed
+#define PRIV_OPERATOR	 2
+#define PRIV_SUPERVISOR	 3
+#define PRIV_MAINTENANCE 4
+
+// NetPortState code points (see <MgtSocket::net_port_state>)
+#define NET_PORT_STATE_DISABLED	 1	// disabled
+#define NET_PORT_STATE_LINK_UP	 4	// linkUp
+#define NET_PORT_STATE_PT_PT	 5	// pointToPoint
+
+// error status in the ls 4 bits of the first byte of a reply, as in SNMPv1 
+//		(see <MgtSocket::ReceiveData>)
+#define MGT_ERR_TOO_BIG		 1	// tooBig: e.g. more VarBinds than the agent can take
+#define MGT_ERR_NO_SUCH_NAME 2	// noSuchName
+#define MGT_ERR_BAD_VALUE	 3	// badValue
+#define MGT_ERR_READ_ONLY	 4	// readOnly
+#define MGT_ERR_GEN_ERR		 5	// genErr
+
+// timeouts for management sessions (see <FlexilinkSocket::TimerExpired>)
+// +++ TEMP: these are twice what was intended, to allow for programming flash 
+//		in the unit to which we're directly connected (not sure why it takes 
+//		longer, may be because the VM is occupied forwarding replies from 
+//		other units)
+#define MGT_MSG_REPEAT		1000	// ms between repeats of <mgt_msg>
+#define MAX_REPEAT_COUNT	20		// give up after 20 secs
+#define MGT_SILENCE_TIMEOUT	130000	// ms with no message before timing out
+#define MGT_RETRY_SOON		1000	// ms before reconnecting, states >= MGT_ST_MIN_RETRY
+#define MGT_RETRY_WAIT		10000	// ms before reconnecting, other failed states
+
+// build the FindRoute request that opens a management session in <m>; 
+//		<owner> is our 64-bit ident (as <LinkSocket::our_ident>), the ls 13 
+//		bits of <call_ref> are the flow label for messages from the unit, 
+//		<privilege> is a PRIV_ code, <called> is the unit's address, and 
+//		<pw> is the 12 bytes of the Password IE, or NULL to leave it out
+extern void BuildConnReq(ByteString& m, const char * owner, int call_ref, 
+					int privilege, const ByteString& called, const uint8_t * pw);
+
+// check the value of unitIdentity (<len> bytes at <b>): returns 
+//		UPD_ST_NO_INFO if it's too short, UPD_ST_NOT_RECOGD if it's not a 
+//		Nine Tiles product, else UPD_ST_BEGIN with the product code copied 
+//		to <product_code> (if not NULL)
+extern int CheckUnitIdentity(const uint8_t * b, int len, uint8_t * product_code);
+
+// keeps track of the in-cycle Status reports from a unit, so that at the end 
+//		of a cycle in which none were missed, anything that was last reported 
+//		before the cycle started can be assumed to have gone from the MIB
+class StatusCycle {
+public:
+	StatusCycle() { next_seq = 0; prev_report_time = 0; start_time = 0; }
+		// a Status report with sequence number <seq> has arrived at <now> 
+		//		(a change message, with <seq> zero, means the cycle can't be 
+		//		relied on); returns whether it's the first of a cycle
+	bool Report(uint8_t seq, int64_t now);
+		// the cycle is known to be incomplete, e.g. a report was malformed
+	void Abandon() { next_seq = 0; }
+		// whether the report whose first byte was <cmd> ends an OK cycle
+	bool Complete(uint8_t cmd) { return next_seq >= 2 && (cmd & 0x0F) == 0x0F; }
+
+		// 2 secs before time of the most recent start of a cycle (not valid 
+		//		if <next_seq> is 0 or 1)
+		// any object that should be reported in a cycle and is older than 
+		//		this at the end of an OK cycle can be assumed to have 
+		//		disappeared from the MIB
+	int64_t start_time;
+
+private:
+		// expected sequence number of next in-cycle report message, or zero 
+		//		if the information is already known to be incomplete (e.g. a 
+		//		message has arrived out of sequence)
+	uint8_t next_seq;
+		// time the previous message in the current cycle arrived (not valid 
+		//		if <next_seq> is 0 or 1)
+	int64_t prev_report_time;
+};
@@ -0,0 +1,68 @@
+/*
+ *  mib_bus.cpp
+ *  notification of changes to the units' MIBs
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "mib_bus.h"
+
+
+int MibBus::Subscribe(uint32_t bits, void * unit)
+{
+	Subscriber s;
+	s.bits = bits;
+	s.unit = unit;
+	subs.push_back(s);
+	return (int)subs.size() - 1;
+}
+
+
+void MibBus::SetUnit(int id, void * unit)
+{
+	subs[id].unit = unit;
+	subs[id].pending.clear();
+}
+
+
+// the number of subscribers is small (one for each window etc) so we just
+//		look at each of them
+void MibBus::Publish(void * unit, uint32_t bits)
+{
+	std::vector<Subscriber>::iterator p = subs.begin();
+	for (; p != subs.end(); p++) {
+		unless ((p->bits & bits) != 0) continue;
+		unless (unit == NULL || p->unit == NULL || p->unit == unit) continue;
+		p->pending[unit] |= p->bits & bits;
+	}
+}
+
+
+bool MibBus::Collect(int id, std::vector<MibDelta>& d)
+{
+	d.clear();
+	std::map<void *, uint32_t>& q = subs[id].pending;
+	if (q.empty()) return false;
+	MibDelta e;
+	std::map<void *, uint32_t>::iterator p = q.begin();
+	for (; p != q.end(); p++) {
+		e.unit = p->first;
+		e.bits = p->second;
+		d.push_back(e);
+	}
+	q.clear();
+	return true;
+}
+
+
+bool MibBus::Flush(int id)
+{
+	std::map<void *, uint32_t>& q = subs[id].pending;
+	if (q.empty()) return false;
+	q.clear();
+	return true;
+}
@@ -0,0 +1,68 @@
+/*
+ *  mib_bus.h
+ *  notification of changes to the units' MIBs: each part of the program
+ *		that shows or acts on MIB objects subscribes to the ones it is
+ *		interested in, and collects the changes in batches when it's ready
+ *		to deal with them
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "mgt_core.h"
+#include <map>
+
+// Objects are identified by their MIB_COL_ code, as a bit in a 32-bit
+//		mask; MIB_COL_NONE stands for all the objects that don't have a code
+// Changes are coalesced, so a subscriber sees at most one <MibDelta> for
+//		each unit however many times the objects have changed since it last
+//		collected them
+// Units are identified by pointers, but only as keys; a unit may have been
+//		deleted by the time its changes are collected, so the pointer should
+//		not be followed without checking
+
+static_assert(MIB_COL_COUNT <= 31, "MIB_COL_ codes don't fit in a MibBus mask");
+#define MIB_BIT(col)		(1u << (col))
+#define MIB_BITS_ALL_COLS	((1u << MIB_COL_COUNT) - 1)
+	// not an object: the state of the management connection has changed, or
+	//		the unit has been removed
+#define MIB_BIT_UNIT_STATE	(1u << 31)
+#define MIB_BITS_ALL		(MIB_BITS_ALL_COLS | MIB_BIT_UNIT_STATE)
+
+
+// changes to the objects in <bits> for <unit>; <unit> is NULL for a
+//		change that affects all units, such as to the link
+struct MibDelta {
+	void * unit;
+	uint32_t bits;
+};
+
+
+class MibBus
+{
+public:
+		// returns the id to use in the other calls; <unit> is the unit
+		//		whose changes are wanted, or NULL for all units
+	int Subscribe(uint32_t bits, void * unit = NULL);
+		// change the unit for subscription <id>; any changes waiting to be
+		//		collected are discarded
+	void SetUnit(int id, void * unit);
+
+		// called when objects in <bits> for <unit> have changed
+	void Publish(void * unit, uint32_t bits);
+
+		// move the changes waiting for subscription <id> to <d>; return
+		//		whether there were any
+	bool Collect(int id, std::vector<MibDelta>& d);
+		// discard the changes waiting for subscription <id>; return whether
+		//		there were any
+	bool Flush(int id);
+
+private:
+	struct Subscriber {
+		uint32_t bits;
+		void * unit;
+		std::map<void *, uint32_t> pending;		// keyed by unit
+	};
+	std::vector<Subscriber> subs;
+};
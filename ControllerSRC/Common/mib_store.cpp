@@ -0,0 +1,419 @@
+/*
+ *  mib_store.cpp
+ *  the objects in a unit's MIB, and the store in which they are kept
+ *
+ *  Copyright 2014-2015, 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "mib_store.h"
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wnonnull-compare"	// see header
+#endif
+
+
+// as <_abs64>, which is Microsoft-only
+static int64_t Abs64(int64_t n) { return n < 0 ? -n : n; }
+
+
+// ------------------------ class MibObject
+
+MibObject::MibObject() {
+	tag = TAG_INVALID;
+		// added so the compiler (which doesn't understand "valid only if 
+		//		<tag> is ASN1_TAG_INTEGER") won't whinge
+	value = 0;
+	recd = 0;
+	msg_type = 0;
+}
+
+
+// initialise by reading a VarBind from the buffer described by <p> and <len>, 
+//		which are skipped over it
+// sets <tag = TAG_INVALID> if any error: if failed to read the OID all arrays 
+//		are empty and <b> and <len> unchanged; else they are skipped over the 
+//		OID, which is in <oid_ber>, and <oid> is empty if the OID is invalid, 
+//		valid if the error was in the value.
+MibObject::MibObject(uint8_t * &p, int &len) {
+	value = 0;
+	recd = 0;
+	msg_type = 0;
+	VarBindReader r(p, len);
+	VarBindView v;
+	if (r.Next(v)) SetValue(v);
+	else {
+		tag = TAG_INVALID;
+		return;
+	}
+	p = r.Position();
+	len = r.Remaining();
+}
+
+
+MibObject::~MibObject() {
+}
+
+
+// return value of octet-string object as a character string
+// result is a null string if <this> is NULL or tag not OCTET STRING
+std::string MibObject::StdStringValue()// const
+{
+	std::string s;	// initially empty
+	if (this == NULL || tag != ASN1_TAG_OCTET_STRING) return s;
+
+	int n = GetCount();
+	int i = 0;
+	while (i < n) { s += (char)at(i); i += 1; }
+	return s;
+}
+
+
+// return value of octet-string object in hex
+// result is a null string if <this> is NULL or tag not OCTET STRING
+// if <group_size > 0>, a space is inserted after every <group_size> bytes 
+//		except at the end of the string; else no spaces inserted
+std::string MibObject::StdStringHex(int group_size)// const
+{
+	std::string s;	// initially empty
+	if (this == NULL || tag != ASN1_TAG_OCTET_STRING) return s;
+
+	int i = 0;	// counts bytes
+	int j = 0;	// counts bytes modulo <group_size>
+	int n = (int)GetCount();
+	if (n <= 0) return s;
+	while (true) {
+		unsigned int b = at(i);
+		s += ToHex(b, 2);
+		i += 1;
+		if (i >= n) return s;
+		j += 1;
+		if (j != group_size) continue;
+		s += ' ';
+		j = 0;
+	}
+}
+
+
+// return value of object as text
+std::string MibObject::TextValue()// const
+{
+	switch (tag) {
+case ASN1_TAG_INTEGER:
+		return "INT: " + ToDecimal(value);
+
+case ASN1_TAG_OCTET_STRING:
+		return "STR: " + StdStringHex(1);
+
+case ASN1_TAG_OID:
+		return "OID: " + OidToText(*this);
+	}
+
+		// here if tag not recognised
+	return "TAG " + ToHex(tag, 2) + ": " +  StdStringHex(1);
+}
+
+
+
+// set <tag> and the byte array from an ASN.1 value in a message
+// <p> points to the tag, <len> is the number of bytes left in the message
+// updates <p> and <len> (to skip over the object) and returns <true> if OK, 
+//		else returns <false> without changing anything
+// if the tag is ASN1_TAG_INTEGER, and the length is in the range 1 to 4 
+//		inclusive, we set <value> accordingly; if the length is out of range 
+//		we set <tag> to TAG_INTEGER_OUT_OF_RANGE
+// does not read beyond <p[len-1]> in case that would cause a protection fault
+bool MibObject::GetAsn1Value(uint8_t * &p, int &len)
+{
+	ValueSizes sz = ParseLength(p, len);
+	if (sz.hd_len < 0) return false;
+
+	uint8_t * b = p;
+	tag = b[0];
+	b += sz.hd_len;
+	resize(sz.len);
+	int i = 0;
+	while (i < sz.len) { at(i) = b[i]; i += 1; }
+
+	if (tag == ASN1_TAG_INTEGER && !Asn1IntegerValue(b, sz.len, value)) 
+											tag = TAG_INTEGER_OUT_OF_RANGE;
+
+	p = b + sz.len;
+	len -= (sz.hd_len + sz.len);
+	return true;
+}
+
+
+// append the value to <b> in the format for an index in an OID; returns 
+//		<true> if OK, <false> with <b> unchanged else
+// currently only copes with octet strings and positive 32-bit integers
+bool MibObject::AppendAsIndexTo(ByteString & b) {
+	int i, n;
+	uint8_t v;
+	switch (tag) {
+case ASN1_TAG_INTEGER:
+		i = IntegerValue();
+		if (i < 0) return false;
+			// set <n> to 7 * ((bytes to add) - 1)
+		n = 0;
+		while (i >= (128 << n) && n < 28) n += 7;
+		while (n > 0) { b.push_back((i >> n) | 0x80); n -= 7; }
+		b.push_back(i & 0x7F);
+		return true;
+
+case ASN1_TAG_OCTET_STRING:
+		n = (int)size();
+		if (n > 0x3FF) return false; // length is silly
+		if (n > 0x7F) b.push_back((n >> 7) | 0x80);
+		b.push_back(n & 0x7F);
+		i = 0;
+		while (i < n) {
+			v = at(i);
+			if (v & 0x80) b.push_back(0x81);
+			b.push_back(v & 0x7F);
+			i += 1;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+// copy the OID into a message (including tag and length)
+// length uses the shortest form it can
+// assumes there is enough room (and that the length is less than 64KB)
+// returns the number of bytes written
+int MibObject::CopyOid(uint8_t * p)
+{
+	*p++ = ASN1_TAG_OID;
+	int n = (int)oid_ber.size();
+	int len = n + 2;
+	if (n < 128) *p++ = (uint8_t)n;
+	else if (n < 256) { *p++ = 0x81; *p++ = (uint8_t)n; len += 1; }
+	else { *p++ = 0x82; *p++ = (uint8_t)(n >> 8); *p++ = (uint8_t)n; len += 2; }
+
+	int i = 0;
+	while (i < n) *p++ = oid_ber.at(i++);
+	return len;
+}
+
+
+// return whether <m> and <this> have different values
+// if <this->oid_ber> indicates unitUpTime, we compare the implied reset 
+//		times, not the values
+bool MibObject::ChangedFrom(MibObject * m) {
+	static const uint8_t up_time[] = 	// 1.0.62379.1.1.1.9
+							{ 0x28, 0x83, 0xE7, 0x2B, 1, 1, 1, 9 };
+	if (m->tag != tag) return true;
+
+	if (tag == ASN1_TAG_INTEGER) {
+		if (oid_ber.size() != sizeof(up_time) || 
+					memcmp(oid_ber.data(), up_time, sizeof(up_time)) != 0) 
+												return m->value != value;
+
+			// else is unitUpTime; compare the implied reset times
+			// we allow up to 2 secs for rounding errors etc; this means if a 
+			//		unit is reset twice within about 2 secs we only see one 
+			//		of the resets, but it's unlikely we'll have got far with 
+			//		collecting MIB etc information between the two anyway
+		return Abs64(recd + value - (m->recd + m->value)) > 2;
+	}
+
+	int n = m->GetCount();
+	if (n != GetCount()) return true;
+	int i = 0;
+	while (i < n) { if (m->at(i) != at(i)) return true; i += 1; }
+	return false;
+}
+
+
+// return whether <v>, received at time <t>, has a different value from 
+//		<this>; as above, but without needing a <MibObject> for the new value
+bool MibObject::ChangedFrom(VarBindView& v, int64_t t) {
+	static const uint8_t up_time[] = 	// 1.0.62379.1.1.1.9
+							{ 0x28, 0x83, 0xE7, 0x2B, 1, 1, 1, 9 };
+	if (v.tag != tag) return true;
+
+	if (tag == ASN1_TAG_INTEGER) {
+		unless (v.OidIs(up_time, sizeof(up_time))) return v.value != value;
+		return Abs64(t + v.value - (recd + value)) > 2;
+	}
+
+	if (v.val_len != GetCount()) return true;
+	return v.val_len != 0 && memcmp(v.val, data(), v.val_len) != 0;
+}
+
+
+// set the OID, value, <tag>, and <value> from <v>; assigning (rather than 
+//		constructing) means the existing buffers are reused if big enough
+void MibObject::SetValue(VarBindView& v) {
+	unless ((int)oid_ber.size() == v.oid_len && 
+						memcmp(oid_ber.data(), v.oid, v.oid_len) == 0) 
+								oid_ber.assign(v.oid, v.oid + v.oid_len);
+	assign(v.val, v.val + v.val_len);
+	tag = v.tag;
+	value = v.value;
+}
+
+
+
+// ------------------------ class MibStore
+
+MibStore::MibStore() {
+	count = 0;
+	hash_used = 0;
+	hash_table.assign(MIB_HASH_INIT_SIZE, MIB_HASH_EMPTY);
+	objs.reserve(MIB_HASH_INIT_SIZE / 2);
+	age_prev.reserve(MIB_HASH_INIT_SIZE / 2);
+	age_next.reserve(MIB_HASH_INIT_SIZE / 2);
+	age_head = MIB_AGE_END;
+	age_tail = MIB_AGE_END;
+}
+
+
+MibStore::~MibStore() {
+}
+
+
+// FNV-1a hash of the BER coding of an OID
+uint32_t MibStore::Hash(const uint8_t * oid, int len) {
+	uint32_t h = 2166136261U;
+	while (len > 0) { h = (h ^ *oid++) * 16777619U; len -= 1; }
+	return h;
+}
+
+
+// return the index in <hash_table> of the entry for <oid> (for which the 
+//		hash is <h>), or of the empty entry at which the search stopped
+int MibStore::Lookup(const uint8_t * oid, int len, uint32_t h) {
+	int mask = (int)hash_table.size() - 1;
+	int i = (int)(h & mask);
+	int k;
+	while ((k = hash_table[i]) != MIB_HASH_EMPTY) {
+		unless (k == MIB_HASH_REMOVED) {
+			ByteString& o = objs[k].oid_ber;
+			if ((int)o.size() == len && memcmp(o.data(), oid, len) == 0) return i;
+		}
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+
+MibObject * MibStore::Find(const uint8_t * oid, int len) {
+	int k = hash_table[Lookup(oid, len, Hash(oid, len))];
+	if (k < 0) return NULL;
+	return &objs[k];
+}
+
+
+MibObject * MibStore::Add(const uint8_t * oid, int len, bool& added) {
+	uint32_t h = Hash(oid, len);
+	int i = Lookup(oid, len, h);
+	int k = hash_table[i];
+	if (k >= 0) {
+		added = false;
+		return &objs[k];
+	}
+
+		// here if not present; <i> is an empty entry in the hash table
+		// keep the table no more than 3/4 full (including removed entries)
+	if ((hash_used + 1) * 4 > (int)hash_table.size() * 3) {
+		Rehash((count + 1) * 2 > (int)hash_table.size() ? 
+							(int)hash_table.size() * 2 : (int)hash_table.size());
+		i = Lookup(oid, len, h);
+	}
+
+	if (free_list.empty()) {
+		k = (int)objs.size();
+		objs.resize(k + 1);
+		age_prev.push_back(MIB_AGE_UNLISTED);
+		age_next.push_back(MIB_AGE_UNLISTED);
+	}
+	else {
+		k = free_list.back();
+		free_list.pop_back();
+	}
+
+	MibObject& m = objs[k];
+	m.oid_ber.assign(oid, oid + len);
+	m.SetInvalid();
+	hash_table[i] = k;
+	hash_used += 1;
+	count += 1;
+	added = true;
+	return &m;
+}
+
+
+void MibStore::Remove(MibObject * m) {
+	int k = (int)(m - objs.data());
+	int i = Lookup(m->oid_ber.data(), (int)m->oid_ber.size(), 
+						Hash(m->oid_ber.data(), (int)m->oid_ber.size()));
+	ASSERT(hash_table[i] == k);
+	hash_table[i] = MIB_HASH_REMOVED;
+	Unlink(k);
+		// clear the entry but keep the buffers for reuse
+	m->oid_ber.clear();
+	m->SetInvalid();
+	free_list.push_back(k);
+	count -= 1;
+}
+
+
+// move <m> to the end of the aging list, or take it off the list
+void MibStore::Reported(MibObject * m, bool ages) {
+	int k = (int)(m - objs.data());
+	Unlink(k);
+	unless (ages) return;
+	age_prev[k] = age_tail;
+	age_next[k] = MIB_AGE_END;
+	if (age_tail == MIB_AGE_END) age_head = k;
+	else age_next[age_tail] = k;
+	age_tail = k;
+}
+
+
+// take entry <k> in <objs> off the aging list, if it's on it
+void MibStore::Unlink(int k) {
+	int prev = age_prev[k];
+	int next = age_next[k];
+	if (prev == MIB_AGE_UNLISTED) return;
+	if (prev == MIB_AGE_END) age_head = next;
+	else age_next[prev] = next;
+	if (next == MIB_AGE_END) age_tail = prev;
+	else age_prev[next] = prev;
+	age_prev[k] = MIB_AGE_UNLISTED;
+	age_next[k] = MIB_AGE_UNLISTED;
+}
+
+
+MibObject * MibStore::Next(int& i) {
+	int n = (int)objs.size();
+	while (i < n) {
+		MibObject * m = &objs[i++];
+		unless (m->oid_ber.empty()) return m;
+	}
+	return NULL;
+}
+
+
+// rebuild the hash table with <size> entries, dropping removed entries
+void MibStore::Rehash(int size) {
+	hash_table.assign(size, MIB_HASH_EMPTY);
+	hash_used = 0;
+	int n = (int)objs.size();
+	int k = 0;
+	while (k < n) {
+		ByteString& o = objs[k].oid_ber;
+		unless (o.empty()) {
+			hash_table[Lookup(o.data(), (int)o.size(), 
+										Hash(o.data(), (int)o.size()))] = k;
+			hash_used += 1;
+		}
+		k += 1;
+	}
+}
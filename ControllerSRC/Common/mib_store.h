@@ -0,0 +1,192 @@
+/*
+ *  mib_store.h
+ *  the objects in a unit's MIB, as reported in its management messages,
+ *		and the store in which they are kept
+ *
+ *  Copyright 2014-2015, 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+#include "mgt_core.h"
+#include <vector>
+
+// Shared by <MgtSocket> and the daemon's <DaemonUnit>; the members that
+//		use MFC types are only declared in the Windows build, and are
+//		defined in MgtSocket.cpp
+// Several members return an empty value if <this> is NULL, as the Windows
+//		code relies on, e.g. in <GetObject(...)->IntegerValue()>; GCC
+//		assumes <this> can't be NULL and may drop those tests, so the
+//		daemon checks for NULL before calling them
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnonnull-compare"
+#endif
+
+// object, as in a MIB
+// CByteArray holds the value, in the same format as in ASN.1 BER
+class MibObject : public ByteString
+//class MibObject : public CByteArray
+{
+public:
+	MibObject();
+	MibObject(uint8_t * &p, int &len);	// reads a VarBind
+	MibObject(VarBindView& v) { recd = 0; msg_type = 0; SetValue(v); }
+	virtual ~MibObject();
+
+		// redefining CByteArray members for backwards compatibility
+		// +++ I have removed the <const> suffixes below because calls of these 
+		//		routines get faulted "cannot convert 'this' pointer from 'const 
+		//		MibObject' to 'MibObject &' if they're left in", even though 
+		//		<size> etc are defined as <const> too
+	int GetCount() { return (int)(size()); }
+	int GetUpperBound() { return (int)(size()) - 1; }
+	uint8_t GetAt(int i) { return at(i); }
+	uint8_t * GetData() { return data(); }
+	void SetSize(int n) { resize(n); }
+	void Add(uint8_t b) { push_back(b); }
+
+	ByteString oid_ber;	// as in the message (excluding tag and length)
+	int tag;			// see below
+	int value;			// valid only if <tag> is ASN1_TAG_INTEGER
+	int64_t recd;		// time the value was reported
+	uint8_t msg_type;	// first 4 bits of message in which reported (in high half)
+
+	// <tag> is one of the TAG_ or ASN1_TAG_ codes in mgt_core.h
+
+	int IntegerValue() { if (this == NULL || tag != ASN1_TAG_INTEGER) return 0;
+						 return value; }
+#ifdef _MFC_VER
+	CString StringValue();// const;
+	CString StringHex(int group_size);// const;
+	void CopyOctetStringValue(CByteArray& b);
+#endif
+	ByteString OctetStringValue() { if (this == NULL || 
+				tag != ASN1_TAG_OCTET_STRING) return ByteString(); 
+									return *this; }
+
+
+		// return value of object as a character string if an octet-string
+	std::string StdStringValue();// const;
+		// return value of object in hex if an octet-string
+	std::string StdStringHex(int group_size);// const;
+		// return value of object as text
+	std::string TextValue();// const;
+
+		// set <tag>, <value>, and the byte array from an ASN.1 value in a message
+		// <b> points to the tag, <len> is the number of bytes left in the message
+		// updates <b> and <len> and returns <true> if OK, else sets <tag> to -1 
+		//		and empties the byte array and returns <false> 
+	bool GetAsn1Value(uint8_t * &b, int &len);
+
+#ifdef _MFC_VER
+		// return the value in dotted-decimal form if it is a valid OID, else an 
+		//		empty string
+	CString ConvertOid();
+		// return <oid_ber> in dotted-decimal form (e.g. for display); empty 
+		//		string if <this> is NULL
+	CString OidText() { if (this == NULL) return CString(); 
+									return OidToText(oid_ber).c_str(); }
+#endif
+
+		// append the value to <b> in the format for an index in an OID; returns 
+		//		<true> if OK, <false> with <b> unchanged else
+//	bool AppendAsIndexTo(CByteArray & b);
+	bool AppendAsIndexTo(ByteString & b);
+
+		// copy the OID into a message (including tag and length)
+	int CopyOid(uint8_t * p);
+
+		// clear out any value that was stored
+	void SetInvalid() { clear(); tag = TAG_INVALID; }
+
+		// return whether the first <n> bytes of <oid_ber> are <prefix>
+	bool OidStartsWith(const uint8_t * prefix, int n) { 
+				return (int)oid_ber.size() >= n && 
+								memcmp(oid_ber.data(), prefix, n) == 0; }
+
+		// return whether another object has a significantly different value
+	bool ChangedFrom(MibObject * m);
+		// the same, for a new value <v> received at time <t>
+	bool ChangedFrom(VarBindView& v, int64_t t);
+		// set the OID (if it's different), value, <tag> and <value> from <v>; 
+		//		the existing buffers are reused if big enough
+	void SetValue(VarBindView& v);
+};
+
+
+// store for the objects in a unit's MIB
+// the objects are held in a single array, with a hash table (open addressing, 
+//		linear probing) giving the index in the array for each OID; the key 
+//		is the BER coding of the OID, so there's no need to convert to and 
+//		from the dotted-decimal form when objects are stored or looked up
+// when an object is removed its entry in the array goes on a free list to 
+//		be reused, so once the MIB has reached its working size, storing a 
+//		new value doesn't normally involve any heap allocation
+// NOTE: Add() and Remove() may move objects in memory, so any pointers 
+//		obtained previously should not be used after calling them
+class MibStore
+{
+public:
+	MibStore();
+	~MibStore();
+
+		// return the object with OID <oid>, <len> bytes in the same format as 
+		//		<MibObject::oid_ber>, or NULL if not present
+	MibObject * Find(const uint8_t * oid, int len);
+	MibObject * Find(ByteString& oid) { return oid.empty() ? NULL : 
+										Find(oid.data(), (int)oid.size()); }
+		// return the object with OID <oid>, adding it (with <tag> set to 
+		//		TAG_INVALID) if not present; <added> shows which
+	MibObject * Add(const uint8_t * oid, int len, bool& added);
+		// remove <m>, which must be in the store
+	void Remove(MibObject * m);
+		// number of objects in the store
+	int GetCount() { return count; }
+		// step through the objects: <i> should be zero for the first call; 
+		//		returns NULL when there are no more
+	MibObject * Next(int& i);
+
+		// record that <m> has just been reported: if <ages> it goes to the 
+		//		end of the aging list, else it's taken off the list
+	void Reported(MibObject * m, bool ages);
+		// the object on the aging list that was reported least recently, or 
+		//		NULL if the list is empty
+	MibObject * Oldest() { return age_head < 0 ? NULL : &objs[age_head]; }
+
+private:
+	std::vector<MibObject> objs;	// the objects; unused entries have empty OID
+	std::vector<int> free_list;		// indexes in <objs> of unused entries
+	int count;						// number of entries in use in <objs>
+
+		// hash table: the size is a power of 2, each entry is an index in 
+		//		<objs> or one of the following
+#define MIB_HASH_EMPTY		(-1)	// never been used
+#define MIB_HASH_REMOVED	(-2)	// object removed (but keep searching)
+#define MIB_HASH_INIT_SIZE	1024	// initial size
+	std::vector<int> hash_table;
+	int hash_used;					// entries not MIB_HASH_EMPTY
+	static uint32_t Hash(const uint8_t * oid, int len);
+
+		// aging list: objects that should be reported in every status cycle, 
+		//		in the order in which they were last reported, so those that 
+		//		have dropped out of the status reports are at the start
+		// the links are indexes in <objs>, kept in parallel arrays so that 
+		//		adding, moving, and removing entries doesn't allocate
+#define MIB_AGE_END			(-1)	// no previous or next entry
+#define MIB_AGE_UNLISTED	(-2)	// entry in <objs> is not on the list
+	std::vector<int> age_prev;
+	std::vector<int> age_next;
+	int age_head;					// least recently reported
+	int age_tail;					// most recently reported
+	void Unlink(int k);
+		// return the index in <hash_table> for <oid>, or if not present the 
+		//		index of the empty entry at the end of the chain
+	int Lookup(const uint8_t * oid, int len, uint32_t h);
+	void Rehash(int size);
+};
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
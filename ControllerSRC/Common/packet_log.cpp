@@ -0,0 +1,224 @@
+/*
+ *  packet_log.cpp
+ *  record of messages sent and received on a flow
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "packet_log.h"
+#include <stdio.h>
+#include <chrono>
+
+
+PacketLog::PacketLog(int slots, int bytes)
+{
+	n_slots = slots;
+	n_bytes = bytes;
+	first = 0;
+	count = 0;
+	next = 0;
+}
+
+
+int64_t PacketLog::Now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+// the records are in the same order in the arena as in <recs>, so the ones
+//		at or above <next> (if any) were written on the previous time round
+//		and are the oldest
+void PacketLog::Add(const uint8_t * b, int len, char flag, int label, int state)
+{
+	if (recs.empty()) {
+		recs.resize(n_slots);
+		arena.resize(n_bytes);
+	}
+	int n = len;
+	if (n > PACKET_LOG_SNAP) n = PACKET_LOG_SNAP;
+	if (n > n_bytes) n = n_bytes;
+	if (n < 0) n = 0;
+
+	if (count >= (int)recs.size()) Drop();
+	if (next + n > n_bytes) {
+			// wrap round, discarding any messages beyond <next>
+		while (count > 0 && Record(0).offset >= next) Drop();
+		next = 0;
+	}
+	while (count > 0 && Record(0).offset >= next && Record(0).offset < next + n)
+																		Drop();
+
+	PacketRecord& r = recs[(first + count) % (int)recs.size()];
+	r.time = Now();
+	r.len = len;
+	r.saved = n;
+	r.offset = next;
+	r.label = label;
+	r.state = state;
+	r.flag = flag;
+	if (n > 0) memcpy(arena.data() + next, b, n);
+	next += n;
+	count += 1;
+}
+
+
+std::string PacketLog::Text(int i) const
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const PacketRecord& r = Record(i);
+	if (r.len == 0) return "*** empty message ***";
+
+	char buf[24];
+	snprintf(buf, sizeof(buf), "%4d%2d", r.len, r.state);	// +++ TEMP state
+	std::string s(buf);
+	const uint8_t * b = Data(r);
+	int n = r.saved;
+	int k = 0;
+	if (r.flag == 'H') {
+			// 8-byte words, shown most significant byte first
+		if (n > 200) n = 200;
+		s.reserve(s.size() + n * 2 + n / 8 + 1);
+		while (k < n) {
+			if ((k & 7) == 0) s += ' ';
+			int j = k ^ 7;
+			if (j < r.saved) { s += hex[b[j] >> 4]; s += hex[b[j] & 15]; }
+			else s += "  ";
+			k += 1;
+		}
+	}
+	else {
+		if (n > 160) n = 160;
+		s.reserve(s.size() + n * 3);
+		while (k < n) {
+			s += ' ';
+			s += hex[b[k] >> 4];
+			s += hex[b[k] & 15];
+			k += 1;
+		}
+	}
+	return s;
+}
+
+
+// ------------------------ pcapng export
+
+// pcapng block types, and the link type for packets that start with an
+//		IP header
+#define PCAPNG_SHB		0x0A0D0D0A
+#define PCAPNG_IDB		1
+#define PCAPNG_EPB		6
+#define LINKTYPE_RAW	101
+// IPv4 and UDP headers
+#define PCAP_IP_HDR_LEN		20
+#define PCAP_UDP_HDR_LEN	8
+
+// pcapng is written in our own byte order, which the reader deduces from
+//		the byte order magic; we always write little-endian
+static void Put16(ByteString& f, uint32_t n)
+{
+	f.push_back((uint8_t)n);
+	f.push_back((uint8_t)(n >> 8));
+}
+
+static void Put32(ByteString& f, uint32_t n)
+{
+	Put16(f, n);
+	Put16(f, n >> 16);
+}
+
+// network byte order, for the IP and UDP headers
+static void PutBig16(uint8_t * p, uint32_t n)
+{
+	p[0] = (uint8_t)(n >> 8);
+	p[1] = (uint8_t)n;
+}
+
+
+// whether the message was sent by us
+static bool Transmitted(char flag)
+{
+	switch (flag) {
+case 't': case 'T': case 'e': case 'E':
+		return true;
+	}
+	return false;
+}
+
+
+void PacketLog::Pcapng(ByteString& f, uint32_t our_addr, uint32_t link_addr,
+												bool standard_format) const
+{
+		// section header, with unspecified section length
+	Put32(f, PCAPNG_SHB);
+	Put32(f, 28);
+	Put32(f, 0x1A2B3C4D);
+	Put16(f, 1);
+	Put16(f, 0);
+	Put32(f, 0xFFFFFFFF);
+	Put32(f, 0xFFFFFFFF);
+	Put32(f, 28);
+
+		// interface description; timestamps default to microseconds
+	Put32(f, PCAPNG_IDB);
+	Put32(f, 20);
+	Put16(f, LINKTYPE_RAW);
+	Put16(f, 0);
+	Put32(f, 0);	// no snap length
+	Put32(f, 20);
+
+	uint8_t h[PCAP_IP_HDR_LEN + PCAP_UDP_HDR_LEN + LINK_HDR_LEN];
+	int i = -1;
+	while (++i < count) {
+		const PacketRecord& r = Record(i);
+		if (r.flag == 'H') continue;
+		int orig = (int)sizeof(h) + r.len;
+		int cap = (int)sizeof(h) + r.saved;
+		int pad = (4 - (cap & 3)) & 3;
+
+			// IPv4 header, don't fragment, UDP; the checksum is over the
+			//		header only
+		uint8_t * p = h;
+		memset(p, 0, PCAP_IP_HDR_LEN);
+		p[0] = 0x45;
+		PutBig16(p + 2, orig);
+		p[6] = 0x40;
+		p[8] = 64;
+		p[9] = 17;
+		uint32_t src = Transmitted(r.flag) ? our_addr : link_addr;
+		uint32_t dst = Transmitted(r.flag) ? link_addr : our_addr;
+		memcpy(p + 12, &src, 4);
+		memcpy(p + 16, &dst, 4);
+		uint32_t sum = 0;
+		int j = 0;
+		while (j < PCAP_IP_HDR_LEN) { sum += (p[j] << 8) | p[j + 1]; j += 2; }
+		while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+		PutBig16(p + 10, ~sum);
+
+			// UDP header, no checksum
+		p += PCAP_IP_HDR_LEN;
+		PutBig16(p, AES51_PORT);
+		PutBig16(p + 2, AES51_PORT);
+		PutBig16(p + 4, orig - PCAP_IP_HDR_LEN);
+		PutBig16(p + 6, 0);
+
+		BuildItHeader(p + PCAP_UDP_HDR_LEN, r.len, r.label, standard_format);
+
+		Put32(f, PCAPNG_EPB);
+		Put32(f, 32 + cap + pad);
+		Put32(f, 0);	// interface
+		Put32(f, (uint32_t)((uint64_t)r.time >> 32));
+		Put32(f, (uint32_t)r.time);
+		Put32(f, cap);
+		Put32(f, orig);
+		f.insert(f.end(), h, h + sizeof(h));
+		f.insert(f.end(), Data(r), Data(r) + r.saved);
+		f.insert(f.end(), pad, 0);
+		Put32(f, 32 + cap + pad);
+	}
+}
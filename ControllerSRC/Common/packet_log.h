@@ -0,0 +1,82 @@
+/*
+ *  packet_log.h
+ *  a record of the most recent messages sent and received on a flow, kept
+ *		as raw bytes so that it costs little to keep and is only turned
+ *		into text when it's displayed; it can also be written out as a
+ *		pcapng capture for Wireshark (see WiresharkPlugin/Flexilink.lua)
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+#include "link_core.h"
+
+// The bytes of the messages are held in a single arena, used as a ring;
+//		when there isn't room for a new message, or all the records are in
+//		use, the oldest messages are discarded
+// Nothing is allocated after the first message has been added
+
+
+// one message; <flag> is as described for <FlexilinkSocket::SaveMessage>
+struct PacketRecord {
+	int64_t time;		// microseconds since 1 Jan 1970
+	int len;			// length of the message
+	int saved;			// number of bytes kept, starting at <offset>
+	int offset;			// in the arena
+	int label;			// flow label including the CRC
+	int state;			// state of the socket when the message was saved
+	char flag;
+};
+
+
+class PacketLog
+{
+public:
+		// defaults allow for the last 300 or so messages, which is what the
+		//		earlier versions kept as text
+#define PACKET_LOG_SLOTS	300
+#define PACKET_LOG_BYTES	0x10000
+		// limit on the bytes kept for one message, i.e. all of it
+#define PACKET_LOG_SNAP		(LINK_DATAGRAM_SIZE - LINK_HDR_LEN)
+	PacketLog(int slots = PACKET_LOG_SLOTS, int bytes = PACKET_LOG_BYTES);
+
+		// add message of <len> bytes at <b>, which excludes the AES51 and
+		//		IT headers; <label> is used for the headers in a capture
+	void Add(const uint8_t * b, int len, char flag, int label, int state);
+	void Clear() { first = 0; count = 0; next = 0; }
+
+		// number of messages, and the <i>th message, oldest first
+	int Count() const { return count; }
+	const PacketRecord& Record(int i) const
+						{ return recs[(first + i) % (int)recs.size()]; }
+	const uint8_t * Data(const PacketRecord& r) const
+												{ return arena.data() + r.offset; }
+
+		// message <i> in hex, as shown on the screen (without the flag)
+		// only the first 160 bytes are shown (200 for a hash dump) because
+		//		longer lines exceed the maximum window size
+	std::string Text(int i) const;
+
+		// append to <f> a pcapng file containing the messages, with the
+		//		AES51 and IT headers reconstructed and wrapped in IPv4 and UDP
+		//		headers; <our_addr> and <link_addr> are the IPv4 addresses of
+		//		this end and the gateway (network byte order), and
+		//		<standard_format> is as for <BuildItHeader>
+		// hash dumps ('H') are not included
+	void Pcapng(ByteString& f, uint32_t our_addr, uint32_t link_addr,
+												bool standard_format) const;
+
+		// time now, in the units of <PacketRecord::time>
+	static int64_t Now();
+
+private:
+	std::vector<PacketRecord> recs;
+	ByteString arena;
+	int n_slots;		// sizes to allocate when the first message is added
+	int n_bytes;
+	int first;			// index in <recs> of the oldest message
+	int count;			// number of messages
+	int next;			// offset in <arena> for the next message
+	void Drop() { first = (first + 1) % (int)recs.size(); count -= 1; }
+};
@@ -0,0 +1,174 @@
+/*
+ *  request_table.cpp
+ *  management requests that have not yet been replied to
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "request_table.h"
+
+
+RequestTable::RequestTable()
+{
+	last_serial = 0;
+	srtt = -1;
+	rttvar = 0;
+	rto = REQ_INITIAL_RTO;
+}
+
+
+// the search starts after the last one allocated
+int RequestTable::NextSerial()
+{
+	int s = last_serial;
+	int i = 255;
+	do {
+		s = (s >= 255) ? 1 : s + 1;
+		if (entries.find((uint8_t)s) == entries.end()) {
+			last_serial = s;
+			return s;
+		}
+	} while (--i > 0);
+	return 0;
+}
+
+
+int RequestTable::Oldest() const
+{
+	int s = -1;
+	uint64_t t = 0;
+	std::map<uint8_t, PendingRequest>::const_iterator p = entries.begin();
+	for (; p != entries.end(); p++) {
+		if (s < 0 || p->second.first_sent < t) {
+			s = p->first;
+			t = p->second.first_sent;
+		}
+	}
+	return s;
+}
+
+
+void RequestTable::Add(const uint8_t * m, int len, bool repeat, int kind,
+												int ref, uint64_t now)
+{
+	PendingRequest& r = entries[m[1]];
+	r.m.assign(m, m + len);
+	r.repeat = repeat;
+	r.kind = kind;
+	r.ref = ref;
+	r.first_sent = now;
+	r.sent = now;
+	r.due = now + (repeat ? rto : REQ_GIVE_UP);
+	r.sends = 1;
+}
+
+
+PendingRequest * RequestTable::Find(int serial)
+{
+	std::map<uint8_t, PendingRequest>::iterator p = entries.find((uint8_t)serial);
+	return (p == entries.end()) ? NULL : &p->second;
+}
+
+
+// the reply has the request's type in bits 4-6
+bool RequestTable::Complete(int serial, int type, uint64_t now,
+														PendingRequest& r)
+{
+	std::map<uint8_t, PendingRequest>::iterator p = entries.find((uint8_t)serial);
+	if (p == entries.end() || ((p->second.m[0] ^ type) & 0x70) != 0) return false;
+	r.m.swap(p->second.m);
+	r.repeat = p->second.repeat;
+	r.kind = p->second.kind;
+	r.ref = p->second.ref;
+	r.first_sent = p->second.first_sent;
+	r.sent = p->second.sent;
+	r.due = p->second.due;
+	r.sends = p->second.sends;
+	entries.erase(p);
+	if (r.sends == 1) Sample((int)(now - r.sent));
+	return true;
+}
+
+
+void RequestTable::Busy(int serial, uint64_t now)
+{
+	PendingRequest * r = Find(serial);
+	if (r == NULL || !r->repeat) return;
+	r->due = now + rto;
+}
+
+
+// linear search, but there are seldom more than a few requests outstanding
+int RequestTable::Due(uint64_t now)
+{
+	std::map<uint8_t, PendingRequest>::iterator p = entries.begin();
+	for (; p != entries.end(); p++) if (p->second.due <= now) return p->first;
+	return -1;
+}
+
+
+// the interval is doubled for each repeat, but the request is given up on
+//		REQ_GIVE_UP after it was first sent
+void RequestTable::Resent(int serial, uint64_t now)
+{
+	PendingRequest * r = Find(serial);
+	if (r == NULL) return;
+	r->sent = now;
+	int t = rto;
+	int i = r->sends;
+	while (i-- > 0 && t < REQ_MAX_RTO) t *= 2;
+	if (t > REQ_MAX_RTO) t = REQ_MAX_RTO;
+	r->sends += 1;
+	r->due = now + t;
+	if (r->due > r->first_sent + REQ_GIVE_UP) r->due = r->first_sent + REQ_GIVE_UP;
+}
+
+
+uint64_t RequestTable::NextDue() const
+{
+	uint64_t t = 0;
+	std::map<uint8_t, PendingRequest>::const_iterator p = entries.begin();
+	for (; p != entries.end(); p++) if (t == 0 || p->second.due < t) t = p->second.due;
+	return t;
+}
+
+
+void RequestTable::Remove(int serial)
+{
+	entries.erase((uint8_t)serial);
+}
+
+
+void RequestTable::RemoveKind(int kind)
+{
+	std::map<uint8_t, PendingRequest>::iterator p = entries.begin();
+	while (p != entries.end()) {
+		if (p->second.kind == kind) p = entries.erase(p);
+		else p++;
+	}
+}
+
+
+// RFC 6298 section 2, with alpha = 1/8, beta = 1/4, K = 4
+void RequestTable::Sample(int rtt)
+{
+	if (rtt < 0) return;
+	if (srtt < 0) {
+		srtt = rtt;
+		rttvar = rtt / 2;
+	}
+	else {
+		int d = srtt - rtt;
+		if (d < 0) d = -d;
+		rttvar += (d - rttvar) / 4;
+		srtt += (rtt - srtt) / 8;
+	}
+	rto = srtt + ((4 * rttvar > REQ_CLOCK_GRANULARITY) ? 4 * rttvar :
+													REQ_CLOCK_GRANULARITY);
+	if (rto < REQ_MIN_RTO) rto = REQ_MIN_RTO;
+	if (rto > REQ_MAX_RTO) rto = REQ_MAX_RTO;
+}
@@ -0,0 +1,98 @@
+/*
+ *  request_table.h
+ *  management requests that have been sent and not yet replied to, with
+ *		retransmit timeouts calculated from the round-trip times
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+#include "mgt_core.h"
+
+// Requests are keyed by serial number (the second byte of the message);
+//		a serial number isn't reused while there's a request with it in the
+//		table, so a late reply can't be taken as being for a later request;
+//		if all 255 are in use, the owner has to give up on one (see <Oldest>)
+//		before it can send another
+// Serial number 0 is never allocated, so it can be used for messages that
+//		are sent before the table is in use
+// The retransmit timeout (RTO) is calculated as in RFC 6298 from the
+//		smoothed round-trip time and its variation; round trips are only
+//		measured for requests that were only sent once (Karn's algorithm),
+//		and each time a request is repeated the interval before the next
+//		repeat is doubled
+// Each request has a <kind>, defined by the owner, which is passed back to
+//		the owner when the request completes or is given up on, and tells it
+//		what to do
+
+#define REQ_INITIAL_RTO		1000	// ms, before any round trip has been measured
+#define REQ_MIN_RTO			 200	// ms
+#define REQ_MAX_RTO			8000	// ms
+#define REQ_CLOCK_GRANULARITY 16	// ms, of the clock the times come from
+	// ms after the first send; as long as the single <mgt_msg> was repeated, 
+	//		which was made long enough for flash programming
+#define REQ_GIVE_UP			(MAX_REPEAT_COUNT * MGT_MSG_REPEAT)
+
+
+struct PendingRequest {
+	ByteString m;			// the message as sent, serial number in m[1]
+	bool repeat;			// whether to repeat it if there's no reply
+	int kind;				// what it's for
+	int ref;				// for the owner's use
+	uint64_t first_sent;	// times in ms
+	uint64_t sent;			// when last sent
+	uint64_t due;			// when to repeat it or give up
+	int sends;				// number of times sent
+};
+
+
+class RequestTable
+{
+public:
+	RequestTable();
+
+		// serial number for the next request, 1 to 255; 0 if all are in use
+	int NextSerial();
+		// serial number of the request that was sent first, -1 if none
+	int Oldest() const;
+		// record a request that has just been sent at time <now>; <m[1]>
+		//		must be a serial number from <NextSerial>
+	void Add(const uint8_t * m, int len, bool repeat, int kind, int ref,
+															uint64_t now);
+	PendingRequest * Find(int serial);
+
+		// remove the request that message type <type> with serial number
+		//		<serial> is the reply to, if any, copying it to <r>; returns
+		//		whether there was one
+	bool Complete(int serial, int type, uint64_t now, PendingRequest& r);
+		// the reply to request <serial> said the unit was busy: repeat it
+		//		after the RTO
+	void Busy(int serial, uint64_t now);
+
+		// serial number of a request whose time to be repeated or given up
+		//		on is at or before <now>, -1 if none; the caller should then
+		//		either repeat it and call <Resent>, or <Remove> it
+	int Due(uint64_t now);
+	void Resent(int serial, uint64_t now);
+		// time of the next <Due>, 0 if none
+	uint64_t NextDue() const;
+
+	void Remove(int serial);
+	void RemoveKind(int kind);
+		// remove all the requests; the round-trip times are kept
+	void Clear() { entries.clear(); }
+	int Count() const { return (int)entries.size(); }
+
+		// add a round-trip time measured elsewhere
+	void Sample(int rtt);
+	int Rto() const { return rto; }
+	int Srtt() const { return srtt; }	// -1 if not measured yet
+
+private:
+	std::map<uint8_t, PendingRequest> entries;
+	int last_serial;
+	int srtt;				// smoothed round-trip time, ms
+	int rttvar;				// round-trip time variation, ms
+	int rto;				// ms
+};
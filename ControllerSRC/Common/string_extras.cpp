@@ -228,6 +228,7 @@ extern uint64_t FromDecimal(std::string n)
 }
 
 
+#ifdef _MFC_VER
 // return text form of 3-bit request code <c> in management message header
 CString MgtReqCode(int c)
 {
@@ -256,6 +257,7 @@ case 7: return "ConsoleData";
 #endif
 	return s;
 }
+#endif // _MFC_VER
 
 
 // versions of <isspace> etc that avoid the problems with Microsoft's library
@@ -427,11 +429,9 @@ extern int FindName(std::string n, std::string d)
 
 // return <n> as the top 13 bits of one half of an IT packet header, 
 //		with the CRC in the ls 3 bits
-// this is not the fastest way to calculate the CRC; the way <AddHec> in the VM 
-//		code does it would be faster, and quickest would be to have a table lookup 
-//		(32KB, or 3002 bytes if we reckon lengths and flow labels will never be 
-//		more than 1500 and the packet type will always be zero)
-int AddHec(int n)
+// this is the bit-by-bit calculation; it's kept as the definition against 
+//		which the table used by <AddHec> can be checked
+int AddHecBitwise(int n)
 {
 	int x = n & 0x1FFF;	// in case <n> wasn't 13 bits
 	int i = 13;
@@ -445,6 +445,75 @@ int AddHec(int n)
 }
 
 
+// the CRC for each 13-bit value, generated at compile time
+// the CRC (before the final inversion) is linear in the input bits, so 
+//		each entry is found from the one with its lowest 1 bit cleared; the 
+//		CRCs for single bits are calculated as in <AddHecBitwise>
+struct HecTable {
+	uint8_t crc[0x2000];
+
+	static constexpr int BitCrc(int n) {
+		int x = n;
+		int i = 13;
+		do {
+			x = x << 1;
+			if (x & 0x2000) x ^= 0x2C00;
+			i -= 1;
+		} while (i > 0);
+		return x >> 10;
+	}
+
+	constexpr HecTable() : crc() {
+		int n = 1;
+		crc[0] = 7;
+		while (n < 0x2000) {
+			int b = n & -n;	// lowest 1 bit
+			crc[n] = (uint8_t)(crc[n ^ b] ^ BitCrc(b));
+			n += 1;
+		}
+	}
+};
+
+static constexpr HecTable hec_table;
+
+
+// as <AddHecBitwise>, using the table
+int AddHec(int n)
+{
+	return (uint16_t)((n << 3) | hec_table.crc[n & 0x1FFF]);
+}
+
+
+// check the CRCs in <count> halves of IT packet headers (each as the 16-bit 
+//		value returned by <AddHec>), e.g. for a batch of received packets
+// sets <ok>[i] to 1 if <h>[i] is correct, else 0, and returns the number 
+//		that are correct
+int CheckHecs(const uint16_t * h, uint8_t * ok, int count)
+{
+	int i = 0;
+	int k = 0;
+	while (i < count) {
+		ok[i] = ((h[i] & 7) == hec_table.crc[h[i] >> 3]);
+		k += ok[i];
+		i += 1;
+	}
+	return k;
+}
+
+
+// return whether the table gives the same result as <AddHecBitwise> for 
+//		all 13-bit values; intended to be called in an ASSERT at startup
+bool HecTableOK()
+{
+	int n = 0;
+	while (n < 0x2000) {
+		if (AddHec(n) != AddHecBitwise(n)) return false;
+		n += 1;
+	}
+	return true;
+}
+
+
 // return the coding of v as an immediate value if possible, else -1
 // uses the codings defined for VM3
 // note that -1 will be returned if v is INT64T_MIN
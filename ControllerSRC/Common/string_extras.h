@@ -42,7 +42,9 @@ extern std::string ScpPointerToHex(uint32_t n);
 extern uint64_t FromHexEtc(std::string n, int d_size);
 extern uint64_t FromDecimal(std::string n);
 
+#ifdef _MFC_VER
 extern CString MgtReqCode(int c); // as in Tealeaves <MgtMsgHdr.msg_type>
+#endif
 
 // routines similar to the C library functions but avoiding the problems 
 //		with the Windows implementation
@@ -61,6 +63,10 @@ extern int FindName(std::string n, std::string d);
 
 // CRC calculation for Flexilink IT packet headers
 extern int AddHec(int n);
+extern int AddHecBitwise(int n);	// slow version, for checking
+// check the CRCs in a batch of header values
+extern int CheckHecs(const uint16_t * h, uint8_t * ok, int count);
+extern bool HecTableOK();
 // label on rcv packets for the signalling flow, including the CRC 
 //		(assumed to be flow 0 for <LinkSocket::flow>)
 #define RCV_SIG_FLOW	7
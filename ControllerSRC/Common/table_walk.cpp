@@ -0,0 +1,110 @@
+/*
+ *  table_walk.cpp
+ *  reading a MIB table with several GetNext requests in progress at once
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "table_walk.h"
+
+
+void TableWalk::Start(const uint8_t * prefix, int len,
+										const std::vector<ByteString>& starts)
+{
+	Clear();
+	this->prefix.assign(prefix, prefix + len);
+	int n = (int)starts.size();
+	if (n > WALK_MAX_CURSORS) n = WALK_MAX_CURSORS;
+	if (n == 0) {
+		cursors.resize(1);
+		cursors[0].from = this->prefix;
+	}
+	else {
+		cursors.resize(n);
+		int i = n;
+		while (--i >= 0) {
+			cursors[i].from = starts[i];
+			if (i < n - 1) cursors[i].limit = starts[i + 1];
+		}
+	}
+	int i = (int)cursors.size();
+	while (--i >= 0) cursors[i].serial = -1;
+}
+
+
+bool TableWalk::Done() const
+{
+	if (cursors.empty()) return false;
+	int i = (int)cursors.size();
+	while (--i >= 0) unless (cursors[i].serial == 0) return false;
+	return true;
+}
+
+
+// the length uses the shortest form, as <VarBindView::CopyOid>
+void TableWalk::Request(int i, ByteString& m)
+{
+	const ByteString& oid = cursors[i].from;
+	int n = (int)oid.size();
+	m.clear();
+	m.push_back(WALK_GETNEXT);
+	m.push_back(0);
+	m.push_back(ASN1_TAG_OID);
+	if (n >= 256) { m.push_back(0x82); m.push_back((uint8_t)(n >> 8)); }
+	else if (n >= 128) m.push_back(0x81);
+	m.push_back((uint8_t)n);
+	m.insert(m.end(), oid.begin(), oid.end());
+}
+
+
+// a reply with no objects, or with one that isn't after the OID asked for,
+//		would leave the cursor where it was, so is treated as an error rather
+//		than asking again
+int TableWalk::Reply(int serial, uint8_t * p, int len)
+{
+	if (serial <= 0) return WALK_NOT_OURS;
+	int i = (int)cursors.size();
+	while (--i >= 0) if (cursors[i].serial == serial) break;
+	if (i < 0) return WALK_NOT_OURS;
+	Cursor& c = cursors[i];
+
+	VarBindReader r(p, len);
+	VarBindView v;
+	bool any = false;
+	while (r.Remaining() > 0) {
+		uint8_t * q = r.Position();
+		unless (r.Next(v)) return WALK_ERROR;
+		if (!v.OidStartsWith(prefix.data(), (int)prefix.size()) ||
+				(!c.limit.empty() && OidCompare(v.oid, v.oid_len,
+							c.limit.data(), (int)c.limit.size()) >= 0)) {
+				// reached the end of the range
+			c.serial = 0;
+			return WALK_STOPPED;
+		}
+		if (OidCompare(v.oid, v.oid_len, c.from.data(),
+										(int)c.from.size()) <= 0) break;
+		c.data.insert(c.data.end(), q, r.Position());
+		c.from.assign(v.oid, v.oid + v.oid_len);
+		any = true;
+	}
+	unless (any) return WALK_ERROR;
+	return i;
+}
+
+
+// each range is after the one before, and within a range the objects are
+//		in the order the unit returned them
+const ByteString& TableWalk::Results()
+{
+	if (merged.empty()) {
+		int n = (int)cursors.size();
+		int i = -1;
+		while (++i < n) merged.insert(merged.end(),
+								cursors[i].data.begin(), cursors[i].data.end());
+	}
+	return merged;
+}
@@ -0,0 +1,79 @@
+/*
+ *  table_walk.h
+ *  reading a MIB table with several GetNext requests in progress at once
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "mgt_core.h"
+
+// The table is divided into ranges of OIDs, each read by a "cursor" that
+//		sends a GetNext for the last OID it has had back, so the ranges are
+//		read in parallel; they are usually a column each, in which case a
+//		table with n rows takes about n/16 round trips instead of n/16 for
+//		each column in turn
+// A cursor stops at the first object in a reply that is beyond the end of
+//		its range; that object and any after it are discarded, because they
+//		are in another cursor's range or not in the table
+// The owner sends the requests and passes the replies to <Reply>; when all
+//		the cursors have stopped, <Results> has the VarBinds in OID order, the
+//		same as if the table had been read with one GetNext at a time, so
+//		they can be read with a <VarBindReader>
+
+#define WALK_GETNEXT		0x1F	// GetNext request for up to 16 objects
+#define WALK_MAX_CURSORS	   8	// requests in progress at once
+
+// results of <TableWalk::Reply> other than a cursor number
+#define WALK_STOPPED	(-1)	// the cursor has reached the end of its range
+#define WALK_NOT_OURS	(-2)	// not a reply to a request from any cursor
+#define WALK_ERROR		(-3)	// reply malformed or didn't move forward
+
+
+class TableWalk
+{
+public:
+	TableWalk() {}
+
+		// start reading the table whose OIDs begin with the <len> bytes at
+		//		<prefix> (BER coding, excluding tag and length); each of
+		//		<starts>, which must be in order and begin with <prefix>, is
+		//		where a range starts, and it extends to the next (or to the
+		//		end of the table); if <starts> is empty the table is read as
+		//		one range; the objects at the <starts> themselves aren't read
+		// there are at most WALK_MAX_CURSORS ranges; any further <starts>
+		//		are ignored, so the last range covers the rest of the table
+	void Start(const uint8_t * prefix, int len,
+										const std::vector<ByteString>& starts);
+	void Clear() { cursors.clear(); merged.clear(); }
+	bool Active() const { return !cursors.empty(); }
+		// whether all the cursors have stopped (false if not <Active>)
+	bool Done() const;
+	int Cursors() const { return (int)cursors.size(); }
+
+		// GetNext request for cursor <i>, with zero as its serial number; the
+		//		owner should send it and then call <Sent> with the serial number
+	void Request(int i, ByteString& m);
+	void Sent(int i, int serial) { cursors[i].serial = serial; }
+
+		// process the <len> bytes of VarBinds at <p> in a reply with serial
+		//		number <serial>; returns the number of the cursor if another
+		//		request should be sent for it, else one of the WALK_ codes
+		//		above; on WALK_ERROR the walk should be abandoned
+	int Reply(int serial, uint8_t * p, int len);
+
+		// the VarBinds from all the cursors, valid once <Done>
+	const ByteString& Results();
+
+private:
+	struct Cursor {
+		ByteString from;	// OID to ask for the object after
+		ByteString limit;	// first OID not in the range, empty if end of table
+		ByteString data;	// VarBinds received so far
+		int serial;			// of the request in progress, 0 if stopped, -1 
+							//		if the first request hasn't been sent
+	};
+	ByteString prefix;
+	std::vector<Cursor> cursors;
+	ByteString merged;		// concatenation of the <data>s, see <Results>
+};
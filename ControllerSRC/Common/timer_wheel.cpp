@@ -0,0 +1,248 @@
+/*
+ *  timer_wheel.cpp
+ *  hierarchical timing wheel with millisecond resolution
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "timer_wheel.h"
+
+
+TimerWheel::TimerWheel()
+{
+	free_list = -1;
+	int i = TW_EXPIRED + 1;
+	while (--i >= 0) heads[i] = -1;
+	i = TW_LEVELS;
+	while (--i >= 0) occupied[i] = 0;
+	now_ms = 0;
+	started = false;
+}
+
+
+void TimerWheel::Set(void * owner, int kind, uint64_t due)
+{
+	std::pair<void *, int> key(owner, kind);
+	TimerIndex::iterator p = index.find(key);
+	int i;
+	if (p != index.end()) {
+		i = p->second;
+		Unlink(i);
+	}
+	else {
+		if (free_list >= 0) {
+			i = free_list;
+			free_list = pool[i].next;
+		}
+		else {
+			i = (int)pool.size();
+			pool.resize(i + 1);
+		}
+		pool[i].owner = owner;
+		pool[i].kind = kind;
+		index[key] = i;
+	}
+	pool[i].due = due;
+	Link(i);
+}
+
+
+void TimerWheel::Cancel(void * owner, int kind)
+{
+	TimerIndex::iterator p = index.find(std::make_pair(owner, kind));
+	if (p == index.end()) return;
+	Release(p->second);
+	index.erase(p);
+}
+
+
+void TimerWheel::CancelAll(void * owner)
+{
+	TimerIndex::iterator p = index.begin();
+	while (p != index.end()) {
+		unless (p->first.first == owner) {
+			p++;
+			continue;
+		}
+		Release(p->second);
+		p = index.erase(p);
+	}
+}
+
+
+uint64_t TimerWheel::When(void * owner, int kind)
+{
+	TimerIndex::iterator p = index.find(std::make_pair(owner, kind));
+	return (p == index.end()) ? 0 : pool[p->second].due;
+}
+
+
+// until the time is known, all timers are put on the "expired" list; on the
+//		first call of <Expired> they are moved to the right slots
+bool TimerWheel::Expired(uint64_t now, void * &owner, int &kind)
+{
+	unless (started) {
+		started = true;
+		now_ms = now;
+		int i = heads[TW_EXPIRED];
+		heads[TW_EXPIRED] = -1;
+		while (i >= 0) {
+			int j = pool[i].next;
+			Link(i);
+			i = j;
+		}
+	}
+	while (heads[TW_EXPIRED] < 0 && now_ms < now) Step(now);
+
+	int i = heads[TW_EXPIRED];
+	if (i < 0) return false;
+	owner = pool[i].owner;
+	kind = pool[i].kind;
+	Release(i);
+	index.erase(std::make_pair(owner, kind));
+	return true;
+}
+
+
+// the earliest timer at each level is in the first occupied slot after the
+//		current one, wrapping round to the current one, except that the top 
+//		level may also have timers that are further ahead than it covers, so 
+//		for that we use the time the slot will be moved down
+uint64_t TimerWheel::NextExpiry()
+{
+	if (index.empty()) return 0;
+	uint64_t t = 0;
+	int i = heads[TW_EXPIRED];
+	if (i >= 0) {
+		for (; i >= 0; i = pool[i].next) if (t == 0 || pool[i].due < t) t = pool[i].due;
+		return t;
+	}
+
+	int level = -1;
+	while (++level < TW_LEVELS) {
+		int s = (int)(now_ms >> (TW_SLOT_BITS * level)) & (TW_SLOTS - 1);
+		int k = (s < TW_SLOTS - 1) ? FirstSlot(level, s + 1) : -1;
+		if (k < 0) k = FirstSlot(level, 0);
+		if (k < 0) continue;
+		if (level == TW_LEVELS - 1) {
+			uint64_t c = (now_ms >> (TW_SLOT_BITS * level)) + 
+									((k > s) ? k - s : k - s + TW_SLOTS);
+			c <<= TW_SLOT_BITS * level;
+			if (t == 0 || c < t) t = c;
+			continue;
+		}
+		for (i = heads[level * TW_SLOTS + k]; i >= 0; i = pool[i].next) {
+			if (t == 0 || pool[i].due < t) t = pool[i].due;
+		}
+	}
+	return t;
+}
+
+
+// the level is the lowest one in which the slot for <due> hasn't yet been
+//		passed
+void TimerWheel::Link(int i)
+{
+	Timer& t = pool[i];
+	int list = TW_EXPIRED;
+	if (started && t.due > now_ms) {
+		uint64_t due = t.due;
+		uint64_t d = due - now_ms;
+		int level = 0;
+		while (level < TW_LEVELS - 1 &&
+					d >= ((uint64_t)1 << (TW_SLOT_BITS * (level + 1)))) level += 1;
+		if (d >= ((uint64_t)1 << (TW_SLOT_BITS * TW_LEVELS)))
+				due = now_ms + ((uint64_t)1 << (TW_SLOT_BITS * TW_LEVELS)) - 1;
+		int slot = (int)(due >> (TW_SLOT_BITS * level)) & (TW_SLOTS - 1);
+		list = level * TW_SLOTS + slot;
+		occupied[level] |= (uint64_t)1 << slot;
+	}
+	t.list = list;
+	t.prev = -1;
+	t.next = heads[list];
+	if (t.next >= 0) pool[t.next].prev = i;
+	heads[list] = i;
+}
+
+
+void TimerWheel::Unlink(int i)
+{
+	Timer& t = pool[i];
+	if (t.prev >= 0) pool[t.prev].next = t.next;
+	else heads[t.list] = t.next;
+	if (t.next >= 0) pool[t.next].prev = t.prev;
+	if (heads[t.list] < 0 && t.list < TW_EXPIRED) {
+		occupied[t.list / TW_SLOTS] &= ~((uint64_t)1 << (t.list % TW_SLOTS));
+	}
+}
+
+
+void TimerWheel::Release(int i)
+{
+	Unlink(i);
+	pool[i].owner = NULL;
+	pool[i].next = free_list;
+	free_list = i;
+}
+
+
+// stops at the next occupied slot in level 0 or the start of the next
+//		revolution of level 0, whichever is first; at the latter the slots
+//		in the higher levels that now come within the range of the level
+//		below are moved down
+void TimerWheel::Step(uint64_t limit)
+{
+	int s = (int)(now_ms & (TW_SLOTS - 1));
+	uint64_t target = now_ms - s + TW_SLOTS;
+	int k = (s < TW_SLOTS - 1) ? FirstSlot(0, s + 1) : -1;
+	if (k >= 0) target = now_ms - s + k;
+	if (target > limit) {
+		now_ms = limit;
+		return;
+	}
+	now_ms = target;
+
+	s = (int)(now_ms & (TW_SLOTS - 1));
+	if (s == 0) {
+		int level = 0;
+		while (++level < TW_LEVELS) {
+			k = (int)(now_ms >> (TW_SLOT_BITS * level)) & (TW_SLOTS - 1);
+			Cascade(level, k);
+			unless (k == 0) break;
+		}
+	}
+	Cascade(0, s);
+}
+
+
+// each timer is put back in the list for its expiry time, which will be in
+//		a lower level or the "expired" list
+void TimerWheel::Cascade(int level, int slot)
+{
+	int list = level * TW_SLOTS + slot;
+	int i = heads[list];
+	if (i < 0) return;
+	heads[list] = -1;
+	occupied[level] &= ~((uint64_t)1 << slot);
+	while (i >= 0) {
+		int j = pool[i].next;
+		Link(i);
+		i = j;
+	}
+}
+
+
+int TimerWheel::FirstSlot(int level, int from)
+{
+	uint64_t m = occupied[level] >> from;
+	if (m == 0) return -1;
+	while ((m & 1) == 0) {
+		m >>= 1;
+		from += 1;
+	}
+	return from;
+}
@@ -0,0 +1,90 @@
+/*
+ *  timer_wheel.h
+ *  hierarchical timing wheel with millisecond resolution
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+#include <unordered_map>
+
+// Each timer is identified by an owner (typically the object it's for) and a
+//		<kind> (defined by the user of the class) and has an expiry time in
+//		ms; there is at most one timer for each (owner, kind) pair, so
+//		setting a timer that's already running just changes its expiry time
+// The caller supplies the time (e.g. from GetTickCount64()); timers that
+//		have expired are collected by calling <Expired> repeatedly, after
+//		which <NextExpiry> says when to call it again
+// The wheel has TW_LEVELS levels of TW_SLOTS slots; level 0 has one slot per
+//		ms, and each slot at level n covers the whole of level n-1, so
+//		setting, cancelling and expiring a timer take constant time (on
+//		average, as the timers are found through a hash table) however
+//		many there are, and advancing the time only visits slots that have
+//		timers in them (plus one step per TW_SLOTS ms); timers further ahead
+//		than the wheel covers (about 4.6 hours) go in the top level and are
+//		moved down when it comes round
+
+#define TW_SLOT_BITS	 6
+#define TW_SLOTS		(1 << TW_SLOT_BITS)
+#define TW_LEVELS		 4
+
+
+class TimerWheel
+{
+public:
+	TimerWheel();
+
+		// set timer (<owner>, <kind>) to expire at time <due>; if that's no
+		//		later than the time given to the last call of <Expired> it
+		//		will be returned by the next call
+	void Set(void * owner, int kind, uint64_t due);
+	void Cancel(void * owner, int kind);
+		// cancel all <owner>'s timers; takes time proportional to the
+		//		number of timers running, as it looks at all of them
+	void CancelAll(void * owner);
+		// expiry time of timer (<owner>, <kind>), 0 if not running
+	uint64_t When(void * owner, int kind);
+
+		// if a timer has expired at time <now>, remove it, set <owner> and
+		//		<kind>, and return true; timers are returned in order of
+		//		expiry time
+	bool Expired(uint64_t now, void * &owner, int &kind);
+		// earliest expiry time, 0 if no timers are running; may be early if 
+		//		the earliest is more than a few minutes ahead, in which case
+		//		<Expired> just returns false
+	uint64_t NextExpiry();
+	int Count() const { return (int)index.size(); }
+
+private:
+	struct Timer {
+		void * owner;
+		int kind;
+		uint64_t due;
+		int list;		// index in <heads>
+		int prev;		// in <pool>, -1 for none
+		int next;
+	};
+	std::vector<Timer> pool;	// entries not in use are chained through <next>
+	int free_list;
+	struct KeyHash {
+		size_t operator()(const std::pair<void *, int>& k) const {
+				return std::hash<void *>()(k.first) ^
+										((size_t)k.second * 0x9E3779B9u); }
+	};
+	typedef std::unordered_map<std::pair<void *, int>, int, KeyHash> TimerIndex;
+	TimerIndex index;		// value is index in <pool>
+		// lists of timers; the last is those that have expired
+#define TW_EXPIRED		(TW_LEVELS * TW_SLOTS)
+	int heads[TW_EXPIRED + 1];
+	uint64_t occupied[TW_LEVELS];	// bit per slot, set if list not empty
+	uint64_t now_ms;		// the wheel has been advanced to here
+	bool started;			// whether <now_ms> has been set
+
+	void Link(int i);		// add <pool[i]> to the right list for its <due>
+	void Unlink(int i);
+	void Release(int i);	// unlink and put on <free_list>
+	void Step(uint64_t limit);	// advance to the next slot, not past <limit>
+	void Cascade(int level, int slot);	// move timers down a level
+	int FirstSlot(int level, int from);	// first occupied slot at or after <from>, -1 if none
+};
@@ -0,0 +1,201 @@
+/*
+ *  topology_graph.cpp
+ *  the point-to-point links between units, with hop counts
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// For Windows this file needs to be #included in a .cpp file in
+//		the project directory (see extras.cpp), as for string_extras.cpp
+
+#include "topology_graph.h"
+#include <deque>
+
+
+TopologyGraph::TopologyGraph()
+{
+	root = NULL;
+	stale = false;
+	revision = 0;
+	next_id = 0;
+}
+
+
+TopologyGraph::Node& TopologyGraph::Add(void * u)
+{
+	std::unordered_map<void *, Node>::iterator it = nodes.find(u);
+	if (it != nodes.end()) return it->second;
+	Node& n = nodes[u];
+	n.hops = (u == root) ? 0 : -1;
+	n.parent = u;
+	n.rank = 0;
+	n.id = next_id++;
+	return n;
+}
+
+
+void TopologyGraph::SetRoot(void * u)
+{
+	if (u == root) return;
+	root = u;
+	stale = true;
+	revision += 1;
+}
+
+
+// links that have gone or whose partner has changed are removed first; if
+//		there are any, everything will be recalculated, so the new links are
+//		just recorded
+void TopologyGraph::SetLinks(void * u, const std::map<int, void *>& ports)
+{
+	Node& n = Add(u);
+	std::map<int, void *>::iterator p = n.ports.begin();
+	while (p != n.ports.end()) {
+		std::map<int, void *>::const_iterator q = ports.find(p->first);
+		if (q != ports.end() && q->second == p->second) { p++; continue; }
+		Unlink(u, p->second);
+		p = n.ports.erase(p);
+		stale = true;
+	}
+
+	bool changed = false;
+	std::map<int, void *>::const_iterator q = ports.begin();
+	for (; q != ports.end(); q++) {
+		if (n.ports.find(q->first) != n.ports.end()) continue;
+		n.ports[q->first] = q->second;
+		Node& m = Add(q->second);
+		m.in[u] += 1;
+		changed = true;
+		if (stale) continue;
+		Union(u, q->second);
+		if (n.hops >= 0 && (m.hops < 0 || m.hops > n.hops + 1)) {
+			m.hops = n.hops + 1;
+			Relax(q->second);
+		}
+	}
+	if (changed || stale) revision += 1;
+}
+
+
+void TopologyGraph::RemoveUnit(void * u)
+{
+	if (root == u) root = NULL;
+	std::unordered_map<void *, Node>::iterator it = nodes.find(u);
+	if (it == nodes.end()) return;
+	std::map<int, void *>::iterator p = it->second.ports.begin();
+	for (; p != it->second.ports.end(); p++) {
+		if (p->second != u) Unlink(u, p->second);
+	}
+	std::unordered_map<void *, int>::iterator w = it->second.in.begin();
+	for (; w != it->second.in.end(); w++) {
+		if (w->first == u) continue;
+		std::map<int, void *>& ports = nodes[w->first].ports;
+		std::map<int, void *>::iterator q = ports.begin();
+		while (q != ports.end()) {
+			if (q->second == u) q = ports.erase(q);
+			else q++;
+		}
+	}
+	nodes.erase(it);
+	stale = true;
+	revision += 1;
+}
+
+
+void TopologyGraph::Unlink(void * u, void * v)
+{
+	std::unordered_map<void *, Node>::iterator it = nodes.find(v);
+	if (it == nodes.end()) return;
+	std::unordered_map<void *, int>::iterator c = it->second.in.find(u);
+	if (c != it->second.in.end() && --c->second <= 0) it->second.in.erase(c);
+}
+
+
+// breadth-first from <u>, but only through units whose count is reduced
+void TopologyGraph::Relax(void * u)
+{
+	std::deque<void *> queue;
+	queue.push_back(u);
+	until (queue.empty()) {
+		Node& n = nodes[queue.front()];
+		queue.pop_front();
+		std::map<int, void *>::iterator p = n.ports.begin();
+		for (; p != n.ports.end(); p++) {
+			Node& m = nodes[p->second];
+			unless (m.hops < 0 || m.hops > n.hops + 1) continue;
+			m.hops = n.hops + 1;
+			queue.push_back(p->second);
+		}
+	}
+}
+
+
+void * TopologyGraph::Find(void * u)
+{
+	void * r = u;
+	while (true) {
+		void * p = nodes[r].parent;
+		if (p == r) break;
+		r = p;
+	}
+	until (u == r) {
+		Node& n = nodes[u];
+		u = n.parent;
+		n.parent = r;
+	}
+	return r;
+}
+
+
+void TopologyGraph::Union(void * u, void * v)
+{
+	u = Find(u);
+	v = Find(v);
+	if (u == v) return;
+	Node& a = nodes[u];
+	Node& b = nodes[v];
+	if (a.rank < b.rank) a.parent = v;
+	else {
+		b.parent = u;
+		if (a.rank == b.rank) a.rank += 1;
+	}
+}
+
+
+void TopologyGraph::Recalculate()
+{
+	std::unordered_map<void *, Node>::iterator it = nodes.begin();
+	for (; it != nodes.end(); it++) {
+		it->second.hops = -1;
+		it->second.parent = it->first;
+		it->second.rank = 0;
+	}
+	stale = false;
+
+	it = nodes.find(root);
+	if (it != nodes.end()) {
+		it->second.hops = 0;
+		Relax(root);
+	}
+	for (it = nodes.begin(); it != nodes.end(); it++) {
+		std::map<int, void *>::iterator p = it->second.ports.begin();
+		for (; p != it->second.ports.end(); p++) Union(it->first, p->second);
+	}
+}
+
+
+int TopologyGraph::Hops(void * u)
+{
+	if (stale) Recalculate();
+	std::unordered_map<void *, Node>::iterator it = nodes.find(u);
+	return (it == nodes.end()) ? -1 : it->second.hops;
+}
+
+
+int TopologyGraph::Component(void * u)
+{
+	if (stale) Recalculate();
+	if (nodes.find(u) == nodes.end()) return -1;
+	return nodes[Find(u)].id;
+}
@@ -0,0 +1,71 @@
+/*
+ *  topology_graph.h
+ *  the point-to-point links between units, with the number of hops from
+ *		the gateway unit to each, kept up to date as the links change
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+#pragma once
+#include "string_extras.h"
+#include <unordered_map>
+
+// Each unit's links are set from its own MIB (the network ports that are
+//		point-to-point and the partner on each), so a link is directed:
+//		from the unit that reports it to its partner; the hop counts follow
+//		the links in that direction, as tracing the network from the gateway
+//		does, whereas components are found ignoring the direction
+// Hop counts are maintained as links are added (a new link can only
+//		shorten paths, so the search only goes as far as the units whose
+//		count is reduced), and components are merged using union-find; when
+//		a link is removed or the root changes they are recalculated, but
+//		not until they are next asked for
+// Units are identified by pointers, as for <MibBus>; a unit that is deleted
+//		must be removed with <RemoveUnit>
+
+
+class TopologyGraph
+{
+public:
+	TopologyGraph();
+
+		// the unit from which hops are counted (normally the link partner)
+	void SetRoot(void * u);
+		// replace the links reported by <u> with <ports>, which maps port
+		//		number to partner (which must not be NULL)
+	void SetLinks(void * u, const std::map<int, void *>& ports);
+		// remove <u> and all links to and from it
+	void RemoveUnit(void * u);
+
+		// number of hops from the root to <u>, or -1 if it can't be reached
+		//		(including if it isn't known); the root is 0
+	int Hops(void * u);
+		// the component containing <u>, as a number that's the same for all
+		//		the units in it; -1 if <u> isn't known
+	int Component(void * u);
+		// incremented whenever any hop count or component may have changed
+	unsigned Revision() const { return revision; }
+
+private:
+	struct Node {
+		std::map<int, void *> ports;		// links from this unit
+		std::unordered_map<void *, int> in;	// number of links to this unit
+											//		from each other unit
+		int hops;
+		void * parent;		// for union-find; the unit itself if a root
+		int rank;
+		int id;				// component number if a union-find root
+	};
+	std::unordered_map<void *, Node> nodes;
+	void * root;
+	bool stale;			// hop counts and components need to be recalculated
+	unsigned revision;
+	int next_id;
+
+	Node& Add(void * u);
+	void Unlink(void * u, void * v);	// remove one link from <u> to <v>
+	void Relax(void * u);	// <u>'s hop count has been reduced
+	void * Find(void * u);
+	void Union(void * u, void * v);
+	void Recalculate();
+};
@@ -26,6 +26,7 @@ AnalyserDoc::AnalyserDoc(MgtSocket * u, uint8_t p)
 {
 	partner = u;
 	partner_port = p;
+	scp_index = -1;	// until written by CControllerApp::FindScpServer()
 	server_state = NULL;
 	display_messages = false;
 	dbg_st = -1;
@@ -53,7 +54,8 @@ AnalyserDoc::AnalyserDoc(MgtSocket * u, uint8_t p)
 // destructor
 AnalyserDoc::~AnalyserDoc()
 {
-	if (call_ref >= 0 && (call_ref & 256)) theApp.scp.at(call_ref & 255) = NULL;
+	if (scp_index >= 0) theApp.scp.at(scp_index) = NULL;
+	unless (call_ref < 0) theApp.labels.Free(call_ref & LABEL_MAX);
 }
 
 
@@ -231,6 +233,8 @@ case 'f':	pending_console_input.clear();
 		p = (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
 		if (p == server_state) return;	// no change
 		server_state = p;
+			// the sources window shows the VM state
+		theApp.mib_bus.Publish(partner, MIB_BIT(MIB_COL_N_PORT_VM_STATE));
 		ConsoleLine(ServerState());	// assumed nonempty
 		unless (state == MGT_ST_CONN_MADE) return;
 		state = MGT_ST_ACTIVE;
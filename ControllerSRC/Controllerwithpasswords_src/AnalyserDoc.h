@@ -108,6 +108,9 @@ public:
 		// <partner_port> is the block id for the port on the partner unit
 	class MgtSocket * partner;	// assumed not to be NULL
 	uint8_t partner_port;		// block id (rubbish if <partner> is NULL)
+		// index in <theApp.scp>, which is also the <display_select> value 
+		//		for the controller window
+	int scp_index;
 		// the unit containing the SCP server (NULL if unknown)
 	MgtSocket * Host() { return partner->LinkPartner(partner_port); }
 
@@ -128,7 +131,7 @@ public:
 	uint32_t server_state;
 	std::string ServerState();	// <server_state> as text; empty string if not known
 
-		// over-rides etc; NB for <PollAwaitingAck> we only need the base class version
+		// over-rides etc; NB for <TimerExpired> we only need the base class version
 		// send FindRoute request
 	void SendConnReq();
 		// called when the connection has been made
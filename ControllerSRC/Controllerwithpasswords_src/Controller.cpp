@@ -11,6 +11,7 @@
 #include "CrosspointDoc.h"
 #include "CrosspointView.h"
 //#include ".\controller.h"
+#include <set>
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -24,6 +25,8 @@ BEGIN_MESSAGE_MAP(CControllerApp, CWinApp)
 	// Standard file based document commands
 	ON_COMMAND(ID_FILE_NEW, CWinApp::OnFileNew)
 	ON_COMMAND(ID_FILE_OPEN, CWinApp::OnFileOpen)
+	ON_COMMAND(ID_FILE_RUN_SALVO, OnFileRunSalvo)
+	ON_UPDATE_COMMAND_UI(ID_FILE_RUN_SALVO, OnUpdateFileRunSalvo)
 END_MESSAGE_MAP()
 
 
@@ -42,12 +45,19 @@ CControllerApp::CControllerApp()
 	link_socket = NULL;
 	link_partner = NULL;
 	pre_connection = true;
-	last_unit_allocd = 0;
 	controller_doc = NULL;
 	input_list = NULL;
 	output_list = NULL;
-	mib_changed = false;
+	xpt_revision = 0;
+	bus_topology = mib_bus.Subscribe(TOPOLOGY_BITS | MIB_BIT_UNIT_STATE);
+	bus_any = mib_bus.Subscribe(MIB_BITS_ALL);
+	bus_inputs = mib_bus.Subscribe(XPT_BITS_UNIT | XPT_BITS_INPUTS);
+	bus_outputs = mib_bus.Subscribe(XPT_BITS_UNIT | XPT_BITS_OUTPUTS);
+	bus_console = mib_bus.Subscribe(MIB_BITS_ALL);
 	update_flags = -1;
+	rollout = new Rollout();
+	salvo = new Salvo();
+	timer_armed = 0;
 }
 
 CCommandLineOptions::CCommandLineOptions()
@@ -100,6 +110,15 @@ CFont * FindFont(int height)
 
 // CControllerApp initialization
 
+// whether <fn> has the extension of a product file (.9t3prd or .9t4prd), as 
+//		the optional parameter after "-rollout" must
+static bool IsProductFile(const TCHAR* fn)
+{
+	CString ext = CString(fn).Right(7);
+	ext.MakeLower();
+	return ext == ".9t3prd" || ext == ".9t4prd";
+}
+
 // parsing parameters: called for each word <pszParam> on the command line
 // <bFlag> is true if '/' or '-' was removed from the front of <pszParam>
 // <bLast> is true for the last word on the command line
@@ -122,6 +141,23 @@ void CCommandLineOptions::ParseParam(const TCHAR* pszParam,
 			return;
 		}
 
+		if (s == "rollout") {
+				// product file is optional, see case 4 below
+			theApp.rollout->Start("");
+			theApp.next_param = 4;
+			return;
+		}
+
+		if (s == "budget") {
+			theApp.next_param = 5;	// if parameter is "-budget"
+			return;
+		}
+
+		if (s == "salvo") {
+			theApp.next_param = 6;	// if parameter is "-salvo"
+			return;
+		}
+
 		if (s == "vm4") theApp.vm4scp = true;
 		else if (s == "listener") theApp.privilege = PRIV_LISTENER;
 		else if (s == "operator") theApp.privilege = PRIV_OPERATOR;
@@ -159,6 +195,21 @@ case 2:		// is a number following "-privilege"
 		theApp.privilege = 0;
 		break;
 
+case 4:		// may be the product file following "-rollout"; if it isn't, 
+			//		the rollout applies to all units and the parameter is 
+			//		ignored, as it would be if "-rollout" hadn't been there
+		if (IsProductFile(pszParam)) theApp.rollout->Start(pszParam);
+		break;
+
+case 5:		// is a number of kbytes/s following "-budget"
+		if (sscanf_s(pszParam, "%i", &n) == 1 && n > 0) 
+										theApp.rollout->budget = n * 1000;
+		break;
+
+case 6:		// is the file following "-salvo"
+		theApp.salvo->Load(pszParam);
+		break;
+
 case 3:		// we didn't recognise it, let the base class deal with it
 		CCommandLineInfo::ParseParam(pszParam, bFlag, bLast);
 		return;
@@ -184,6 +235,10 @@ BOOL CControllerApp::InitInstance()
 
 	units.SetSize(1);	// create the dummy entry for flow label 0
 
+		// check the IT header CRC table against the bit-by-bit calculation 
+		//		(debug builds only)
+	ASSERT(HecTableOK());
+
 		// InitCommonControls() is required on Windows XP if an application
 		// manifest specifies use of ComCtl32.dll version 6 or later to enable
 		// visual styles.  Otherwise, any window creation will fail.
@@ -321,6 +376,8 @@ int CControllerApp::ExitInstance() {
 	i = (int) scp.size();
 	while (--i >= 0) { delete scp.at(i); scp.at(i) = NULL; }
 	delete link_socket;
+	delete rollout;
+	delete salvo;
 	return r;
 }
 
@@ -366,6 +423,22 @@ void CControllerApp::OnAppAbout()
 }
 
 
+// File > Run Salvo: choose a file of connections to make (see Salvo.h)
+void CControllerApp::OnFileRunSalvo()
+{
+	CFileDialog d(TRUE, "txt", NULL, OFN_FILEMUSTEXIST | OFN_HIDEREADONLY, 
+				"Salvo files (*.txt;*.csv)|*.txt;*.csv|All files (*.*)|*.*||");
+	unless (d.DoModal() == IDOK) return;
+	salvo->Load(d.GetPathName());
+}
+
+
+void CControllerApp::OnUpdateFileRunSalvo(CCmdUI* pCmdUI)
+{
+	pCmdUI->Enable(privilege >= PRIV_OPERATOR && !salvo->active);
+}
+
+
 // routine called after messages processed; return whether should be 
 //		called again immediately
 // <lCount> is the number of previous calls since the last message
@@ -376,6 +449,8 @@ BOOL CControllerApp::OnIdle(LONG lCount)
 
 	MgtSocket * m;
 	int i;
+	bool retrace;
+	std::vector<MibDelta> d;
 	switch (lCount) {
 case 3:
 			// check whether MgtSocket objects have anything to do
@@ -388,37 +463,125 @@ case 3:
 		return TRUE;
 
 case 4:
-		unless (mib_changed) return r;
-		mib_changed = false;
-
-			// check whether there are any units we don't have management 
-			//		sockets for yet, or for which it needs to reconnect
-			// +++ ought not to do this unless the change to the MIB affects 
-			//		the connectivity
-		if (link_partner && link_partner->state == MGT_ST_ACTIVE) {
+			// update <topology> for units whose network ports have changed, 
+			//		which also creates management sockets for any neighbours 
+			//		we haven't met yet
+			// a unit that has been deleted may be among the changes (it 
+			//		publishes MIB_BIT_UNIT_STATE), so we only look at those 
+			//		that are still in <units>
+		retrace = mib_bus.Collect(bus_topology, d);
+		if (retrace) {
+			std::set<void *> changed;
+			std::vector<MibDelta>::iterator p = d.begin();
+			for (; p != d.end(); p++) if (p->bits & TOPOLOGY_BITS) 
+														changed.insert(p->unit);
 			i = (int)(units.GetCount());
 			while (--i > 0) {
 				m = units.GetAt(i);
-				if (m) m->traced = false;
+				if (m && changed.count(m) != 0) m->UpdateLinks();
 			}
+		}
 
-			link_partner->Trace();
+			// check whether there are any units for which it needs to 
+			//		reconnect; any change prompts a retry if there are units 
+			//		that need it, but only those that can be reached
+		if (mib_bus.Flush(bus_any) && !retrace) {
+			i = (int)(units.GetCount());
+			while (--i > 0) {
+				m = units.GetAt(i);
+				if (m && m->state >= MGT_ST_MIN_RETRY) retrace = true;
+			}
+		}
+		if (retrace && link_partner && link_partner->state == MGT_ST_ACTIVE) {
+			i = (int)(units.GetCount());
+			while (--i > 0) {
+				m = units.GetAt(i);
+				if (m && m->state >= MGT_ST_MIN_RETRY && 
+									topology.Hops(m) >= 0) m->SendConnReq();
+			}
 		}
 
 			// redraw windows
-		if (input_list != NULL) input_list->UpdateAllViews(NULL);
-		if (output_list != NULL) output_list->UpdateAllViews(NULL);
+		if (mib_bus.Collect(bus_inputs, d) && input_list != NULL) 
+												input_list->MibChanged(d);
+		if (mib_bus.Collect(bus_outputs, d) && output_list != NULL) 
+												output_list->MibChanged(d);
+		if (mib_bus.Flush(bus_console) && controller_doc != NULL && 
+				controller_doc->display_select < 0 && !controller_doc->UnitIs(NULL)) 
+											controller_doc->UpdateDisplay();
 	}
 	return r;
 }
 
 
+void CControllerApp::StartTimerAt(void * owner, int kind, ULONGLONG t)
+{
+	timers.Set(owner, kind, t);
+	ArmTimer();
+}
+
+
+// Windows timers repeat, so the timer is only changed if it needs to go off 
+//		sooner; <RunTimers> sets it again each time
+bool CControllerApp::ArmTimer()
+{
+	ULONGLONG t = timers.NextExpiry();
+	if (t == 0 || m_pMainWnd == NULL) return true;
+	unless (timer_armed == 0 || t < timer_armed) return true;
+	ULONGLONG now = GetTickCount64();
+	UINT ms = (t > now) ? (UINT)(t - now) : USER_TIMER_MINIMUM;
+	if (m_pMainWnd->SetTimer(IDT_TIMERS, ms, NULL) == 0) return false;
+	timer_armed = t;
+	return true;
+}
+
+
+// the owner of each kind of timer is as shown where they are defined
+void CControllerApp::RunTimers()
+{
+	ULONGLONG now = GetTickCount64();
+	void * owner;
+	int kind;
+	while (timers.Expired(now, owner, kind)) switch (kind) {
+case TMR_LINK_RETRY:
+		((CMainFrame *)m_pMainWnd)->RestartLink();
+		break;
+
+case TMR_PRUNE:
+			// remove flows that are no longer being reported
+		if (flow_senders.Prune((uint32_t)_time64(NULL) - FLOW_SENDER_MAX_AGE) > 0) {
+			xpt_revision += 1;
+			mib_bus.Publish(NULL, MIB_BIT(MIB_COL_UD_NET_BLOCK_ID));
+		}
+		StartTimer(NULL, TMR_PRUNE, FLOW_PRUNE_INTERVAL);
+		break;
+
+case TMR_LINK_RX:
+case TMR_LINK_TX:
+		((LinkSocket *)owner)->TimerExpired(kind);
+		break;
+
+case TMR_SALVO:
+		((Salvo *)owner)->Poll();
+		break;
+
+default:
+		((FlexilinkSocket *)owner)->TimerExpired(kind);
+	}
+
+	m_pMainWnd->KillTimer(IDT_TIMERS);
+	timer_armed = 0;
+	ArmTimer();
+}
+
+
 // called by the link socket when the Link Accept is received; <id> is the link 
 //		partner's address
 // creates a management socket for the link partner if we don't already have one
 // prompts any existing management sockets to attempt reconnection
 void CControllerApp::NewLinkPartner(ByteString id)
 {
+	mib_bus.Publish(NULL, MIB_BIT_UNIT_STATE);	// the topology has changed
 	int i = (int)units.GetCount();
 	if (i > 1) {
 			// have management sockets from a previous link
@@ -428,16 +591,18 @@ void CControllerApp::NewLinkPartner(ByteString id)
 			if (m_skt) m_skt->SendConnReq();
 		} while (i > 0);
 
-		void * q;
-		if (unit_addrs.Lookup(ByteArrayToHex(id), q)) {
+		MgtSocket * q = (MgtSocket *)unit_addrs.Find(id);
+		if (q) {
 				// the new link partner is among them
-			link_partner = (MgtSocket *)q;
+			link_partner = q;
+			topology.SetRoot(q);
 			return;
 		}
 	}
 
 		// here to create a management object for the link partner
 	link_partner = NewUnit(id);
+	topology.SetRoot(link_partner);
 	if (link_partner) controller_doc->SetUnit(link_partner);
 }
 
@@ -449,32 +614,19 @@ class MgtSocket * CControllerApp::NewUnit(ByteString call_addr)
 	MgtSocket * m = new MgtSocket();
 	unless (m) return NULL;
 
-		// Allocate a flow label; if the table isn't very large, just allocate 
-		//		a new one, else see whether there's one we can re-use
-	int n = (int)units.GetCount();
-	if (n < 50) goto extend_list;
-	int j = last_unit_allocd;
-	do {
-		j += 1;
-		if (j >= n) j = 1;
-		if (j == last_unit_allocd) {
-			if (n < 256) goto extend_list;
-			return NULL;	// no labels left in the range we use for units
-		}
-	} while (units.GetAt(j) != NULL);
-	units.SetAt(j, m);
-	n = j;
-	goto have_index;
-
-extend_list:
-	units.Add(m);
-have_index:	// here when the unit has been added at index <n>
-	last_unit_allocd = n;
-	m->call_ref = n;
+		// allocate a flow label, which is also the index in <units>
+	int n = labels.Allocate((FlexilinkSocket *)m);
+	if (n < 0) {
+		delete m;	// no labels left
+		return NULL;
+	}
+	if (n >= units.GetSize()) units.SetSize(n + 1);
+	units.SetAt(n, m);
+	m->call_ref = labels.CallRef(n);
 	m->unit_name.Format("[unit %d]", n);
 	m->unit_TAddress = call_addr;
 	m->unit_address = ByteArrayToHex(call_addr);
-	unit_addrs.SetAt(m->unit_address, (void *)m);
+	unit_addrs.Set(call_addr, (void *)m);
 	m->SendConnReq();
 	return m;
 }
@@ -518,15 +670,20 @@ class AnalyserDoc * CControllerApp::FindScpServer(MgtSocket * u, int p, int step
 	if (steps == 0 || p < 0 || u == NULL) return NULL;
 		// here to create a new <AnalyserDoc> object
 		// there are no free entries if <j> is negative, else entry <j> is free
+	a = new AnalyserDoc(u, p);
+	int n = labels.Allocate((FlexilinkSocket *)a);
+	if (n < 0) {
+		delete a;	// no labels left
+		return NULL;
+	}
 	if (j < 0) {
 			// need a new entry
 		j = scp.size();
-		if (j > 255) return NULL; // can't add any more
 		scp.push_back(NULL);
 	}
-	a = new AnalyserDoc(u, p);
 	scp.at(j) = a;
-	a->call_ref = j | 256;
+	a->scp_index = j;
+	a->call_ref = labels.CallRef(n);
 
 	if (steps > 1) a->SendConnReq();
 	return a;
@@ -551,10 +708,15 @@ void CControllerApp::RemoveFromAnalysers(MgtSocket * u)
 // return the object to which to route packets with label <n>, NULL if none
 class FlexilinkSocket * CControllerApp::FindSocket(int n)
 {
-	if (n > 0 && n < units.GetSize()) return units.GetAt(n);
-	n -= 256;
-	if (n >= 0 && n < (int)scp.size()) return scp.at(n);
-	return NULL;
+	return (FlexilinkSocket *)labels.Find(n);
+}
+
+
+// as above but <n> is from a call reference, so is also checked against the 
+//		generation of the label
+class FlexilinkSocket * CControllerApp::FindCall(int n)
+{
+	return (FlexilinkSocket *)labels.FindRef(n);
 }
 
 
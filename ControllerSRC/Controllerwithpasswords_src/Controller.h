@@ -4,6 +4,12 @@
 
 #pragma once
 #include "../Common/string_extras.h"
+#include "../Common/mgt_core.h"
+#include "../Common/mib_bus.h"
+#include "../Common/label_registry.h"
+#include "../Common/addr_directory.h"
+#include "../Common/topology_graph.h"
+#include "../Common/timer_wheel.h"
 
 #ifndef __AFXWIN_H__
 	#error include 'stdafx.h' before including this file for PCH
@@ -63,14 +69,11 @@ public:
 
 		// context while parsing command line if no '-' or '/'
 		// 1 = server_addr, 2 = privilege value, 3 = unknown, 
+		//		4 = rollout product file, 5 = rollout budget, 6 = salvo file, 
 		//		0 = nothing expected
 	int next_param;
 		// information from command line
-	uint8_t privilege; // as in 62379-1, defaults to PRIV_OPERATOR, 0 = invalid
-#define PRIV_LISTENER	 1 // min privilege, no password needed
-#define PRIV_OPERATOR	 2
-#define PRIV_SUPERVISOR	 3
-#define PRIV_MAINTENANCE 4
+	uint8_t privilege; // PRIV_ code (see mgt_core.h), defaults to PRIV_OPERATOR, 0 = invalid
 		// flag to show whether to include the "console" window but actually 
 		//		it's always there and can be restored by clicking in the bottom 
 		//		left of the workspace
@@ -97,12 +100,14 @@ public:
 		//		partner; if no link is connected it will apply to the previous 
 		//		link partner
 		// the index to <units> is the flow number used on the link; the entry 
-		//		with index 0 is not used; all unused entries are NULL
+		//		with index 0 is not used; all unused entries are NULL, 
+		//		including those for labels allocated to SCP sessions
+		// <labels> allocates the flow numbers for both units and SCP sessions
 	class LinkSocket * link_socket;
 	class MgtSocket * link_partner;
 	bool pre_connection;	// haven't connected to anything
 	CArray<class MgtSocket *, MgtSocket *> units;
-	int last_unit_allocd;
+	LabelRegistry labels;	// values are <FlexilinkSocket *>
 	class CControllerDoc * controller_doc;
 	class CCrosspointDoc * input_list;
 	class CCrosspointDoc * output_list;
@@ -114,45 +119,60 @@ public:
 	class AnalyserDoc * FindScpServer(MgtSocket * u, int p, int steps = 2);
 		// remove references to <u> from <Analyser> objects
 	void RemoveFromAnalysers(MgtSocket * u);
-		// find socket with label <n>
+		// find socket with label <n>, or with <n> in the ls 16 bits of its 
+		//		call reference (as in signalling messages)
 	class FlexilinkSocket * FindSocket(int n);
+	class FlexilinkSocket * FindCall(int n);
 
 		// list of all the connections to SCP servers; NULL means the object no 
 		//		longer exists; we don't shuffle them to close the gap because 
-		//		the indexes mustn't change
+		//		the indexes (<AnalyserDoc::scp_index>) mustn't change
 	std::vector<AnalyserDoc *> scp;
 
 		// list of all the addresses of units we know about
-		// value is a <MgtSocket *>; may be NULL
-		// +++ it would be safer for the value to be an index into <units> but 
-		//		there's nothing like CMapStringToInt; ought to change to use 
-		//		something like std::map<std::string, int> (or with ByteString 
-		//		as the key)
-		// key is the nPortPartnerAddr in Flexilink format (05 + 16 hex digits 
-		//		of EUI64, as a string of ASCII hex digits), or derived from 
-		//		unitAddress in the case of the first unit connected to
-	CMapStringToPtr unit_addrs;
+		// value is a <MgtSocket *>
+		// key is the nPortPartnerAddr in Flexilink format (05 followed by the 
+		//		8 bytes of EUI64) in binary, or derived from unitAddress in the 
+		//		case of the first unit connected to
+	AddrDirectory unit_addrs;
 
 		// list of senders of all the flows we know about
-		// value is a <MgtSocket *>; may be NULL
-		// +++ see note above
-		// key is the flow id in dotted decimal, including the initial 16 arc
-		// we don't prune entries when flows are disconnected; they need to be 
-		//		pruned if we remove a unit, and over time the table might get 
-		//		unreasonably large
-	CMapStringToPtr flow_senders;
-
-		// flag which is set whenever anything (in any of the MIBs) that is 
-		//		relevant to the "crosspoint" windows is updated, and cleared 
-		//		when the windows are repainted
-		// if clear, we know the screen is up-to-date; the screen could also be 
-		//		up-to-date if it is set, for instance if the update happened 
-		//		before the object was displayed or was to an object that doesn't 
-		//		affect the displayed information
-		// NOTE: I have been lazy here; it is set whenever anything changes in 
-		//		any of the MIBs, even if the thing that has changed doesn't 
-		//		affect the information that is displayed
-	bool mib_changed;
+		// value is a <MgtSocket *>
+		// key is the flow id as BER-coded index arcs (see <IndexFromText>), 
+		//		including the initial 16 arc
+		// the stamp is the time (in seconds) the flow was last reported; flows 
+		//		that are disconnected stop being reported, and entries that 
+		//		haven't been confirmed for FLOW_SENDER_MAX_AGE are removed every 
+		//		FLOW_PRUNE_INTERVAL (see <RunTimers>), as are all those for a 
+		//		unit that is removed
+#define FLOW_SENDER_MAX_AGE		300		// seconds
+#define FLOW_PRUNE_INTERVAL		60000	// ms
+	AddrDirectory flow_senders;
+
+		// the point-to-point links between units, as reported in their MIBs, 
+		//		with the number of hops from <link_partner> to each unit
+		// a unit's links are updated in <OnIdle> when <bus_topology> reports 
+		//		a change to its network ports (see <MgtSocket::UpdateLinks>)
+		// keys are <MgtSocket *>
+	TopologyGraph topology;
+
+		// changes to the MIBs (and to the units' states) are published here, 
+		//		and collected in <OnIdle> for the subscriptions below, each of 
+		//		which is for the objects that affect one window or activity
+	MibBus mib_bus;
+	int bus_topology;	// units' network ports and link partners: update 
+						//		<topology> and retry connections
+#define TOPOLOGY_BITS	(MIB_BIT(MIB_COL_N_PORT_STATE) | \
+				MIB_BIT(MIB_COL_N_PORT_ADDR_TYPE) | \
+				MIB_BIT(MIB_COL_N_PORT_PARTNER_ADDR))
+	int bus_any;		// anything: re-trace if any units are to be retried
+	int bus_inputs;		// objects shown in <input_list>
+	int bus_outputs;	// objects shown in <output_list>
+	int bus_console;	// the unit selected in <controller_doc>
+		// similar to <MgtSocket::xpt_revision> but for changes that may affect 
+		//		the lines shown for other units: names of units and ports (which 
+		//		are shown as the senders of flows) and <flow_senders>
+	unsigned xpt_revision;
 
 		// report of most recent error responses (if any)
 	CStringArray err_msgs;
@@ -163,6 +183,42 @@ public:
 //	CMapStringToString name_translations;
 
 	int update_flags;	// -ve = haven't asked yet, 0 = no, +ve = yes
+		// software updates across several units, and the images being 
+		//		uploaded (see Rollout.h); always a valid pointer
+	class Rollout * rollout;
+		// connections being made together (see Salvo.h); always a valid 
+		//		pointer
+	class Salvo * salvo;
+
+		// timeouts for repeating messages, keepalives, reconnecting etc; the 
+		//		times are from GetTickCount64(), and a single Windows timer 
+		//		(IDT_TIMERS) is set for the earliest expiry, so nothing is done 
+		//		for units that have nothing due
+		// the owner of each timer is the object named below, or NULL; objects 
+		//		that own timers cancel them when they are deleted
+	TimerWheel timers;
+#define TMR_LINK_RETRY		1	// NULL: replace the link socket (see <CMainFrame::RestartLink>)
+#define TMR_PRUNE			2	// NULL: remove old entries from <flow_senders>
+#define TMR_LINK_RX			3	// LinkSocket: no keepalive received
+#define TMR_LINK_TX			4	// LinkSocket: send a keepalive
+#define TMR_SALVO			5	// Salvo: see <Salvo::Poll>
+#define TMR_UNIT_SIGNAL		6	// FlexilinkSocket: repeat <mgt_msg>
+#define TMR_UNIT_LIVENESS	7	// FlexilinkSocket: check the unit is still sending
+#define TMR_UNIT_RETRY		8	// FlexilinkSocket: try to reconnect
+#define TMR_UNIT_REQUEST	9	// MgtSocket: repeat <requests> that are due
+#define TMR_UNIT_FLASH		10	// MgtSocket: read the flash map again while erasing
+		// (re)start a timer to expire after <ms>, or at time <t>
+	void StartTimer(void * owner, int kind, int ms) 
+						{ StartTimerAt(owner, kind, GetTickCount64() + ms); }
+	void StartTimerAt(void * owner, int kind, ULONGLONG t);
+	void CancelTimer(void * owner, int kind) { timers.Cancel(owner, kind); }
+		// set the Windows timer if there's a timer due before it; returns 
+		//		false if no Windows timer is available
+	bool ArmTimer();
+	ULONGLONG timer_armed;	// when the Windows timer is due, 0 if not set
+		// called when the Windows timer fires: act on the timers that have 
+		//		expired
+	void RunTimers();
 
 // Overrides
 public:
@@ -170,6 +226,8 @@ public:
 
 // Implementation
 	afx_msg void OnAppAbout();
+	afx_msg void OnFileRunSalvo();
+	afx_msg void OnUpdateFileRunSalvo(CCmdUI* pCmdUI);
 	DECLARE_MESSAGE_MAP()
 	virtual BOOL OnIdle(LONG lCount);
 };
@@ -13,6 +13,10 @@
 #define new DEBUG_NEW
 #endif
 
+// the area table, from which the flash map is read (see <MgtSocket::ReadFlashMap>)
+static const uint8_t prefix_area_table[] = 	// 1.0.62379.1.1.5.1.1
+								{ 0x28, 0x83, 0xE7, 0x2B, 1, 1, 5, 1, 1 };
+
 
 // NetPortList
 
@@ -66,8 +70,7 @@ FlexilinkSocket::FlexilinkSocket()
 	call_ref = -1; // until written by CControllerApp::NewUnit() etc
 	tx_flow = -1;
 	state = MGT_ST_BEGIN;
-	next_serial = 1;
-	keep_alive_count = 0;
+	last_rx = 0;
 	mgt_msg.count = 0;
 }
 
@@ -75,23 +78,35 @@ MgtSocket::MgtSocket()
 {
 	password_state = PW_NOT_USED; // until FindRoute response received
 	upd_state_view = -1;
+	state_view = -1;
 	upd_state = UPD_ST_NO_INFO;
 	upd_area = flash.end();
+	upd_acked = 0;
+	upd_data_start = 0;
+	upd_data_base = 0;
+	upd_written = 0;
+	upd_resume.area = -1;
+	upd_resume.file = NULL;
 	last_serial = -1;
 	upd_reply = 0xA0;
+	upd_window_size = UPD_WINDOW_INIT;
+	upd_window_acks = 0;
+	upd_min_rtt = -1;
+	hash_batch = 0;
 	unit_id = 0;
+	xpt_revision = 0;
 	scp_server = NULL;
 	last_console_serial = -1;
-	next_seq = 0;
 	user_update_flags = -1;
-	mib_map.InitHashTable(499);	// initialise <mib>
-	keep_alive_count = 0;
-	traced = true;
+	last_rx = 0;
+	multi_set_ok = true;
+	setup_msg.reserve(SETUP_MSG_RESERVE);
 }
 
 FlexilinkSocket::~FlexilinkSocket()
 {
 	int i;
+	theApp.timers.CancelAll(this);
 	unless (state == MGT_ST_CLOSED || call_ref < 0 || 
 								theApp.link_socket->state != LINK_ST_ACTIVE) {
 			// send a ClearDown message
@@ -125,27 +140,20 @@ FlexilinkSocket::~FlexilinkSocket()
 MgtSocket::~MgtSocket()
 {
 	if (theApp.link_partner == this) theApp.link_partner = NULL;
+	theApp.topology.RemoveUnit(this);
 
-	POSITION p = mib.GetHeadPosition();
-	MibObject * obj;
-	while (p != NULL) {
-		obj = mib.GetNext(p);
-		delete obj;
-	}
+	theApp.flow_senders.RemoveValue(this);
+	theApp.xpt_revision += 1;
 
-	p = input_flows.GetStartPosition();
-	CString s1;
-	CString s2;
-	while (p != NULL) {
-		input_flows.GetNextAssoc(p, s1, s2);
-		theApp.flow_senders.RemoveKey(s2);
+	if (theApp.unit_addrs.Find(unit_TAddress) == this) 
+									theApp.unit_addrs.Remove(unit_TAddress);
+	unless (call_ref < 0) {
+		theApp.units.SetAt(call_ref & LABEL_MAX, NULL);
+		theApp.labels.Free(call_ref & LABEL_MAX);
 	}
-
-	theApp.unit_addrs.RemoveKey(unit_address);
-	unless (call_ref < 0) theApp.units.SetAt(call_ref & 255, NULL);
 	theApp.input_list->RemoveFromLocs(this);
 	theApp.output_list->RemoveFromLocs(this);
-	theApp.mib_changed = true;
+	theApp.mib_bus.Publish(this, MIB_BIT_UNIT_STATE);
 
 	theApp.RemoveFromAnalysers(this);
 
@@ -168,39 +176,41 @@ MgtSocket::~MgtSocket()
 
 
 // return the neighbour on port <p>, if any, else NULL
-MgtSocket * MgtSocket::LinkPartner(int p) {
-	CString oid;
-	oid.Format("1.0.62379.5.1.1.1.1.1.6.%d", p); // nPortPAddrType
-	unless (GetOidObject(oid) == "1.0.62379.5.2.2") return NULL;
-	oid.SetAt(22, '7'); // nPortPartnerAddress
-	ByteString p_addr = GetOctetStringObject(oid);
-	if (p_addr.empty()) return NULL;
-
-		// now <p_addr> is the link partner's address; check whether we already 
+// the objects are looked up in binary, and the address is the key in 
+//		<theApp.unit_addrs>, so nothing is converted to text
+MgtSocket * MgtSocket::LinkPartner(int p, bool create) {
+		// 1.0.62379.5.2.2, which is the nPortPAddrType for a Flexilink address
+	static const uint8_t fl_addr_type[] = { 0x28, 0x83, 0xE7, 0x2B, 5, 2, 2 };
+	MibObject * obj = GetObject(MIB_COL_N_PORT_ADDR_TYPE, p);
+	unless (obj != NULL && obj->tag == ASN1_TAG_OID && 
+				obj->size() == sizeof(fl_addr_type) && 
+					memcmp(obj->data(), fl_addr_type, sizeof(fl_addr_type)) == 0) 
+																return NULL;
+	obj = GetObject(MIB_COL_N_PORT_PARTNER_ADDR, p);
+	if (obj == NULL || obj->tag != ASN1_TAG_OCTET_STRING || obj->empty()) 
+																return NULL;
+
+		// now <obj> is the link partner's address; check whether we already 
 		//		have a management socket for it, and create if not
-	MgtSocket * m;
-	if (theApp.unit_addrs.Lookup(ByteArrayToHex(p_addr), (void *&)m)) return m;
-	return theApp.NewUnit(p_addr);
+	MgtSocket * m = (MgtSocket *)theApp.unit_addrs.Find(*obj);
+	if (m) return m;
+	return create ? theApp.NewUnit(*obj) : NULL;
 }
 
 
-// set <traced>, retry connection if appropriate, and trace any neighbours that 
-//		haven't already been traced
-void MgtSocket::Trace()
+// replace our links in <theApp.topology> with the neighbours on the ports 
+//		that are currently point-to-point, creating management sockets for 
+//		any we haven't met yet
+void MgtSocket::UpdateLinks()
 {
-	traced = true;
-
-		// see if should reconnect
-	if (state >= MGT_ST_MIN_RETRY) SendConnReq();
-
-		// examine neighbours
+	std::map<int, void *> ports;
 	NetPortList::iterator q = net_port_state.begin();
-	MgtSocket * p;
-	unless (q == net_port_state.end()) do {
+	for (; q != net_port_state.end(); q++) {
 		unless (q->second == NET_PORT_STATE_PT_PT) continue;
-		p = LinkPartner(q->first);
-		unless (p == NULL || p->traced) p->Trace();
-	} until (++q == net_port_state.end());
+		MgtSocket * p = LinkPartner(q->first);
+		unless (p == NULL) ports[q->first] = p;
+	}
+	theApp.topology.SetLinks(this, ports);
 }
 
 
@@ -210,12 +220,10 @@ void MgtSocket::OnIdle()
 	CString s;
 	CString s2;
 	int i, j, k;
-	uint8_t byte;
 	CStdioFile f;
-	CFile fb;
 	FlashMap::iterator p;
 	FlashMap::iterator code_area[2][16];
-	CByteArray image_buf;	// see comments where used
+	bool bad;				// for <ImageCache::Find>
 	CFileException err;		// for debug
 
 	if (theApp.link_socket->state == LINK_ST_ACTIVE) switch (upd_state) {
@@ -226,9 +234,9 @@ case UPD_ST_BEGIN:
 			upd_state = UPD_ST_NO_INFO;
 			break;
 		}
-		if (m->at(0) != 0 || m->at(1) != 0x90 || m->at(2) != 0xA8) {
-				// not a Nine Tiles product
-			upd_state = UPD_ST_NOT_RECOGD;
+		i = CheckUnitIdentity(m->data(), (int)m->size(), product_code);
+		unless (i == UPD_ST_BEGIN) {
+			upd_state = i;
 			break;
 		}
 
@@ -248,11 +256,14 @@ case UPD_ST_BEGIN:
 		if (s.Mid(i, 8) == "; logic ") sw_ver[1].FromFilename(s.Mid(i + 8));
 have_sw_ver:
 			// read product file
-		i = 3;
-		do product_code[i] = m->at(i+5); until (--i < 0);
 case UPD_ST_HAVE_SW_VER:
 			// enter here after changing product code
-		s.Format("product~%d-%d-%d-%d.9t3prd", 
+			// use the product file the rollout was started with, if any
+		if (theApp.rollout->Includes(this) && 
+						!theApp.rollout->product_file.IsEmpty()) {
+			s = theApp.rollout->product_file;
+		}
+		else s.Format("product~%d-%d-%d-%d.9t3prd", 
 						product_code[0], product_code[1], 
 								product_code[2], product_code[3]);
 		if (!f.Open(s, CFile::modeRead, &err)) {
@@ -355,6 +366,9 @@ case UPD_ST_HAVE_SW_VER:
 		break;
 
 
+case UPD_ST_QUEUED:
+			// waiting for <theApp.rollout> to let us start; go through the 
+			//		checks below again, in case something has changed
 case UPD_ST_HAVE_MAP:
 			// here when the flash map has been collected; we've checked 
 			//		previously that at least one of the software components 
@@ -482,155 +496,79 @@ case UPD_ST_HAVE_MAP:
 
 			// here to generate the image and start uploading
 		unless (OkToUpdate()) break;
+		unless (theApp.rollout->MayStart(this)) {
+				// too many units writing to flash, or one nearer the gateway 
+				//		waiting; try again next time
+			upd_state = UPD_ST_QUEUED;
+			break;
+		}
 
 			// if both need updating, we do the logic first, then collect the map 
 			//		again before doing the VM code
 			// +++ this assumes the new map will indeed show it as correct
 		if (vl_update[1]) {
-				// upload logic
-				// +++ we checked the extension earlier, so can assume this is a 
-				//		Xilinx .bit file and not the format specified in 62379-1; 
-				//		we also assume it was generated for SPI wifth 4 and 
-				//		includes the MultiBoot stub (the latter selected by the 
-				//		"place MultiBoot settings into bit stream" option); the 
-				//		loader code implements the functionality of the stub, so 
-				//		we locate the data by the second sync word
-			if (!fb.Open(vl_fn[1], CFile::modeRead)) {
-				upd_state = UPD_ST_NO_LOGIC;
+				// upload logic; see ImageCache::LocateLogicData for the format
+			image.file = theApp.rollout->images.Find(vl_fn[1], 1, bad);
+			if (image.file == NULL) {
+				upd_state = bad ? UPD_ST_BAD_LOGIC : UPD_ST_NO_LOGIC;
 				break;
 			}
 
-			k = (int)fb.GetLength();
-			if (k < 4096) {
-				upd_state = UPD_ST_BAD_LOGIC;
-				break;
-			}
-				// read the file into a CByteArray, then transfer it to <image>
-				// +++ ought to read it directly into <image>, but the version of 
-				//		Visual Studio I'm using doesn't implement <std::vector::data>
-				// +++ however, to aid portability to an environment that does 
-				//		implement it I copy the whole file into <image> rather than 
-				//		looking for the start of the data in the CByteArray and only 
-				//		copying what we need
-			image_buf.SetSize(k);
-			i = fb.Read(image_buf.GetData(), k);
-			fb.Close();
-			if (i != k) {
-				upd_state = UPD_ST_BAD_LOGIC;
-				break;
-			}
-			image.resize(k);
-			i = 0;
-			do { image[i] = image_buf[i]; i += 1; } while (i < k);
-
-				// look for the second sync word
-			i = 0;	// offset in data
-			j = 0;	// number of sync word bytes we've seen so far
-			do {
-				byte = image[i++];
-				switch (j & 3) {
-		case 0:		if (byte == 0xAA) j += 1;
-					break;
-
-		case 1:		if (byte == 0x99) j += 1; else j &= ~3;
-					break;
-
-		case 2:		if (byte == 0x55) j += 1; else j &= ~3;
-					break;
-
-		case 3:		if (byte == 0x66) j += 1; else j &= ~3;
-				}
-			} until (j >= 8 || i >= 4096);
-
-			if (j < 8) {
-				upd_state = UPD_ST_BAD_LOGIC;
-				image.clear();
-				break;
-			}
-
-				// now we know the length that will be required
-				// <k> is total length of image, <i> is offset to byte after 
-				//		second sync word
-			i -= 20; // offset to where atart of image will be
-			image.erase(image.begin(), image.begin() + i); // remove unwanted bytes
-
-				// overwrite the first four bytes with the version number and the 
-				//		next four with the product code; the FPGA image in flash 
-				//		will begin with the area header, version number, product 
-				//		code, 8 bytes of FF, and the sync word; we need to ensure 
-				//		that the version number and product code can't include a 
-				//		sync word, but that just needs all the components other 
-				//		than the beta number to be less than 85
-			image[0] = vl_ver[1][3];	// beta number
-			image[1] = vl_ver[1][0];
-			image[2] = vl_ver[1][1];
-			image[3] = vl_ver[1][2];
+				// the first four bytes are overwritten with the version number 
+				//		and the next four with the product code; the FPGA image 
+				//		in flash will begin with the area header, version number, 
+				//		product code, 8 bytes of FF, and the sync word; we need to 
+				//		ensure that the version number and product code can't 
+				//		include a sync word, but that just needs all the 
+				//		components other than the beta number to be less than 85
+				// the new bytes are in <image.overlay>, which replaces the 
+				//		start of the data in the file as it's sent
+			image.overlay.resize(vl_type[1] == 4 ? 16 : 8);
+			image.overlay[0] = vl_ver[1][3];	// beta number
+			image.overlay[1] = vl_ver[1][0];
+			image.overlay[2] = vl_ver[1][1];
+			image.overlay[3] = vl_ver[1][2];
 
 			i = 3;
 			j = vl_fn[1].ReverseFind('c');
 			/*if (j >= 4 && sscanf_s(vl_fn[1].Mid(j-4), "logic-%d-%d-%d-%d", 
 					&p_code_local[0], &p_code_local[1], 
 						&p_code_local[2], &p_code_local[3]) == 4) 
-							do image[i+4] = p_code_local[i]; while (--i >= 0);
-			else*/ do image[i+4] = product_code[i]; while (--i >= 0);
+							do image.overlay[i+4] = p_code_local[i]; while (--i >= 0);
+			else*/ do image.overlay[i+4] = product_code[i]; while (--i >= 0);
 
 			if (vl_type[1] == 4) {
 					// replace the FFs with the 64-bit identifier
-				image[8] = 0;
-				image[9] = 0x90;
-				image[10] = 0xA8;
-				image[11] = 0x99;
-				image[12] = 0;
-				image[13] = 0;
-				image[14] = 0;
-				image[15] = last_serial + 1;
+				image.overlay[8] = 0;
+				image.overlay[9] = 0x90;
+				image.overlay[10] = 0xA8;
+				image.overlay[11] = 0x99;
+				image.overlay[12] = 0;
+				image.overlay[13] = 0;
+				image.overlay[14] = 0;
+				image.overlay[15] = last_serial + 1;
 			}
 			StartUpload(1);
 			break;
 		}
 
 			// here if there's something to upload but it's not the logic, so 
-			//		must be the VM code
-			// +++ as with the logic, we've checked the extension and 
-			//		assume it's the format the compiler outputs; I think 
-			//		it does actually conform to the 62379-1 format, but 
-			//		we ought to check the header
-		if (!fb.Open(vl_fn[0], CFile::modeRead)) {
-			upd_state = UPD_ST_NO_VM_FILE;
-			break;
-		}
-
-		k = (int)fb.GetLength();
-			// read the file into a CByteArray, then transfer it to <image>
-			// +++ see remarks for logic file above
-		image_buf.SetSize(k);
-		i = fb.Read(image_buf.GetData(), k);
-		fb.Close();
-		if (i != k) {
-			upd_state = UPD_ST_BAD_VM_FILE;
-			break;
-		}
-		image.resize(k);
-		i = 0;
-		while (i < k) { image[i] = image_buf[i]; i += 1; }
-
-		i = 0;
-		while (i < k && image[i] != 0x0D) i += 1;
-		j = i + 1;
-		while (j < k && image[j] != 0x0D) j += 1;
-		if (j >= k) {
-				// haven't found the two carriage returns
-			upd_state = UPD_ST_BAD_VM_FILE;
+			//		must be the VM code; see ImageCache::LocateVmData
+		image.file = theApp.rollout->images.Find(vl_fn[0], 0, bad);
+		if (image.file == NULL) {
+			upd_state = bad ? UPD_ST_BAD_VM_FILE : UPD_ST_NO_VM_FILE;
 			break;
 		}
+		image.overlay.clear();
+		StartUpload(0);
+		break;
 
-			// here with <i> pointing to the first carriage return and <j> to 
-			//		the second
-			// +++ ought to read the length and check it corresponds to the 
-			//		length of the data; also ought to check the checksum
-		image.erase(image.begin(), image.begin() + j + 1); // remove unwanted bytes
 
-		StartUpload(0);
+case UPD_ST_UPLOADING:
+			// send more data if FillUploadWindow() was held back by the 
+			//		rollout's budget; not once it's all been sent, because 
+			//		then it would repeat the final Set
+		if (upd_offset >= 0 && upd_offset < image.size()) FillUploadWindow();
 		break;
 
 
@@ -641,6 +579,12 @@ case UPD_ST_MAKE_SPACE:
 			//		enough space to load another one, and I think 3 is plenty
 		p = flash.begin();
 		while (p != flash.end()) {
+			if (p->second.status == AREA_STATUS_EMPTY || 
+							p->second.status == AREA_STATUS_ERASING) {
+					// already free or on the way
+				p++;
+				continue;
+			}
 			if (p->second.data_type == vl_type[0]) i = 0;
 			else if (p->second.data_type == vl_type[1]) i = 1;
 			else { p++; continue; }
@@ -652,18 +596,19 @@ case UPD_ST_MAKE_SPACE:
 			p++;
 		}
 
-			// now look for the first area that is marked "invalid", either 
-			//		because we've just changed its status or because that 
+			// now erase the areas that are marked "invalid", either 
+			//		because we've just changed their status or because that 
 			//		was the status reported by the managed unit
-		SendNextErase();	// sets appropriate state
+		StartErasing();	// sets appropriate state
 		break;
 	}
 break_out_of_switch:
 
-	if (upd_state != upd_state_view) {
+	if (upd_state != upd_state_view || state != state_view) {
 			// screen may need to be repainted
-		UpdateDisplay();
+		theApp.mib_bus.Publish(this, MIB_BIT_UNIT_STATE);
 		upd_state_view = upd_state;
+		state_view = state;
 	}
 }
 
@@ -687,19 +632,92 @@ void MgtSocket::StartCollectFlashMap()
 		}
 	}
 
-	uint8_t b[14];
-	b[0]  = 0x1F;
-	b[2]  = 6;		// OID tag
-	b[3]  = 7;		// length of OID
-	b[4]  = 0x28;	// OID = 1.0.62379.1.1.5
-	b[5]  = 0x83;
-	b[6]  = 0xE7;
-	b[7]  = 0x2B;
-	b[8]  = 1;
-	b[9]  = 1;
-	b[10] = 5;
-	TxNewMessage(b, 11, true, true);
+		// one cursor for each of the columns we read (see <ReadFlashMap>), 
+		//		all started at once
+	std::vector<ByteString> starts;
+	int col;
+	for (col = 3; col <= 8; col++) {
+		starts.push_back(ByteString(prefix_area_table, 
+							prefix_area_table + sizeof(prefix_area_table)));
+		starts.back().push_back((uint8_t)col);
+	}
+	map_walk.Start(prefix_area_table, sizeof(prefix_area_table), starts);
+	upd_reply = 0xA0;	// no REQ_UPDATE request in progress
 	upd_state = UPD_ST_COLLECT_MAP;
+	int i = -1;
+	BeginHashBatch();
+	while (++i < map_walk.Cursors() && state <= MGT_ST_MAX_OK) SendWalkRequest(i);
+	EndHashBatch();
+}
+
+
+void MgtSocket::SendWalkRequest(int i)
+{
+	ByteString m;
+	map_walk.Request(i, m);
+	TxNewMessage(m, true, REQ_WALK);
+	map_walk.Sent(i, m[1]);
+}
+
+
+// <r> reads the VarBinds collected by <map_walk>, which are all in the area 
+//		table, in order
+void MgtSocket::ReadFlashMap(VarBindReader& r)
+{
+	VarBindView v;
+	int arcs[2];	// index arcs decoded from an OID
+	int i, k;
+
+	while (r.Remaining() > 0) {
+		unless (r.Next(v)) {
+			upd_state = UPD_ST_FAILED;
+			return;
+		}
+
+			// set <arcs[0]> to the column number and <i> to the area id
+		if (v.IndexArcs(sizeof(prefix_area_table), arcs, 2) != 2) continue;
+		i = arcs[1];
+
+		switch (arcs[0]) {
+				// +++ ought to read the class (column 2) as well, which would 
+				//		need another cursor (see <StartCollectFlashMap>)
+case 3:		flash[i].access = v.IntegerValue(); break;
+
+case 4:		flash[i].status = v.IntegerValue(); break;
+
+case 5:		flash[i].length = v.IntegerValue(); break;
+case 6:		flash[i].data_type = v.IntegerValue(); break;
+case 7:		flash[i].serial = v.IntegerValue(); break;
+
+case 8:		if (v.tag == ASN1_TAG_OCTET_STRING) {
+				ByteString fn(v.val, v.val + v.val_len);
+				flash[i].vn.FromFilename(fn);
+				break;
+			}
+			flash[i].vn.Invalidate(); // if not an octet string
+		}
+	}
+
+	if (unit_id == 0x0090A8990000000DLL) {
+			// +++ KLUDGE: in unit 13 block 145 fails to program; ideally 
+			//		the VM code should handle bad blocks, maybe via "sticky" 
+			//		MIB objects
+		FlashMap::iterator p;
+		p = flash.begin();
+		unless (p == flash.end()) do {
+			if (p->second.status != AREA_STATUS_EMPTY) continue;
+			if (p->first > 145) continue; // area id is block number
+			if (p->first + (p->second.length >> 16) <= 145) continue;
+				// here if we've found an empty area that includes block 
+				//		145; we can use the part below block 145, but using 
+				//		the part above would be more difficult as it would 
+				//		require inventing a new area
+			i = 145 - p->first;
+			if (i > 0) p->second.length = i << 16;
+			else p->second.status = AREA_STATUS_INVALID;
+		} until (++p == flash.end());
+	}
+	upd_state = UPD_ST_HAVE_MAP;	// trigger for OnIdle()
 }
 
 
@@ -769,6 +787,9 @@ bool MgtSocket::OkToUpdate() {
 		return false;
 	}
 
+		// the user has already said yes by starting the rollout
+	if (theApp.rollout->Includes(this)) return true;
+
 	if (user_update_flags < 0) {
 		if (theApp.update_flags < 0) {
 			CQuery q("Update flash in " + unit_name + " as follows?");
@@ -826,74 +847,232 @@ bool MgtSocket::OkToUpdate() {
 
 // look for a free area in flash into which <image> can be uploaded; if 
 //		found, kick-start the process of uploading by sending the request 
-//		to change its state, else just set state UPD_ST_TIDY_UP (so we'll 
-//		look for something to erase) and remove the image
+//		to change its state, and erase any areas the unit shows as INVALID 
+//		meanwhile; if not, erase enough to make room (see <PlanSpace>) and 
+//		remove the image, so it's loaded again when the map is next read; 
+//		if that isn't possible, set state UPD_ST_MAKE_SPACE
 // <i> is the index into the <vl_> arrays
 // caller is assumed to have checked that neither of the two serial 
 //		numbers following <vl_serial[i]> is in use
 // increments <vl_serial[i]> so it corresponds to the area into which the 
 //		new image is being uploaded
 void MgtSocket::StartUpload(int i) {
-	int len = (int)image.size();
+	int len = image.size();
 	if (len <= 0) {
 			// no image; must have failed to load
 		if (upd_state < UPD_ST_MIN_FILE_ERR || 
 					upd_state > UPD_ST_MAX_FILE_ERR) upd_state = UPD_ST_NO_S_FILE;
 		return;
 	}
+	if (ResumeUpload(i)) return;
 
-	upd_area = flash.begin();
-	until (upd_area == flash.end()) {
-		if (upd_area->second.status == AREA_STATUS_EMPTY && 
-									upd_area->second.length >= len) {
-				// <upd_area> points to the area to be used
-			upd_area->second.length = len;
-			upd_area->second.data_type = vl_type[i];
-			vl_serial[i] = (vl_serial[i] + 1) & 15;
-			upd_area->second.serial = vl_serial[i];
-			upd_area->second.vn = vl_ver[i];
-
-				// set the area to "writing"
-				// OID = 1.0.62379.1.1.5.1.1.4.a (a = area)
-			uint8_t b[24];
-			b[0]  = 0x30;	// "Set" request
-			b[2]  = ASN1_TAG_OID;
-			b[4]  = 0x28;
-			b[5]  = 0x83;
-			b[6]  = 0xE7;
-			b[7]  = 0x2B;
-			b[8]  = 1;
-			b[9]  = 1;
-			b[10] = 5;
-			b[11] = 1;
-			b[12] = 1;
-			b[13] = 4;	// column number for swaStatus
-			uint8_t * p = b + 14;
-			AddIndex(p, upd_area->first);
-				// <p> points to where the tag byte for the value will go
-			b[3] = (uint8_t)((p - b) - 4);	// assumed < 128
-			*p++ = ASN1_TAG_INTEGER;
-			*p++ = 1;
-			*p++ = AREA_STATUS_WRITING;
-				// now <b> points to the first byte of the message and 
-				//		<p> to the byte after last
-			TxNewMessage(b, (int)(p - b), true, true);
-			upd_state = UPD_ST_UPLOADING;
-			upd_offset = -4;
-			return;
-		}
+		// best fit: the smallest empty area that's big enough, so that 
+		//		large areas are kept for large images
+	FlashMap::iterator a = flash.begin();
+	upd_area = flash.end();
+	for (; a != flash.end(); a++) {
+		if (a->second.status == AREA_STATUS_EMPTY && a->second.length >= len && 
+				(upd_area == flash.end() || 
+							a->second.length < upd_area->second.length)) upd_area = a;
+	}
 
-			// here to try next area
-		upd_area++;
+	unless (upd_area == flash.end()) {
+			// <upd_area> points to the area to be used
+		upd_area->second.length = len;
+		upd_area->second.data_type = vl_type[i];
+		vl_serial[i] = (vl_serial[i] + 1) & 15;
+		upd_area->second.serial = vl_serial[i];
+		upd_area->second.vn = vl_ver[i];
+
+			// set the area to "writing"
+			// OID = 1.0.62379.1.1.5.1.1.4.a (a = area)
+		uint8_t b[24];
+		b[0]  = 0x30;	// "Set" request
+		b[2]  = ASN1_TAG_OID;
+		b[4]  = 0x28;
+		b[5]  = 0x83;
+		b[6]  = 0xE7;
+		b[7]  = 0x2B;
+		b[8]  = 1;
+		b[9]  = 1;
+		b[10] = 5;
+		b[11] = 1;
+		b[12] = 1;
+		b[13] = 4;	// column number for swaStatus
+		uint8_t * p = b + 14;
+		AddIndex(p, upd_area->first);
+			// <p> points to where the tag byte for the value will go
+		b[3] = (uint8_t)((p - b) - 4);	// assumed < 128
+		*p++ = ASN1_TAG_INTEGER;
+		*p++ = 1;
+		*p++ = AREA_STATUS_WRITING;
+			// now <b> points to the first byte of the message and 
+			//		<p> to the byte after last
+		TxNewMessage(b, (int)(p - b), true, REQ_UPDATE);
+		upd_state = UPD_ST_UPLOADING;
+		upd_offset = -4;
+		ClearUploadWindow();
+		upd_window_size = UPD_WINDOW_INIT;
+		upd_window_acks = 0;
+		upd_acked = 0;
+		upd_written = 0;
+
+			// erases of areas already INVALID can go on meanwhile
+		SendErases();
+		return;
 	}
 
 		// here if no free areas big enough
-		// +++ need to signal we weren't able to load the s/w so (a) user 
-		//		isn't told needs reboot to run new s/w (b) "tidy up" code 
-		//		can make sure it leaves enough room (including maybe 
-		//		asking user whether it's OK to leave fewer than normal)
-	upd_state = UPD_ST_TIDY_UP;
-	image.clear();
+	image.Clear();
+	upd_state = UPD_ST_MAKE_SPACE;
+	if (PlanSpace(len)) StartErasing();
+
+		// else no run of areas can be freed without erasing software that 
+		//		has to be kept; leave it to the MAKE_SPACE code in <OnIdle>, 
+		//		which erases whatever else it can, or if there's nothing 
+		//		sets UPD_ST_BAD_FLASH so the user isn't told the new 
+		//		software has been loaded
+}
+
+
+// if <upd_resume> is for software <i> and the area it refers to is still 
+//		being written with the same image, start reading back what was 
+//		written (see <SendVerifyRequests>) and return true; if it's ours but 
+//		the image or the map has changed, the area is no use so it's 
+//		marked to be erased
+// the checkpoint is only used once, so if the connection is lost again 
+//		before the new one is saved we start again
+bool MgtSocket::ResumeUpload(int i) {
+	UploadCheckpoint& c = upd_resume;
+	if (c.area < 0 || c.data_type != vl_type[i]) return false;
+	FlashMap::iterator a = flash.find(c.area);
+	c.area = -1;
+	if (a == flash.end() || a->second.status != AREA_STATUS_WRITING || 
+			a->second.data_type != c.data_type || a->second.serial != c.serial) {
+		return false;	// someone else has dealt with it
+	}
+	if (c.file != image.file || c.overlay != image.overlay || 
+				c.serial != ((vl_serial[i] + 1) & 15) || 
+							a->second.length < image.size()) {
+			// the image or the rest of the flash has changed
+		a->second.status = AREA_STATUS_INVALID;
+		return false;
+	}
+
+	upd_area = a;
+	vl_serial[i] = c.serial;
+	upd_area->second.vn = vl_ver[i];
+	upd_offset = c.written;
+	upd_written = c.written;
+	upd_acked = c.written;
+	ClearUploadWindow();
+	upd_window_size = UPD_WINDOW_INIT;
+	upd_window_acks = 0;
+	upd_data_start = GetTickCount64();
+	upd_data_base = upd_acked;
+	if (c.written <= 0) {
+			// nothing to check
+		upd_state = UPD_ST_UPLOADING;
+		FillUploadWindow();
+	}
+	else SendVerifyRequests();
+	SendErases();
+	return true;
+}
+
+
+// mark INVALID the areas to be erased to make a free space of at least <len> 
+//		bytes; returns false if there's no way to do that
+// an area can be used if it's empty or being erased, and can be erased if 
+//		it's INVALID or holds software of either type that isn't one of the 
+//		latest three or the one running (see <FreeCost>); when a run of 
+//		adjacent areas are all empty the unit merges them, so we choose the 
+//		run that's big enough with the fewest areas to erase, and of those 
+//		the smallest
+// areas are adjacent if one starts in the block after the other ends (the 
+//		area id is the block number, see <ReadFlashMap>)
+// a run that's all empty already is no use: if the unit were going to merge 
+//		it, it would have done so
+bool MgtSocket::PlanSpace(int len) {
+	FlashMap::iterator a, b, first = flash.end(), last = flash.end();
+	int best_erases = 0;
+	int64_t best_size = 0;
+	for (a = flash.begin(); a != flash.end(); a++) {
+		int erases = 0;		// areas in the run that need erasing
+		int busy = 0;		// areas in the run already being erased
+		int64_t size = 0;
+		int32_t next = a->first;	// block after the end of the run so far
+		for (b = a; b != flash.end(); b++) {
+			int k = FreeCost(b->second);
+			if (k < 0 || b->first != next) break;
+			next = b->first + ((b->second.length + 0xFFFF) >> 16);
+			erases += k;
+			if (b->second.status == AREA_STATUS_ERASING) busy += 1;
+			size += b->second.length;
+			if (size < len) continue;
+
+				// here if the run from <a> to <b> is big enough
+			if (erases + busy > 0 && (first == flash.end() || 
+							erases < best_erases || 
+							(erases == best_erases && size < best_size))) {
+				first = a;
+				last = b;
+				best_erases = erases;
+				best_size = size;
+			}
+			break;
+		}
+	}
+	if (first == flash.end()) return false;
+
+	last++;
+	for (a = first; a != last; a++) {
+		if (FreeCost(a->second) > 0) a->second.status = AREA_STATUS_INVALID;
+	}
+	return true;
+}
+
+
+// for <PlanSpace>: 0 if <area> is free or being erased, 1 if it can be 
+//		erased, -1 if it has to be kept
+// software is kept if its serial number is <vl_serial[i]> or one of the two 
+//		before it, so the unit can still fall back to an earlier version, or 
+//		if it's the version the unit is running, which may be older
+int MgtSocket::FreeCost(SoftwareArea& area) {
+	int i;
+	switch (area.status) {
+case AREA_STATUS_EMPTY:
+case AREA_STATUS_ERASING:
+		return 0;
+
+case AREA_STATUS_INVALID:
+		return 1;
+
+case AREA_STATUS_VALID:
+		if (area.data_type == vl_type[0]) i = 0;
+		else if (area.data_type == vl_type[1]) i = 1;
+		else return -1;
+		if (((vl_serial[i] - area.serial) & 15) <= 2) return -1;
+		if (sw_ver[i].IsValid() && area.vn == sw_ver[i]) return -1;
+		return 1;
+	}
+	return -1;
+}
+
+
+// progress of the current upload, for the display; empty if no image
+CString MgtSocket::UploadProgress()
+{
+	CString s;
+	if (image.size() <= 0) return s;
+	s.Format("%d%% of %d bytes", (int)(((int64_t)upd_acked * 100) / 
+												image.size()), image.size());
+	ULONGLONG t = GetTickCount64() - upd_data_start;
+	if (upd_acked > upd_data_base && t > 0) {
+			// bytes per ms is the same as kbytes per second
+		s.AppendFormat(", %.1f kbytes/s", (double)(upd_acked - upd_data_base) / t);
+	}
+	return s;
 }
 
 
@@ -944,13 +1123,11 @@ BOOL CControllerDoc::OnNewDocument()
 	}
 	theApp.link_socket = skt;
 
-		// Request a timer for retries and checking for keepalives
-		// +++ TEMP: double the timeout to allow for programming flash in 
-		//		the unit to which we're directly connected (not sure why it 
-		//		takes longer, may be because the VM is occupied forwarding
-		//		replies from other units)
-//	if (theApp.m_pMainWnd->SetTimer(IDT_500MSEC, 500, NULL) == 0) 
-	if (theApp.m_pMainWnd->SetTimer(IDT_500MSEC, 1000, NULL) == 0) 
+		// the timers for the link itself are started by the LinkSocket 
+		//		constructor; start pruning the flow senders, and check a 
+		//		Windows timer is available to drive the timer wheel
+	theApp.StartTimer(NULL, TMR_PRUNE, FLOW_PRUNE_INTERVAL);
+	unless (theApp.ArmTimer()) 
 		AfxMessageBox("No timer available; unacknowledged messages "
 				"will not be repeated", MB_OK | MB_ICONEXCLAMATION);
 
@@ -991,6 +1168,7 @@ void CControllerDoc::SetUnit(MgtSocket * u)
 {
 	if (this == NULL) return;
 	unit = u;
+	theApp.mib_bus.SetUnit(theApp.bus_console, u);
 	UpdateTitle();
 	BringToFront();
 	UpdateAllViews(NULL);
@@ -6,8 +6,13 @@
 
 #pragma once
 #include "../common/string_extras.h"
+#include "../common/request_table.h"
+#include "../common/table_walk.h"
+#include "../common/keccak.h"
 #include "MgtSocket.h"
 #include "Query.h"
+#include "Rollout.h"
+#include "Salvo.h"
 #include <queue>
 
 // NOTE: versions before 2023 read data from up to three files:
@@ -77,29 +82,52 @@ public:
 // structure to show what (if any) acknowledgement a thread is awaiting
 struct MessageAckState {
 	ByteString m;	// the message; empty if none; serial number in 2nd byte
-	int count;	// number of timer ticks since first sent (rubbish if m empty)
+	int count;	// number of times repeated (rubbish if m empty)
+};
+// the timeouts for management sockets (MGT_MSG_REPEAT etc) are in mgt_core.h
+
+// structure describing a tranche of data for the flash that has been sent
+//		but not yet acknowledged; see <MgtSocket::upd_window>; the message 
+//		itself is in <FlexilinkSocket::requests>
+struct UploadTranche {
+	int offset;		// offset in the area (and in <MgtSocket::image>)
+	int length;		// number of bytes of data
+};
+
+// structure describing an upload that was in progress when the connection 
+//		was lost, so that it can be continued instead of starting again; see 
+//		<MgtSocket::upd_resume>
+struct UploadCheckpoint {
+	int32_t area;	// area id, -1 if none
+	int data_type;	// swaType and swaSerial that were set for the area
+	int serial;
+	int written;	// bytes from the start that the unit had acknowledged
+		// the image, which must be the same when we come to continue
+	const MappedImage * file;
+	ByteString overlay;
 };
-#define MAX_REPEAT_COUNT	20	// give up after 10 secs
 
 // structure describing a connection request
 // if <m[0]> is a Get, we are waiting for the call id; else we are waiting 
 //		for acks to one or more Set requests
+// if <ends> is not empty, <m[0]> is a single Set with all the VarBinds for 
+//		setting up the connection, and <ends> holds the offset in it of the 
+//		end of each, so that it can be split up if the unit rejects it
 struct ConnReqInfo {
 	ByteString srce_addr;
 	int dest_port;
 	std::vector<ByteString> m;	// the messages (at least one, all at least 2 bytes)
-	int count;		// number of timer ticks since first sent
+	std::vector<int> ends;
+	int salvo_entry;	// index in <theApp.salvo>'s list, -1 if not in a salvo
 };
 
 
 // class used for keeping track of the unit's network ports
 // key is port number, value is NetPortState coding from the MIB except that 
 //		NET_PORT_WAITING is used instead when entering linkUp state
-// states; +ve values are NetPortState code points
+// states; +ve values are NetPortState code points (NET_PORT_STATE_DISABLED 
+//		etc, see mgt_core.h)
 #define NET_PORT_STATE_WAITING (-1) // see above
-#define NET_PORT_STATE_DISABLED	 1	// disabled
-#define NET_PORT_STATE_LINK_UP	 4	// linkUp
-#define NET_PORT_STATE_PT_PT	 5	// pointToPoint
 class NetPortList : public std::map<int, int> {
 public:
 	NetPortList();
@@ -164,34 +192,17 @@ public:
 		// flow label for tx packets; -1 until FindRoute response rec'd
 	int tx_flow;
 
-		// current state: one of the following
-		// +++ most of this is purely session layer state; the update process has 
-		//		its own state (though I'm not convinced it will survive a change 
-		//		of lower-layer connection) and I think everything else is 
-		//		stateless at the protocol level; the link socket state also needs 
-		//		to be checked if e.g. a reply fails to arrive
-		// +++ however, states 3 and 4 are really layer 7
-#define MGT_ST_BEGIN	 0	// nothing done yet
-#define MGT_ST_CONN_REQ	 1	// FindRoute request sent
-#define MGT_ST_CONN_ACK	 2	// FindRoute request acknowledged
-#define MGT_ST_CONN_MADE 3	// <tx_flow> valid; initial GetNext sent
-#define MGT_ST_HAVE_INFO 4	// unitName etc valid; Status Request has been sent
-#define MGT_ST_ACTIVE	 5	// Status Response has been received (normal state)
-#define MGT_ST_MAX_OK	 5	// codes above this are for "failed" states
-#define MGT_ST_NOT_CONN	 6	// failed to connect
-#define MGT_ST_FAILED	 7	// call to base class (Create, Connect, Send) failed
-#define MGT_ST_TIMEOUT	 8	// any kind of timeout
-#define MGT_ST_MIN_RETRY 9	// wait before retry connection for codes below this
-#define MGT_ST_CLOSED	 9	// target has disconnected
-#define MGT_ST_ERROR	11	// any other kind of protocol error in flash map
+		// current state: one of the MGT_ST_ codes in mgt_core.h
 	int state;
 		// set state to _FAILED; might want to do some tidying up too
 	void SetStateFailed() { state = MGT_ST_FAILED; UpdateDisplay(); 
-												theApp.mib_changed = true; }
+			theApp.mib_bus.Publish(this, MIB_BIT_UNIT_STATE); ScheduleRetry(); }
 	void SetStateTimedOut() { state = MGT_ST_TIMEOUT; UpdateDisplay(); 
-												theApp.mib_changed = true; }
+			theApp.mib_bus.Publish(this, MIB_BIT_UNIT_STATE); ScheduleRetry(); }
 	void SetStateError() { state = MGT_ST_ERROR; UpdateDisplay(); 
-												theApp.mib_changed = true; }
+			theApp.mib_bus.Publish(this, MIB_BIT_UNIT_STATE); ScheduleRetry(); }
+		// set TMR_UNIT_RETRY after entering a failed state
+	void ScheduleRetry();
 
 		// add an index arc to an OID; add the "length" field for a value; 
 		//		add an integer value to a message
@@ -202,33 +213,49 @@ public:
 	void AddInteger(ByteString& m, int64_t n);
 
 
-		// serial number to go in next transmitted management message
-	uint8_t next_serial;
-
-		// messages: only save the last 300 or so
-		// first character is 't' for transmitted message, 'o' for overlength 
-		//		received message, 'r' for any other received message
-	CStringArray msgs;		// in hex
+		// management requests awaiting a reply, keyed by serial number, 
+		//		which also allocates the serial numbers; the <kind> says 
+		//		what to do if there's no reply, and <ref> is 1 if the 
+		//		request is sent with a password hash, else 0
+	RequestTable requests;
+#define REQ_OTHER		0	// not repeated; the serial number is just reserved
+#define REQ_UPDATE		1	// reading the flash map or updating the flash
+#define REQ_TRANCHE		2	// data for the flash, see <MgtSocket::upd_window>
+#define REQ_CONN		3	// setting up a connection, see <MgtSocket::conn_pend>
+#define REQ_STATUS		4	// Status request
+#define REQ_WALK		5	// GetNext for a table, see <MgtSocket::map_walk>
+#define REQ_ERASE		6	// erasing an area, see <MgtSocket::erase_pending>
+#define REQ_VERIFY		7	// reading back flash data, see <MgtSocket::upd_verify>
+
+		// messages: only save the last 300 or so, see <SaveMessage> for the 
+		//		flags; they are converted to hex when displayed
+	PacketLog msgs;
 	void SaveMessage(uint8_t * b, int len, char flag);
 	void SaveMessage(ByteString b, char flag) 
 							{ SaveMessage(b.data(), (int)b.size(), flag); }
 	int AddMsgsToDisplay(int x, int y, int CharHeight, CDC * pDC);
 
 		// console text: only save the last 2000 lines (HyperTerminal saves about 500)
-		// each string is 1 line
-	std::vector<std::string> console;
+		// the last line is the one that text is added to
+	ConsoleLog console;
 	void SaveConsole(unsigned char * b, INT_PTR len);
 	void ConsoleLine(std::string s);
+	int AddConsoleToDisplay(int x, int y, int CharHeight, CDC * pDC);
 
-		// check whether anything needs to be repeated: called every 1/2 sec
-		// derived classes should call this to check on signalling messages and 
-		//		override to check on their own message types if required
+		// called when one of this object's timers expires (see 
+		//		<CControllerApp::timers>); the base class version deals with 
+		//		TMR_UNIT_SIGNAL, TMR_UNIT_LIVENESS and TMR_UNIT_RETRY, and 
+		//		derived classes should call it for those
 		// +++ NOTE: messages are not expected to include a password
-	bool PollAwaitingAck();
-		// count to check the unit hasn't locked up
-	int keep_alive_count;
+	virtual void TimerExpired(int kind);
+		// GetTickCount64() when a message was last received, to check the 
+		//		unit hasn't locked up
+	ULONGLONG last_rx;
 		// record for each thread
 	MessageAckState mgt_msg;	// messages that affect <state>
+		// start repeating <mgt_msg>, which has just been sent
+	void AwaitAck() { mgt_msg.count = 0; 
+			theApp.StartTimer(this, TMR_UNIT_SIGNAL, MGT_MSG_REPEAT); }
 
 		// update display if required
 	void UpdateDisplay() { if (theApp.controller_doc->Selected(this)) 
@@ -247,11 +274,10 @@ public:
 #define SHA3_HASH_BYTES			64 // bytes for the hash
 #define SHA3_HASH_STRING_BYTES (SHA3_HASH_COUNT_BYTES + SHA3_HASH_BYTES)
 
-		// Hash calculation, imported from SHA3.h so the routine can use <SaveMessage>
-		// 'Words' here refers to uint64_t; <sizeof> counts octets
+		// 'Words' here refers to uint64_t; <sizeof> counts octets; the 
+		//		permutation is <Keccakf> (see keccak.h)
 #define SHA3_KECCAK_SPONGE_WORDS (1600/(sizeof(uint64_t) * 8))
 	typedef uint64_t sha3_sponge[SHA3_KECCAK_SPONGE_WORDS];
-	void keccakf(uint64_t s[SHA3_KECCAK_SPONGE_WORDS]);
 
 		// write <n> 64-bit words big-endianly (i.e. network byte order) to <b>
 	void CopyLongwordsToNetwork(uint8_t * b, uint64_t * w, int n);
@@ -290,13 +316,26 @@ public:
 
 		// send a message (override for the base class version)
 	void TxNewMessage(uint8_t * b, int len, bool pw = true, 
-													bool flash_request = false);
+													int kind = REQ_OTHER);
 	void TxMessage(uint8_t * b, int len, bool pw = true);
 	void TxWithHash(uint8_t * b, int len);
+		// while <hash_batch> is nonzero, messages for <TxWithHash> are held in 
+		//		<hash_queue>, and <EndHashBatch> then hashes them up to 
+		//		KECCAK_MAX_LANES at a time and sends them in order; used where 
+		//		several requests are sent together
+	std::vector<ByteString> hash_queue;
+	int hash_batch;
+	void BeginHashBatch() { hash_batch += 1; }
+	void EndHashBatch();
+		// start of the hash calculation for message <b>; also increments the 
+		//		count in <password_string>
+	void HashInput(sha3_sponge s, const uint8_t * b, int len);
+		// send message <b> with count <count> and the hash in <s[0]> to <s[7]>
+	void TxHashed(const uint8_t * b, int len, uint32_t count, uint64_t * s);
 //	void TxMessage(CByteArray& m);
 	void TxWithHash(ByteString& m) { TxWithHash(m.data(), (int)m.size()); }
-	void TxNewMessage(ByteString& m, bool pw = true)
-									{ TxNewMessage(m.data(), (int)m.size(), pw); }
+	void TxNewMessage(ByteString& m, bool pw = true, int kind = REQ_OTHER)
+							{ TxNewMessage(m.data(), (int)m.size(), pw, kind); }
 	void TxMessage(ByteString& m, bool pw = true)
 										{ TxMessage(m.data(), (int)m.size(), pw); }
 
@@ -357,54 +396,88 @@ public:
 	int user_update_flags;
 	bool OkToUpdate();
 	void StartCollectFlashMap();
+		// reads the area table for <flash> in UPD_ST_COLLECT_MAP state, with 
+		//		a cursor for each column
+	TableWalk map_walk;
+	void SendWalkRequest(int i);	// for cursor <i> of <map_walk>
+	void ReadFlashMap(VarBindReader& r);	// fill in <flash> from the results
 
-		// when writing, also when setting to Valid, the reply doesn't come 
-		//		until the operation is complete; erasing simply marks the 
-		//		area(s) to be erased, and as each completes its status changes 
-		//		to Empty; we don't get told when the last one finishes, so we 
-		//		stick in "waiting" state until the user clicks on the status 
-		//		message on the screen
-#define UPD_ST_NO_INFO		 0	// waiting for unitIdentity etc
-#define UPD_ST_BEGIN		 1	// have unitIdentity and unitFirmwareVersion
-#define UPD_ST_NOT_RECOGD	 2	// unitIdentity etc not as expected
-#define UPD_ST_HAVE_SW_VER	 3	// unitIdentity etc decoded
-#define UPD_ST_NO_P_FILE	 4	// couldn't open product file
-#define UPD_ST_BAD_P_FILE	 5	// couldn't find req'd info in product file
-#define UPD_ST_NO_ACTION	 6	// already up-to-date
-#define UPD_ST_FROM_ISE		 7	// software loaded by Impact and Compiler
-#define UPD_ST_COLLECT_MAP	 8	// reading contents of flash
-#define UPD_ST_HAVE_MAP		 9	// ready to check what needs updating
-#define UPD_ST_UP_TO_DATE	10	// flash OK; needs restart
-#define UPD_ST_NOT_MAINT	11	// privilege level forbids update
-#define UPD_ST_USER_REFUSED	12	// user replied refusing update
-#define UPD_ST_BAD_FLASH	13	// e.g. all 16 serial numbers used
-#define UPD_ST_NO_S_FILE	14	// no data read from image file
-#define UPD_ST_MIN_FILE_ERR	15	// first of the "file error" codes
-#define UPD_ST_NO_LOGIC		15	// couldn't open logic image file
-#define UPD_ST_BAD_LOGIC	16	// e.g. no sync word found in logic image file
-#define UPD_ST_NO_VM_FILE	17	// couldn't open VM software image file
-#define UPD_ST_BAD_VM_FILE	18	// e.g. VM software image file empty
-#define UPD_ST_MAX_FILE_ERR	18	// last of the "file error" codes
-#define UPD_ST_UPLOADING	19	// writing (see <upd_area> and <upd_offset>)
-#define UPD_ST_TIDY_UP		20	// check for areas that should be erased
-#define UPD_ST_MAKE_SPACE	21	// as _TIDY_UP when have run out of space
-#define UPD_ST_ERASING		22	// erasing (tidying up; see <upd_area>)
-#define UPD_ST_WAITING		23	// for erases to complete
-#define UPD_ST_FAILED		24	// failure during uploading process
-	int upd_state;					// one of the above
+	int upd_state;					// UPD_ST_ code, see mgt_core.h
 	int upd_state_view;				// <upd_state> as displayed by the view
+	int state_view;					// similarly for <state>
 	FlashMap::iterator upd_area;	// for which erase or write requested
 	int vl_serial[2];	// latest serial number in map; index as for <vl_type>
 	VersionNumber flash_ver[2];	// version in latest area; index as for <vl_type>
 		// following are valid in UPLOADING state only
 		// <upd_offset> is negative (-4 to -1) for the four commands (beginning 
 		//		with setting the area to "writing" state) that precede the 
-		//		uploading of the data, thereafter it is the offset in <upd_area> 
+		//		uploading of the data, thereafter it is the offset in <upd_area>
+		//		of the next tranche to be sent
 	int upd_offset;				// see above
-	ByteString image;			// to write to the selected area
+		// image to write to the selected area; the data is in 
+		//		<theApp.rollout->images>
+	FlashImage image;
 //	int PreWriteValue();		// value for current Set if <upd_offset < 0>
-	void SendNextErase();		// send Erase request if required; update state
 	void StartUpload(int i);	// set up for writing flash
+		// choose areas to erase to make room for <len> bytes
+	bool PlanSpace(int len);
+	int FreeCost(SoftwareArea& area);
+
+		// erasing: areas marked INVALID are erased independently of each 
+		//		other and of any upload, with up to FLASH_MAX_ERASES requests 
+		//		awaiting a reply; <erase_pending> maps the serial number of 
+		//		each to the area id
+		// the unit replies when it starts erasing, so once all the replies 
+		//		are in we're in UPD_ST_WAITING, reading the map again every 
+		//		FLASH_ERASE_POLL until no area is shown as ERASING
+	std::map<uint8_t, int32_t> erase_pending;
+#define FLASH_MAX_ERASES	   4
+#define FLASH_ERASE_POLL	2000	// ms
+	void StartErasing();		// send Erase requests if required; update state
+	int SendErases();			// returns number awaiting a reply
+	void WaitForErases();
+
+		// tranches of data that have been sent and not yet acknowledged; key
+		//		is the serial number; each can be acknowledged (and if necessary
+		//		repeated) independently of the others, so that the time taken
+		//		for an upload is not simply the number of tranches times the
+		//		round-trip time
+		// the number allowed is <upd_window_size>, which is reduced when the
+		//		unit says it's busy or a tranche has to be repeated, and
+		//		increased (by 1 for every <upd_window_size> tranches
+		//		acknowledged) as long as the round-trip time stays close to
+		//		the smallest seen, i.e. replies aren't being held up in a queue
+	std::map<uint8_t, UploadTranche> upd_window;
+#define UPD_WINDOW_MIN		 1	// i.e. one Set per round trip, as before
+#define UPD_WINDOW_INIT		 4
+#define UPD_WINDOW_MAX		16	// well short of the 255 serial numbers
+	int upd_window_size;	// see above
+	int upd_window_acks;	// tranches acknowledged since <upd_window_size> changed
+	int upd_min_rtt;		// smallest round-trip time seen (ms), -1 if none
+	void FillUploadWindow();	// send more tranches, or the final Set
+	void UploadAcked(const PendingRequest& r);	// adjust window for ack to <r>
+	void ClearUploadWindow();	// forget the tranches awaiting acknowledgement
+		// progress of the data part of the upload, for the display
+	int upd_acked;				// bytes of <image> acknowledged
+	ULONGLONG upd_data_start;	// GetTickCount64() when first tranche sent
+	int upd_data_base;			// <upd_acked> at <upd_data_start>
+	CString UploadProgress();	// e.g. "45% (... bytes, 20 kbytes/s)"
+
+		// resuming an upload: <upd_written> is the offset below which all 
+		//		the tranches have been acknowledged; if the connection is 
+		//		lost while uploading, <ConnectionMade> saves it in 
+		//		<upd_resume> with the rest of what's needed to carry on, and 
+		//		when the map has been read again, if the area is still being 
+		//		written with the same image, UPD_VERIFY_SAMPLES tranches of 
+		//		what was written are read back (<upd_verify>, keyed by serial 
+		//		number) and if they're correct the upload continues from there
+	int upd_written;
+	UploadCheckpoint upd_resume;
+	std::map<uint8_t, UploadTranche> upd_verify;
+#define UPD_VERIFY_SAMPLES	4
+	void SaveCheckpoint();
+	bool ResumeUpload(int i);	// continue from <upd_resume> if possible
+	void SendVerifyRequests();
 
 		// product code and software versions from MIB, valid in states > 2
 	uint8_t product_code[4];	// unitIdentity
@@ -447,23 +520,18 @@ public:
 	int last_console_serial;
 
 		// latest value for each object
-		// new objects are added at the end; new values for an existing object 
-		//		replace the existing object; objects missing from a report cycle 
-		//		are removed from here and <mib_map>
+		// new values for an existing object replace the existing value; 
+		//		objects missing from a report cycle are removed
 		// see note on <dest_call_flows> re block outputs
-	CList<class MibObject *, MibObject *> mib;
-
-		// key is the dotted-decimal form of the OID, value is the POSITION in <mib>
-		// there is a 1:1 correspondence between entries in <mib> and <mib_map>
-		// +++ should consider replacing <map> and <mib_map> with a 
-		//		std::map<std::string, MibObject *>
-	CMapStringToPtr mib_map;
+	MibStore mib;
 
 		// return pointer to object in the MIB, or NULL if not present
-	MibObject * GetObject(CString oid) {
-			void * v;
-			if (mib_map.Lookup(oid, v)) return mib.GetAt((POSITION)v);
-			return NULL; }
+		// the first version is for OIDs in BER format as in <oid_ber>; the 
+		//		second, which converts from dotted-decimal, is for the display 
+		//		code etc, and shouldn't be used when processing messages
+	MibObject * GetObject(ByteString& oid) { return mib.Find(oid); }
+	MibObject * GetObject(CString oid) { ByteString b = OidFromText(oid);
+													return mib.Find(b); }
 
 		// return value of an integer object (up to 32 bits, signed)
 		// result is zero if <oid> not found in the MIB
@@ -491,12 +559,30 @@ public:
 	ByteString GetOctetStringObject(CString oid) {
 									return GetObject(oid)->OctetStringValue(); }
 
+		// as above, for the object in column <col> (a MIB_COL_ code) whose 
+		//		index is the single arc <index>, or the arcs in dotted-decimal 
+		//		form in <index>; these build the OID in BER format directly, 
+		//		so are the ones to use for objects the display looks up for 
+		//		each port
+	MibObject * GetObject(int col, int index);
+	MibObject * GetObject(int col, const char * index);
+#define MAX_OID_LENGTH	128	// BER bytes; longer OIDs are treated as not found
+	int GetIntegerObject(int col, int index) { 
+								return GetObject(col, index)->IntegerValue(); }
+	int GetIntegerObject(int col, const char * index) { 
+								return GetObject(col, index)->IntegerValue(); }
+	CString GetStringObject(int col, int index) { 
+								return GetObject(col, index)->StringValue(); }
+	CString GetOidObject(int col, int index) { 
+								return GetObject(col, index)->ConvertOid(); }
+	CString GetStringHex(int col, int index, int group_size) {
+						return GetObject(col, index)->StringHex(group_size); }
+
 		// text description used in crosspoint windows
 	CString DisplayName();
 
 		// lists of ports and calls we know about
 typedef CList<int, int> PortList;
-	int IntIndex(CString s);
 		// map of network ports for which the state is in <mib>, showing state
 	NetPortList net_port_state;
 		// block ids for media ports for which the direction is in <mib>, 
@@ -523,34 +609,54 @@ typedef CList<int, int> PortList;
 		// similarly for input ports, except that the value doesn't include the 
 		//		port id; there is an entry for each udNetBlockId for a media port
 	CMapStringToString input_flows;
-
-		// expected sequence number of next in-cycle report message, or zero if the 
-		//		information is already known to be incomplete (e.g. a message has 
-		//		arrived out of sequence)
-	uint8_t next_seq;
-		// time the previous message in the current cycle arrived (not valid if 
-		//		<next_seq> is 0 or 1)
-	__time64_t prev_report_time;
-		// 2 secs before time of the most recent start of a cycle (not valid if 
-		//		<next_seq> is 0 or 1)
-		// any object that should be reported in a cycle and is older than this at 
-		//		the end of an OK cycle can be assumed to have disappeared from the 
-		//		MIB
-	__time64_t start_cycle_time;
-
-		// check whether anything needs to be repeated: called every 1/2 sec
-	bool PollAwaitingAck();
+		// incremented whenever anything changes that affects the lines shown 
+		//		for this unit in the crosspoint windows, so they know which 
+		//		units need to be reformatted (see crosspoint_model.h)
+	unsigned xpt_revision;
+
+		// sequence numbers of the in-cycle status reports
+	StatusCycle cycle;
+
+		// repeat any <requests> that are due (TMR_UNIT_REQUEST)
+	void TimerExpired(int kind);
+		// set TMR_UNIT_REQUEST for the next of <requests> that is due
+	void ArmRequestTimer();
+		// there has been no reply to request <r>, which has been removed 
+		//		from <requests>
+	void RequestTimedOut(PendingRequest& r);
 		// record for each thread
 //	MessageAckState mgt_msg;	[moved to parent class]
-	MessageAckState upd_msg;	// messages that affect <upd_state>
 
 	std::vector<ConnReqInfo> conn_pend;	// record for each conn req not completed
-
-		// find the neighbour on port <p>
-	MgtSocket * LinkPartner(int p);
-		// check which neighbours are accessible
-	void Trace();
-	bool traced;
+		// whether the user's privilege allows connecting to output <port>
+	bool MayConnect(int port);
+		// start connecting output <port> to input <srce_port> of <srce>; 
+		//		returns false if the request couldn't be sent
+	bool RequestConnection(int port, MgtSocket * srce, int srce_port, 
+														int salvo_entry = -1);
+		// whether to send the VarBinds that set up a connection in a single 
+		//		Set; cleared if the unit rejects one as tooBig, after which 
+		//		they are sent in separate messages as for earlier software
+	bool multi_set_ok;
+		// buffer in which the Set is built, which keeps its allocation 
+		//		from one connection to the next
+	ByteString setup_msg;
+#define SETUP_MSG_RESERVE	256
+		// add the VarBinds for setting up <ci> with call id <v> to <msg>; 
+		//		sets <ends> (4 entries) as for <ConnReqInfo::ends>; returns 
+		//		false if the call id can't be coded
+	bool AppendSetupVarBinds(ByteString& msg, VarBindView& v, ConnReqInfo& ci, 
+																int * ends);
+		// send each VarBind from <msg> (built as above) in a separate Set, 
+		//		recording them in <ci>
+	void SendSetupSeparately(ConnReqInfo& ci, const ByteString& msg, 
+															const int * ends);
+
+		// find the neighbour on port <p>; if <create>, sets up a management 
+		//		connection to it if we don't already have one
+	MgtSocket * LinkPartner(int p, bool create = true);
+		// update our links in <theApp.topology>
+	void UpdateLinks();
 
 		// update display if required, to reflect change in MIB or console text 
 		// in the console case, we also select console if this unit is displayed; 
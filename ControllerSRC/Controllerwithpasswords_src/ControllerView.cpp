@@ -23,6 +23,8 @@ IMPLEMENT_DYNCREATE(CControllerView, CScrollView)
 BEGIN_MESSAGE_MAP(CControllerView, CScrollView)
 	//{{AFX_MSG_MAP(CControllerView)
 	ON_WM_CHAR()
+	ON_COMMAND(ID_FILE_SAVE_CAPTURE, OnFileSaveCapture)
+	ON_UPDATE_COMMAND_UI(ID_FILE_SAVE_CAPTURE, OnUpdateFileSaveCapture)
 	//}}AFX_MSG_MAP
 END_MESSAGE_MAP()
 
@@ -97,12 +99,7 @@ void CControllerView::OnDraw(CDC* pDC)
 			// output text
 		pDC->SetTextColor(0); // black
 		pDC->SetBkColor(0xFFFFFF); // on white
-		n = a->console.size();
-		i = -1;
-		while (++i < n) {
-			pDC->TextOut(x, y, a->console.at(i).c_str());
-			y += CharHeight;
-		}
+		y = a->AddConsoleToDisplay(x, y, CharHeight, pDC);
 		y += CharHeight;
 
 			// command input
@@ -408,6 +405,7 @@ case UPD_ST_BAD_VM_FILE:
 
 case UPD_ST_UPLOADING:
 		str = "Writing data to flash";
+		if (m->upd_offset >= 0) str += ": " + m->UploadProgress();
 		break;
 
 case UPD_ST_TIDY_UP:
@@ -424,7 +422,7 @@ case UPD_ST_ERASING:
 		break;
 
 case UPD_ST_WAITING:
-		str = "Erase requested";	// +++ click to check whether complete
+		str = "Waiting for erase to complete";
 		pDC->SetTextColor(0xFF0000); // blue
 		break;
 
@@ -432,6 +430,14 @@ case UPD_ST_FAILED:
 		str = "Protocol failure in uploading process";
 		break;
 
+case UPD_ST_QUEUED:
+		str = "Waiting for other units to finish writing to flash";
+		break;
+
+case UPD_ST_VERIFYING:
+		str = "Checking data already written to flash";
+		break;
+
 default:
 		str.Format("Unknown state of uploading process, code %d", m->upd_state);
 	}
@@ -439,7 +445,27 @@ default:
 	pDC->TextOut(x, y, str);
 	y += CharHeight * 2;
 
-	if (theApp.update_flags > 0) {
+	if (theApp.rollout->active) {
+			// count the units the rollout applies to and how many of them 
+			//		have finished
+		int in_rollout = 0;
+		int done = 0;
+		i = (int)(theApp.units.GetCount());
+		while (--i > 0) {
+			MgtSocket * u = theApp.units.GetAt(i);
+			unless (u && theApp.rollout->Includes(u)) continue;
+			in_rollout += 1;
+			if (u->upd_state == UPD_ST_UP_TO_DATE || 
+						u->upd_state == UPD_ST_NO_ACTION) done += 1;
+		}
+		pDC->SetTextColor(0x0000FF); // red
+		str.Format("Software rollout: %d of %d units done", done, in_rollout);
+		if (theApp.rollout->budget > 0) str.AppendFormat(
+					", limited to %d kbytes/s", theApp.rollout->budget / 1000);
+		pDC->TextOut(x, y, str);
+		y += CharHeight * 2;
+	}
+	else if (theApp.update_flags > 0) {
 		pDC->SetTextColor(0x0000FF); // red
 		pDC->TextOut(x, y, "Software update enabled for all units");
 		y += CharHeight * 2;
@@ -454,22 +480,16 @@ default:
 		pDC->TextOut(x, y, "Console output");
 		y += CharHeight * 2;
 
-		n = m->console.size();
-		i = -1;
-		while (++i < n) {
-			pDC->TextOut(x, y, m->console.at(i).c_str());
-			y += CharHeight;
-		}
-
+		m->AddConsoleToDisplay(x, y, CharHeight, pDC);
 		return;
 	}
 
 		// else dump the MIB
-	POSITION p = m->mib.GetHeadPosition();
-	if (p != NULL) {
+	int mi = 0;
+	MibObject * obj = m->mib.Next(mi);
+	if (obj != NULL) {
 		do {
-			MibObject * obj = m->mib.GetNext(p);
-			s3 = obj->oid + " =";
+			s3 = obj->OidText() + " =";
 			n = obj->GetCount();
 
 			switch (obj->tag) {
@@ -508,22 +528,14 @@ in_hex:		j = 0;
 
 write_line:	pDC->TextOut(x, y, s3);
 			y += CharHeight;
-		} while (p != NULL);
-
-		y += CharHeight;
-	}
+		} until ((obj = m->mib.Next(mi)) == NULL);
 
-	if (m->mib_map.GetCount() != m->mib.GetCount()) {
-		str.Format("*** %d in MIB, %d in map ***", m->mib.GetCount(), m->mib_map.GetCount());
-		y += CharHeight;
-		pDC->SetTextColor(0x0000FF); // red
-		pDC->TextOut(x, y, str);
 		y += CharHeight;
 	}
 
 		// dump the input and output flows
 	y += CharHeight;
-	p = m->output_flows.GetStartPosition();
+	POSITION p = m->output_flows.GetStartPosition();
 	while (p) {
 		m->output_flows.GetNextAssoc(p, str, s3);
 		pDC->TextOut(x, y, "out " + str + ' ' + s3);
@@ -542,13 +554,19 @@ write_line:	pDC->TextOut(x, y, s3);
 }
 
 
-// list the stored messages
+// list the stored messages; only those in the clip box are converted to text
 // returns new <y> value; colours on return are undefined
 int FlexilinkSocket::AddMsgsToDisplay(int x, int y, int CharHeight, CDC * pDC)
 {
+	CRect clip;
+	pDC->GetClipBox(&clip);
 	int i = -1;
-	while (++i < msgs.GetSize()) {
-		switch (msgs.GetAt(i)[0]) {
+	while (++i < msgs.Count()) {
+		if (y + CharHeight <= clip.top || y >= clip.bottom) {
+			y += CharHeight;
+			continue;
+		}
+		switch (msgs.Record(i).flag) {
 case 'T':	pDC->SetTextColor(0); // black
 			pDC->SetBkColor(0x00FFFF); // yellow
 			break;
@@ -577,7 +595,7 @@ default:	pDC->SetTextColor(0x0000FF); // red
 			pDC->SetBkColor(0xFFFFFF); // white
 		}
 
-		pDC->TextOut(x, y, msgs.GetAt(i).Mid(1));
+		pDC->TextOut(x, y, msgs.Text(i).c_str());
 		y += CharHeight;
 	}
 
@@ -585,6 +603,25 @@ default:	pDC->SetTextColor(0x0000FF); // red
 }
 
 
+// list the console text; only the lines in the clip box are drawn
+// returns new <y> value
+int FlexilinkSocket::AddConsoleToDisplay(int x, int y, int CharHeight, CDC * pDC)
+{
+	CRect clip;
+	pDC->GetClipBox(&clip);
+	int i, end;
+	console.Visible(y, CharHeight, clip.top, clip.bottom, i, end);
+	i -= 1;
+	while (++i < end) {
+		int len;
+		const char * p = console.Line(i, len);
+		pDC->TextOut(x, y + i * CharHeight, p, len);
+	}
+
+	return y + console.Count() * CharHeight;
+}
+
+
 void CControllerView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint) 
 {
 	CControllerDoc* pDoc = GetDocument();
@@ -599,11 +636,11 @@ void CControllerView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
 	if (m == NULL) h = 12;
 	else if (pDoc->display_select >= 0) {
 		AnalyserDoc * a = theApp.scp.at(pDoc->display_select);
-		h = 20 + a->msgs.GetSize() + a->console.size();
+		h = 20 + a->msgs.Count() + a->console.Count();
 	}
 	else if (m->state < 0) h = 12;
-	else if (pDoc->display_select == CONSOLE_DISPLAY) h = (int)m->console.size() + 20;
-	else h = (int)(m->mib.GetCount() + m->msgs.GetSize() + m->mib.GetCount() + 23);
+	else if (pDoc->display_select == CONSOLE_DISPLAY) h = m->console.Count() + 20;
+	else h = (int)(m->mib.GetCount() + m->msgs.Count() + m->mib.GetCount() + 23);
 
 	area.cx = (20) + ((Char5Width * w)/4); // +++ ought to be /5 but then the messages don't fit
 	area.cy = (10) + (CharHeight * h);
@@ -714,6 +751,51 @@ void CControllerView::OnChar(UINT nChar, UINT nRepCnt, UINT nFlags)
 }
 
 
+// write the messages saved for the unit or SCP session being shown to a 
+//		pcapng file, which can be examined with Wireshark using the 
+//		Flexilink plugin
+// the messages are only saved at maintenance level
+void CControllerView::OnFileSaveCapture()
+{
+	CControllerDoc* pDoc = GetDocument();
+	if (pDoc == NULL || theApp.link_socket == NULL) return;
+	FlexilinkSocket * s = pDoc->unit;
+	if (pDoc->display_select >= 0) s = theApp.scp.at(pDoc->display_select);
+	if (s == NULL) return;
+
+	CFileDialog d(FALSE, "pcapng", NULL, OFN_OVERWRITEPROMPT | OFN_HIDEREADONLY, 
+				"Capture files (*.pcapng)|*.pcapng|All files (*.*)|*.*||", this);
+	unless (d.DoModal() == IDOK) return;
+
+		// our address is the one the link is bound to, which may be 0.0.0.0
+	SOCKADDR_IN our_addr;
+	int n = sizeof(our_addr);
+	memset(&our_addr, 0, n);
+	theApp.link_socket->GetSockName((SOCKADDR *)&our_addr, &n);
+	ByteString f;
+	s->msgs.Pcapng(f, our_addr.sin_addr.s_addr, 
+					inet_addr(theApp.link_socket->link_ip_addr), 
+									theApp.link_socket->standard_format);
+
+	CFile file;
+	unless (file.Open(d.GetPathName(), CFile::modeCreate | CFile::modeWrite)) {
+		AfxMessageBox("Could not create " + d.GetPathName(), 
+												MB_OK | MB_ICONEXCLAMATION);
+		return;
+	}
+	file.Write(f.data(), (UINT)f.size());
+	file.Close();
+}
+
+
+void CControllerView::OnUpdateFileSaveCapture(CCmdUI* pCmdUI)
+{
+	CControllerDoc* pDoc = GetDocument();
+	pCmdUI->Enable(theApp.privilege == PRIV_MAINTENANCE && pDoc != NULL && 
+						(pDoc->unit != NULL || pDoc->display_select >= 0));
+}
+
+
 // CControllerView diagnostics
 
 #ifdef _DEBUG
@@ -42,6 +42,8 @@ protected:
 protected:
 	//{{AFX_MSG(C9tos2View)
 	afx_msg void OnChar(UINT nChar, UINT nRepCnt, UINT nFlags);
+	afx_msg void OnFileSaveCapture();
+	afx_msg void OnUpdateFileSaveCapture(CCmdUI* pCmdUI);
 	//}}AFX_MSG
 	DECLARE_MESSAGE_MAP()
 public:
@@ -41,7 +41,7 @@ CCrosspointDoc::~CCrosspointDoc()
 }
 
 
-// replace any pointers to <u> in <CCrosspointView::locs> with NULL
+// replace any pointers to <u> in <CCrosspointView::model> with NULL
 // safe if <this> is NULL
 void CCrosspointDoc::RemoveFromLocs(MgtSocket * u)
 {
@@ -55,6 +55,19 @@ void CCrosspointDoc::RemoveFromLocs(MgtSocket * u)
 }
 
 
+// called from CControllerApp::OnIdle with the changes to the objects shown 
+//		in this window since the last call
+void CCrosspointDoc::MibChanged(const std::vector<MibDelta>& d)
+{
+	POSITION pos = GetFirstViewPosition();
+	while (pos != NULL) {
+		CCrosspointView * pView = 
+					dynamic_cast<CCrosspointView *>(GetNextView(pos));
+		if (pView) pView->MibChanged(d);
+	}
+}
+
+
 BEGIN_MESSAGE_MAP(CCrosspointDoc, CDocument)
 END_MESSAGE_MAP()
 
@@ -1,4 +1,5 @@
 #pragma once
+#include "../Common/mib_bus.h"
 
 
 struct PortIdent {
@@ -24,6 +25,7 @@ public:
 	bool inputs;			// else is list of outputs
 	PortIdent sel_port;		// selected port; <unit == NULL> if none
 	void RemoveFromLocs(MgtSocket * u);	// call if <u> being deleted
+	void MibChanged(const std::vector<MibDelta>& d);
 
 protected:
 	virtual BOOL OnNewDocument();
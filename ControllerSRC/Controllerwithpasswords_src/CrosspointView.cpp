@@ -23,7 +23,7 @@ CCrosspointView::CCrosspointView()
 	Char5Width = 40;
 	CharHeight = 12;
 	text_font = FindFont(CharHeight);
-	sel_port.p.unit = NULL;
+	sel_port.unit = NULL;
 }
 
 CCrosspointView::~CCrosspointView()
@@ -31,16 +31,46 @@ CCrosspointView::~CCrosspointView()
 }
 
 
-// replace any pointers to <u> in <locs> with NULL
+// replace any pointers to <u> in <model> with NULL
 // safe if <this> is NULL
 void CCrosspointView::RemoveFromLocs(MgtSocket * u) {
 	if (this == NULL) return;
-	if (sel_port.p.unit == u) sel_port.p.unit = NULL;
-	INT_PTR n = locs.GetSize();
-	int i = 0;
-	while (i < n) {
-		if (locs[i].p.unit == u) locs[i].p.unit = NULL;
-		i += 1;
+	if (sel_port.unit == u) sel_port.unit = NULL;
+	model.RemoveUnit(u);
+}
+
+
+// <y> is such that if we are pointing to the middle of a line it's the y 
+//		value for the top of the line
+PortIdent CCrosspointView::HitTest(int y)
+{
+	PortIdent r;
+	const XptRow * row = model.Nearest(y);
+	r.unit = (row == NULL) ? NULL : (MgtSocket *)row->unit;
+	r.port = (row == NULL) ? -1 : row->port;
+	return r;
+}
+
+
+// only the lines for the units in <d> need to be repainted, unless the change 
+//		can affect other units' lines or a unit isn't in the window yet; if a 
+//		unit's lines change in number, <OnDraw> repaints the rest
+void CCrosspointView::MibChanged(const std::vector<MibDelta>& d)
+{
+	CPoint pos = GetDeviceScrollPosition();
+	CRect client;
+	GetClientRect(&client);
+	CRect r;
+	int top, bottom;
+	std::vector<MibDelta>::const_iterator p = d.begin();
+	for (; p != d.end(); p++) {
+		if ((p->bits & XPT_BITS_GLOBAL) != 0 || 
+								!model.Extent(p->unit, top, bottom)) {
+			OnUpdate(NULL, 0, NULL);
+			return;
+		}
+		r.SetRect(client.left, top - pos.y, client.right, bottom - pos.y);
+		InvalidateRect(&r);
 	}
 }
 
@@ -97,6 +127,7 @@ void CCrosspointView::OnDraw(CDC* pDC)
 	}
 	else if (j > 0) str = inputs ? "Media sources" : "Media destinations";
 	else {
+		model.RemoveAll();
 		if (theApp.link_socket == NULL) str = "No local termination for link to Flexilink network";
 		else switch (theApp.link_socket->state) {
 		case LINK_ST_BEGIN:
@@ -139,395 +170,450 @@ void CCrosspointView::OnDraw(CDC* pDC)
 	pDC->TextOut(x, y, str);
 	y += CharHeight * 2;
 
-	locs.RemoveAll();
-
-	MibObject * obj;
-	CString s;
-	CString s2;
+		// reformat the lines for any units whose information has changed
 	MgtSocket * m;
-	MgtSocket * h;
-	AnalyserDoc * a;
+	XptKey key;
+	key.global_rev = theApp.xpt_revision;
+	key.state[3] = (theApp.link_socket == NULL) ? -1 : theApp.link_socket->state;
+	key.state[4] = theApp.privilege;
+		// the SCP server lines depend on the state of the analyser windows 
+		//		and of the units at the other end of the link, so are always 
+		//		reformatted
+		// +++ could count changes to <AnalyserDoc::server_state> too
+	key.always = inputs && theApp.privilege == PRIV_MAINTENANCE;
+	model.Truncate((int)n + 1);
 	j = 0;
-	PortLocation loc;
-	while (++j <= n) { // for each unit
+	while (++j <= n) {
 		m = theApp.units.GetAt(j);
-		if (m == NULL) continue;
-		if (m->state < 0) {
-				// illegal value, maybe 0xFEEEFEEE
-			if (theApp.privilege >= PRIV_SUPERVISOR) {
-				pDC->SetTextColor(0x0000FF); // red
-				pDC->SetBkColor(0xFFFFFF); // white
-				pDC->TextOut(x, y, "Unit's description corrupted");
-				y += (CharHeight * 3) / 2;
-			}
+		if (m == NULL) {
+			model.Clear(j);
 			continue;
 		}
+		key.unit_rev = m->xpt_revision;
+		key.state[0] = m->state;
+		key.state[1] = m->upd_state;
+		key.state[2] = m->password_state;
+		if (model.IsCurrent(j, m, key)) continue;
+		BuildUnitRows(m, model.NewRows(j, m, key));
+	}
 
-			// here for each management socket m
-		loc.p.unit = m;
+		// now output the lines that are in the area to be painted; if any 
+		//		have moved, the whole window needs to be repainted
+	y = model.Layout(y, CharHeight);
+	if (model.Moved() && !pDC->IsPrinting()) Invalidate();
+	CRect clip;
+	pDC->GetClipBox(&clip);
+	const std::vector<const XptRow *>& lines = model.Lines();
+	j = (int)lines.size();
+	i = model.FirstVisible(clip.top);
+	while (i < j) {
+		const XptRow * r = lines[i++];
+		if (r->y >= clip.bottom) break;
+		pDC->SetTextColor(r->colour);
+		if (r->media && r->unit == pDoc->sel_port.unit && 
+								r->port == pDoc->sel_port.port) 
+										pDC->SetBkColor(0x00FFFF); // yellow
+			else pDC->SetBkColor(r->bk_colour);
+		pDC->TextOut(x + r->indent * Char5Width, r->y, r->text.c_str(), 
+														(int)r->text.size());
+	}
 
-		if (theApp.privilege > PRIV_LISTENER && (m->password_state == PW_NOT_SET || 
-						m->password_state == PW_CANCELLED || theApp.privilege == 
-//						PRIV_MAINTENANCE || sel_port.p.unit->state != MGT_ST_ACTIVE)) {
-// +++ the above crashes if <sel_port.p.unit> is NULL; I'm not quite sure what was intended
-						PRIV_MAINTENANCE || m->state != MGT_ST_ACTIVE)) {
-				// include the unit's name etc so can click on it
-			loc.p.port = -1;
-			loc.y = y;
-			locs.Add(loc);
+	if (inputs) return;
+		// here to add the latest error messages at the end of the outputs list
+	n = theApp.err_msgs.GetSize();
+	if (n <= 0) return;
+	pDC->SetTextColor(0x0000FF); // red
+	pDC->SetBkColor(0xFFFFFF); // white
+	i = 0;
+	do {
+		pDC->TextOut(x, y, theApp.err_msgs[i++]);
+		y += CharHeight;
+	} while (i < n);
+}
 
-			str = m->DisplayName();
-			if (str.IsEmpty()) {
-				pDC->SetTextColor(0x0000FF); // red
-				pDC->SetBkColor(0xFFFFFF); // white
-				pDC->TextOut(x, y, "Unidentified unit");
-				y += (CharHeight * 3) / 2;
-				continue;
-			}
 
-			if (inputs) {
-				s = m->GetStringObject("1.0.62379.1.1.1.6.0"); // product name
-				unless (str.Left(s.GetLength()) == s) str += " - " + s;
-				s.Format(" - %d-%d-%d-%d", m->product_code[0], 
-					m->product_code[1], m->product_code[2], m->product_code[3]);
-				str += s;
+// this is only called when something the lines depend on has changed, see 
+//		crosspoint_model.h
+// the rows are built in <row> and appended to <rows>; <row.text> is set 
+//		from <str> when each row is complete
+void CCrosspointView::BuildUnitRows(MgtSocket * m, std::vector<XptRow>& rows)
+{
+	bool inputs = GetDocument()->inputs;
+	MibObject * obj;
+	CString str;
+	CString s;
+	CString s2;
+	MgtSocket * h;
+	AnalyserDoc * a;
+	XptRow row;
+	int i;
+
+	if (m->state < 0) {
+			// illegal value, maybe 0xFEEEFEEE
+		if (theApp.privilege >= PRIV_SUPERVISOR) {
+			row.text = "Unit's description corrupted";
+			row.colour = 0x0000FF; // red
+			row.gap = 1;
+			rows.push_back(row);
+		}
+		return;
+	}
+
+	row.unit = m;
+
+	if (theApp.privilege > PRIV_LISTENER && (m->password_state == PW_NOT_SET || 
+					m->password_state == PW_CANCELLED || theApp.privilege == 
+//					PRIV_MAINTENANCE || sel_port.unit->state != MGT_ST_ACTIVE)) {
+// +++ the above crashes if <sel_port.unit> is NULL; I'm not quite sure what was intended
+					PRIV_MAINTENANCE || m->state != MGT_ST_ACTIVE)) {
+			// include the unit's name etc so can click on it
+		row.port = -1;
+		row.gap = 1;
+
+		str = m->DisplayName();
+		if (str.IsEmpty()) {
+			row.text = "Unidentified unit";
+			row.colour = 0x0000FF; // red
+			rows.push_back(row);
+			return;
+		}
+
+		if (inputs) {
+			s = m->GetStringObject("1.0.62379.1.1.1.6.0"); // product name
+			unless (str.Left(s.GetLength()) == s) str += " - " + s;
+			s.Format(" - %d-%d-%d-%d", m->product_code[0], 
+				m->product_code[1], m->product_code[2], m->product_code[3]);
+			str += s;
+		}
+		else {
+			obj = m->GetObject("1.0.62379.1.1.4.7");
+			bool in_paren = (obj != NULL);
+			if (in_paren) str.AppendFormat(" (sync %d", obj->IntegerValue());
+
+			obj = m->GetObject("1.0.62379.1.1.4.6");
+			unless (obj == NULL) {
+				if (in_paren) str += ", ";
+				else { str += " ("; in_paren = true; }
+				str.AppendFormat("timing %02X %d %d", obj->at(0), 
+						obj->at(8), (obj->at(9) << 8 | obj->at(10)) ^ 0xFFFF);
 			}
-			else {
-				obj = m->GetObject("1.0.62379.1.1.4.7");
-				bool in_paren = (obj != NULL);
-				if (in_paren) str.AppendFormat(" (sync %d", obj->IntegerValue());
-
-				obj = m->GetObject("1.0.62379.1.1.4.6");
-				unless (obj == NULL) {
-					if (in_paren) str += ", ";
-					else { str += " ("; in_paren = true; }
-					str.AppendFormat("timing %02X %d %d", obj->at(0), 
-							obj->at(8), (obj->at(9) << 8 | obj->at(10)) ^ 0xFFFF);
-				}
 
-				obj = m->GetObject("1.0.62379.1.1.4.8");
-				unless (obj == NULL) {
-					if (in_paren) str += ", ";
-					else { str += " ("; in_paren = true; }
-					str.AppendFormat("framing %02X %d ", obj->at(0), obj->at(8));
-					i = (obj->at(9) << 8 | obj->at(10)) ^ 0xFFFF; // "uncertainty" value
-					if (i >= 0x2000) {
-						str.AppendFormat("%d+", i >> 13);
-						i &= 0x1FFF;
-					}
-					str.AppendFormat("%d", i);
+			obj = m->GetObject("1.0.62379.1.1.4.8");
+			unless (obj == NULL) {
+				if (in_paren) str += ", ";
+				else { str += " ("; in_paren = true; }
+				str.AppendFormat("framing %02X %d ", obj->at(0), obj->at(8));
+				i = (obj->at(9) << 8 | obj->at(10)) ^ 0xFFFF; // "uncertainty" value
+				if (i >= 0x2000) {
+					str.AppendFormat("%d+", i >> 13);
+					i &= 0x1FFF;
 				}
-
-				if (in_paren) str += ')';
+				str.AppendFormat("%d", i);
 			}
 
-			if (theApp.link_socket == NULL || theApp.link_socket->state > LINK_ST_MAX_OK) 
-													pDC->SetTextColor(0x0000FF); // red
-			else if (theApp.link_socket->state != LINK_ST_ACTIVE) 
-													pDC->SetTextColor(0xFF00FF); // magenta
-			else if (m->state > MGT_ST_MAX_OK) pDC->SetTextColor(0x0000FF); // red
-			else if (m->state != MGT_ST_ACTIVE) pDC->SetTextColor(0xFF00FF); // magenta
-			else if (m->upd_state == UPD_ST_NO_ACTION) pDC->SetTextColor(0x40BF00); // green
-			else pDC->SetTextColor(0xFF0000); // blue
-
-			pDC->SetBkColor(0xFFFFFF); // white
-			pDC->TextOut(x, y, str);
-			y += (CharHeight * 3) / 2;
-
-			if (theApp.privilege == PRIV_MAINTENANCE && m->unit_id) {
-					// list any SCP servers accessible via this unit in sources window, 
-					//		transparent tunnels in destinations window
-				NetPortList::iterator q = m->net_port_state.begin();
-				unless (q == m->net_port_state.end()) do {
+			if (in_paren) str += ')';
+		}
+
+		if (theApp.link_socket == NULL || theApp.link_socket->state > LINK_ST_MAX_OK) 
+												row.colour = 0x0000FF; // red
+		else if (theApp.link_socket->state != LINK_ST_ACTIVE) 
+												row.colour = 0xFF00FF; // magenta
+		else if (m->state > MGT_ST_MAX_OK) row.colour = 0x0000FF; // red
+		else if (m->state != MGT_ST_ACTIVE) row.colour = 0xFF00FF; // magenta
+		else if (m->upd_state == UPD_ST_NO_ACTION) row.colour = 0x40BF00; // green
+		else row.colour = 0xFF0000; // blue
+
+		row.text = (LPCSTR)str;
+		rows.push_back(row);
+		row.gap = 0;
+		row.indent = 1;
+
+		if (theApp.privilege == PRIV_MAINTENANCE && m->unit_id) {
+				// list any SCP servers accessible via this unit in sources window, 
+				//		transparent tunnels in destinations window
+			NetPortList::iterator q = m->net_port_state.begin();
+			unless (q == m->net_port_state.end()) do {
 // +++ NetPortState codings need review; currently SCP is AwaitSync which is shown 
 //		as link down
-//					unless (q->second >= NET_PORT_STATE_LINK_UP) continue;
-					loc.p.port = q->first;
-					s2.Format("%d", loc.p.port);
-					if (inputs) {
-							// get nPortScpDevice from MIB
-						s = m->GetStringHex("1.0.62379.5.1.1.1.1.1.9." + s2, 1);
-						if (s.IsEmpty()) continue;
-						if (s == "00 90 A8 00") {
-							i = 1;
-							str = s2 + ": debug server";
-						}
-						else {
-							i = 0;
-							str = s2 + ": SCP server type " + s;
-						}
-						h = m->LinkPartner(loc.p.port);
-						if (h) {
-							s = h->DisplayName();
-							unless (s.IsEmpty()) str += " in " + s;
-						}
-						pDC->SetTextColor(0); // black
-						pDC->SetBkColor(0xFFFFFF); // white
-						if (i) {
-								// add the VM state
-							a = theApp.FindScpServer(m, loc.p.port, 0);
-							if (a && a->state >= MGT_ST_CONN_MADE && a->server_state != 0) {
-									// <server_state> is valid so take the VM state from that
-								pDC->SetTextColor(0xFF0000); // blue
-								i = ((a->server_state >> 24) & 3) | 4;
-							}
-							else i = m->GetIntegerObject("1.0.62379.5.1.1.1.1.1.10." + s2);
-							switch (i) {
-					case 4:		str += " (CPU initialising)";
-								pDC->SetBkColor(0xA0FF80); // pale green
-								break;
-					case 5:		str += " (CPU waiting)";
-								pDC->SetBkColor(0xA0FF80); // pale green
-								break;
-					case 6:		str += " (CPU running)";
-								break;
-					case 7:		str += " (CPU stopped)";
-								pDC->SetBkColor(0x8080FF); // pale red
-								break;
-					default:	pDC->SetTextColor(0x0000FF); // red
-							}
-						}
-
-						loc.y = y;
-						locs.Add(loc);
+//				unless (q->second >= NET_PORT_STATE_LINK_UP) continue;
+				row.port = q->first;
+				s2.Format("%d", row.port);
+				row.bk_colour = 0xFFFFFF; // white
+				if (inputs) {
+						// get nPortScpDevice from MIB
+					s = m->GetStringHex(MIB_COL_N_PORT_SCP_DEVICE, row.port, 1);
+					if (s.IsEmpty()) continue;
+					if (s == "00 90 A8 00") {
+						i = 1;
+						str = s2 + ": debug server";
 					}
 					else {
-							// get nPortTransparentPartner and nPortState from MIB
-						s = m->GetStringHex("1.0.62379.5.1.1.1.1.1.11." + s2, 1);
-						str = "Network port " + s2;
-						i = m->GetIntegerObject("1.0.62379.5.1.1.1.1.1.3."+ s2);
+						i = 0;
+						str = s2 + ": SCP server type " + s;
+					}
+					h = m->LinkPartner(row.port);
+					if (h) {
+						s = h->DisplayName();
+						unless (s.IsEmpty()) str += " in " + s;
+					}
+					row.unit = m;
+					row.colour = 0; // black
+					if (i) {
+							// add the VM state
+						a = theApp.FindScpServer(m, row.port, 0);
+						if (a && a->state >= MGT_ST_CONN_MADE && a->server_state != 0) {
+								// <server_state> is valid so take the VM state from that
+							row.colour = 0xFF0000; // blue
+							i = ((a->server_state >> 24) & 3) | 4;
+						}
+						else i = m->GetIntegerObject(MIB_COL_N_PORT_VM_STATE, row.port);
 						switch (i) {
-					default: continue;
-					case 3:		// link down
-							if (s.IsEmpty()) continue; // null string or not reported
-							pDC->SetTextColor(0x00A0A0); // yellow
+				case 4:		str += " (CPU initialising)";
+							row.bk_colour = 0xA0FF80; // pale green
 							break;
-					case 1: pDC->SetTextColor(0x0000FF); // red
-							str += " reserved";
-							unless (s.IsEmpty()) str += "; transparent partner " + s;
+				case 5:		str += " (CPU waiting)";
+							row.bk_colour = 0xA0FF80; // pale green
 							break;
-					case 8: pDC->SetTextColor(0x40BF00); break; // green
-						}
-						unless (i == 1) {
-							str += " transparent";
-							unless (s.IsEmpty()) str += " partner " + s;
+				case 6:		str += " (CPU running)";
+							break;
+				case 7:		str += " (CPU stopped)";
+							row.bk_colour = 0x8080FF; // pale red
+							break;
+				default:	row.colour = 0x0000FF; // red
 						}
-						pDC->SetBkColor(0xFFFFFF); // white
 					}
-					pDC->TextOut(x + Char5Width, y, str);
-					y += CharHeight;
-				} until (++q == m->net_port_state.end());
-			}
-		}
-
-		POSITION port_ptr = (inputs ? m->input_port_list : 
-										m->output_port_list).GetHeadPosition();
-		while (port_ptr != NULL) {
-			int colour = 4; // d2 set if not connected, d1-0 ms 2 bits of importance
-			if (inputs) {
-				loc.p.port = m->input_port_list.GetNext(port_ptr);
-				s2.Format("%d", loc.p.port);
-				str = m->GetStringObject("1.0.62379.2.1.1.1.1.5." + s2); // aPortName
-				unless (str.IsEmpty()) {
-						// have an audio port name
-		//			if (theApp.name_translations.Lookup(str, s)) str = s;
-						// see if it's receiving and if so add the sampling rate
-					s = m->GetOidObject("1.0.62379.2.1.1.1.1.3." + s2); // aPortFormat
-					unless (s.Left(18) == "1.0.62379.2.2.1.3.") goto input_done;
-					str += " (" + s.Mid(s.ReverseFind('.') + 1) + ')';
-					goto input_done;
 				}
-
-				str = m->GetStringObject("1.0.62379.3.1.1.1.1.5." + s2); // vPortName
-				if (str.IsEmpty()) {
-					str.Format("[input port %d]", loc.p.port);
-					goto input_done;
+				else {
+						// get nPortTransparentPartner and nPortState from MIB
+						// these lines can't be clicked on
+					s = m->GetStringHex(MIB_COL_N_PORT_PARTNER, row.port, 1);
+					str = "Network port " + s2;
+					i = m->GetIntegerObject(MIB_COL_N_PORT_STATE, row.port);
+					switch (i) {
+				default: continue;
+				case 3:		// link down
+						if (s.IsEmpty()) continue; // null string or not reported
+						row.colour = 0x00A0A0; // yellow
+						break;
+				case 1: row.colour = 0x0000FF; // red
+						str += " reserved";
+						unless (s.IsEmpty()) str += "; transparent partner " + s;
+						break;
+				case 8: row.colour = 0x40BF00; break; // green
+					}
+					unless (i == 1) {
+						str += " transparent";
+						unless (s.IsEmpty()) str += " partner " + s;
+					}
+					row.unit = NULL;
 				}
+				row.text = (LPCSTR)str;
+				rows.push_back(row);
+			} until (++q == m->net_port_state.end());
+		}
+	}
 
-					// here if have a video port name
-		//			if (theApp.name_translations.Lookup(str, s)) str = s;
+	row.unit = m;
+	row.indent = 1;
+	row.bk_colour = 0xFFFFFF; // white
+	row.media = true;
+	POSITION port_ptr = (inputs ? m->input_port_list : 
+									m->output_port_list).GetHeadPosition();
+	while (port_ptr != NULL) {
+		int colour = 4; // d2 set if not connected, d1-0 ms 2 bits of importance
+		if (inputs) {
+			row.port = m->input_port_list.GetNext(port_ptr);
+			s2.Format("%d", row.port);
+			str = m->GetStringObject(MIB_COL_A_PORT_NAME, row.port);
+			unless (str.IsEmpty()) {
+					// have an audio port name
+	//			if (theApp.name_translations.Lookup(str, s)) str = s;
 					// see if it's receiving and if so add the sampling rate
-				s = m->GetOidObject("1.0.62379.3.1.1.1.1.3." + s2); // vPortFormat
-				i = 0;
-				sscanf_s(s, "1.0.62379.3.2.1.%u", &i);
-				if (i == 1) goto input_done; // no signal
-				int k0, k1, k2, k3;
-				if (i == 2) {
-					str += " (invalid format)";
-					goto input_done;
-				}
-				if (i == 0) {
-					str += " (unspecified format)";
-					goto input_done;
-				}
-				if (i != 3 || sscanf_s(s.Mid(17), ".%u.%u.%u.%u", 
-														&k0, &k1, &k2, &k3) < 4) {
-					str += " (unrecognised format)";
-					goto input_done;
-				}
-					// here if videoSource (see 4.1.3.5 of 62379-3)
-				str += " (";
-				switch (k1) {
-			case 1: str += "SD "; break;
-			case 2: str += "HD "; break;
-			case 3: str += "4k "; break;
-			case 4: str += "8k "; break;
-				}
-				str.AppendFormat("%u", k2);
-				if (k3 == 1) str.AppendFormat("p%u", k0/1000);
-				else if (k3 == 2) str.AppendFormat("i%u", k0/500);
-				str += ')';
-	
-		input_done:	// here when any indication of what input is present on the port 
-					//		has been added to <str>
-				if (!m->input_flows.Lookup(s2, s)) {
-						// no flow for the port
-					goto write_port;
-				}
-
-				obj = m->GetObject("1.0.62379.5.1.1.3.3.1.9." + s);
-				if (obj == NULL) {
-						// udState for the flow no longer in the MIB, so assume it 
-						//		has been cleared down
-					m->input_flows.RemoveKey(s2);
-					goto write_port;
-				}
+				s = m->GetOidObject(MIB_COL_A_PORT_FORMAT, row.port);
+				unless (s.Left(18) == "1.0.62379.2.2.1.3.") goto input_done;
+				str += " (" + s.Mid(s.ReverseFind('.') + 1) + ')';
+				goto input_done;
+			}
 
-				i = obj->IntegerValue();
-				if (i == 6 || i == 9) {	// "disconnected" or "finished"
-					m->input_flows.RemoveKey(s2);
-					goto write_port;
-				}
+			str = m->GetStringObject(MIB_COL_V_PORT_NAME, row.port);
+			if (str.IsEmpty()) {
+				str.Format("[input port %d]", row.port);
+				goto input_done;
+			}
 
-				str += " -> flow " + s;
-				if (i == 4) colour = 	// udImportance
-					m->GetIntegerObject("1.0.62379.5.1.1.3.3.1.14." + s) >> 6;
-				else colour = 7; // magenta if flow not active
+				// here if have a video port name
+	//			if (theApp.name_translations.Lookup(str, s)) str = s;
+				// see if it's receiving and if so add the sampling rate
+			s = m->GetOidObject(MIB_COL_V_PORT_FORMAT, row.port);
+			i = 0;
+			sscanf_s(s, "1.0.62379.3.2.1.%u", &i);
+			if (i == 1) goto input_done; // no signal
+			int k0, k1, k2, k3;
+			if (i == 2) {
+				str += " (invalid format)";
+				goto input_done;
+			}
+			if (i == 0) {
+				str += " (unspecified format)";
+				goto input_done;
+			}
+			if (i != 3 || sscanf_s(s.Mid(17), ".%u.%u.%u.%u", 
+													&k0, &k1, &k2, &k3) < 4) {
+				str += " (unrecognised format)";
+				goto input_done;
+			}
+				// here if videoSource (see 4.1.3.5 of 62379-3)
+			str += " (";
+			switch (k1) {
+		case 1: str += "SD "; break;
+		case 2: str += "HD "; break;
+		case 3: str += "4k "; break;
+		case 4: str += "8k "; break;
+			}
+			str.AppendFormat("%u", k2);
+			if (k3 == 1) str.AppendFormat("p%u", k0/1000);
+			else if (k3 == 2) str.AppendFormat("i%u", k0/500);
+			str += ')';
+	
+	input_done:	// here when any indication of what input is present on the port 
+				//		has been added to <str>
+			if (!m->input_flows.Lookup(s2, s)) {
+					// no flow for the port
+				goto write_port;
 			}
-			else {
-					// output port
-				loc.p.port = m->output_port_list.GetNext(port_ptr);
-				s2.Format("%d", loc.p.port);
-				str = m->GetStringObject("1.0.62379.2.1.1.1.1.5." + s2); // aPortName
-				if (str.IsEmpty()) {
-					str = m->GetStringObject("1.0.62379.3.1.1.1.1.5." + s2); // vPortName
-					if (str.IsEmpty()) str.Format("[input port %d]", loc.p.port);
-				}
 
-		//		if (theApp.name_translations.Lookup(str, s)) str = s;
+			obj = m->GetObject(MIB_COL_UD_STATE, s);
+			if (obj == NULL) {
+					// udState for the flow no longer in the MIB, so assume it 
+					//		has been cleared down
+				m->input_flows.RemoveKey(s2);
+				goto write_port;
+			}
 
-					// set colour from aPortImportance
-					// +++ also need to support vPortImportance; ought to begin by 
-					//		finding what kind of port it is (audio, video, ...) and 
-					//		then look for the appropriate Importance etc objects, 
-					//		or even find a way to make Importance etc independent 
-					//		of the type of port
-				colour = m->GetIntegerObject("1.0.62379.2.1.1.1.1.6." + s2) >> 6;
+			i = obj->IntegerValue();
+			if (i == 6 || i == 9) {	// "disconnected" or "finished"
+				m->input_flows.RemoveKey(s2);
+				goto write_port;
+			}
 
-				unless (m->output_flows.Lookup(s2, s)) {
-						// no flow for the port
-					colour |= 4;
-					goto write_port;
-				}
+			str += " -> flow " + s;
+			if (i == 4) colour = 	// udImportance
+				m->GetIntegerObject(MIB_COL_UD_IMPORTANCE, s) >> 6;
+			else colour = 7; // magenta if flow not active
+		}
+		else {
+				// output port
+			row.port = m->output_port_list.GetNext(port_ptr);
+			s2.Format("%d", row.port);
+			str = m->GetStringObject(MIB_COL_A_PORT_NAME, row.port);
+			if (str.IsEmpty()) {
+				str = m->GetStringObject(MIB_COL_V_PORT_NAME, row.port);
+				if (str.IsEmpty()) str.Format("[input port %d]", row.port);
+			}
 
-				obj = m->GetObject("1.0.62379.5.1.1.2.1.1.7." + s); // usState
-				if (obj == NULL) {
-						// usState for the flow no longer in the MIB, so assume it 
-						//		has been cleared down
-					m->output_flows.RemoveKey(s2);
-					colour |= 4;
-					goto write_port;
-				}
+	//		if (theApp.name_translations.Lookup(str, s)) str = s;
 
-				i = obj->IntegerValue();
-				if (i == 6 || i == 9) {	// "disconnected" or "finished"
-					m->output_flows.RemoveKey(s2);
-					colour |= 4;
-					goto write_port;
-				}
+				// set colour from aPortImportance
+				// +++ also need to support vPortImportance; ought to begin by 
+				//		finding what kind of port it is (audio, video, ...) and 
+				//		then look for the appropriate Importance etc objects, 
+				//		or even find a way to make Importance etc independent 
+				//		of the type of port
+			colour = m->GetIntegerObject(MIB_COL_A_PORT_IMPORTANCE, row.port) >> 6;
 
-				unless (i == 4) colour = 7; // magenta if not active
+			unless (m->output_flows.Lookup(s2, s)) {
+					// no flow for the port
+				colour |= 4;
+				goto write_port;
+			}
 
-				i = m->GetIntegerObject("1.0.62379.2.1.1.4.1.3." + s2); // aLockedSamplesInserted
-				if (i > 0) str.AppendFormat(" %d ins", i);
+			obj = m->GetObject(MIB_COL_US_STATE, s);
+			if (obj == NULL) {
+					// usState for the flow no longer in the MIB, so assume it 
+					//		has been cleared down
+				m->output_flows.RemoveKey(s2);
+				colour |= 4;
+				goto write_port;
+			}
 
-				i = m->GetIntegerObject("1.0.62379.2.1.1.4.1.4." + s2); // aLockedSamplesDropped
-				if (i > 0) str.AppendFormat(" %d drop", i);
+			i = obj->IntegerValue();
+			if (i == 6 || i == 9) {	// "disconnected" or "finished"
+				m->output_flows.RemoveKey(s2);
+				colour |= 4;
+				goto write_port;
+			}
 
-				str += " <- ";
-				int k = m->GetIntegerObject("1.0.62379.2.1.1.4.1.2." + s2); // aLockedTime
-				MgtSocket * sender;
-				s = s.Left(s.ReverseFind('.'));	// flow id
-				if (theApp.flow_senders.Lookup(s, (void *&)sender) && sender) {
-						// we've found the unit transmitting the flow
-					i = sender->GetIntegerObject("1.0.62379.5.1.1.3.3.1.2." + s);
-					if (i) {
-							// sending from port <i>: find aPortName
-						s2.Format("%d", i);
-						s2 = sender->GetStringObject("1.0.62379.2.1.1.1.1.5." + s2);
-						if (s2.IsEmpty()) s2 = 
-								sender->GetStringObject("1.0.62379.3.1.1.1.1.5." + s2);
-						if (!s2.IsEmpty()) {
-						/*	if (theApp.name_translations.Lookup(s2, s)) str += s;
-							else*/ str += s2;
-							goto add_time;
-						}
-							// could default to the unit name plus default port name, 
-							//		but the Aubergine creates its own default values 
-							//		for aPortName and vPortname so in practice it'll 
-							//		always be in the MIB
+			unless (i == 4) colour = 7; // magenta if not active
+
+			i = m->GetIntegerObject(MIB_COL_A_LOCKED_INSERTED, row.port);
+			if (i > 0) str.AppendFormat(" %d ins", i);
+
+			i = m->GetIntegerObject(MIB_COL_A_LOCKED_DROPPED, row.port);
+			if (i > 0) str.AppendFormat(" %d drop", i);
+
+			str += " <- ";
+			int k = m->GetIntegerObject(MIB_COL_A_LOCKED_TIME, row.port);
+			s = s.Left(s.ReverseFind('.'));	// flow id
+				// the key in <flow_senders> is the flow id's arcs in binary, 
+				//		which are in usState's OID between the column and the 
+				//		last arc (the block id)
+			uint8_t col[MIB_COL_MAX_OID_LEN];
+			int a = MibColumnOid(MIB_COL_US_STATE, col);
+			int e = (int)obj->oid_ber.size() - 1;
+			while (e > a && (obj->oid_ber[e-1] & 0x80)) e -= 1;
+			MgtSocket * sender = (MgtSocket *)theApp.flow_senders.Find(
+												obj->oid_ber.data() + a, e - a);
+			if (sender) {
+					// we've found the unit transmitting the flow
+				i = sender->GetIntegerObject(MIB_COL_UD_NET_BLOCK_ID, s);
+				if (i) {
+						// sending from port <i>: find aPortName
+					s2 = sender->GetStringObject(MIB_COL_A_PORT_NAME, i);
+					if (s2.IsEmpty()) s2 = 
+							sender->GetStringObject(MIB_COL_V_PORT_NAME, i);
+					if (!s2.IsEmpty()) {
+					/*	if (theApp.name_translations.Lookup(s2, s)) str += s;
+						else*/ str += s2;
+						goto add_time;
 					}
+						// could default to the unit name plus default port name, 
+						//		but the Aubergine creates its own default values 
+						//		for aPortName and vPortname so in practice it'll 
+						//		always be in the MIB
 				}
+			}
 
-					// here if couldn't find the sending unit and get the name of its port
-				str += "flow " + s;
+				// here if couldn't find the sending unit and get the name of its port
+			str += "flow " + s;
 
 add_time:			// add the "locked time" if nonzero
-				if (k <= 0) goto write_port;
-				str += ' ';;
-				if (k >= 3600) str.AppendFormat("%dh", k/3600);
-				if (k >= 60) str.AppendFormat("%dm", (k/60)%60);
-				str.AppendFormat("%ds", k%60);
-			}
+			if (k <= 0) goto write_port;
+			str += ' ';;
+			if (k >= 3600) str.AppendFormat("%dh", k/3600);
+			if (k >= 60) str.AppendFormat("%dm", (k/60)%60);
+			str.AppendFormat("%ds", k%60);
+		}
 write_port:
-				// here when <colour> is set and <str> is the output line
-			switch (colour) {
-			case 0: pDC->SetTextColor(0x40BF00); // green
-				break;
-			case 1: pDC->SetTextColor(0xFF0000); // blue
-				break;
-			case 2: pDC->SetTextColor(0x3366CC); // orange/brown
-				break;
-			case 3: pDC->SetTextColor(0x0000FF); // red
-				break;
-			case 4:
-			case 5: pDC->SetTextColor(0); // black
-				break;
-			default: pDC->SetTextColor(0xFF00FF); // magenta
-			}
-			if (m == pDoc->sel_port.unit && 
-						loc.p.port == pDoc->sel_port.port) 
-										pDC->SetBkColor(0x00FFFF); // yellow
-				else pDC->SetBkColor(0xFFFFFF); // white
-			loc.y = y;
-			locs.Add(loc);
-			pDC->TextOut(x + Char5Width, y, str);
-			y += CharHeight;
+			// here when <colour> is set and <str> is the output line
+		switch (colour) {
+		case 0: row.colour = 0x40BF00; // green
+			break;
+		case 1: row.colour = 0xFF0000; // blue
+			break;
+		case 2: row.colour = 0x3366CC; // orange/brown
+			break;
+		case 3: row.colour = 0x0000FF; // red
+			break;
+		case 4:
+		case 5: row.colour = 0; // black
+			break;
+		default: row.colour = 0xFF00FF; // magenta
 		}
-
-		y += CharHeight / 2;
+		row.text = (LPCSTR)str;
+		rows.push_back(row);
 	}
 
-	if (inputs) return;
-		// here to add the latest error messages at the end of the outputs list
-	n = theApp.err_msgs.GetSize();
-	if (n <= 0) return;
-	pDC->SetTextColor(0x0000FF); // red
-	i = 0;
-	do {
-		pDC->TextOut(x, y, theApp.err_msgs[i++]);
-		y += CharHeight;
-	} while (i < n);
+	unless (rows.empty()) rows.back().gap += 1;
 }
 
 
@@ -558,48 +644,32 @@ void CCrosspointView::OnLButtonDown(UINT nFlags, CPoint point)
 {
 	CScrollView::OnLButtonDown(nFlags, point);
 
-		// find <y> such that of we are pointing to the middle of the line with 
-		//		location <loc> we will have <y == loc.y>
+		// find <y> such that if we are pointing to the middle of a line it 
+		//		is the top of the line, as <HitTest> expects
 	CPoint hit = point + GetDeviceScrollPosition();
 	int y = hit.y - (CharHeight / 2);
 
 	CCrosspointDoc* pDoc = GetDocument();
 	ASSERT_VALID(pDoc);
 
-	INT_PTR n = locs.GetSize();
-	if (n <= 0) return;	// if list of ports is invalid
-
-	PortLocation loc;
-	int i = 0;
-	while (i < n) {
-		loc = locs.GetAt(i);
-		if (loc.y >= y) break;
-		i += 1;
-	}
-
-		// now <i> is the index to <loc> which is the first line below <y>, 
-		//		unless <y> is below the last line in which case <loc> is the 
-		//		last line and <i == n>
-		// if pointing between two lines and nearer to the line above, select 
-		//		the line above, else select <loc>
-	if (i <= 0 || i >= n || (((sel_port = locs.GetAt(i-1)).y + 
-											loc.y) / 2) < y) sel_port = loc;
+	sel_port = HitTest(y);
+	if (sel_port.unit == NULL) return;	// if list of ports is invalid
 
-	if (sel_port.p.port < 0) {
+	if (sel_port.port < 0) {
 			// left clicking on a heading: select in the console window if 
 			//		maintenance
 		unless (theApp.privilege == PRIV_MAINTENANCE) return;
-		theApp.controller_doc->SetUnit(sel_port.p.unit);
+		theApp.controller_doc->SetUnit(sel_port.unit);
 		return;
 	}
 
 	class AnalyserDoc * a;
-	if (sel_port.p.unit->net_port_state.IsInList(sel_port.p.port)) {
+	if (sel_port.unit->net_port_state.IsInList(sel_port.port)) {
 			// left clicking on a "device" line (because it's a network port)
 		ASSERT(theApp.privilege == PRIV_MAINTENANCE);
-		a = theApp.FindScpServer(sel_port.p.unit, sel_port.p.port);
+		a = theApp.FindScpServer(sel_port.unit, sel_port.port);
 		if (a == NULL) return;
-		theApp.controller_doc->display_select = a->call_ref & 255;
+		theApp.controller_doc->display_select = a->scp_index;
 		theApp.controller_doc->BringToFront();
 		theApp.controller_doc->UpdateDisplay();
 		return;
@@ -619,56 +689,13 @@ void CCrosspointView::OnLButtonDown(UINT nFlags, CPoint point)
 	if (theApp.input_list->sel_port.unit == NULL) return;
 
 		// check privilege against CallId requirement & against port importance
-	if (theApp.privilege < PRIV_OPERATOR) return;
-	CString s2;
-	s2.Format("%d", sel_port.p.port);
-	MibObject * obj = sel_port.p.unit->GetObject("1.0.62379.2.1.1.1.1.6." + s2);
-	if (obj == NULL) obj = sel_port.p.unit->GetObject("1.0.62379.3.1.1.1.1.6." + s2);
-	if (obj == NULL || theApp.privilege <= (obj->IntegerValue() >> 6)) return;
+	unless (sel_port.unit->MayConnect(sel_port.port)) return;
 
 		// here if OK to begin by asking for a CallId; first remove any error 
 		//		messages from previous requests
 	theApp.err_msgs.RemoveAll();
-	ByteString msg;
-	msg.resize(14);
-
-	msg[0]  = 0;		// "Get" request
-	msg[2]  = 6;		// OID tag
-	msg[3]  = 10;		// length of OID
-	msg[4]  = 0x28;		// OID = 1.0.62379.5.1.1.3.2.0
-	msg[5]  = 0x83;
-	msg[6]  = 0xE7;
-	msg[7]  = 0x2B;
-	msg[8]  = 5;
-	msg[9]  = 1;
-	msg[10] = 1;
-	msg[11] = 3;
-	msg[12] = 2;
-	msg[13] = 0;
-
-	sel_port.p.unit->TxNewMessage(msg);
-	if (sel_port.p.unit == NULL) return;	// transmission must have failed
-
-		// add an entry to the list of pending connections
-	ConnReqInfo ci;
-	ci.dest_port = sel_port.p.port;
-	ci.m.push_back(msg);
-	ci.count = 0;
-
-	msg.clear();
-	msg.push_back(0);
-	ByteString& uta = theApp.input_list->sel_port.unit->unit_TAddress;
-	int k = (int)(uta.size());
-	msg.push_back((uint8_t)k);
-	i = 0;
-	while (i < k) msg.push_back(uta[i++]);
-	msg.push_back(9);
-	i = theApp.input_list->sel_port.port;
-	k = 24;						// always send 32 bits
-	do { msg.push_back(i >> k); k -= 8; } while (k >= 0);
-	ci.srce_addr = msg;
-
-	sel_port.p.unit->conn_pend.push_back(ci);
+	sel_port.unit->RequestConnection(sel_port.port, 
+			theApp.input_list->sel_port.unit, theApp.input_list->sel_port.port);
 }
 
 
@@ -676,41 +703,24 @@ void CCrosspointView::OnRButtonDown(UINT nFlags, CPoint point)
 {
 	CScrollView::OnRButtonDown(nFlags, point);
 
-		// find <y> such that of we are pointing to the middle of the line with 
-		//		location <loc> we will have <y == loc.y>
+		// find <y> such that if we are pointing to the middle of a line it 
+		//		is the top of the line, as <HitTest> expects
 	CPoint hit = point + GetDeviceScrollPosition();
 	int y = hit.y - (CharHeight / 2);
 
 	CCrosspointDoc* pDoc = GetDocument();
 	ASSERT_VALID(pDoc);
 
-	INT_PTR n = locs.GetSize();
-	if (n <= 0) return;	// if list of ports is invalid
-
-	PortLocation loc;
-	int i = 0;
-	while (i < n) {
-		loc = locs.GetAt(i);
-		if (loc.y >= y) break;
-		i += 1;
-	}
-
 	ByteString b;
-		// now <i> is the index to <loc> which is the first line below <y>, 
-		//		unless <y> is below the last line in which case <loc> is the 
-		//		last line and <i == n>
-		// if pointing between two lines and nearer to the line above, select 
-		//		the line above, else select <loc>
-	PortLocation sel_port;
-	if (i <= 0 || i >= n || (((sel_port = locs.GetAt(i-1)).y + 
-											loc.y) / 2) < y) sel_port = loc;
-	if (sel_port.p.unit == NULL) return;
-	if (sel_port.p.port < 0) {
+	int i;
+	PortIdent sel_port = HitTest(y);
+	if (sel_port.unit == NULL) return;
+	if (sel_port.port < 0) {
 			// right click on unit name:
 			// remove the unit if not connected 
-		unless (sel_port.p.unit->state == MGT_ST_ACTIVE) {
-			sel_port.p.unit->state = MGT_ST_CLOSED; // so won't send ClearDown
-			delete sel_port.p.unit;
+		unless (sel_port.unit->state == MGT_ST_ACTIVE) {
+			sel_port.unit->state = MGT_ST_CLOSED; // so won't send ClearDown
+			delete sel_port.unit;
 			if (theApp.privilege == PRIV_MAINTENANCE) 
 										theApp.controller_doc->UpdateDisplay();
 			return;
@@ -720,21 +730,21 @@ void CCrosspointView::OnRButtonDown(UINT nFlags, CPoint point)
 			//		setting the password) if maintenance level, "supply 
 			//		password" if any other level 
 		unless (theApp.privilege == PRIV_MAINTENANCE) {
-			if (sel_port.p.unit->password_state == PW_NOT_USED) return;
-			if (sel_port.p.unit->password_state == PW_REQUESTED) return;
-			sel_port.p.unit->GetPassword();
+			if (sel_port.unit->password_state == PW_NOT_USED) return;
+			if (sel_port.unit->password_state == PW_REQUESTED) return;
+			sel_port.unit->GetPassword();
 			return;
 		}
 
 			// here if maintenance privilege
 		CPcodeChange q; // created with <include_password> ticked, others not
 			// set existing product code and password
-		if (sel_port.p.unit->upd_state > 2 && 
-									sel_port.p.unit->upd_state != UPD_ST_FROM_ISE)
-				q.pcode.Format("%d-%d-%d-%d", sel_port.p.unit->product_code[0], 
-				sel_port.p.unit->product_code[1], sel_port.p.unit->product_code[2], 
-												sel_port.p.unit->product_code[3]);
-		if (sel_port.p.unit == theApp.link_partner) q.include_password = BST_UNCHECKED;
+		if (sel_port.unit->upd_state > 2 && 
+									sel_port.unit->upd_state != UPD_ST_FROM_ISE)
+				q.pcode.Format("%d-%d-%d-%d", sel_port.unit->product_code[0], 
+				sel_port.unit->product_code[1], sel_port.unit->product_code[2], 
+												sel_port.unit->product_code[3]);
+		if (sel_port.unit == theApp.link_partner) q.include_password = BST_UNCHECKED;
 
 			// do dialogue; repeat if new product code not well-formed
 		unsigned int pc[4]; // for the product code
@@ -756,8 +766,8 @@ void CCrosspointView::OnRButtonDown(UINT nFlags, CPoint point)
 				i = 4;
 				do {
 					i -= 1;
-					if (sel_port.p.unit->product_code[i] == pc[i]) continue;
-					sel_port.p.unit->product_code[i] = pc[i];
+					if (sel_port.unit->product_code[i] == pc[i]) continue;
+					sel_port.unit->product_code[i] = pc[i];
 					ch = true;
 				} while (i > 0);
 				break;
@@ -773,23 +783,23 @@ void CCrosspointView::OnRButtonDown(UINT nFlags, CPoint point)
 			// here with <q> holding the result having already updated the product code
 		if (ch) {
 				// product code has changed
-			sel_port.p.unit->sw_ver[0].Invalidate();
-			sel_port.p.unit->sw_ver[1].Invalidate();
-			sel_port.p.unit->upd_state = UPD_ST_HAVE_SW_VER;
+			sel_port.unit->sw_ver[0].Invalidate();
+			sel_port.unit->sw_ver[1].Invalidate();
+			sel_port.unit->upd_state = UPD_ST_HAVE_SW_VER;
 		}
 		if (ch || q.reset_update_state == BST_CHECKED) {
-			sel_port.p.unit->user_update_flags = -1;
+			sel_port.unit->user_update_flags = -1;
 			theApp.update_flags = -1;
 		}
 
 			// collect the password if required
 		if (q.change_password == BST_CHECKED) {
-			StringToPassword(q.pw, sel_port.p.unit->password_string);
-			sel_port.p.unit->password_state = PW_VALID;
+			StringToPassword(q.pw, sel_port.unit->password_string);
+			sel_port.unit->password_state = PW_VALID;
 		}
 				
 		if (q.include_password == BST_UNCHECKED) 
-								sel_port.p.unit->password_state = PW_CANCELLED;
+								sel_port.unit->password_state = PW_CANCELLED;
 
 		if (q.configure_tunnel == BST_CHECKED) {
 			if (q.remote_unit == 0) {
@@ -829,7 +839,7 @@ void CCrosspointView::OnRButtonDown(UINT nFlags, CPoint point)
 			b[14] = 11;
 			b[15] = q.local_port;
 			b[16] = ASN1_TAG_OCTET_STRING;
-			sel_port.p.unit->TxNewMessage(b);
+			sel_port.unit->TxNewMessage(b);
 		}
 
 		theApp.controller_doc->UpdateDisplay();
@@ -840,11 +850,11 @@ void CCrosspointView::OnRButtonDown(UINT nFlags, CPoint point)
 		// request disconnection by setting usState or udState (as appropriate) 
 		//		to terminating (3)
 	CString s;
-	s.Format("%d", sel_port.p.port);
+	s.Format("%d", sel_port.port);
 	if (pDoc->inputs) {
-		if (!sel_port.p.unit->input_flows.Lookup(s, s)) return;
+		if (!sel_port.unit->input_flows.Lookup(s, s)) return;
 	}
-	else if (!sel_port.p.unit->output_flows.Lookup(s, s)) return;
+	else if (!sel_port.unit->output_flows.Lookup(s, s)) return;
 
 		// in each case, <s> is the "index" part of the OID
 		// first remove any error messages from previous requests
@@ -893,47 +903,30 @@ void CCrosspointView::OnRButtonDown(UINT nFlags, CPoint point)
 	b.push_back(ASN1_TAG_INTEGER);
 	b.push_back(1);
 	b.push_back(3);
-	sel_port.p.unit->TxNewMessage(b);
+	sel_port.unit->TxNewMessage(b);
 }
 
 void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 {
 	CScrollView::OnLButtonDblClk(nFlags, point);
 
-		// find <y> such that of we are pointing to the middle of the line with 
-		//		location <loc> we will have <y == loc.y>
+		// find <y> such that if we are pointing to the middle of a line it 
+		//		is the top of the line, as <HitTest> expects
 	CPoint hit = point + GetDeviceScrollPosition();
 	int y = hit.y - (CharHeight / 2);
 
 	CCrosspointDoc* pDoc = GetDocument();
 	ASSERT_VALID(pDoc);
 
-	INT_PTR n = locs.GetSize();
-	if (n <= 0) return;	// if list of ports is invalid
-
-	PortLocation loc;
-	int i = 0;
-	do {
-		loc = locs.GetAt(i);
-		if (loc.y >= y) break;
-		i += 1;
-	} while (i < n);
-
-		// now <i> is the index to <loc> which is the first line below <y>, 
-		//		unless <y> is below the last line in which case <loc> is the 
-		//		last line and <i == n>
-		// if pointing between two lines and nearer to the line above, select 
-		//		the line above, else select <loc>
-	PortLocation sel_port;
-	if (i <= 0 || i >= n || (((sel_port = locs.GetAt(i-1)).y + 
-											loc.y) / 2) < y) sel_port = loc;
-	if (sel_port.p.unit == NULL) return;
+	int i;
+	PortIdent sel_port = HitTest(y);
+	if (sel_port.unit == NULL) return;
 
 	ByteString msg;
 	CString new_name;
 	bool set_name = false;
 	CString location;
-	if (sel_port.p.port < 0) {
+	if (sel_port.port < 0) {
 			// double click on unit name
 		msg.resize(46);
 		msg[0]  = 0x40;	// "non-volatile Set" request
@@ -953,9 +946,9 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 		bool set_location = false;
 		if (theApp.privilege == PRIV_MAINTENANCE) {
 			CSetUnitPasswords qp;
-			qp.caption = sel_port.p.unit->DisplayName();
+			qp.caption = sel_port.unit->DisplayName();
 			qp.name = qp.caption;
-			location = sel_port.p.unit->GetStringObject("1.0.62379.1.1.1.2.0");
+			location = sel_port.unit->GetStringObject("1.0.62379.1.1.1.2.0");
 			qp.location = location;
 			i = qp.DoModal();
 			unless (i == IDOK) {
@@ -978,24 +971,24 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 					// set operator password
 				StringToPassword(qp.operator_password, pw);
 				BytesFrom64Bit(pw, msg.data() + 14);
-				sel_port.p.unit->TxNewMessage(msg);
-				if (sel_port.p.unit == NULL) return; // tx must have failed
+				sel_port.unit->TxNewMessage(msg);
+				if (sel_port.unit == NULL) return; // tx must have failed
 			}
 			if (qp.reset_svr == BST_CHECKED) {
 					// set supervisor password
 				msg[11] = 18;
 				StringToPassword(qp.supervisor_password, pw);
 				BytesFrom64Bit(pw, msg.data() + 14);
-				sel_port.p.unit->TxNewMessage(msg);
-				if (sel_port.p.unit == NULL) return; // tx must have failed
+				sel_port.unit->TxNewMessage(msg);
+				if (sel_port.unit == NULL) return; // tx must have failed
 			}
 			if (qp.reset_maint == BST_CHECKED) {
 					// set maintenance password
 				msg[11] = 19;
 				StringToPassword(qp.maintenance_password, pw);
 				BytesFrom64Bit(pw, msg.data() + 14);
-				sel_port.p.unit->TxNewMessage(msg);
-				if (sel_port.p.unit == NULL) return; // tx must have failed
+				sel_port.unit->TxNewMessage(msg);
+				if (sel_port.unit == NULL) return; // tx must have failed
 			}
 
 				// now collect the name and location in the same way as for the 
@@ -1012,9 +1005,9 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 		else {
 				// levels below maintenance
 			CSetUnitName qn;
-			qn.caption = sel_port.p.unit->DisplayName();
+			qn.caption = sel_port.unit->DisplayName();
 			qn.name = qn.caption;
-			location = sel_port.p.unit->GetStringObject("1.0.62379.1.1.1.2.0");
+			location = sel_port.unit->GetStringObject("1.0.62379.1.1.1.2.0");
 			qn.location = location;
 			i = qn.DoModal();
 			unless (i == IDOK) {
@@ -1056,8 +1049,8 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 			}
 			msg.resize(y + i);
 			memcpy(msg.data() + y, new_name.GetBuffer(), i);
-			sel_port.p.unit->TxNewMessage(msg);
-			if (sel_port.p.unit == NULL) return; // tx must have failed
+			sel_port.unit->TxNewMessage(msg);
+			if (sel_port.unit == NULL) return; // tx must have failed
 		}
 
 		if (set_location) {
@@ -1085,7 +1078,7 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 			}
 			msg.resize(y + i);
 			memcpy(msg.data() + y, location.GetBuffer(), i);
-			sel_port.p.unit->TxNewMessage(msg);
+			sel_port.unit->TxNewMessage(msg);
 		}
 		theApp.controller_doc->UpdateDisplay();
 		return;
@@ -1093,14 +1086,14 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 
 		// here for a double click on a port
 		// find its current name etc
-	location.Format("%d", loc.p.port);	// port number on the unit
+	location.Format("%d", sel_port.port);	// port number on the unit
 		// we assume the objects reported in the status broadcast always 
 		//		include a name
-	new_name = sel_port.p.unit->GetStringObject("1.0.62379.2.1.1.1.1.5." + 
+	new_name = sel_port.unit->GetStringObject("1.0.62379.2.1.1.1.1.5." + 
 														location); // aPortName
 	bool video = new_name.IsEmpty();
 	if (video) {
-		new_name = sel_port.p.unit->GetStringObject("1.0.62379.3.1.1.1.1.5." + 
+		new_name = sel_port.unit->GetStringObject("1.0.62379.3.1.1.1.1.5." + 
 														location); // vPortName
 		if (new_name.IsEmpty())  return;	// must be a SCP debug port
 	}
@@ -1119,14 +1112,14 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 	msg[11] = 1;
 	msg[12] = 1;
 	msg[13] = 6;
-	msg[14] = loc.p.port;	// +++ NB assumes port number < 128
+	msg[14] = sel_port.port;	// +++ NB assumes port number < 128
 	msg[15] = 2;	// INTEGER tag
 	msg[16] = 1;	// length
 
 	if (pDoc->inputs) {
 			// just set the name
 		CSetPortName qn;
-		qn.caption = sel_port.p.unit->DisplayName() + " port " + location;
+		qn.caption = sel_port.unit->DisplayName() + " port " + location;
 		qn.name = new_name;
 		i = qn.DoModal();
 		if (i != IDOK || qn.name == new_name) {
@@ -1139,10 +1132,10 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 	else {
 			// also set importance
 		CSetPortNameEtc qn;
-		qn.caption = sel_port.p.unit->DisplayName() + " port " + location;
+		qn.caption = sel_port.unit->DisplayName() + " port " + location;
 		qn.name = new_name;
 		CString s = video ? "1.0.62379.3" : "1.0.62379.2";
-		int importance = sel_port.p.unit->GetIntegerObject(s + ".1.1.1.1.6." + location);
+		int importance = sel_port.unit->GetIntegerObject(s + ".1.1.1.1.6." + location);
 		qn.importance = importance;
 		i = qn.DoModal();
 		if (i != IDOK) {
@@ -1165,8 +1158,8 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 				msg[17] = 0;
 				msg[18] = qn.importance;
 			}
-			sel_port.p.unit->TxNewMessage(msg);
-			if (sel_port.p.unit == NULL) return; // tx must have failed
+			sel_port.unit->TxNewMessage(msg);
+			if (sel_port.unit == NULL) return; // tx must have failed
 		}
 		if (qn.name != new_name) {
 			new_name = qn.name;
@@ -1202,7 +1195,7 @@ void CCrosspointView::OnLButtonDblClk(UINT nFlags, CPoint point)
 			return;
 		}
 		memcpy(msg.data() + y, new_name.GetBuffer(), i);
-		sel_port.p.unit->TxNewMessage(msg);
-		if (sel_port.p.unit == NULL) return; // tx must have failed
+		sel_port.unit->TxNewMessage(msg);
+		if (sel_port.unit == NULL) return; // tx must have failed
 	}
 }
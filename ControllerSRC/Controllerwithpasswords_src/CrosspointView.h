@@ -1,10 +1,6 @@
 #pragma once
 #include "CrosspointDoc.h"
-
-
-struct PortLocation {
-	PortIdent p;	// <p.port> is -ve for the header line with the unit's name
-	int y; };		// y value before line describing port is output
+#include "../common/crosspoint_model.h"
 
 
 // CCrosspointView view
@@ -28,12 +24,19 @@ public:
 	int CharHeight;				// height of 1 line
 	CFont * text_font;			// for initialisation of the font
 
-	CArray<PortLocation, PortLocation> locs;	// entry for each port
-	PortLocation sel_port;		// unit last clicked on; <unit == NULL> if none
+	CrosspointModel model;		// the lines, with a block for each unit
+	PortIdent sel_port;			// unit last clicked on; <unit == NULL> if none
 	void RemoveFromLocs(MgtSocket * u);	// call if <u> being deleted
+		// the unit or port <y> is pointing to (<port> -ve for the header 
+		//		line); <unit> is NULL if none
+	PortIdent HitTest(int y);
+		// repaint the lines for the units in <d>
+	void MibChanged(const std::vector<MibDelta>& d);
 
 protected:
 	virtual void OnDraw(CDC* pDC);      // overridden to draw this view
+		// format the lines for unit <m> into <rows>
+	void BuildUnitRows(MgtSocket * m, std::vector<XptRow>& rows);
 	virtual void OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint);
 
 	DECLARE_MESSAGE_MAP()
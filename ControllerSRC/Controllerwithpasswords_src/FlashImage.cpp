@@ -0,0 +1,149 @@
+// FlashImage.cpp : implementation of ImageCache and FlashImage
+// Copyright (c) 2024 Nine Tiles
+
+#include "stdafx.h"
+#include "FlashImage.h"
+
+
+ImageCache::~ImageCache()
+{
+	std::map<CString, MappedImage>::iterator p = files.begin();
+	for (; p != files.end(); p++) {
+		UnmapViewOfFile(p->second.base);
+		CloseHandle(p->second.mapping);
+		CloseHandle(p->second.file);
+	}
+}
+
+
+const MappedImage * ImageCache::Find(const CString& fn, int i, bool& bad)
+{
+	bad = false;
+	std::map<CString, MappedImage>::iterator p = files.find(fn);
+	if (p != files.end()) return &p->second;
+
+	MappedImage m;
+	LARGE_INTEGER size;
+	m.file = CreateFile(fn, GENERIC_READ, FILE_SHARE_READ, NULL,
+								OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m.file == INVALID_HANDLE_VALUE) return NULL;
+
+		// a file that is empty can't be mapped, and one that doesn't fit in
+		//		an int is certainly not an image
+	bad = true;
+	unless (GetFileSizeEx(m.file, &size) && size.QuadPart > 0 &&
+										size.QuadPart < INT_MAX) {
+		CloseHandle(m.file);
+		return NULL;
+	}
+
+	m.mapping = CreateFileMapping(m.file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m.mapping == NULL) {
+		CloseHandle(m.file);
+		return NULL;
+	}
+	m.base = (const uint8_t *)MapViewOfFile(m.mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m.base == NULL) goto fail;
+
+	if (i == 0 ? LocateVmData(m, (int)size.QuadPart) :
+							LocateLogicData(m, (int)size.QuadPart)) {
+		bad = false;
+		return &(files[fn] = m);
+	}
+
+	UnmapViewOfFile(m.base);
+fail:
+	CloseHandle(m.mapping);
+	CloseHandle(m.file);
+	return NULL;
+}
+
+
+// the VM code is in the format the compiler outputs: two lines of text, each
+//		ending with a carriage return, followed by the data
+// +++ we've checked the extension and assume it's the format the compiler
+//		outputs; I think it does actually conform to the 62379-1 format, but
+//		we ought to check the header
+// +++ ought to read the length and check it corresponds to the length of
+//		the data; also ought to check the checksum
+bool ImageCache::LocateVmData(MappedImage& m, int k)
+{
+	const uint8_t * b = m.base;
+	int i = 0;
+	while (i < k && b[i] != 0x0D) i += 1;
+	int j = i + 1;
+	while (j < k && b[j] != 0x0D) j += 1;
+	if (j >= k) return false;	// haven't found the two carriage returns
+
+	m.data = b + j + 1;
+	m.length = k - (j + 1);
+	return m.length > 0;
+}
+
+
+// the FPGA logic is a Xilinx .bit file
+// +++ we checked the extension earlier, so can assume this is a Xilinx .bit
+//		file and not the format specified in 62379-1; we also assume it was
+//		generated for SPI wifth 4 and includes the MultiBoot stub (the latter
+//		selected by the "place MultiBoot settings into bit stream" option);
+//		the loader code implements the functionality of the stub, so we
+//		locate the data by the second sync word
+// the data starts 20 bytes before the byte after the second sync word; the
+//		unit-specific header is written over the first 16 of those bytes
+bool ImageCache::LocateLogicData(MappedImage& m, int k)
+{
+	if (k < 4096) return false;
+
+	const uint8_t * b = m.base;
+	uint8_t byte;
+	int i = 0;	// offset in data
+	int j = 0;	// number of sync word bytes we've seen so far
+	do {
+		byte = b[i++];
+		switch (j & 3) {
+case 0:		if (byte == 0xAA) j += 1;
+			break;
+
+case 1:		if (byte == 0x99) j += 1; else j &= ~3;
+			break;
+
+case 2:		if (byte == 0x55) j += 1; else j &= ~3;
+			break;
+
+case 3:		if (byte == 0x66) j += 1; else j &= ~3;
+		}
+	} until (j >= 8 || i >= 4096);
+	if (j < 8) return false;
+
+	m.data = b + i - 20;
+	m.length = k - (i - 20);
+	return true;
+}
+
+
+void FlashImage::Copy(uint8_t * p, int offset, int n) const
+{
+	int k = (int)overlay.size() - offset;	// bytes to take from <overlay>
+	if (k > 0) {
+		if (k > n) k = n;
+		memcpy(p, overlay.data() + offset, k);
+		p += k;
+		offset += k;
+		n -= k;
+	}
+	if (n > 0) memcpy(p, file->data + offset, n);
+}
+
+
+bool FlashImage::Equals(const uint8_t * p, int offset, int n) const
+{
+	int k = (int)overlay.size() - offset;
+	if (k > 0) {
+		if (k > n) k = n;
+		if (memcmp(p, overlay.data() + offset, k) != 0) return false;
+		p += k;
+		offset += k;
+		n -= k;
+	}
+	return n <= 0 || memcmp(p, file->data + offset, n) == 0;
+}
@@ -0,0 +1,69 @@
+// FlashImage.h : software images to be written to units' flash
+// Copyright (c) 2024 Nine Tiles
+
+// Each file named in a product file is mapped into memory the first time a
+//		unit needs it, and the part that is written to flash is located then;
+//		after that, every unit that needs the same file uses the same mapping,
+//		so updating many identical units doesn't read or copy the file again
+// The only part of an image that differs between units is the header at
+//		the start of the FPGA logic (see MgtSocket::OnIdle); this is held in
+//		each unit's <FlashImage> and replaces the first few bytes of the data
+//		as it is sent
+
+#pragma once
+#include "../common/string_extras.h"
+#include <map>
+
+
+// a file mapped into memory, and where the data for the flash is in it
+// <data> is NULL if the file has not been mapped
+struct MappedImage {
+	HANDLE file;
+	HANDLE mapping;
+	const uint8_t * base;	// start of the file
+	const uint8_t * data;	// start of the data for the flash
+	int length;				// number of bytes of data
+};
+
+
+// the files that have been mapped, indexed by filename; the filename
+//		includes the version number (see MgtSocket::OnIdle) so there is no
+//		need to include the version in the key
+// +++ the files stay open (and so can't be replaced) until the Controller
+//		exits
+class ImageCache
+{
+public:
+	~ImageCache();
+
+		// the image in file <fn>, which is of kind <i> (index as for
+		//		<MgtSocket::vl_type>, i.e. 0 for VM code, 1 for FPGA logic);
+		//		NULL if it couldn't be opened (<bad> false) or isn't in the
+		//		expected format (<bad> true)
+		// failures are not remembered, so the file is tried again next time
+	const MappedImage * Find(const CString& fn, int i, bool& bad);
+
+private:
+	std::map<CString, MappedImage> files;
+		// set <m.data> and <m.length> for a VM code or FPGA logic file;
+		//		return whether found
+	static bool LocateVmData(MappedImage& m, int k);
+	static bool LocateLogicData(MappedImage& m, int k);
+};
+
+
+// an image as it is written to one unit's flash: the data from a
+//		<MappedImage>, with the first <overlay.size()> bytes replaced by
+//		<overlay>
+struct FlashImage {
+	const MappedImage * file;	// NULL if none
+	ByteString overlay;
+
+	FlashImage() { file = NULL; }
+	void Clear() { file = NULL; overlay.clear(); }
+	int size() const { return file == NULL ? 0 : file->length; }
+		// copy <n> bytes starting at <offset> to <p>
+	void Copy(uint8_t * p, int offset, int n) const;
+		// whether the <n> bytes at <p> are the same as those at <offset>
+	bool Equals(const uint8_t * p, int offset, int n) const;
+};
@@ -37,7 +37,6 @@ static UINT indicators[] =
 
 CMainFrame::CMainFrame()
 {
-	retry_count = -1;
 }
 
 CMainFrame::~CMainFrame()
@@ -144,84 +143,47 @@ void CMainFrame::OnDestroy()
 }
 
 
-// timer tick
+// timer tick: see <CControllerApp::timers>
 void CMainFrame::OnTimer(UINT nIDEvent) 
 {
-	if (nIDEvent == IDT_500MSEC) {
-			// tell each of the <MgtSocket> objects
-		int i = (int)theApp.units.GetCount();
-		MgtSocket * m;
-		while (--i > 0) {
-			m = theApp.units.GetAt(i);
-				// sanity check on <m> includes look for 0xFEEEFEEE
-			if (m && m->state > 0) m->PollAwaitingAck();
-		}
-
-			// tell the <LinkSocket> object; if the link has timed out we retry 
-			//		immediately
-		if (theApp.link_socket->PollKeepalives()) retry_count = 0;
-
-			// <retry_count> is -ve during normal operation; on failure we set it +ve 
-			//		and count down and retry when it goes back to -ve; we also set it 
-			//		+ve on entry to Requesting state
-			// retrying includes deleting the old socket and creating a new one; note 
-			//		that we need to keep <theApp.link_socket> valid and non-NULL any 
-			//		time a management socket might need it
-		if (retry_count < 0) {
-			if (theApp.link_socket->state > LINK_ST_MAX_OK) {
-					// has just failed: wait 5 sec before retry if sockets stack 
-					//		failure, 1 sec else
-				retry_count = (theApp.link_socket->state == LINK_ST_FAILED) ? 10 : 2;
-			}
-			else if (theApp.link_socket->state == LINK_ST_REQ) {
-					// have just sent the first Link Request: wait 7 sec before give 
-					//		up & retry
-				retry_count = 14;
-			}
-
-			goto done;
-		}
-
-		if (theApp.link_socket->state == LINK_ST_ACTIVE) {
-			retry_count = -1;
-			goto done;
-		}
-
-		retry_count -= 1;
-		if (retry_count >= 0) goto done;
-
-			// here on timeout, to replace the link socket
-		LinkSocket * skt = new LinkSocket();
-
-			// +++ NOTE: calling skt->Bind(0) after Create fails with WSAEINVAL 
-			//		("invalid argument was supplied") in the assembly-code 
-			//		part, but Create seems to call Bind(0) anyway; also, doing 
-			//		Connect at this point seems to stop the broadcast being sent
-		int err; // to hold result of GetLastError() for debug
-		unless (skt && skt->Create(0, SOCK_DGRAM, FD_READ | FD_CLOSE)) {
-			err = GetLastError(); // for debug
-			delete skt;
-				// +++ ought really to make the action depend on whether <err> seems 
-				//		to be transient or permanent
-			retry_count = 20;	// wait 10 secs then try again
-			goto done;		// keeping the old socket
-		}
-
-			// the king is dead; long live the king
-		delete theApp.link_socket;
-		theApp.link_socket = skt;
-
-			// now send the Link Request; we don't care whether it succeeded because 
-			//		either way we'll want a timeout
-			// +++ might think about having different timeouts for failure to send 
-			//		the reply and waiting for a response to it, though
-		skt->Init();
-		retry_count = 14;
-
-		theApp.mib_changed = true;
-		theApp.controller_doc->UpdateAllViews(NULL);
+	if (nIDEvent == IDT_TIMERS) theApp.RunTimers();
+	CMDIFrameWnd::OnTimer(nIDEvent);
+}
+
+
+// called when TMR_LINK_RETRY expires, which is set when the link fails (see 
+//		<LinkSocket::Failed>) and when a Link Request is sent
+// retrying includes deleting the old socket and creating a new one; note 
+//		that we need to keep <theApp.link_socket> valid and non-NULL any 
+//		time a management socket might need it
+void CMainFrame::RestartLink()
+{
+	if (theApp.link_socket->state == LINK_ST_ACTIVE) return;
+
+	LinkSocket * skt = new LinkSocket();
+
+		// +++ NOTE: calling skt->Bind(0) after Create fails with WSAEINVAL 
+		//		("invalid argument was supplied") in the assembly-code 
+		//		part, but Create seems to call Bind(0) anyway; also, doing 
+		//		Connect at this point seems to stop the broadcast being sent
+	int err; // to hold result of GetLastError() for debug
+	unless (skt && skt->Create(0, SOCK_DGRAM, FD_READ | FD_CLOSE)) {
+		err = GetLastError(); // for debug
+		delete skt;
+			// +++ ought really to make the action depend on whether <err> seems 
+			//		to be transient or permanent
+		theApp.StartTimer(NULL, TMR_LINK_RETRY, LINK_RETRY_CREATE);
+		return;		// keeping the old socket
 	}
 
-done:
-	CMDIFrameWnd::OnTimer(nIDEvent);
+		// the king is dead; long live the king
+	delete theApp.link_socket;
+	theApp.link_socket = skt;
+
+		// now send the Link Request, which sets the timer for giving up 
+		//		waiting for a response to it
+	skt->Init();
+
+	theApp.mib_bus.Publish(NULL, MIB_BIT_UNIT_STATE);
+	theApp.controller_doc->UpdateAllViews(NULL);
 }
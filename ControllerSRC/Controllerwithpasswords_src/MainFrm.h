@@ -27,7 +27,8 @@ public:
 	virtual void Dump(CDumpContext& dc) const;
 #endif
 
-	int retry_count;	// controls re-attempting connection in <OnTimer>
+		// replace the link socket if the link isn't up
+	void RestartLink();
 
 protected:  // control bar embedded members
 	CStatusBar  m_wndStatusBar;
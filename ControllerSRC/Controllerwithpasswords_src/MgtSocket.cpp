@@ -13,79 +13,9 @@
 
 
 
-// return the length of the tag + length fields and of the value, given <b> 
-//		pointing to the tag; there are <len> bytes available in the message
-ValueSizes ParseLength(uint8_t * b, int len)
-{
-	ValueSizes v;
-	if (len < 2) goto error;
-	v.len = b[1];
-	if (v.len < 0x80) {
-			// "length" field is the 7-bit form
-		if (len < v.len + 2) goto error;
-		v.hd_len = 2;	// length of tag + length
-		return v;
-	}
-
-	switch (v.len) {
-			// the only others we support are the 8-bit and 16-bit forms
-case 0x81:
-		if (len < 3) break;
-		v.len = b[2];
-		if (len < v.len + 3) goto error;
-		v.hd_len = 3;
-		return v;
-
-case 0x82:
-		if (len < 4) break;
-		v.len = (b[2] << 8) | b[3];
-		if (len < v.len + 4) goto error;
-		v.hd_len = 4;
-		return v;
-	}
-
-error:	// here if can't parse
-	v.hd_len = -1;
-	v.len = -1;
-	return v;
-}
-
-
 // ------------------------ class MibObject
 
-MibObject::MibObject() {
-	tag = TAG_INVALID;
-		// added so the compiler (which doesn't understand "valid only if 
-		//		<tag> is ASN1_TAG_INTEGER") won't whinge
-	value = 0;
-	recd = 0;
-	msg_type = 0;
-}
-
-
-// initialise by reading a VarBind from the buffer described by <p> and <len>, 
-//		which are skipped over it
-// sets <tag = TAG_INVALID> if any error: if failed to read the OID all arrays 
-//		are empty and <b> and <len> unchanged; else they are skipped over the 
-//		OID, which is in <oid_ber>, and <oid> is empty if the OID is invalid, 
-//		valid if the error was in the value.
-MibObject::MibObject(uint8_t * &p, int &len) {
-		// get OID as if it was the value, transfer it to the OID, then 
-		//		get the value
-	if (!GetAsn1Value(p, len)) {
-		tag = TAG_INVALID;
-		return;
-	}
-	oid_ber = *this;
-	oid = ConvertOid();
-	clear();
-	if (oid.IsEmpty() || !GetAsn1Value(p, len)) tag = TAG_INVALID;
-}
-
-
-MibObject::~MibObject() {
-}
-
+// the members that use MFC types; the others are in ../Common/mib_store.cpp
 
 // return value of octet-string object as a character string
 // result is a null string if <this> is NULL or tag not OCTET STRING
@@ -146,113 +76,6 @@ void MibObject::CopyOctetStringValue(CByteArray& b)
 }
 
 
-// return value of octet-string object as a character string
-// result is a null string if <this> is NULL or tag not OCTET STRING
-std::string MibObject::StdStringValue()// const
-{
-	std::string s;	// initially empty
-	if (this == NULL || tag != ASN1_TAG_OCTET_STRING) return s;
-
-	int n = GetCount();
-	int i = 0;
-	while (i < n) { s += (char)at(i); i += 1; }
-	return s;
-}
-
-
-// return value of octet-string object in hex
-// result is a null string if <this> is NULL or tag not OCTET STRING
-// if <group_size > 0>, a space is inserted after every <group_size> bytes 
-//		except at the end of the string; else no spaces inserted
-std::string MibObject::StdStringHex(int group_size)// const
-{
-	std::string s;	// initially empty
-	if (this == NULL || tag != ASN1_TAG_OCTET_STRING) return s;
-
-	int i = 0;	// counts bytes
-	int j = 0;	// counts bytes modulo <group_size>
-	int n = (int)GetCount();
-	if (n <= 0) return s;
-	while (true) {
-		unsigned int b = at(i);
-		s += ToHex(b, 2);
-		i += 1;
-		if (i >= n) return s;
-		j += 1;
-		if (j != group_size) continue;
-		s += ' ';
-		j = 0;
-	}
-}
-
-
-// return value of object as text
-std::string MibObject::TextValue()// const
-{
-	switch (tag) {
-case ASN1_TAG_INTEGER:
-		return "INT: " + ToDecimal(value);
-
-case ASN1_TAG_OCTET_STRING:
-		return "STR: " + StdStringHex(1);
-
-case ASN1_TAG_OID:
-		return "OID: " + OidToText(*this);
-	}
-
-		// here if tag not recognised
-	return "TAG " + ToHex(tag, 2) + ": " +  StdStringHex(1);
-}
-
-
-
-// set <tag> and the byte array from an ASN.1 value in a message
-// <p> points to the tag, <len> is the number of bytes left in the message
-// updates <p> and <len> (to skip over the object) and returns <true> if OK, 
-//		else returns <false> without changing anything
-// if the tag is ASN1_TAG_INTEGER, and the length is in the range 1 to 4 
-//		inclusive, we set <value> accordingly; if the length is out of range 
-//		we set <tag> to TAG_INTEGER_OUT_OF_RANGE
-// does not read beyond <p[len-1]> in case that would cause a protection fault
-bool MibObject::GetAsn1Value(uint8_t * &p, int &len)
-{
-	ValueSizes sz = ParseLength(p, len);
-	if (sz.hd_len < 0) return false;
-
-	uint8_t * b = p;
-	tag = b[0];
-	b += sz.hd_len;
-	resize(sz.len);
-	int i = 0;
-	while (i < sz.len) { at(i) = b[i]; i += 1; }
-
-	if (tag == ASN1_TAG_INTEGER) switch (sz.len) {
-case 1:
-		value = (char)(b[0]); // cast to signed so will sign extend
-		break;
-
-case 2:
-		value = ((char)(b[0]) << 8) | b[1];
-		break;
-
-case 3:
-		value = ((char)(b[0]) << 16) | (b[1] << 8) | b[2];
-		break;
-
-case 4:
-		value = (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
-		break;
-
-default:
-		tag = TAG_INTEGER_OUT_OF_RANGE;
-	}
-
-	p = b + sz.len;
-	len -= (sz.hd_len + sz.len);
-	return true;
-}
-
-
 // return the value in dotted-decimal form if <tag> is ASN1_TAG_OID, the 
 //		byte array is nonempty, and the first and last bytes have their top 
 //		bits clear; else return an empty string
@@ -324,85 +147,6 @@ case ASN1_TAG_OCTET_STRING:
 }
 */
 
-// append the value to <b> in the format for an index in an OID; returns 
-//		<true> if OK, <false> with <b> unchanged else
-// currently only copes with octet strings and positive 32-bit integers
-bool MibObject::AppendAsIndexTo(ByteString & b) {
-	int i, n;
-	uint8_t v;
-	switch (tag) {
-case ASN1_TAG_INTEGER:
-		i = IntegerValue();
-		if (i < 0) return false;
-			// set <n> to 7 * ((bytes to add) - 1)
-		n = 0;
-		while (i >= (128 << n) && n < 28) n += 7;
-		while (n > 0) { b.push_back((i >> n) | 0x80); n -= 7; }
-		b.push_back(i & 0x7F);
-		return true;
-
-case ASN1_TAG_OCTET_STRING:
-		n = (int)size();
-		if (n > 0x3FF) return false; // length is silly
-		if (n > 0x7F) b.push_back((n >> 7) | 0x80);
-		b.push_back(n & 0x7F);
-		i = 0;
-		while (i < n) {
-			v = at(i);
-			if (v & 0x80) b.push_back(0x81);
-			b.push_back(v & 0x7F);
-			i += 1;
-		}
-		return true;
-	}
-
-	return false;
-}
-
-
-// copy the OID into a message (including tag and length)
-// length uses the shortest form it can
-// assumes there is enough room (and that the length is less than 64KB)
-// returns the number of bytes written
-int MibObject::CopyOid(uint8_t * p)
-{
-	*p++ = ASN1_TAG_OID;
-	int n = (int)oid_ber.size();
-	int len = n + 2;
-	if (n < 128) *p++ = (uint8_t)n;
-	else if (n < 256) { *p++ = 0x81; *p++ = (uint8_t)n; len += 1; }
-	else { *p++ = 0x82; *p++ = (uint8_t)(n >> 8); *p++ = (uint8_t)n; len += 2; }
-
-	int i = 0;
-	while (i < n) *p++ = oid_ber.at(i++);
-	return len;
-}
-
-
-// return whether <m> and <this> have different values
-// if <this->oid> indicates unitUpTime, we compare the implied reset times, 
-//		not the values
-bool MibObject::ChangedFrom(MibObject * m) {
-	if (m->tag != tag) return true;
-
-	if (tag == ASN1_TAG_INTEGER) {
-		if (oid != "1.0.62379.1.1.1.9") return m->value != value;
-
-			// else is unitUpTime; compare the implied reset times
-			// we allow up to 2 secs for rounding errors etc; this means if a 
-			//		unit is reset twice within about 2 secs we only see one 
-			//		of the resets, but it's unlikely we'll have got far with 
-			//		collecting MIB etc information between the two anyway
-		return _abs64(recd + value - (m->recd + m->value)) > 2;
-	}
-
-	int n = m->GetCount();
-	if (n != GetCount()) return true;
-	int i = 0;
-	while (i < n) { if (m->at(i) != at(i)) return true; i += 1; }
-	return false;
-}
-
 
 
 // --------------------------- class VersionNumber
@@ -572,13 +316,14 @@ LinkSocket::LinkSocket()
 	standard_format = false;
 	memset(our_ident, 0, 8);
 	state = LINK_ST_BEGIN;
-	rcv_timer_count = LINK_RCV_TIMEOUT;
-	tx_timer_count = 1;
+	theApp.StartTimer(this, TMR_LINK_RX, LINK_RCV_TIMEOUT_MS);
+	theApp.StartTimer(this, TMR_LINK_TX, LINK_KEEPALIVE_MS);
 }
 
 
 LinkSocket::~LinkSocket()
 {
+	theApp.timers.CancelAll(this);
 	if (!link_ip_addr.IsEmpty()) {
 			// send a Link Reject message
 		ByteString m(aes51_data_hdr);
@@ -612,7 +357,7 @@ BOOL LinkSocket::Init()
 			theApp.controller_doc->failure_notice += ToDecimal(err).c_str();
 			theApp.controller_doc->failure_notice += ' ';
 			theApp.controller_doc->failure_notice += strerror(err);
-			state = LINK_ST_FAILED;
+			Failed(LINK_ST_FAILED);
 			return FALSE;
 		}
 	}
@@ -634,44 +379,49 @@ BOOL LinkSocket::Init()
 		theApp.controller_doc->failure_notice += ToDecimal(err).c_str();
 		theApp.controller_doc->failure_notice += ' ';
 		theApp.controller_doc->failure_notice += strerror(err);
-		state = LINK_ST_FAILED;
+		Failed(LINK_ST_FAILED);
 		return FALSE;
 	}
 
 	state = LINK_ST_REQ;
+	theApp.StartTimer(NULL, TMR_LINK_RETRY, LINK_ACCEPT_TIMEOUT);
 	return TRUE;
 }
 
 
+void LinkSocket::Failed(int st)
+{
+	state = st;
+	theApp.StartTimer(NULL, TMR_LINK_RETRY, 
+					(st == LINK_ST_FAILED) ? LINK_RETRY_FAILED : LINK_RETRY_WAIT);
+}
+
+
 // send message from <b>, total size <len>, with flow label (including 
 //		CRC) <flow>
 // if <flow> is all-zero or omitted, <tx_sig_flow> is used
-// adds the AES51 header and IT header into the front of a copy
+// builds the AES51 header and IT header in <tx_buf> and copies the message 
+//		in after them, so no allocation is needed
 // returns whether the message was sucessfully sent
 bool LinkSocket::TxMessage(uint8_t * b, int len, int flow) {
-	if (state != LINK_ST_ACTIVE || flow < 0) {
+	if (state != LINK_ST_ACTIVE || flow < 0 || 
+							len > LINK_DATAGRAM_SIZE - LINK_HDR_LEN) {
 		return false;
 	}
-	ByteString msg(aes51_data_hdr);
-	if (flow) {
-		msg[8] = (uint8_t)(flow >> 8);
-		msg[9] = (uint8_t)flow;
-	}
-	flow = AddHec(len + (standard_format ? -1 : 3));	// packet length
-	msg[6] = (uint8_t)(flow >> 8);
-	msg[7] = (uint8_t)flow;
-	msg.resize(len + 10);
-	uint8_t * b2 = msg.data(); // NB after resizing in case it moves
-	memcpy(b2 + 10, b, len);
-	len += 10;
-	if (Send(b2, len) == len) return true;
+	unless (flow) flow = (aes51_data_hdr[8] << 8) | aes51_data_hdr[9];
+	BuildItHeader(tx_buf.b, len, flow, standard_format);
+	memcpy(tx_buf.b + LINK_HDR_LEN, b, len);
+	len += LINK_HDR_LEN;
+	if (Send(tx_buf.b, len) == len) return true;
 	return false;
 }
 
 
-// process an incoming message
-// for type 0x26, the label values are: 0 signalling 1-255 management socket 
-//		256- analyser
+// process incoming messages
+// reads all the datagrams that are waiting into <rx_ring> and then processes 
+//		them in turn, so that a burst of packets (e.g. a status cycle or the 
+//		replies during a software upload) is handled in one notification 
+//		rather than one each
 void LinkSocket::OnReceive(int nErrorCode)
 {
 // NOTE: we're told to call the base class function, but currently it's null 
@@ -679,52 +429,66 @@ void LinkSocket::OnReceive(int nErrorCode)
 //		the message so I think it's safer not to.
 //	CAsyncSocket::OnReceive(nErrorCode);
 
-		// read the message
-		// I've added a few more bytes to the length of the buffer because the 
-		//		compiler has noticed that if the message ends in the middle of 
-		//		an IE the code that collects info from a ClearDown request 
-		//		could be reading beyond the end of the buffer; now it'll be 
-		//		reading uninitialised bytes within the buffer, which is maybe 
-		//		no better
-	uint8_t b[MAX_REPLY_LENGTH + 16];
-	CString remote_address;
-	UINT remote_port;
-	int len = ReceiveFrom(b, MAX_REPLY_LENGTH, remote_address, remote_port);
-	FlexilinkSocket * f_skt;
+	SOCKADDR_IN sa;
+	int sa_len;
+	int len;
 	int err;
-/*	if (theApp.controller_doc->failure_notice.IsEmpty()) {
-		err = GetLastError();
-		theApp.controller_doc->failure_notice = "Packet received, last error code ";
-		theApp.controller_doc->failure_notice += ToDecimal(err).c_str();
-		theApp.controller_doc->failure_notice += ' ';
-		theApp.controller_doc->failure_notice += strerror(err);
-	}
-*/
-	switch (len) {
-case 0:	return;		// length zero, or socket has been closed
-
-case SOCKET_ERROR:	// error
-		err = GetLastError();
-		if (err != WSAEWOULDBLOCK && state != LINK_ST_FAILED) {
-			state = LINK_ST_FAILED;
-			theApp.controller_doc->failure_notice = "Socket error, code ";
-			theApp.controller_doc->failure_notice += ToDecimal(err).c_str();
-			theApp.controller_doc->failure_notice += ' ';
-			theApp.controller_doc->failure_notice += strerror(err);
-			theApp.controller_doc->UpdateDisplay();
+
+	while (rx_ring.Space() > 0) {
+		Datagram& d = rx_ring.NewSlot(0);
+		sa_len = sizeof(sa);
+		len = ReceiveFrom(d.b, MAX_REPLY_LENGTH, (SOCKADDR *)&sa, &sa_len);
+		if (len == 0) break;	// length zero, or socket has been closed
+		if (len == SOCKET_ERROR) {
+			err = GetLastError();
+			if (err != WSAEWOULDBLOCK && state != LINK_ST_FAILED) {
+				Failed(LINK_ST_FAILED);
+				theApp.controller_doc->failure_notice = "Socket error, code ";
+				theApp.controller_doc->failure_notice += ToDecimal(err).c_str();
+				theApp.controller_doc->failure_notice += ' ';
+				theApp.controller_doc->failure_notice += strerror(err);
+				theApp.controller_doc->UpdateDisplay();
+			}
+			break;
 		}
-		return;
+		d.len = len;
+		d.addr = sa.sin_addr.s_addr;
+		d.port = ntohs(sa.sin_port);
+		rx_ring.Added(1);
 	}
 
-		// here if OK
-	if (remote_port != AES51_PORT) return;
+	CheckItPackets(rx_ring, rx_ring.Count(), standard_format);
+	while (rx_ring.Count() > 0) {
+		ProcessDatagram(rx_ring.OldSlot(0));
+		rx_ring.Removed(1);
+	}
+}
+
+
+// process an incoming message
+// for type 0x26, label 0 is signalling and the others are allocated to 
+//		management sockets and analysers by <theApp.labels>
+// NB the buffer has a few more bytes than the maximum message length 
+//		because the compiler has noticed that if the message ends in the 
+//		middle of an IE the code that collects info from a ClearDown request 
+//		could be reading beyond the end of the buffer; now it'll be reading 
+//		uninitialised bytes within the buffer, which is maybe no better
+void LinkSocket::ProcessDatagram(Datagram& d)
+{
+	uint8_t * b = d.b;
+	int len = d.len;
+	FlexilinkSocket * f_skt;
+	int err;
+
+	if (d.port != AES51_PORT) return;
 	if (len >= MAX_REPLY_LENGTH) return; // overlength UDP datagram
 	if (len < 6 || b[0] != 2) return;	// not a valid message
 
 	if (state == LINK_ST_REQ) {
 			// collect the address for use with subsequent packets
+		CString remote_address = Ip4AddrString(ntohl(d.addr)).c_str();
 		if (!Connect(remote_address, AES51_PORT)) {
-			state = MGT_ST_FAILED;
+			Failed(MGT_ST_FAILED);
 			err = GetLastError();
 			theApp.controller_doc->failure_notice = 
 								"Failed to connect socket, error code ";
@@ -747,22 +511,13 @@ case SOCKET_ERROR:	// error
 		//		if required
 	int label, cause;
 	int i, j;
-	ByteString m;	// for reply messages
+	uint8_t hdr[6];	// for reply messages
 	ByteString id;	// for link partner's id in Link Accept
 	MgtSocket * m_skt;
 	switch (b[1]) {
-case 0x26:		// IT packet
-		if (b[6] & 0xC0) return;	// ignore if not normal data
-			// +++ maybe should allow a preamble? spec doesn't say
-		label = (b[6] << 8) | b[7];	// "length" field
-			// set <i> to length including AES51 header & IT header
-		i = (label >> 3) + (standard_format ? 11 : 7);
-		if (len != i) {
-				// length in IT header is different from UDP length
-			if (len < i) return;	// IT packet truncated
-			if (label != AddHec(label >> 3)) return;	// CRC error
-			len = i;	// remove padding
-		}
+case AES51_TYPE_IT_PACKET:
+			// the length has been checked, and any padding removed, by 
+			//		CheckItPackets() (see OnReceive())
 		label = (b[8] << 8) | b[9];
 
 		if (label == RCV_SIG_FLOW) switch (b[10]) {	// signalling message
@@ -793,8 +548,9 @@ case 0x26:		// IT packet
 			}
 
 					// mark the socket as closed
-					// <theApp.FindSocket> returns NULL if not found, 
-					//		including whenever <label> is negative
+					// <theApp.FindCall> returns NULL if not found, 
+					//		including whenever <label> is negative or is 
+					//		for a previous call on the same flow label
 					// +++ a previous version deleted it; now that 
 					//		we don't do that it would be better to 
 					//		process it in the <f_skt> object but we 
@@ -802,11 +558,12 @@ case 0x26:		// IT packet
 					//		with the FindRoute case because we want 
 					//		different action when the label's not 
 					//		recognised
-			f_skt = theApp.FindSocket(label);
+			f_skt = theApp.FindCall(label);
 			if (f_skt == NULL) return;
 			f_skt->SaveMessage(b + 10, len - 10, 'R');
 			f_skt->state = (f_skt->state < MGT_ST_CONN_MADE) ?
 									MGT_ST_NOT_CONN : MGT_ST_CLOSED;
+			f_skt->ScheduleRetry();
 			if (cause != 0x0218) return;
 				// here if cause is Q.850 code for "call rejected due 
 				//		to a feature at the destination" which we will 
@@ -821,7 +578,7 @@ case 0x26:		// IT packet
 	case 0x88:		// ack FindRoute request
 	case 0x28:		// FindRoute response
 			if (b[11] != 13 || memcmp(b+12, our_ident, 8) != 0) return;
-			f_skt = theApp.FindSocket((b[22] << 8) | b[23]);
+			f_skt = theApp.FindCall((b[22] << 8) | b[23]);
 			if (f_skt) {
 				f_skt->ReceiveSignalling(b + 10, len - 10);
 				return;
@@ -845,11 +602,12 @@ case 0x26:		// IT packet
 		return;
 
 
-case 0x81:	// Link Accept
+case AES51_TYPE_LINK_ACCEPT:
 		unless (state == LINK_ST_REQ) return;
 			// we only offered one protocol, so don't need to check 
 			//		which one the link partner is proposing
 		state = LINK_ST_ACTIVE;
+		theApp.CancelTimer(NULL, TMR_LINK_RETRY);
 			// log that we can connect (stays true if link lost)
 		theApp.pre_connection = false;
 			// we've already collected the link partner's IP address
@@ -896,57 +654,52 @@ case 0x81:	// Link Accept
 		return;
 
 
-case 0x82:	// Link Reject
-		state = LINK_ST_CLOSED;
-			// nothing else to do; we leave it up to the 
-			//		<CControllerDoc> object to notice the change
+case AES51_TYPE_LINK_REJECT:
+		Failed(LINK_ST_CLOSED);
+			// nothing else to do; the socket will be replaced when 
+			//		TMR_LINK_RETRY expires
 			// we don't close it so that the user can see the state
 		return;
 
 
-case 0x84:	// Link Keepalive
-		rcv_timer_count = LINK_RCV_TIMEOUT;
+case AES51_TYPE_LINK_KEEPALIVE:
+		theApp.StartTimer(this, TMR_LINK_RX, LINK_RCV_TIMEOUT_MS);
 			// KLUDGE ALERT: we seem to stop sending keepalives when uploading 
 			//		software; I don't understand why that should be, but sending 
 			//		one back each time we receive one should be OK provided the 
 			//		other end doesn't do the same; receiving clearly doesn't 
 			//		stop because the acks to the writes are being seen
-		m = aes51_data_hdr;
-		m[1] = 0x84;
-		Send(m.data(), 6);
-		tx_timer_count = LINK_KEEPALIVE_PERIOD;
+		BuildAes51Header(hdr, AES51_TYPE_LINK_KEEPALIVE);
+		Send(hdr, 6);
+		theApp.StartTimer(this, TMR_LINK_TX, LINK_KEEPALIVE_MS);
 		return;
 	}
 
 		// here if packet type not recognised
 		// arguably we should just ignore the packet, though it must be 
 		//		implementing something we haven't said we support
-	state = LINK_ST_ERROR;
+	Failed(LINK_ST_ERROR);
 		// send a Link Reject message
-	m = aes51_data_hdr;
-	m[1] = 0x82;
-	Send(m.data(), 6);
+	BuildAes51Header(hdr, AES51_TYPE_LINK_REJECT);
+	Send(hdr, 6);
 }
 
 
-// routine called every 0.5 sec; returns whether the link has timed out
-bool LinkSocket::PollKeepalives()
+// called when TMR_LINK_RX or TMR_LINK_TX expires
+void LinkSocket::TimerExpired(int kind)
 {
-	rcv_timer_count -= 1;
-	if (rcv_timer_count <= 0) {
-			// treat as Link Reject (see above)
+	if (kind == TMR_LINK_RX) {
+			// treat as Link Reject (see above), but retry immediately
 		state = LINK_ST_CLOSED;
-		return true;
+		theApp.StartTimer(NULL, TMR_LINK_RETRY, 0);
+		return;
 	}
 
-	tx_timer_count -= 1;
-	if (tx_timer_count > 0) return false;
-		// else send a Link Keepalive message
-	ByteString m(aes51_data_hdr);
-	m[1] = 0x84;
-	Send(m.data(), 6);
-	tx_timer_count = LINK_KEEPALIVE_PERIOD;
-	return false;
+		// send a Link Keepalive message
+	uint8_t hdr[6];
+	BuildAes51Header(hdr, AES51_TYPE_LINK_KEEPALIVE);
+	Send(hdr, 6);
+	theApp.StartTimer(this, TMR_LINK_TX, LINK_KEEPALIVE_MS);
 }
 
 
@@ -963,7 +716,7 @@ bool LinkSocket::PollKeepalives()
 {
 	unit_TAddress = call_addr;
 	unit_address = ByteArrayToHex(unit_TAddress);
-	theApp.unit_addrs.SetAt(unit_address, (void *)this);
+	theApp.unit_addrs.Set(unit_TAddress, (void *)this);
 
 	SendConnReq();
 }*/
@@ -982,69 +735,17 @@ void MgtSocket::SendConnReq()
 	call_ref += 0x10000;	// new call reference
 	call_ref &= 0x7FFFFFFF; // in case has wrapped
 
-	ByteString::size_type n = unit_TAddress.size();
 	mgt_msg.count = 0;
-	mgt_msg.m.resize(62+n);
-	mgt_msg.m[0] = 8;		// FindRoute request
-	mgt_msg.m[1] = 13;
-
-	ByteString::size_type i = 0;
-	do {
-		mgt_msg.m[i+2] = theApp.link_socket->our_ident[i];	// owner
-		i += 1;
-	} while (i < 8);
-
-	mgt_msg.m[10] = (uint8_t)(call_ref >> 24);
-	mgt_msg.m[11] = (uint8_t)(call_ref >> 16);
-	mgt_msg.m[12] = (uint8_t)(call_ref >> 8);
-	mgt_msg.m[13] = (uint8_t)call_ref;
-	mgt_msg.m[14] = 2;		// route ref
-		// DataType IE: 1.3.6.1.4.1.9940.2.2.4
-	mgt_msg.m[15] = 5;
-	mgt_msg.m[16] = 0;
-	mgt_msg.m[17] = 10;
-	mgt_msg.m[18] = 43;
-	mgt_msg.m[19] = 6;
-	mgt_msg.m[20] = 1;
-	mgt_msg.m[21] = 4;
-	mgt_msg.m[22] = 1;
-	mgt_msg.m[23] = 0xCD;
-	mgt_msg.m[24] = 0x54;
-	mgt_msg.m[25] = 2;
-	mgt_msg.m[26] = 2;
-	mgt_msg.m[27] = 4;
-		// PrivilegeLevel IE
-	mgt_msg.m[28] = 12;
-	mgt_msg.m[29] = 0;
-	mgt_msg.m[30] = 1;
-	mgt_msg.m[31] = theApp.privilege;
-		// AsyncAlloc IE
-	int rcv_label = AddHec(call_ref & 0x1FFF);
-	mgt_msg.m[32] = 20;
-	mgt_msg.m[33] = 0;
-	mgt_msg.m[34] = 2;
-	mgt_msg.m[35] = (uint8_t)(rcv_label >> 8);
-	mgt_msg.m[36] = (uint8_t)rcv_label;
-		// FlowDescriptor IE
-	mgt_msg.m[37] = 4;
-	mgt_msg.m[38] = 0;
-	mgt_msg.m[39] = 4;
-	mgt_msg.m[40] = 2;
-	mgt_msg.m[41] = 0;
-	mgt_msg.m[42] = 0;
-	mgt_msg.m[43] = 1;
-
-	unsigned int j;
-	if (ExpectPassword()) {
-			// Password IE
-		mgt_msg.m[44] = 13;
-		mgt_msg.m[45] = 0;
-		mgt_msg.m[46] = 12;
-
+	unless (ExpectPassword()) BuildConnReq(mgt_msg.m, 
+						theApp.link_socket->our_ident, call_ref, 
+						theApp.privilege, unit_TAddress, NULL);
+	else {
 			// create the second half of the "random string" with count = 0
+			//		for the Password IE
 			// don't check for success in collecting time or random number; 
 			//		whatever is left in <tb> ot <j> will be "random" enough
 		struct __timeb64 tb;
+		unsigned int j;
 		_ftime64_s(&tb);
 		rand_s(&j);
 		password_string[6] = tb.time;
@@ -1052,32 +753,24 @@ void MgtSocket::SendConnReq()
 										(((uint64_t)(j & 0x3FFFFF)) << 32);
 		uint8_t b[16];
 		CopyLongwordsToNetwork(b, password_string + 6, 2);
-		j = 47;
-		i = 0;
-		do mgt_msg.m[j++] = b[i++]; while (i < 12);
-	}
-	else {
-			// don't include Password IE
-		mgt_msg.m.resize(47+n);
-		j = 44;
+		BuildConnReq(mgt_msg.m, theApp.link_socket->our_ident, call_ref, 
+								theApp.privilege, unit_TAddress, b);
 	}
 
-		// CalledAddress IE; <j> is the index to the tag byte
-	mgt_msg.m[j++] = 3;
-	mgt_msg.m[j++] = 0;
-	mgt_msg.m[j++] = (uint8_t)n;	// assumed < 256
-
-	i = 0;
-	while (i < n) mgt_msg.m[j++] = unit_TAddress[i++];
-
 	if (theApp.link_socket->TxMessage(mgt_msg.m, 0)) {
 		SaveMessage(mgt_msg.m.data(), mgt_msg.m.size(), 'T');
 		state = MGT_ST_CONN_REQ;
+		AwaitAck();
+			// the unit has until MGT_SILENCE_TIMEOUT after now to reply
+		last_rx = GetTickCount64();
+		theApp.StartTimer((FlexilinkSocket *)this, TMR_UNIT_LIVENESS, 
+														MGT_SILENCE_TIMEOUT);
 		return;
 	}
 
 	SaveMessage(mgt_msg.m.data(), mgt_msg.m.size(),'E');
 	state = MGT_ST_FAILED;
+	ScheduleRetry();
 }
 
 
@@ -1106,21 +799,34 @@ void FlexilinkSocket::TxMessage(uint8_t * b, int len) {
 //		already set and if there is no random string a type 5 request will be 
 //		sent instead; otherwise the hash is calculated and inserted after the 
 //		second byte and the random string is invalidated
-// <flash_request> defaults to false; if it is true and transmission is 
-//		successful, fills in <upd_reply> and <upd_msg>
+// the message is recorded in <requests> with kind <kind>, which defaults to 
+//		REQ_OTHER (not repeated); there is only one REQ_UPDATE or REQ_STATUS 
+//		request at a time, so sending one replaces any earlier one, and for 
+//		REQ_UPDATE <upd_reply> and <upd_msg_ser> are also filled in
+// if there's no serial number free, the oldest request is given up on as in 
+//		TimerExpired(), and if that times the session out the message isn't sent
 // if transmission is unsuccessful, enters "failed" state
-void MgtSocket::TxNewMessage(uint8_t * b, int len, bool pw, bool flash_request) {
-	b[1] = next_serial;
-	if (next_serial >= 255) next_serial = 1;
-	else next_serial += 1;
+void MgtSocket::TxNewMessage(uint8_t * b, int len, bool pw, int kind) {
+	if (kind == REQ_UPDATE || kind == REQ_STATUS) requests.RemoveKind(kind);
+	int serial = requests.NextSerial();
+	if (serial == 0) {
+			// all 255 serial numbers are waiting for replies; give up on 
+			//		the oldest request, which will time out the session 
+			//		unless it was one that didn't need a reply
+		PendingRequest r = *requests.Find(requests.Oldest());
+		requests.Remove(r.m[1]);
+		RequestTimedOut(r);
+		if (state > MGT_ST_MAX_OK) return;
+		serial = requests.NextSerial();
+	}
+	b[1] = (uint8_t)serial;
 	TxMessage(b, len, pw);
+	requests.Add(b, len, kind != REQ_OTHER, kind, pw, GetTickCount64());
+	ArmRequestTimer();
 
-	if (flash_request) {
+	if (kind == REQ_UPDATE) {
 		upd_reply = (b[0] & 0x70) | 0x80;
 		upd_msg_ser = b[1];
-		upd_msg.m.resize(len);
-		memcpy(upd_msg.m.data(), b, len);
-		upd_msg.count = 0;
 	}
 }
 
@@ -1155,21 +861,66 @@ void MgtSocket::TxMessage(uint8_t * b, int len, bool pw) {
 // caller must check there is a random string available, also that <len> 
 //		is at least 2
 void MgtSocket::TxWithHash(uint8_t * b, int len) {
+	if (hash_batch > 0) {
+		hash_queue.push_back(ByteString(b, b + len));
+		return;
+	}
+
+	sha3_sponge s;
+	HashInput(s, b, len);
+	Keccakf(s);
+	TxHashed(b, len, (uint32_t)password_string[7], s);
+}
+
+
+// the messages are sent in the order they were queued, so the unit sees the 
+//		counts increasing; if the socket fails they are discarded, as the 
+//		requests will be forgotten when it reconnects
+void MgtSocket::EndHashBatch() {
+	if (--hash_batch > 0) return;
+
+	uint64_t s[SHA3_KECCAK_SPONGE_WORDS][KECCAK_MAX_LANES];
+	uint32_t count[KECCAK_MAX_LANES];
+	sha3_sponge t;
+	int n = (int)hash_queue.size();
+	int i = 0;
+	int j, k, w;
+	memset(s, 0, sizeof(s));
+	while (i < n && state <= MGT_ST_MAX_OK) {
+		k = n - i;
+		if (k > KECCAK_MAX_LANES) k = KECCAK_MAX_LANES;
+		for (j = 0; j < k; j++) {
+			ByteString& m = hash_queue[i + j];
+			HashInput(t, m.data(), (int)m.size());
+			count[j] = (uint32_t)password_string[7];
+			for (w = 0; w < SHA3_KECCAK_SPONGE_WORDS; w++) s[w][j] = t[w];
+		}
+		KeccakfLanes(s, k);
+		for (j = 0; j < k && state <= MGT_ST_MAX_OK; j++) {
+			for (w = 0; w < 8; w++) t[w] = s[w][j];
+			ByteString& m = hash_queue[i + j];
+			TxHashed(m.data(), (int)m.size(), count[j], t);
+		}
+		i += k;
+	}
+	hash_queue.clear();
+}
+
+
+void MgtSocket::HashInput(sha3_sponge s, const uint8_t * b, int len) {
 		// increment the count; note that if it wraps the unit will see the 
 		//		value as being less than the previous one and clear the call 
 		//		down; also, there will be carry into the "random" part so the 
 		//		hash will be wrong, which would also clear the call down
 	password_string[7] += 1;
 
-		// calculate the hash
-	sha3_sponge s;
 		// initialise to <in> + 01 for SHA-3 hash + 1 0* 1 for padding + 
 		//		16 words zero
 	ASSERT(SHA3_KECCAK_SPONGE_WORDS > 9);
 	memcpy(s, password_string, 64);
 		// merge the message in in the same way as in the Tealeaves code
 	int i = 0;			// counts bytes in the message
-	uint8_t * b3 = b;	// next byte to read
+	const uint8_t * b3 = b;	// next byte to read
 	uint64_t w;			// accumulates words
 	w = 0;
 	do {
@@ -1184,19 +935,22 @@ void MgtSocket::TxWithHash(uint8_t * b, int len) {
 		//   1234567890123456 (16 digits, little-endian)
 	s[8] = 0x8000000000000006UL;
 	memset(&s[9], 0, (SHA3_KECCAK_SPONGE_WORDS - 9) * 8);
-	keccakf(s);
+}
+
 
-		// add it to the message
+void MgtSocket::TxHashed(const uint8_t * b, int len, uint32_t count, 
+																uint64_t * s) {
+		// add the hash to the message
 	ByteString m;
 	m.resize(len + 2 + SHA3_HASH_STRING_BYTES);
 	uint8_t * b2 = m.data(); // NB after resizing in case it moves
 	memcpy(b2, b, 2);
 	b2[2] = ASN1_TAG_OCTET_STRING;
 	b2[3] = SHA3_HASH_STRING_BYTES;
-	b2[4] = (uint8_t)(password_string[7] >> 24);
-	b2[5] = (uint8_t)(password_string[7] >> 16);
-	b2[6] = (uint8_t)(password_string[7] >> 8);
-	b2[7] = (uint8_t)(password_string[7]);
+	b2[4] = (uint8_t)(count >> 24);
+	b2[5] = (uint8_t)(count >> 16);
+	b2[6] = (uint8_t)(count >> 8);
+	b2[7] = (uint8_t)(count);
 	CopyLongwordsToNetwork(b2 + 8, s, 8);
 	if (len > 2) memcpy(b2 + 4 + SHA3_HASH_STRING_BYTES, b + 2, len - 2);
 
@@ -1204,16 +958,12 @@ void MgtSocket::TxWithHash(uint8_t * b, int len) {
 }
 
 
-// send Status Request message; fill in <mgt_msg> if <req_ack> is true
+// send Status Request message; repeat it until acknowledged if <req_ack> 
+//		is true
 inline void MgtSocket::RequestStatus(bool req_ack) {
 	unsigned char b2[2];
 	b2[0]  = 0x20;	// "Status" request
-	TxNewMessage(b2, 2, false);
-	if (req_ack) {
-		mgt_msg.m.resize(2);
-		memcpy(mgt_msg.m.data(), b2, 2);
-		mgt_msg.count = 0;
-	}
+	TxNewMessage(b2, 2, false, req_ack ? REQ_STATUS : REQ_OTHER);
 }
 
 
@@ -1279,6 +1029,7 @@ void FlexilinkSocket::ReceiveSignalling(uint8_t * b, int len)
 
 			if (tx_flow < 0) {
 				state = MGT_ST_NOT_CONN;
+				ScheduleRetry();
 				return;
 			}
 			state = MGT_ST_CONN_MADE;
@@ -1309,6 +1060,7 @@ void MgtSocket::ConnectionMade(uint8_t * b)
 		//		for that first, anyway
 	mgt_msg.m.resize(11);
 	mgt_msg.m[0]  = 0x19;
+	mgt_msg.m[1]  = 0;		// serial number; not allocated by <requests>
 	mgt_msg.m[2]  = 6;		// OID tag
 	mgt_msg.m[3]  = 7;		// length of OID
 	mgt_msg.m[4]  = 0x28;	// OID = 1.0.62379.1.1.1
@@ -1319,8 +1071,17 @@ void MgtSocket::ConnectionMade(uint8_t * b)
 	mgt_msg.m[9]  = 1;
 	mgt_msg.m[10] = 1;
 	TxMessage(mgt_msg.m, false);
-	mgt_msg.count = 0;
-	upd_state = UPD_ST_NO_INFO; // in case reconnecting
+	AwaitAck();
+	SaveCheckpoint();	// in case reconnecting
+	upd_state = UPD_ST_NO_INFO;
+	upd_window.clear();
+	upd_verify.clear();
+	map_walk.Clear();
+	erase_pending.clear();
+		// requests sent on an earlier connection won't be answered now; the 
+		//		round-trip times are kept
+	requests.Clear();
+	conn_pend.clear();
 }
 
 
@@ -1334,48 +1095,79 @@ void MgtSocket::ReceiveData(uint8_t * b, int len)
 
 	MibObject * m = NULL;
 	uint8_t * p;
-	CString rel_oid;
+	CString index;	// index arcs of an object, in dotted-decimal form
 	CString s;
+	CString s2;
 	int i,j,k;
 	bool call_id_error = false; // KLUDGE
+	static const uint8_t unit_next_call_id[] = 	// 1.0.62379.5.1.1.3.2.0
+								{ 0x28, 0x83, 0xE7, 0x2B, 5, 1, 1, 3, 2, 0 };
+	PendingRequest done;	// the request this is the reply to, if any
+	done.kind = -1;
+	done.sends = 0;
 
 	len -= 2;				// length of VarBinds
 	if (len < 0) return;	// if message is too short
-	p = b + 2;				// start of first VarBind
-	keep_alive_count = 0;	// note that we've seen a message
-
-		// throughout this code, <m> points to a <MibObject> created 
-		//		from the VarBind being processed, <p> points to the 
-		//		[OID tag of the] VarBind after it, and <len> shows 
-		//		the number of bytes remaining in the message (i.e. 
-		//		starting from <p>); if we haven't started processing 
-		//		the first VarBind, <m> is NULL and <p> points to the 
-		//		first VarBind
+	last_rx = GetTickCount64();	// note that we've seen a message
+
+		// throughout this code, <v> describes the VarBind being 
+		//		processed and <r> reads them from the message in turn; 
+		//		nothing is copied out of the message except values 
+		//		that are stored in <mib>
+	VarBindReader r(b + 2, len);
+	VarBindView v;
 	if (b[0] & 0x80) {
-			// reply
+			// reply; a "busy" reply means the request will be repeated, 
+			//		else see if it's one we're waiting for, matching the 
+			//		serial number and the request type
+			// a Status report whose sequence number is the same as the 
+			//		serial number of a Status request is taken as the reply 
+			//		to it, which does no harm as it shows the unit is 
+			//		sending the reports
+		if (b[0] == 0xBE) {
+			requests.Busy(b[1], GetTickCount64());
+			ArmRequestTimer();
+		}
+		else requests.Complete(b[1], b[0], GetTickCount64(), done);
+
+		if ((b[0] & 0x0F) == MGT_ERR_TOO_BIG && (b[0] & 0x70) == 0x30) {
+				// tooBig response to a Set; if it's one that sets up a 
+				//		connection in a single message, the unit doesn't 
+				//		accept them, so send the VarBinds separately instead, 
+				//		without reporting the error; any other error is 
+				//		about one of the values, so is reported below as it 
+				//		would be for the separate messages
+			i = (int)conn_pend.size();
+			while (i > 0) {
+				ConnReqInfo& ci = conn_pend[--i];
+				if (ci.ends.empty() || ci.m[0][1] != b[1]) continue;
+				multi_set_ok = false;
+				ByteString msg;
+				msg.swap(ci.m[0]);
+				SendSetupSeparately(ci, msg, ci.ends.data());
+				return;
+			}
+		}
 		if ((b[0] & 0x0F) && b[0] != 0xAF) {
 				// response reports failure
 			s.Format(": error code %d from ", b[0] & 15);
 			s += MgtReqCode((b[0] >> 4) & 7);
-			m = new MibObject(p, len);
-			unless (m->oid.IsEmpty()) {
+			if (r.Next(v)) {
 				if (b[0] == 0x82 && 
-							m->oid == "1.0.62379.5.1.1.3.2.0") {
+						v.OidIs(unit_next_call_id, sizeof(unit_next_call_id))) {
 						// NoSuchName response to Get unitNextCallId
 					s = " refused request for call id";
 					call_id_error = true;
 				}
 				else {
 					s += " for ";
-					s += m->oid;
-					unless (m->empty()) {
+					s += v.OidText();
+					unless (v.val_len == 0) {
 						s += " = ";
-						s += Utf8ToUnicode(m->TextValue());
+						s += Utf8ToUnicode(MibObject(v).TextValue());
 					}
 				}
 			}
-			delete m;
-			m = NULL;
 			theApp.err_msgs.Add(DisplayName() + s);
 			theApp.output_list->UpdateAllViews(NULL);
 		}
@@ -1410,6 +1202,7 @@ void MgtSocket::ReceiveData(uint8_t * b, int len)
 			//		will be reported, see above) won't stop the 
 			//		connection being requested
 		if ((b[0] & 0x70) == 0x30) {
+			k = -1;		// salvo entry that has been completed, if any
 			i = (int)conn_pend.size();
 			while (i > 0) {
 				i -= 1;
@@ -1431,12 +1224,14 @@ void MgtSocket::ReceiveData(uint8_t * b, int len)
 							theApp.output_list->sel_port.port == 
 														ci.dest_port) {
 						theApp.output_list->sel_port.unit = NULL;
-						theApp.mib_changed = true;
+						theApp.output_list->UpdateAllViews(NULL);
 					}
 						// remove the entry (invalidates <ci>)
+					if (ci.salvo_entry >= 0) k = ci.salvo_entry;
 					conn_pend.erase(conn_pend.begin() + i);
 				}
 			}
+			if (k >= 0) theApp.salvo->Completed(k, true);
 		}
 	}
 
@@ -1445,26 +1240,8 @@ void MgtSocket::ReceiveData(uint8_t * b, int len)
 		if (b[0] != 0xA0 && b[0] != 0xAF) return; // if error signalled
 		if (len == 2 && b[0] == 0xA0) return;	// OK reply to Status Request
 
-		if (b[1] == 1) {
-				// first in a cycle
-			if (state == MGT_ST_HAVE_INFO) state = MGT_ST_ACTIVE;
-			start_cycle_time = _time64(& prev_report_time) - 2;
-			next_seq = 2;
-		}
-		else if (b[1] == next_seq && next_seq > 1) {
-				// in-cycle Status report with the expected sequence number 
-				//		during an OK cycle
-				// check it's not so long after the previous packet that 
-				//		it might be part of a later cycle
-			__time64_t time_received = _time64(NULL);
-			if (prev_report_time - time_received > 10) next_seq = 0;
-			else {
-				prev_report_time = time_received;
-				if (next_seq == 0xFF) next_seq = 2;
-				else next_seq += 1;
-			}
-		}
-		else next_seq = 0;
+		if (cycle.Report(b[1], _time64(NULL)) && state == MGT_ST_HAVE_INFO)
+													state = MGT_ST_ACTIVE;
 	}
 	else if ((b[0] & 0x70) == 0x70) {
 			// console data
@@ -1487,19 +1264,102 @@ void MgtSocket::ReceiveData(uint8_t * b, int len)
 		SaveConsole(b + 2, len);
 		return;
 	}
-	else if ((b[0] & 0xF0) == upd_reply && b[1] == upd_msg_ser) {
+	else if (done.kind == REQ_WALK) {
+			// reply to a GetNext from one of the cursors of <map_walk>; 
+			//		another request is sent for the cursor unless it has 
+			//		reached the end of its column, and the map is filled in 
+			//		when they all have
+			// as for the other updating messages, nothing is included 
+			//		in <mib>
+		if (upd_state != UPD_ST_COLLECT_MAP) return;	// walk abandoned
+		i = ((b[0] & 0x0F) != 0) ? WALK_ERROR : map_walk.Reply(b[1], b + 2, len);
+		if (i == WALK_ERROR || i == WALK_NOT_OURS) {
+			map_walk.Clear();
+			upd_state = UPD_ST_FAILED;
+			return;
+		}
+		if (i >= 0) SendWalkRequest(i);
+		unless (map_walk.Done()) return;
+
+		ByteString vbs(map_walk.Results());
+		map_walk.Clear();
+		VarBindReader w(vbs.data(), (int)vbs.size());
+		ReadFlashMap(w);
+		return;
+	}
+	else if (done.kind == REQ_ERASE) {
+			// reply to one of the Erase requests sent by <SendErases>; the 
+			//		tag should be INTEGER; these can arrive while uploading, 
+			//		in which case a failure is left for the next time the map 
+			//		is read
+		std::map<uint8_t, int32_t>::iterator e = erase_pending.find(b[1]);
+		if (e == erase_pending.end()) return;
+		erase_pending.erase(e);
+		if ((b[0] & 0x0F) != 0 || !r.Next(v) || v.val_len == 0 || 
+				v.tag != ASN1_TAG_INTEGER || v.value != AREA_STATUS_ERASING) {
+			if (upd_state == UPD_ST_ERASING) upd_state = UPD_ST_FAILED;
+			return;
+		}
+
+		SendErases();	// if any more are waiting
+		if (erase_pending.empty() && upd_state == UPD_ST_ERASING) WaitForErases();
+		return;
+	}
+	else if (done.kind == REQ_VERIFY) {
+			// reply to a Get sent by <SendVerifyRequests>; the tag should be 
+			//		OCTET_STRING and the data what we sent before the 
+			//		connection was lost
+		std::map<uint8_t, UploadTranche>::iterator t = upd_verify.find(b[1]);
+		if (t == upd_verify.end()) return;
+		UploadTranche sample = t->second;
+		upd_verify.erase(t);
+		if (upd_state != UPD_ST_VERIFYING) return;
+		if ((b[0] & 0x0F) != 0 || !r.Next(v) || 
+				v.tag != ASN1_TAG_OCTET_STRING || v.val_len != sample.length || 
+				!image.Equals(v.val, sample.offset, sample.length)) {
+				// can't trust any of it, so write the image to another area 
+				//		and erase this one
+			upd_verify.clear();
+			requests.RemoveKind(REQ_VERIFY);
+			upd_area->second.status = AREA_STATUS_INVALID;
+			i = (upd_area->second.data_type == vl_type[1]) ? 1 : 0;
+			vl_serial[i] = (vl_serial[i] - 1) & 15;
+			StartUpload(i);
+			return;
+		}
+		unless (upd_verify.empty()) return;
+
+			// here when all the samples have been checked
+		upd_state = UPD_ST_UPLOADING;
+		upd_data_start = GetTickCount64();
+		upd_data_base = upd_acked;
+		FillUploadWindow();
+		return;
+	}
+	else if (((b[0] & 0xF0) == upd_reply && b[1] == upd_msg_ser) || 
+				((b[0] & 0xF0) == 0xB0 && upd_window.count(b[1]) != 0)) {
 			// it's the reply to a message sent as part of the process 
 			//		of collecting the flash map or updating the flash
 			// won't come here if <upd_reply> is coded as "status 
 			//		reponse"
 			// we don't include anything from the flash map in <mib>
 			// if it's a "busy" reply to a write, just wait for the 
-			//		repeat
-		if (b[0] == 0xBE && upd_state >= 0) return;
-		upd_reply = 0xA0;
-		upd_msg.m.clear();
+			//		repeat; if it's for a tranche of data, also send
+			//		fewer at a time (<requests> repeats it after the timeout)
+		std::map<uint8_t, UploadTranche>::iterator t = upd_window.find(b[1]);
+		if (b[0] == 0xBE && upd_state >= 0) {
+			unless (t == upd_window.end()) {
+				upd_window_size /= 2;
+				if (upd_window_size < UPD_WINDOW_MIN) 
+									upd_window_size = UPD_WINDOW_MIN;
+				upd_window_acks = 0;
+			}
+			return;
+		}
+		if (t == upd_window.end()) upd_reply = 0xA0;
 		if ((b[0] & 0x0F) != 0) {
 				// error signalled in reply
+			ClearUploadWindow();
 			SetStateError();
 			return;
 		}
@@ -1514,87 +1374,6 @@ case UPD_ST_NO_ACTION:	// +++ need to add diagnostics that will
 						//		response in this state
 			return;
 
-case UPD_ST_COLLECT_MAP: // filling in the map; message will have been 
-						 //		GetNext
-			while (true) {
-				m = new MibObject(p, len);
-				if (m->tag == TAG_INVALID) {
-					goto update_failed;
-				}
-				if (m->oid.Left(20) != "1.0.62379.1.1.5.1.1.") {
-						// not in the table, so must have collected 
-						//		everything
-					if (unit_id == 0x0090A8990000000DLL) {
-							// +++ KLUDGE: in unit 13 block 145 fails 
-							//		to program; ideally the VM code 
-							//		should handle bad blocks, maybe 
-							//		via "sticky" MIB objects
-						FlashMap::iterator p;
-						p = flash.begin();
-						unless (p == flash.end()) do {
-							if (p->second.status != AREA_STATUS_EMPTY) continue;
-							if (p->first > 145) continue; // area id is block number
-							if (p->first + (p->second.length >> 16) <= 145) continue;
-								// here if we've found an empty area that includes 
-								//		block 145; we can use the part below block 
-								//		145, but using the part above would be more 
-								//		difficult as it would require inventing a 
-								//		new area
-							i = 145 - p->first;
-							if (i > 0) p->second.length = i << 16;
-							else p->second.status = AREA_STATUS_INVALID;
-						} until (++p == flash.end());
-					}
-					upd_state = UPD_ST_HAVE_MAP;	// trigger for OnIdle()
-					delete m;
-					return;
-				}
-
-					// here if it's in the table
-					// set <j> to the column number and <i> to the area id
-				if (sscanf_s(m->oid.Mid(20), "%d.%d", &j, &i) != 2) {
-					delete m;
-					continue;
-				}
-
-				switch (j) {
-						// +++ ought to read the class (case 2) as well
-		case 3:		flash[i].access = m->IntegerValue(); break;
-
-		case 4:		k = m->IntegerValue();
-					if (k == AREA_STATUS_ERASING) {
-							// don't want to go on to upload etc until 
-							//		it's done
-						upd_state = UPD_ST_WAITING;
-						delete m;
-						return;
-					}
-
-					flash[i].status = k;
-					break;
-
-		case 5:		flash[i].length = m->IntegerValue(); break;
-		case 6:		flash[i].data_type = m->IntegerValue(); break;
-		case 7:		flash[i].serial = m->IntegerValue(); break;
-
-		case 8:		if (m->tag == ASN1_TAG_OCTET_STRING) {
-						flash[i].vn.FromFilename(*m);
-						break;
-					}
-					flash[i].vn.Invalidate(); // if not an octet string
-				}
-
-				if (len <= 0) break;
-				delete m;
-			}
-
-				// here to ask for more
-				// <m> is the last object in the message
-			b[0] = 0x1F;
-			TxNewMessage(b, m->CopyOid(b + 2) + 2, true, true);
-			delete m;
-			return;
-
 case UPD_ST_UPLOADING:	// writing; message will be reply to a Set
 				// we've already checked it's a reply to the expected 
 				//		request message and not indicating any error 
@@ -1602,14 +1381,14 @@ case UPD_ST_UPLOADING:	// writing; message will be reply to a Set
 				// the tag should be OCTET_STRING when accessing the 
 				//		Content table and INTEGER when accessing the 
 				//		Area table
-			m = new MibObject(p, len);
-			k = (int)m->size();
-			if (k == 0 || (m->tag != ASN1_TAG_INTEGER && 
-						m->tag != ASN1_TAG_OCTET_STRING)) {
+			unless (r.Next(v)) goto update_failed;
+			k = v.val_len;
+			if (k == 0 || (v.tag != ASN1_TAG_INTEGER && 
+						v.tag != ASN1_TAG_OCTET_STRING)) {
 				goto update_failed;
 			}
 
-			if (m->tag == ASN1_TAG_INTEGER) {
+			if (v.tag == ASN1_TAG_INTEGER) {
 					// either one of the preliminaries or setting state at end
 
 				switch (upd_offset) {
@@ -1618,11 +1397,10 @@ case UPD_ST_UPLOADING:	// writing; message will be reply to a Set
 						//		so we allow that, though current VM code waits 
 						//		until the header has been written before sending 
 						//		the reply
-					if (m->value != AREA_STATUS_VALID && 
-										m->value != AREA_STATUS_BEING_WR) {
+					if (v.value != AREA_STATUS_VALID && 
+										v.value != AREA_STATUS_BEING_WR) {
 						goto update_failed;
 					}
-					delete m;
 						// collect the map again; this is required when uploading 
 						//		both logic and VM code to a flash in which all 
 						//		the free space is in one large area, and also 
@@ -1632,26 +1410,26 @@ case UPD_ST_UPLOADING:	// writing; message will be reply to a Set
 					return;
 
 		case -4:		// setting swaStatus to Writing
-					if (m->value != AREA_STATUS_WRITING) {
+					if (v.value != AREA_STATUS_WRITING) {
 						goto update_failed;
 					}
 					upd_area->second.status = AREA_STATUS_WRITING;
 					break;
 
 		case -3:		// swaLength: managed unit may round it up
-					if (m->value < (int)image.size()) {
+					if (v.value < image.size()) {
 						goto update_failed;
 					}
 					break;
 
 		case -2:		// swaType
-					if (m->value != upd_area->second.data_type) {
+					if (v.value != upd_area->second.data_type) {
 						goto update_failed;
 					}
 					break;
 
 		case -1:		// swaSerial
-					if (m->value != upd_area->second.serial) {
+					if (v.value != upd_area->second.serial) {
 						goto update_failed;
 					}
 				}
@@ -1659,21 +1437,38 @@ case UPD_ST_UPLOADING:	// writing; message will be reply to a Set
 				upd_offset += 1;
 			}
 			else {
-					// writing data
-				i = 0;
-				while (i < k) {
-					if (m->at(i) != image[upd_offset + i]) {
-						goto update_failed;
-					}
-					i += 1;
+					// writing data; <t> is the tranche being acknowledged
+					// check the unit has read back what we sent
+				if (t == upd_window.end() || k != t->second.length || 
+						!image.Equals(v.val, t->second.offset, k)) {
+					goto update_failed;
 				}
 
-				upd_offset += k;
+				upd_acked += k;
+				UploadAcked(done);
+				upd_window.erase(t);
+					// tranches are sent in order, so everything before the 
+					//		first that's still outstanding has been written
+				upd_written = upd_offset;
+				for (t = upd_window.begin(); t != upd_window.end(); t++) {
+					if (t->second.offset < upd_written) 
+											upd_written = t->second.offset;
+				}
+				FillUploadWindow();
+				return;
 			}
 
-			delete m;	// finished with incoming message
+			if (upd_offset >= 0) {
+					// preliminaries done; start sending the data
+				upd_acked = 0;
+				upd_data_start = GetTickCount64();
+				upd_data_base = 0;
+				FillUploadWindow();
+				return;
+			}
 
-				// now send the next message
+				// now send the next of the preliminaries
+				// OID = 1.0.62379.1.1.5.1.1.c.a (c = column, a = area)
 			b[0]  = 0x30;	// "Set" request
 			b[2]  = ASN1_TAG_OID;
 			b[4]  = 0x28;	// OID begins 1.0.62379.1.1.5
@@ -1683,93 +1478,37 @@ case UPD_ST_UPLOADING:	// writing; message will be reply to a Set
 			b[8]  = 1;
 			b[9]  = 1;
 			b[10] = 5;
-				// bytes 11-13 are the last 3 arcs before the index(es)
-			b[12] = 1;		// this arc is 1 in all cases
+			b[11] = 1;
+			b[12] = 1;
+			b[13] = upd_offset + 8;
 			p = b + 14;
-			AddIndex(p, upd_area->first);	// first index in all cases
+			AddIndex(p, upd_area->first);
+				// <p> points to where the tag byte for the value will go
+			b[3] = (uint8_t)((p - b) - 4);
 
-			if (upd_offset < 0) {
-					// we're still in the preliminaries
-					// OID = 1.0.62379.1.1.5.1.1.c.a (c = column, a = area)
-					// <p> points to where the tag byte for the value will go
-				b[3] = (uint8_t)((p - b) - 4);
-				b[11] = 1;
-				b[13] = upd_offset + 8;
-
-				switch (upd_offset) {
-			default:	// assume -3: swaLength (c = 5)
-					i = (int)image.size(); // new length
-					break;
-
-			case -2:	// swaType (c = 6)
-					i = upd_area->second.data_type;	// new type
-					break;
+			switch (upd_offset) {
+		default:	// assume -3: swaLength (c = 5)
+				i = image.size(); // new length
+				break;
 
-			case -1:	// swaSerial (c = 7)
-					i = upd_area->second.serial;	// new serial number
-				}
+		case -2:	// swaType (c = 6)
+				i = upd_area->second.data_type;	// new type
+				break;
 
-				AddInteger(p, i); // write the new value
-			}
-			else {
-					// sending data: set <k> to bytes still to be sent
-				k = (int)image.size() - upd_offset;
-				if (k > 0) {
-						// send a tranche of data
-						// OID = 1.0.62379.1.1.5.2.1.4.a.o.l
-						// <p> points to where the second index will go
-					if (k > MAX_DATA_LENGTH) k = MAX_DATA_LENGTH;
-
-					b[11] = 2;
-					b[13] = 4;	// column number for swcData
-
-					AddIndex(p, upd_offset);
-					AddIndex(p, k);
-						// now <p> points to where the tag byte for the value will go
-					b[3] = (uint8_t)((p - b) - 4);
-					*p++ = ASN1_TAG_OCTET_STRING;
-					AddLength(p, k);
-						// copy the data
-					i = 0;
-					do *p++ = image[upd_offset + i++]; while (i < k);
-				}
-				else {
-						// here when the last tranche has been acknowledged
-						// set the area to "valid"
-						// OID = 1.0.62379.1.1.5.1.1.4.a (a = area)
-						// <p> points to where the tag byte for the value will go
-					b[11] = 1;
-					b[13] = 4;	// column number for swaStatus
-					b[3] = (uint8_t)((p - b) - 4);
-					*p++ = ASN1_TAG_INTEGER;
-					*p++ = 1;
-					*p++ = AREA_STATUS_VALID;
-				}
+		case -1:	// swaSerial (c = 7)
+				i = upd_area->second.serial;	// new serial number
 			}
 
+			AddInteger(p, i); // write the new value
+
 				// now <b> points to the first byte of the message and <p> to the 
 				//		byte after last
-			TxNewMessage(b, (int)(p - b), true, true);
-			return;
-
-case UPD_ST_ERASING:	// tidying away old or invalid areas
-				// we've already checked it's a reply to the expected request 
-				//		message and not indicating any error in the header
-				// the tag should be INTEGER
-			m = new MibObject(p, len);
-			k = (int)m->size();
-			if (k == 0 || (m->tag != ASN1_TAG_INTEGER) || 
-										m->value != AREA_STATUS_ERASING) {
-				goto update_failed;
-			}
-			delete m;	// finished with incoming message
-
-			SendNextErase();
+			TxNewMessage(b, (int)(p - b), true, REQ_UPDATE);
 			return;
 		}
 
 update_failed:
-		delete m;
+		ClearUploadWindow();
 		upd_state = UPD_ST_FAILED;
 		return;
 	}
@@ -1782,16 +1521,17 @@ update_failed:
 		//		e.g., fragments of flash
 	int block_id;
 	void * q;
-	POSITION q2;
 	PortList * list;
 	bool value_is_new;
-
-	while (len > 0) {
-			// p -> where the OID tag should be
-			// len = number of bytes left in message
-		m = new MibObject(p, len);
-		if (m->tag == TAG_INVALID) {
-			delete m;
+	int col;		// MIB_COL_ code for the object
+	int posn;		// offset to its index arcs
+	ByteString flow_id;	// key for <theApp.flow_senders>
+	__time64_t now = _time64(NULL);
+	static const uint8_t prefix_flash[] = 		// 1.0.62379.1.1.5
+								{ 0x28, 0x83, 0xE7, 0x2B, 1, 1, 5 };
+
+	while (r.Remaining() > 0) {
+		unless (r.Next(v)) {
 			m = NULL;
 			break;
 		}
@@ -1799,47 +1539,41 @@ update_failed:
 			// objects that are part of the flash map don't get recorded in 
 			//		the MIB; we assume that if it's a GetNext we're not 
 			//		interested in any other objects that may follow the table
-		if (m->oid.Left(16) == "1.0.62379.1.1.5.") {
-			delete m;	// we haven't stored it in the MIB
+		if (v.OidStartsWith(prefix_flash, sizeof(prefix_flash))) {
 			if ((b[0] & 0xF0) != 0xA0) return;
 				// here if in a status broadcast
 			m = NULL;
 			continue;
 		}
 
-		m->recd = _time64(NULL);
+			// find or create the object's entry in the MIB; if it's 
+			//		already there we replace the value anyway, because we 
+			//		want the new <recd>, but only signal a change if the 
+			//		new value is different
+		m = mib.Add(v.oid, v.oid_len, value_is_new);
+		unless (value_is_new) value_is_new = m->ChangedFrom(v, now);
+		m->SetValue(v);
+		m->recd = now;
 		m->msg_type = b[0] & 0xF0;
+		mib.Reported(m, (m->msg_type & 0x20) != 0);
 
-			// now <m> holds the object we've extracted from the message
-			// <p> and <len> have been updated
-		if (mib_map.Lookup(m->oid, q)) {
-				// it's already in the MIB, at position q
-				// we replace it anyway, because we want the new <recd>, 
-				//		but only signal a change if the new value is 
-				//		different
-				// note that the map doesn't change because we keep the 
-				//		same list entry
-			MibObject * m_old = mib.GetAt((POSITION)q); // previous value
-			mib.SetAt((POSITION)q, m);
-			value_is_new = m->ChangedFrom(m_old);
-			delete m_old;
-			if (value_is_new) {
-				theApp.mib_changed = true;
-				UpdateDisplay();
+			// here to update lists etc
+		col = ClassifyOid(v.oid, v.oid_len, posn);
+		if (value_is_new) {
+			theApp.mib_bus.Publish(this, MIB_BIT(col));
+			unless (col == MIB_COL_NONE) {
+					// it's one of the objects the crosspoint windows show
+				xpt_revision += 1;
+				switch (col) {
+case MIB_COL_UNIT_NAME:
+case MIB_COL_UNIT_LOCATION:
+case MIB_COL_A_PORT_NAME:
+case MIB_COL_V_PORT_NAME:
+case MIB_COL_UD_NET_BLOCK_ID:
+					theApp.xpt_revision += 1;
+				}
 			}
 		}
-		else {
-				// it's new: add to MIB and map
-			mib.AddTail(m);
-			mib_map.SetAt(m->oid, mib.GetTailPosition());
-			value_is_new = true;
-			theApp.mib_changed = true;
-			UpdateDisplay();
-		}
-
-			// here to update lists etc
-		if (m->oid.Left(10) != "1.0.62379.") continue;
-		rel_oid = m->oid.Mid(10);
 
 			// here if it may be one of the objects we want to list
 			// we check the lists even if the value is unchanged in the 
@@ -1850,68 +1584,76 @@ update_failed:
 			// +++ maybe now that we don't report Transferred flows that is no 
 			//		longer an issue; however we still need to do it for the link 
 			//		partner address in case it reconnects to the same port
-		if (rel_oid.Left(6) == "5.1.1.") {
-			if (rel_oid.Mid(6, 8) == "2.1.1.7." && m->value != 15) {
+		switch (col) {
+case MIB_COL_US_STATE:
+			if (m->value != 15) {
 					// usState, value is not "Transferred"
-				i = rel_oid.ReverseFind('.');	// last arc is the block id
-				output_flows.SetAt(rel_oid.Mid(i + 1), rel_oid.Mid(14));
-				continue;
+				index = v.IndexText(posn);
+				i = index.ReverseFind('.');	// last arc is the block id
+				s = index.Mid(i + 1);
+				unless (output_flows.Lookup(s, s2) && s2 == index) {
+					output_flows.SetAt(s, index);
+					xpt_revision += 1;
+				}
 			}
+			continue;
 
-			if (rel_oid.Mid(6, 8) == "3.3.1.2.") {
-					// udNetBlockId
-				if (m->tag != ASN1_TAG_INTEGER) continue;
-				q = input_port_list.Find(m->value);
-				if (q) {
-						// it's an input port so remember the flow; we don't 
-						//		include flows through network ports, especially 
-						//		in <flow_senders>
-					s.Format("%d", m->value);
-					input_flows.SetAt(s, rel_oid.Mid(14));
-					theApp.flow_senders.SetAt(rel_oid.Mid(14), this);
-					continue;
+case MIB_COL_UD_NET_BLOCK_ID:
+			if (m->tag != ASN1_TAG_INTEGER) continue;
+			q = input_port_list.Find(m->value);
+			if (q) {
+					// it's an input port so remember the flow; we don't 
+					//		include flows through network ports, especially 
+					//		in <flow_senders>
+				index = v.IndexText(posn);
+				s.Format("%d", m->value);
+				unless (input_flows.Lookup(s, s2) && s2 == index) {
+					input_flows.SetAt(s, index);
+					xpt_revision += 1;
 				}
+				flow_id.assign(v.oid + posn, v.oid + v.oid_len);
+				unless (theApp.flow_senders.Find(flow_id) == this) 
+												theApp.xpt_revision += 1;
+				theApp.flow_senders.Set(flow_id, this, (uint32_t)now);
 			}
+			continue;
 
-			if (value_is_new && rel_oid.Mid(6, 8) == "1.1.1.3.") {
-					// state of a network port
-				block_id = IntIndex(rel_oid.Mid(14));
-				if (block_id < 0) continue;
-				i = m->IntegerValue();
-				if (i < 0) continue;
-				unless (net_port_state.NewState(block_id, i)) continue;
-					// here if new state is _LINK_UP and have set 
-					//		_WAITING
-					// +++ at this point earlier versions checked to 
-					//		see whether they needed to upload any 
-					//		configuration or connect any virtual 
-					//		links; now that that's not needed maybe 
-					//		we don't need _WAITING state?
-				net_port_state[block_id] = NET_PORT_STATE_LINK_UP;
-				continue;
-			}
+case MIB_COL_N_PORT_STATE:
+				// state of a network port
+			unless (value_is_new) continue;
+			if (v.IndexArcs(posn, &block_id, 1) != 1) continue;
+			i = m->IntegerValue();
+			if (i < 0) continue;
+			unless (net_port_state.NewState(block_id, i)) continue;
+				// here if new state is _LINK_UP and have set 
+				//		_WAITING
+				// +++ at this point earlier versions checked to 
+				//		see whether they needed to upload any 
+				//		configuration or connect any virtual 
+				//		links; now that that's not needed maybe 
+				//		we don't need _WAITING state?
+			net_port_state[block_id] = NET_PORT_STATE_LINK_UP;
+			continue;
 
-/*			if (rel_oid.Mid(6, 8) == "1.1.1.7.") {
-					// link partner address for a network port
-				if (m->empty()) continue;
-				MgtSocket * q;
-					// +++ previously if the managed unit cleared the 
-					//		call down, e.g. bad password, we would 
-					//		keep setting up new calls; the logic needs
-					//		tidying up potentially there's something 
-					//		we need to look out for here
-				if (theApp.unit_addrs.Lookup(ByteArrayToHex(*m), 
-										(void *&)q) && q == this) {
-					ASSERT(state = MGT_ST_CLOSED);
-					state = MGT_ST_ACTIVE;
-				}
-				continue;
+/*		if (rel_oid.Mid(6, 8) == "1.1.1.7.") {
+				// link partner address for a network port
+			if (m->empty()) continue;
+			MgtSocket * q;
+				// +++ previously if the managed unit cleared the 
+				//		call down, e.g. bad password, we would 
+				//		keep setting up new calls; the logic needs
+				//		tidying up potentially there's something 
+				//		we need to look out for here
+			if (theApp.unit_addrs.Lookup(ByteArrayToHex(*m), 
+									(void *&)q) && q == this) {
+				ASSERT(state = MGT_ST_CLOSED);
+				state = MGT_ST_ACTIVE;
 			}
-*/
 			continue;
 		}
+*/
 
-		if (rel_oid == "1.1.1.16.0") {
+case MIB_COL_UNIT_IDENTIFIER:
 				// unitIdentifier; note that this is an addition to Table 1 
 				//		of 62379-1:2007
 			unless (m->size() == 8) continue;
@@ -1919,35 +1661,29 @@ update_failed:
 			i = 0;
 			do unit_id = (unit_id << 8) | m->at(++i); while (i < 7);
 			continue;
-		}
 
-		if (rel_oid == "1.1.1.8.0") {
+case MIB_COL_FIRMWARE_VERSION:
 				// unitFirmwareVersion; assume we already have unitIdentity
 			if (upd_state == UPD_ST_NO_INFO) upd_state = UPD_ST_BEGIN;
 			continue;
-		}
-
-			// we've now checked all the ones for which we may want to do 
-			//		something when it's not new
-		unless (value_is_new) continue;
 
-		if (rel_oid == "1.1.1.1.0") {
+case MIB_COL_UNIT_NAME:
 				// unitName
 				// +++ NOTE: not currently included in status broadcasts, 
 				//		so we don't get told if another management terminal 
 				//		changes it
+			unless (value_is_new) continue;
 			unit_name = m->StringValue();
 			theApp.controller_doc->NameChanged(this);
 			continue;
-		}
 
-		if (rel_oid.Left(12) == "2.1.1.1.1.2." || 
-										rel_oid.Left(12) == "3.1.1.1.1.2.") {
+case MIB_COL_A_PORT_DIRECTION:
+case MIB_COL_V_PORT_DIRECTION:
 				// direction of an audio or video port
 				// we choose the list according to the value, and don't 
 				//		store it at all if it's neither input nor output
-			block_id = IntIndex(rel_oid.Mid(12));
-			if (block_id < 0) continue;
+			unless (value_is_new) continue;
+			if (v.IndexArcs(posn, &block_id, 1) != 1) continue;
 			switch (m->value) {
 default:		continue;
 
@@ -1978,16 +1714,13 @@ case DIRECTION_OUT:
 			// here if not a status report, so should be a Get &c 
 			//		response
 		unless (call_id_error || ((b[0] & 0xF0) == 0x80 && m && 
-						m->oid == "1.0.62379.5.1.1.3.2.0")) return;
+				v.OidIs(unit_next_call_id, sizeof(unit_next_call_id)))) return;
 
 			// here if a GetResponse for unitNextCallId
 			// the loop here is somewhat convoluted because <ci> 
 			//		has to be initialised at the point where it's 
 			//		declared, which must therefore be inside the loop, 
 			//		and so its scope can't extend beyond the loop
-			// the issues with ByteString and CByteArray (see 
-			//		declaration of <ConnReqInfo>) make it really 
-			//		quite inefficient, too
 		i = (int)conn_pend.size();
 		while (i > 0) {
 			i -= 1;
@@ -2001,150 +1734,29 @@ case DIRECTION_OUT:
 					// error response (which will have been added to 
 					//		<theApp.err_msgs>)
 					// remove the entry (invalidates <ci>)
+				j = ci.salvo_entry;
 				conn_pend.erase(conn_pend.begin() + i);
+				if (j >= 0) theApp.salvo->Completed(j, false);
 				return;
 			}
 
 				// here if an OK response
-				// convert the call id into a flow id by adding 
-				//		path ref 1, direction towards the owner, 
-				//		and flow ref 1
-			m->push_back(3);
-			m->push_back(0);
-			m->push_back(0);
-			m->push_back(1);
-
-				// send Set for udDestBlockId: must be done first, to 
-				//		create srce rec
-			ByteString msg;
-			msg.resize(15);
-			msg[0]  = 0x30;			// (1) is msg ident
-			msg[2]  = ASN1_TAG_OID;	// (3) is OID length
-			msg[4]  = 40;				// 1.0
-			msg[5]  = 0x83;
-			msg[6]  = 0xE7;
-			msg[7]  = 0x2B;			// 62379
-			msg[8]  = 5;
-			msg[9]  = 1;
-			msg[10] = 1;
-			msg[11] = 3;
-			msg[12] = 3;
-			msg[13] = 1;
-			msg[14] = 21; 
-			if (!m->AppendAsIndexTo(msg)) return;
-			int v_posn = (int)msg.size();	// offset to where value goes
-			msg[3] = v_posn - 4;		// length of OID
-			msg.push_back(ASN1_TAG_INTEGER);
-			k = 1;
-			while (ci.dest_port >= (128 << (8 * (k - 1))) && k < 4) k += 1;
-			msg.push_back(k);
-			do { msg.push_back(ci.dest_port >> (8 * (k - 1))); k -= 1; } while (k > 0);
-			TxNewMessage(msg);
-
-			ByteString bs;
-			k = (int)msg.size();
-			bs.resize(k);
-			j = 0;
-			do {
-				bs[j] = msg[j];
-				j += 1;
-			} while (j < k);
-
-			s.Format("%d", ci.dest_port);
-			s = GetStringObject("1.0.62379.2.1.1.1.1.5." + s); // aPortName
-		/*	if (s.IsEmpty() || !theApp.name_translations.Lookup(s, s) || 
-								sscanf_s(s, " (%u", &j) != 1)*/ ci.m.resize(4);
-		/*	else {
-					// have an audio port name including an importance
-				ci.m.resize(5);
-				ci.m[4] = bs;
-					// send Set for importance
-				msg.SetAt(14, 14);				// column; rest of OID is the same
-				msg.SetAt(v_posn, ASN1_TAG_INTEGER);
-				if (j < 128) {
-					k = v_posn + 3;
-					msg.SetSize(k);
-					msg.SetAt(v_posn + 1, 1);		// length
-					msg.SetAt(v_posn + 2, j);		// value
-				}
-				else {
-					k = v_posn + 4;
-					msg.SetSize(k);
-					msg.SetAt(v_posn + 1, 2);		// length
-					msg.SetAt(v_posn + 2, j >> 8);	// value
-					msg.SetAt(v_posn + 3, j);
-				}
-				TxNewMessage(msg);
-
-				bs.resize(k);
-				j = 0;
-				do {
-					bs[j] = msg[j];
-					j += 1;
-				} while (j < k);
-			}*/
-			ci.m[3] = bs;
-
-
-				// send Set for udSourceAddrType
-			k = v_posn + 9;
-			msg.resize(k);
-			msg[14] = 4;				// column; rest of OID is the same
-			msg[v_posn] = ASN1_TAG_OID;
-			msg[v_posn + 1] = 7;		// length
-			msg[v_posn + 2] = 40;		// 1.0
-			msg[v_posn + 3] = 0x83;
-			msg[v_posn + 4] = 0xE7;
-			msg[v_posn + 5] = 0x2B;	// 62379
-			msg[v_posn + 6] = 5;
-			msg[v_posn + 7] = 2;
-			msg[v_posn + 8] = 2;
-			TxNewMessage(msg);
-
-			bs.resize(k);
-			j = 0;
-			do {
-				bs[j] = msg[j];
-				j += 1;
-			} while (j < k);
-			ci.m[2] = bs;
-
-				// send Set for udSourceAddress
-			msg.resize(v_posn + 2);
-			msg[14] = 5;				// column; rest of OID is the same
-			msg[v_posn] = ASN1_TAG_OCTET_STRING;
-			ByteString& uta = ci.srce_addr;
-			k = (int)(uta.size());
-			msg[v_posn + 1] = (uint8_t)k;
-			j = 0;
-			while (j < k) msg.push_back(uta[j++]);
-			TxNewMessage(msg);
-
-			k = (int)msg.size();
-			bs.resize(k);
-			j = 0;
-			do {
-				bs[j] = msg[j];
-				j += 1;
-			} while (j < k);
-			ci.m[1] = bs;
-
-				// send Set for udState: must be done last, to send FindRoute
-			k = v_posn + 3;
-			msg.resize(k);
-			msg[14] = 9;				// column; rest of OID is the same
-			msg[v_posn] = ASN1_TAG_INTEGER;
-			msg[v_posn + 1] = 1;		// length
-			msg[v_posn + 2] = 1;		// 1 = readyToConnect
-			TxNewMessage(msg);
-
-			bs.resize(k);
-			j = 0;
-			do {
-				bs[j] = msg[j];
-				j += 1;
-			} while (j < k);
-			ci.m[0] = bs;
+				// build the Set in <setup_msg>, and send it as it is 
+				//		unless the unit has rejected one before
+			ByteString& msg = setup_msg;
+			int ends[4];
+			msg.clear();
+			msg.push_back(0x30);	// (1) is msg ident
+			msg.push_back(0);
+			unless (AppendSetupVarBinds(msg, v, ci, ends)) return;
+			unless (multi_set_ok) {
+				SendSetupSeparately(ci, msg, ends);
+				return;
+			}
+			TxNewMessage(msg, true, REQ_CONN);
+			ci.m.resize(1);
+			ci.m[0] = msg;
+			ci.ends.assign(ends, ends + 4);
 		}
 		return;
 	}
@@ -2153,134 +1765,316 @@ case DIRECTION_OUT:
 	if (b[1] == 0) return;
 
 		// here if an in-cycle message
-	if (len != 0) {
+	if (r.Remaining() != 0) {
 			// still something left in the message but not a valid object
-		next_seq = 0;	// no longer sure of the integrity of this cycle
+		cycle.Abandon();	// no longer sure of the integrity of this cycle
 		return;
 	}
 
-	if (next_seq < 2 || (b[0] & 0x0F) != 0x0F) return;
+	unless (cycle.Complete(b[0])) return;
 
 		// here if end of an OK cycle
 		// request another; don't need to do this every time but it's not 
 		//		not much of an overhead to do so
 	RequestStatus(false);
 
-		// go through the MIB removing anything that should have been reported 
-		//		during this cycle but wasn't
-	q2 = mib.GetHeadPosition();
-	while (q2 != NULL) {
-		q = q2;
-		m = mib.GetNext(q2);
-			// don't remove objects that were reported in the reply to a Get 
-			//		or GetNext (such as UnitIdentity) 
-		if ((m->msg_type & 0x20) == 0) continue;
-
-		if (m->recd >= start_cycle_time) continue; // been reported this cycle
-
-			// here if <m>, which is at position <q>, was last reported in a 
-			//		Status Response or Set Response before the current cycle 
-			//		so must now have become obsolete; Set Response includes 
-			//		dest list entries for temporary flow ids and when setting 
-			//		state to "terminating"
-			// remove from <mib> and <mib_map>
-		mib.RemoveAt((POSITION)q);
-		mib_map.RemoveKey(m->oid);
-
-		if (m->oid.Left(10) != "1.0.62379.") {
-			delete m;
+		// remove anything that should have been reported during this cycle 
+		//		but wasn't; the aging list is in the order in which objects 
+		//		were last reported, so these are the ones at the start of it, 
+		//		and we don't need to look at any of the others
+		// objects that were reported in the reply to a Get or GetNext (such 
+		//		as UnitIdentity) aren't on the list, so don't get removed
+	while ((m = mib.Oldest()) != NULL && m->recd < cycle.start_time) {
+			// here if <m> was last reported in a Status Response or Set 
+			//		Response before the current cycle so must now have 
+			//		become obsolete; Set Response includes dest list entries 
+			//		for temporary flow ids and when setting state to 
+			//		"terminating"
+		col = ClassifyOid(m->oid_ber.data(), (int)m->oid_ber.size(), posn);
+		unless (col == MIB_COL_NONE) xpt_revision += 1;
+		theApp.mib_bus.Publish(this, MIB_BIT(col));
+		unless (col == MIB_COL_N_PORT_STATE || ((col == MIB_COL_A_PORT_DIRECTION 
+						|| col == MIB_COL_V_PORT_DIRECTION) && 
+										m->tag == ASN1_TAG_INTEGER)) {
+			mib.Remove(m);
 			continue;
 		}
 
 			// here if it might be in one of the lists
-		rel_oid = m->oid.Mid(10);
-		bool integer = (m->tag == ASN1_TAG_INTEGER);
+		if (OidArcs(m->oid_ber.data() + posn, (int)m->oid_ber.size() - posn, 
+												&block_id, 1) != 1) block_id = -1;
 		int value = m->value;
-		delete m;
+		mib.Remove(m);
 
 			// the rest of the tidying up has been done, so we just need to 
-			//		find and remove the entry for <rel_oid>, if any
-		if (rel_oid.Left(6) == "5.1.1.") {
-			if (rel_oid.Mid(6, 8) == "1.1.1.3.") {
-					// state of a network port; note that <erase> does 
-					//		nothing if the key isn't found, which will be 
-					//		the case if IntIndex returns -1
-					// NB we don't expect this to happen for physical ports
-				net_port_state.Remove(IntIndex(rel_oid.Mid(14)));
-				continue;
-			}
-
+			//		find and remove the entry for <block_id>, if any
+		if (block_id < 0) continue;
+		if (col == MIB_COL_N_PORT_STATE) {
+				// state of a network port; note that <erase> does 
+				//		nothing if the key isn't found
+				// NB we don't expect this to happen for physical ports
+			net_port_state.Remove(block_id);
 			continue;
 		}
 
-		if (integer && (rel_oid.Left(12) == "2.1.1.1.1.2." || 
-										rel_oid.Left(12) == "3.1.1.1.1.2.")) {
-				// direction of an audio or video port
-				// we choose the list according to the value, and don't 
-				//		store it at all if it's neither input nor output
-			block_id = IntIndex(rel_oid.Mid(12));
-			if (block_id < 0) continue;
-			switch (value) {
-default:		continue;
+			// direction of an audio or video port
+			// we choose the list according to the value, and don't 
+			//		store it at all if it's neither input nor output
+		switch (value) {
+default:	continue;
 
 case DIRECTION_IN:
-				list = &input_port_list;
-				break;
+			list = &input_port_list;
+			break;
 
 case DIRECTION_OUT:
-				list = &output_port_list;
-			}
-
-			q = list->Find(block_id);
-			if (q != NULL) list->RemoveAt((POSITION)q);
-			continue;
+			list = &output_port_list;
 		}
+
+		q = list->Find(block_id);
+		if (q != NULL) list->RemoveAt((POSITION)q);
 	}
 }
 
 
 // see whether there are any areas marked INVALID, and if so send the 
-//		Erase request; set <upd_state> accordingly
+//		Erase requests; set <upd_state> to ERASING if there are replies to 
+//		wait for, else WAITING if the unit is still erasing something, else 
+//		as for finished (or out of space if we were trying to make some)
 // searches the whole map each time, in case it has changed
-void MgtSocket::SendNextErase() {
-	upd_area = flash.begin();
-	while (true) {
-		if (upd_area == flash.end()) {
-				// none found
-			upd_state = (upd_state == UPD_ST_ERASING ? UPD_ST_WAITING : 
-							upd_state == UPD_ST_MAKE_SPACE ? 
-								UPD_ST_BAD_FLASH : UPD_ST_UP_TO_DATE);
-			return;
-		}
-		if (upd_area->second.status == AREA_STATUS_INVALID) break;
-		upd_area++;
-	}
+void MgtSocket::StartErasing() {
+	bool invalid = false;
+	bool erasing = false;
+	FlashMap::iterator a = flash.begin();
+	for (; a != flash.end(); a++) {
+		if (a->second.status == AREA_STATUS_INVALID) invalid = true;
+		else if (a->second.status == AREA_STATUS_ERASING) erasing = true;
+	}
+
+	if (invalid) {
+		unless (OkToUpdate()) return;
+		SendErases();
+		if (state > MGT_ST_MAX_OK) return;
+	}
+	if (!erase_pending.empty()) upd_state = UPD_ST_ERASING;
+	else if (erasing) WaitForErases();
+	else upd_state = (upd_state == UPD_ST_MAKE_SPACE) ? 
+										UPD_ST_BAD_FLASH : UPD_ST_UP_TO_DATE;
+}
+
+
+// send Erase requests for areas marked INVALID until FLASH_MAX_ERASES are 
+//		awaiting a reply; doesn't change <upd_state>
+int MgtSocket::SendErases() {
+	FlashMap::iterator a = flash.begin();
+	BeginHashBatch();
+	for (; a != flash.end() && (int)erase_pending.size() < FLASH_MAX_ERASES; 
+																		a++) {
+		unless (a->second.status == AREA_STATUS_INVALID) continue;
+
+		uint8_t b[24];
+		b[0]  = 0x30;	// "Set" request
+		b[2]  = ASN1_TAG_OID;
+		b[4]  = 0x28;	// OID 1.0.62379.1.1.5.1.1.4.a
+		b[5]  = 0x83;
+		b[6]  = 0xE7;
+		b[7]  = 0x2B;
+		b[8]  = 1;
+		b[9]  = 1;
+		b[10] = 5;
+		b[11] = 1;
+		b[12] = 1;
+		b[13] = 4;
+		uint8_t * p = b + 14;
+		AddIndex(p, a->first);	// index: 1 or 2 bytes
+		b[3] = (uint8_t)((p - b) - 4);	// OID size, assumed < 128
+		AddInteger(p, AREA_STATUS_ERASING); // new value: 3 bytes
+
+		TxNewMessage(b, (int)(p - b), true, REQ_ERASE);
+		if (state > MGT_ST_MAX_OK) break;	// transmission failed
+
+		a->second.status = AREA_STATUS_ERASING;
+		erase_pending[b[1]] = a->first;
+	}
+	EndHashBatch();
+	return (int)erase_pending.size();
+}
+
+
+// all the Erase requests have been accepted, but the unit may not have 
+//		finished yet; OnIdle() carries on when the map shows it has
+void MgtSocket::WaitForErases() {
+	upd_state = UPD_ST_WAITING;
+	theApp.StartTimer((FlexilinkSocket *)this, TMR_UNIT_FLASH, FLASH_ERASE_POLL);
+}
 
-		// here if we've found an area to be erased
-	unless (OkToUpdate()) return;
 
-	uint8_t b[24];
+// send tranches of <image> until <upd_window_size> are awaiting 
+//		acknowledgement or there are no more to send; if all have been sent 
+//		and acknowledged, send the Set that marks the area as valid
+// also stops if <theApp.rollout> says the link's budget has been used up; 
+//		in that case OnIdle() calls it again later
+// OID for the data is 1.0.62379.1.1.5.2.1.4.a.o.l (a = area, o = offset, 
+//		l = length), for the area status is 1.0.62379.1.1.5.1.1.4.a
+void MgtSocket::FillUploadWindow() {
+	uint8_t b[MAX_DATA_LENGTH + 40];
+	uint8_t * p;
+	int k;
+
 	b[0]  = 0x30;	// "Set" request
 	b[2]  = ASN1_TAG_OID;
-	b[4]  = 0x28;	// OID 1.0.62379.1.1.5.1.1.4.a
+	b[4]  = 0x28;	// OID begins 1.0.62379.1.1.5
 	b[5]  = 0x83;
 	b[6]  = 0xE7;
 	b[7]  = 0x2B;
 	b[8]  = 1;
 	b[9]  = 1;
 	b[10] = 5;
+	b[12] = 1;
+	b[13] = 4;		// column number for both swcData and swaStatus
+
+	BeginHashBatch();
+	while ((int)upd_window.size() < upd_window_size) {
+			// set <k> to bytes still to be sent
+		k = image.size() - upd_offset;
+		if (k <= 0) break;
+		if (k > MAX_DATA_LENGTH) k = MAX_DATA_LENGTH;
+		unless (theApp.rollout->TakeBudget(k)) break;	// see OnIdle()
+
+		b[11] = 2;
+		p = b + 14;
+		AddIndex(p, upd_area->first);
+		AddIndex(p, upd_offset);
+		AddIndex(p, k);
+			// now <p> points to where the tag byte for the value will go
+		b[3] = (uint8_t)((p - b) - 4);
+		*p++ = ASN1_TAG_OCTET_STRING;
+		AddLength(p, k);
+		image.Copy(p, upd_offset, k);
+		p += k;
+
+		TxNewMessage(b, (int)(p - b), true, REQ_TRANCHE);
+		if (state > MGT_ST_MAX_OK) break;	// transmission failed
+
+			// note: TxNewMessage() has filled in the serial number
+		UploadTranche& t = upd_window[b[1]];
+		t.offset = upd_offset;
+		t.length = k;
+		upd_offset += k;
+	}
+	EndHashBatch();
+	if (state > MGT_ST_MAX_OK) return;
+
+	unless (upd_window.empty() && upd_offset >= image.size()) return;
+
+		// here when the last tranche has been acknowledged
+		// set the area to "valid"
 	b[11] = 1;
+	p = b + 14;
+	AddIndex(p, upd_area->first);
+	b[3] = (uint8_t)((p - b) - 4);
+	*p++ = ASN1_TAG_INTEGER;
+	*p++ = 1;
+	*p++ = AREA_STATUS_VALID;
+	TxNewMessage(b, (int)(p - b), true, REQ_UPDATE);
+}
+
+
+// note that the tranche sent in request <r> has been acknowledged, and 
+//		adjust the window
+// the round-trip time is only measured if <r> was only sent once; if 
+//		it's close to the smallest seen the unit is keeping up, so we 
+//		can allow another tranche to be outstanding, but if it's a lot 
+//		bigger the tranches are being queued so we allow one fewer
+void MgtSocket::UploadAcked(const PendingRequest& r) {
+	unless (r.kind == REQ_TRANCHE && r.sends == 1) return;
+	int rtt = (int)(GetTickCount64() - r.sent);
+
+	if (upd_min_rtt < 0 || rtt < upd_min_rtt) upd_min_rtt = rtt;
+
+	if (rtt > 4 * upd_min_rtt + 50) {
+		if (upd_window_size > UPD_WINDOW_MIN) upd_window_size -= 1;
+		upd_window_acks = 0;
+	}
+	else if (rtt <= 2 * upd_min_rtt + 20 && 
+							++upd_window_acks >= upd_window_size) {
+		if (upd_window_size < UPD_WINDOW_MAX) upd_window_size += 1;
+		upd_window_acks = 0;
+	}
+}
+
+
+void MgtSocket::ClearUploadWindow() {
+	upd_window.clear();
+	requests.RemoveKind(REQ_TRANCHE);
+}
+
+
+// if the data part of an upload was in progress, note how far it got so it 
+//		can be continued (see <ResumeUpload>); any earlier checkpoint is 
+//		kept if not
+void MgtSocket::SaveCheckpoint() {
+	unless ((upd_state == UPD_ST_UPLOADING && upd_offset >= 0) || 
+								upd_state == UPD_ST_VERIFYING) return;
+	if (upd_area == flash.end() || image.size() <= 0) return;
+	upd_resume.area = upd_area->first;
+	upd_resume.data_type = upd_area->second.data_type;
+	upd_resume.serial = upd_area->second.serial;
+	upd_resume.written = upd_written;
+	upd_resume.file = image.file;
+	upd_resume.overlay = image.overlay;
+}
+
+
+// read back UPD_VERIFY_SAMPLES tranches spread over the first <upd_written> 
+//		bytes, the last of them ending at <upd_written> as that's the one 
+//		most likely to have been cut short; tranches are on multiples of 
+//		MAX_DATA_LENGTH, as when they were written
+// OID is 1.0.62379.1.1.5.2.1.4.a.o.l as for <FillUploadWindow>
+void MgtSocket::SendVerifyRequests() {
+	uint8_t b[40];
+	uint8_t * p;
+	int offset, k;
+	int last = -1;	// offset of the previous sample
+
+	upd_state = UPD_ST_VERIFYING;
+	upd_verify.clear();
+	b[0]  = 0x00;	// "Get" request
+	b[2]  = ASN1_TAG_OID;
+	b[4]  = 0x28;	// OID begins 1.0.62379.1.1.5.2.1.4
+	b[5]  = 0x83;
+	b[6]  = 0xE7;
+	b[7]  = 0x2B;
+	b[8]  = 1;
+	b[9]  = 1;
+	b[10] = 5;
+	b[11] = 2;
 	b[12] = 1;
 	b[13] = 4;
-	uint8_t * p = b + 14;
-	AddIndex(p, upd_area->first);	// index: 1 or 2 bytes
-	b[3] = (uint8_t)((p - b) - 4);	// OID size, assumed < 128
-	AddInteger(p, AREA_STATUS_ERASING); // new value: 3 bytes
 
-	TxNewMessage(b, (int)(p - b), true, true);
-
-	upd_area->second.status = AREA_STATUS_ERASING;
-	upd_state = UPD_ST_ERASING;
+	BeginHashBatch();
+	int i = 0;
+	while (++i <= UPD_VERIFY_SAMPLES) {
+		offset = (int)(((int64_t)upd_written * i) / UPD_VERIFY_SAMPLES) - 1;
+		offset -= offset % MAX_DATA_LENGTH;
+		if (offset <= last) continue;
+		last = offset;
+		k = upd_written - offset;
+		if (k > MAX_DATA_LENGTH) k = MAX_DATA_LENGTH;
+
+		p = b + 14;
+		AddIndex(p, upd_area->first);
+		AddIndex(p, offset);
+		AddIndex(p, k);
+		b[3] = (uint8_t)((p - b) - 4);
+		TxNewMessage(b, (int)(p - b), true, REQ_VERIFY);
+		if (state > MGT_ST_MAX_OK) break;	// transmission failed
+
+		UploadTranche& t = upd_verify[b[1]];
+		t.offset = offset;
+		t.length = k;
+	}
+	EndHashBatch();
 }
 
 
@@ -2395,13 +2189,43 @@ CString MgtSocket::DisplayName() {
 	return str + ' ' + s;
 }
 
-// if <s> is a decimal integer, return its value; otherwise return -1
-// intended for retrieving an index value from the end of an OID
-int MgtSocket::IntIndex(CString s) {
-	int i;
-	int n = -1;
-	sscanf_s(s, "%d%n", &i, &n);
-	return n == s.GetLength() ? i : -1;
+// return the object in column <col> with index <index>, or NULL if not 
+//		present
+MibObject * MgtSocket::GetObject(int col, int index) {
+	uint8_t b[MIB_COL_MAX_OID_LEN + 5];
+	int n = MibColumnOid(col, b);
+	int k;
+	if (n == 0 || index < 0) return NULL;
+		// append <index> as a single arc; set <k> to 7 * ((bytes to add) - 1)
+	k = 0;
+	while (k < 28 && (index >> k) >= 128) k += 7;
+	while (k > 0) { b[n++] = (uint8_t)((index >> k) | 0x80); k -= 7; }
+	b[n++] = (uint8_t)(index & 0x7F);
+	return mib.Find(b, n);
+}
+
+// as above, with the index arcs in dotted-decimal form (e.g. a flow id as 
+//		stored in <output_flows>)
+MibObject * MgtSocket::GetObject(int col, const char * index) {
+	uint8_t b[MAX_OID_LENGTH];
+	int n = MibColumnOid(col, b);
+	uint32_t arc;
+	int k;
+	if (n == 0) return NULL;
+	while (*index != 0) {
+		unless (*index >= '0' && *index <= '9') return NULL;
+		arc = 0;
+		do arc = arc * 10 + (*index++ - '0'); while (*index >= '0' && *index <= '9');
+		if (*index == '.') index += 1;
+		else unless (*index == 0) return NULL;
+			// set <k> to 7 * ((bytes to add) - 1)
+		k = 0;
+		while (k < 28 && (arc >> k) >= 128) k += 7;
+		if (n + k / 7 >= MAX_OID_LENGTH) return NULL;
+		while (k > 0) { b[n++] = (uint8_t)((arc >> k) | 0x80); k -= 7; }
+		b[n++] = (uint8_t)(arc & 0x7F);
+	}
+	return mib.Find(b, n);
 }
 
 
@@ -2421,7 +2245,7 @@ POSITION MgtSocket::PortLocation(PortList * list, int n) {
 }
 
 
-// first character is:
+// flag is:
 //		't' for transmitted message,
 //		'e' for transmission error,
 //		'r' for an OK received message
@@ -2430,40 +2254,24 @@ POSITION MgtSocket::PortLocation(PortList * list, int n) {
 //		'?' for a received message without a valid AES51 header
 //		'H' for a dump of an iteration of the hash calculation
 // also flags that the state has changed
+// the label is only used if the messages are exported to a capture file
 void FlexilinkSocket::SaveMessage(uint8_t * b, int len, char flag)
 {
-		// only save the last 300-ish; remove several at a time in case 
-		//		removal involves a lot of copying
-	if (msgs.GetSize() > 300) msgs.RemoveAt(0,10);
-
-	if (len == 0) {
-		msgs.Add("*** empty message ***");
-		UpdateMibDisplay();
-		return;
-	}
-
-		// only save the first 160 bytes if 3 chars/byte; longer lines 
-		//		exceed the maximum window size
-	CString s;
-//	s.Format("%c%4d", flag, len);
-	s.Format("%c%4d%2d", flag, len, state); // +++ TEMP
-	if (flag == 'H') {
-		if (len > 200) len = 200;
-		int i = 0;
-		while (i < len) {
-			s.AppendFormat(((i & 7) == 0) ? " %02X" : "%02X", (int) b[i^7]);
-			i += 1;
-		}
-	}
-	else {
-		if (len > 160) len = 160;
-		int i = 0;
-		while (i < len) {
-			s.AppendFormat(" %02X", (int) b[i]);
-			i += 1;
-		}
+	int label;
+	switch (flag) {
+case 't': case 'e':
+		label = tx_flow;
+		break;
+case 'T': case 'E':
+		label = (aes51_data_hdr[8] << 8) | aes51_data_hdr[9];
+		break;
+case 'R':
+		label = RCV_SIG_FLOW;
+		break;
+default:
+		label = AddHec(call_ref & 0x1FFF);
 	}
-	msgs.Add(s);
+	msgs.Add(b, len, flag, label, state);	// +++ TEMP state
 
 	UpdateMibDisplay();
 }
@@ -2502,48 +2310,25 @@ void  FlexilinkSocket::SaveMessage(ByteString b, char flag)
 
 // add text <b> to the console output
 // also switches to console display if this unit is in the controller window
+// text is added to the current last line unless it starts with a newline
 void FlexilinkSocket::SaveConsole(unsigned char * b, INT_PTR len)
 {
-	std::string s;
-	int i;
-	if (b[0] == '\n') i = 0;
-	else {
-			// start by adding text to the current last line
-		i = (int)console.size();
-		if (i > 0) {
-			s = console.at(i - 1);
-			console.pop_back();
-		}
-		i = -1;
-	}
-
-	while (++i < len) {
-		if (b[i] == '\n') {
-			console.push_back(s);
-			s.clear();
-		}
-		else s += b[i];
-	}
-
-	ConsoleLine(s);
+	console.Append((const char *)b, (int)len);
+	UpdateDisplay();
 }
 
 // add line <s> to the console output
 void FlexilinkSocket::ConsoleLine(std::string s)
 {
-	console.push_back(s);
-
-		// only save the last 2000-ish lines; remove several at a time in case 
-		//		removal involves a lot of copying
-	int i = (int)console.size() - 2000;
-	if (i > 25) console.erase(console.begin(), console.begin() + i);
-
+	console.NewLine();
+	console.Append(s);
 	UpdateDisplay();
 }
 
 
-// check whether anything needs to be repeated: called every 1/2 sec 
-//		as long as the link is up
+// called when one of this object's timers expires; nothing is done while 
+//		the link is down, because all the units are reconnected when it 
+//		comes back up (see <CControllerApp::NewLinkPartner>)
 // sets the state to "timed out" if the unit seems to have stopped 
 //		responding
 // note that if we get no reply to a request because the link has gone 
@@ -2553,23 +2338,16 @@ void FlexilinkSocket::ConsoleLine(std::string s)
 //		session-layer state from application-layer state; most of the 
 //		MIB accesses are stateless as far as the managed unit is 
 //		concerned, though
-// does nothing (so is safe) if <this> is NULL
 
-// base class version; returns whether OK
-bool FlexilinkSocket::PollAwaitingAck()
+// base class version
+void FlexilinkSocket::TimerExpired(int kind)
 {
-	if (this == NULL || 
-			theApp.link_socket->state != LINK_ST_ACTIVE) return false;
+	if (theApp.link_socket->state != LINK_ST_ACTIVE) return;
 
-	if (keep_alive_count > 130) {
-			// seen nothing for 1 min 5 secs; ought to have had three 
-			//		status broadcasts in that time
-		SetStateTimedOut();
-		return false;
-	}
-	keep_alive_count += 1;
-
-	if (state > MGT_ST_MAX_OK) {
+	bool ok;
+	ULONGLONG now = GetTickCount64();
+	switch (kind) {
+case TMR_UNIT_RETRY:
 			// various kinds of failure; in general if, say, a 
 			//		connection is cleared down we retry it immediately 
 			//		and if that doesn't work retry again every 10 
@@ -2579,20 +2357,27 @@ bool FlexilinkSocket::PollAwaitingAck()
 			// +++ for the ones we don't re-try, ought to wait a bit 
 			//		and then delete the MgtSocket object in case it's 
 			//		a problem such as having got a password wrong
-		if (state >= MGT_ST_MIN_RETRY || 
-								keep_alive_count >= 20) SendConnReq();
-		return false;
-	}
-
-	if (mgt_msg.m.empty()) return true;
+		if (state > MGT_ST_MAX_OK) SendConnReq();
+		return;
 
-	bool ok;
-	if (mgt_msg.count >= MAX_REPEAT_COUNT) {
+case TMR_UNIT_LIVENESS:
+		if (state > MGT_ST_MAX_OK) return;
+		if (now - last_rx < MGT_SILENCE_TIMEOUT) {
+			theApp.StartTimerAt(this, TMR_UNIT_LIVENESS, 
+											last_rx + MGT_SILENCE_TIMEOUT);
+			return;
+		}
+			// ought to have had several status broadcasts in that time
 		SetStateTimedOut();
-		return false;
-	}
-	mgt_msg.count += 1;
-	if (mgt_msg.count > 1) {
+		return;
+
+case TMR_UNIT_SIGNAL:
+		if (mgt_msg.m.empty() || state > MGT_ST_MAX_OK) return;
+		if (mgt_msg.count >= MAX_REPEAT_COUNT) {
+			SetStateTimedOut();
+			return;
+		}
+		mgt_msg.count += 1;
 			// resend the message
 		if (state == MGT_ST_CONN_REQ) {
 				// it's a signalling message
@@ -2600,48 +2385,233 @@ bool FlexilinkSocket::PollAwaitingAck()
 			SaveMessage(mgt_msg.m.data(), mgt_msg.m.size(), (ok ? 'T' : 'E'));
 			unless (ok) {
 				SetStateFailed();
-				return false;
+				return;
 			}
 		}
 		else TxMessage(mgt_msg.m); // NB simply repeats the payload verbatim
+		theApp.StartTimer(this, TMR_UNIT_SIGNAL, MGT_MSG_REPEAT);
+		return;
 	}
+}
+
+
+void FlexilinkSocket::ScheduleRetry()
+{
+	theApp.StartTimer(this, TMR_UNIT_RETRY, 
+				(state >= MGT_ST_MIN_RETRY) ? MGT_RETRY_SOON : MGT_RETRY_WAIT);
+}
+
+
+// the port's importance is in the top 2 bits of the aPortImportance or 
+//		vPortImportance object; the privilege must be higher
+bool MgtSocket::MayConnect(int port)
+{
+	if (theApp.privilege < PRIV_OPERATOR) return false;
+	MibObject * obj = GetObject(MIB_COL_A_PORT_IMPORTANCE, port);
+	if (obj == NULL) obj = GetObject(MIB_COL_V_PORT_IMPORTANCE, port);
+	return obj != NULL && theApp.privilege > (obj->IntegerValue() >> 6);
+}
+
+
+// begin by asking for a call id; the rest is done when the reply arrives 
+//		(see <ReceiveData>)
+bool MgtSocket::RequestConnection(int port, MgtSocket * srce, int srce_port, 
+															int salvo_entry)
+{
+	static const uint8_t unit_next_call_id[] = 	// 1.0.62379.5.1.1.3.2.0
+								{ 0x28, 0x83, 0xE7, 0x2B, 5, 1, 1, 3, 2, 0 };
+	ConnReqInfo ci;
+	ci.dest_port = port;
+	ci.salvo_entry = salvo_entry;
+	ci.m.resize(1);
+	ByteString& msg = ci.m[0];
+	msg.push_back(0);		// "Get" request
+	msg.push_back(0);
+	msg.push_back(ASN1_TAG_OID);
+	msg.push_back(sizeof(unit_next_call_id));
+	msg.insert(msg.end(), unit_next_call_id, 
+							unit_next_call_id + sizeof(unit_next_call_id));
+	TxNewMessage(msg, true, REQ_CONN);
+	if (state > MGT_ST_MAX_OK) return false;	// transmission failed
+
+		// the source address is the unit's address followed by the port 
+		//		number, always 32 bits
+	ByteString& uta = srce->unit_TAddress;
+	ci.srce_addr.push_back(0);
+	ci.srce_addr.push_back((uint8_t)uta.size());
+	ci.srce_addr.insert(ci.srce_addr.end(), uta.begin(), uta.end());
+	ci.srce_addr.push_back(9);
+	int k = 24;
+	do { ci.srce_addr.push_back(srce_port >> k); k -= 8; } while (k >= 0);
+
+		// add an entry to the list of pending connections
+	conn_pend.push_back(ci);
 	return true;
 }
 
 
+// add the VarBinds for setting up the connection described by <ci> to <msg>, 
+//		in the order in which the unit needs them: udDestBlockId first, to 
+//		create the source record, and udState last, to send the FindRoute
+// the OID is that of the udEntry row for the flow id, which is the call id 
+//		<v> with path ref 1, direction towards the owner, and flow ref 1 
+//		added; the VarBinds differ only in the column
+// assumes the OID and source address are each less than 128 bytes
+bool MgtSocket::AppendSetupVarBinds(ByteString& msg, VarBindView& v, 
+												ConnReqInfo& ci, int * ends)
+{
+	static const uint8_t ud_entry[] = 	// 1.0.62379.5.1.1.3.3.1
+								{ 0x28, 0x83, 0xE7, 0x2B, 5, 1, 1, 3, 3, 1 };
+	static const uint8_t flow_suffix[] = { 3, 0, 0, 1 };
+	static const uint8_t fl_addr_type[] = 	// 1.0.62379.5.2.2
+								{ 0x28, 0x83, 0xE7, 0x2B, 5, 2, 2 };
+	static const uint8_t columns[] = { 21, 4, 5, 9 };
+	int oid_posn = (int)msg.size();
+	msg.push_back(ASN1_TAG_OID);
+	msg.push_back(0);			// OID length, filled in below
+	msg.insert(msg.end(), ud_entry, ud_entry + sizeof(ud_entry));
+	int col_posn = (int)msg.size();
+	msg.push_back(columns[0]);
+	unless (v.AppendAsIndexTo(msg, flow_suffix, 4)) return false;
+	int n = (int)msg.size() - oid_posn;	// length of OID including tag and length
+	if (n > 129) return false;
+	msg[oid_posn + 1] = (uint8_t)(n - 2);
+
+	int i = 0;
+	while (true) {
+		int k;
+		switch (i) {
+case 0:		// udDestBlockId
+			msg.push_back(ASN1_TAG_INTEGER);
+			k = 1;
+			while (ci.dest_port >= (128 << (8 * (k - 1))) && k < 4) k += 1;
+			msg.push_back(k);
+			do { msg.push_back(ci.dest_port >> (8 * (k - 1))); k -= 1; } while (k > 0);
+			break;
+
+case 1:		// udSourceAddrType
+			msg.push_back(ASN1_TAG_OID);
+			msg.push_back(sizeof(fl_addr_type));
+			msg.insert(msg.end(), fl_addr_type, fl_addr_type + sizeof(fl_addr_type));
+			break;
+
+case 2:		// udSourceAddress
+			msg.push_back(ASN1_TAG_OCTET_STRING);
+			msg.push_back((uint8_t)ci.srce_addr.size());
+			msg.insert(msg.end(), ci.srce_addr.begin(), ci.srce_addr.end());
+			break;
+
+case 3:		// udState
+			msg.push_back(ASN1_TAG_INTEGER);
+			msg.push_back(1);		// length
+			msg.push_back(1);		// 1 = readyToConnect
+			break;
+		}
+		ends[i] = (int)msg.size();
+		if (++i >= 4) return true;
+
+			// copy the OID for the next VarBind, with the new column
+		int p = (int)msg.size();
+		k = 0;
+		do { msg.push_back(msg[oid_posn + k]); } while (++k < n);
+		msg[p + col_posn - oid_posn] = columns[i];
+	}
+}
+
+
+// send the VarBinds from <msg> (as built by <AppendSetupVarBinds>) each in 
+//		a Set of its own, in the same order, and record the messages in <ci> 
+//		with the last one first, as <ReceiveData> expects
+void MgtSocket::SendSetupSeparately(ConnReqInfo& ci, const ByteString& msg, 
+															const int * ends)
+{
+	int i = 0;
+	int posn = 2;	// start of the first VarBind
+	ci.m.resize(4);
+	do {
+		ByteString& bs = ci.m[3 - i];
+		bs.clear();
+		bs.push_back(0x30);
+		bs.push_back(0);
+		bs.insert(bs.end(), msg.begin() + posn, msg.begin() + ends[i]);
+		TxNewMessage(bs, true, REQ_CONN);
+		posn = ends[i];
+	} while (++i < 4);
+	ci.ends.clear();
+}
+
+
 // version for management sockets
-// +++ currently only called in one place which ignores the result
 // NB analyser sockets just use the base class version
-bool MgtSocket::PollAwaitingAck()
+void MgtSocket::TimerExpired(int kind)
 {
-	unless (FlexilinkSocket::PollAwaitingAck()) return false;
+	unless (kind == TMR_UNIT_REQUEST || kind == TMR_UNIT_FLASH) {
+		FlexilinkSocket::TimerExpired(kind);
+		return;
+	}
+	if (theApp.link_socket->state != LINK_ST_ACTIVE || 
+										state > MGT_ST_MAX_OK) return;
 
-	int i;
-	unless (upd_msg.m.empty()) {
-		if (upd_msg.count >= MAX_REPEAT_COUNT) {
-			SetStateTimedOut();
-			return true;
-		}
-		upd_msg.count += 1;
-		if (upd_msg.count > 1) {
-				// resend the message
-			TxMessage(upd_msg.m);
-		}
+	if (kind == TMR_UNIT_FLASH) {
+			// see whether the erases have finished
+		if (upd_state == UPD_ST_WAITING) StartCollectFlashMap();
+		return;
 	}
 
-	i = (int)conn_pend.size();
-	while (i > 0) {
-		ConnReqInfo& inf = conn_pend.at(--i);
-		if (inf.count >= MAX_REPEAT_COUNT) {
-			SetStateTimedOut();
-			return true;
-		}
-		inf.count += 1;
-		if (inf.count > 1) {
-				// resend the messages
-			int j = (int)inf.m.size();
-			while (j > 0) TxMessage(inf.m[--j]);
+		// repeat any requests that haven't been acknowledged within the 
+		//		timeout (or for which the unit said it was busy); the others 
+		//		are left alone as their replies may still be on the way
+	ULONGLONG now = GetTickCount64();
+	bool repeated = false;	// whether a tranche of flash data was repeated
+	int i;
+	BeginHashBatch();
+	while ((i = requests.Due(now)) >= 0) {
+		PendingRequest * p = requests.Find(i);
+		if (p->repeat && now - p->first_sent < REQ_GIVE_UP) {
+			TxMessage(p->m, p->ref != 0);
+			if (state > MGT_ST_MAX_OK) break;	// transmission failed
+			if (p->kind == REQ_TRANCHE) repeated = true;
+			requests.Resent(i, now);
+			continue;
 		}
-	}
-	return true;
+		PendingRequest r = *p;
+		requests.Remove(i);
+		RequestTimedOut(r);
+		if (state > MGT_ST_MAX_OK) break;
+	}
+	EndHashBatch();
+	if (state > MGT_ST_MAX_OK) return;
+
+	if (repeated) {
+			// something was lost; send fewer at a time
+		upd_window_size /= 2;
+		if (upd_window_size < UPD_WINDOW_MIN) 
+							upd_window_size = UPD_WINDOW_MIN;
+		upd_window_acks = 0;
+	}
+	ArmRequestTimer();
+}
+
+
+// the timer is only changed if it's not running or is due later
+void MgtSocket::ArmRequestTimer()
+{
+	ULONGLONG t = requests.NextDue();
+	if (t == 0) return;
+	ULONGLONG w = theApp.timers.When((FlexilinkSocket *)this, TMR_UNIT_REQUEST);
+	if (w == 0 || t < w) theApp.StartTimerAt((FlexilinkSocket *)this, 
+														TMR_UNIT_REQUEST, t);
+}
+
+
+// requests that weren't to be repeated are just forgotten; for any others 
+//		we assume the unit has stopped responding
+void MgtSocket::RequestTimedOut(PendingRequest& r)
+{
+	if (r.kind == REQ_OTHER) return;
+	if (r.kind == REQ_TRANCHE) ClearUploadWindow();
+	if (r.kind == REQ_WALK) map_walk.Clear();
+	if (r.kind == REQ_ERASE) erase_pending.clear();
+	if (r.kind == REQ_VERIFY) upd_verify.clear();
+	SetStateTimedOut();
 }
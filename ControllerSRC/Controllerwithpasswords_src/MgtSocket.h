@@ -5,104 +5,11 @@
 #pragma once
 
 #include "../Common/string_extras.h"
-
-#define PORT_TYPE_AUDIO		2
-#define PORT_TYPE_VIDEO		3
-
-// "direction" etc values for audio ports
-#define DIRECTION_IN	1
-#define DIRECTION_OUT	2
-#define AUDIO_FORMAT_UNKNOWN	 0	// not been reported or not recognised
-#define AUDIO_FORMAT_NONE		 1	// 1.0.62379.2.2.1.1
-#define AUDIO_FORMAT_ANALOGUE	 2	// 1.0.62379.2.2.1.2.a.c
-#define AUDIO_FORMAT_PCM		 3	// 1.0.62379.2.2.1.3.a.c.b.f
-#define AUDIO_FORMAT_INVALID	13	// 1.0.62379.2.2.1.13
-
-
-// structure to hold the result of parsing the "length" field
-struct ValueSizes {
-	int hd_len;		// bytes of tag + length (-1 if invalid)
-	int len;		// bytes of value
-};
-
-extern ValueSizes ParseLength(uint8_t * b, int len);
-
-
-// object, as in a MIB
-// CByteArray holds the value, in the same format as in ASN.1 BER
-class MibObject : public ByteString
-//class MibObject : public CByteArray
-{
-public:
-	MibObject();
-	MibObject(uint8_t * &p, int &len);	// reads a VarBind
-	virtual ~MibObject();
-
-		// redefining CByteArray members for backwards compatibility
-		// +++ I have removed the <const> suffixes below because calls of these 
-		//		routines get faulted "cannot convert 'this' pointer from 'const 
-		//		MibObject' to 'MibObject &' if they're left in", even though 
-		//		<size> etc are defined as <const> too
-	int GetCount() { return (int)(size()); }
-	int GetUpperBound() { return (int)(size()) - 1; }
-	uint8_t GetAt(int i) { return at(i); }
-	uint8_t * GetData() { return data(); }
-	void SetSize(int n) { resize(n); }
-	void Add(uint8_t b) { push_back(b); }
-
-	CString oid;		// as ASCII in the dotted-decimal form
-	ByteString oid_ber;	// as in the message (excluding tag and length)
-	int tag;			// see below
-	int value;			// valid only if <tag> is ASN1_TAG_INTEGER
-	__time64_t recd;	// time the value was reported
-	uint8_t msg_type;	// first 4 bits of message in which reported (in high half)
-
-#define TAG_INTEGER_OUT_OF_RANGE	-2 // tag was ASN1_TAG_INTEGER, length not 1-4
-#define TAG_INVALID					-1 // other fields not valid, byte array empty
-#define ASN1_TAG_INTEGER			 2
-#define ASN1_TAG_OCTET_STRING		 4
-#define ASN1_TAG_OID				 6
-
-	int IntegerValue() { if (this == NULL || tag != ASN1_TAG_INTEGER) return 0;
-						 return value; }
-	CString StringValue();// const;
-	CString StringHex(int group_size);// const;
-	void CopyOctetStringValue(CByteArray& b);
-	ByteString OctetStringValue() { if (this == NULL || 
-				tag != ASN1_TAG_OCTET_STRING) return ByteString(); return *this; }
-
-
-		// return value of object as a character string if an octet-string
-	std::string StdStringValue();// const;
-		// return value of object in hex if an octet-string
-	std::string StdStringHex(int group_size);// const;
-		// return value of object as text
-	std::string TextValue();// const;
-
-		// set <tag>, <value>, and the byte array from an ASN.1 value in a message
-		// <b> points to the tag, <len> is the number of bytes left in the message
-		// updates <b> and <len> and returns <true> if OK, else sets <tag> to -1 
-		//		and empties the byte array and returns <false> 
-	bool GetAsn1Value(uint8_t * &b, int &len);
-
-		// return the value in dotted-decimal form if it is a valid OID, else an 
-		//		empty string
-	CString ConvertOid();
-
-		// append the value to <b> in the format for an index in an OID; returns 
-		//		<true> if OK, <false> with <b> unchanged else
-//	bool AppendAsIndexTo(CByteArray & b);
-	bool AppendAsIndexTo(ByteString & b);
-
-		// copy the OID into a message (including tag and length)
-	int CopyOid(uint8_t * p);
-
-		// clear out any value that was stored
-	void SetInvalid() { clear(); tag = TAG_INVALID; }
-
-		// return whether another object has a significantly different value
-	bool ChangedFrom(MibObject * m);
-};
+#include "../Common/link_core.h"
+#include "../Common/mgt_core.h"
+#include "../Common/mib_store.h"
+#include "../Common/packet_log.h"
+#include "../Common/console_log.h"
 
 
 class VersionNumber
@@ -218,7 +125,7 @@ public:
 	bool TxMessage(ByteString m, int flow = 0) 
 						{ return TxMessage(m.data(), (int)m.size(), flow); }
 
-		// process an incoming message
+		// process incoming messages
 	virtual void OnReceive(int nErrorCode);
 
 		// information about the network connection that carries the link
@@ -226,29 +133,29 @@ public:
 		//		n-1 where n is the number of payload bytes; if false (the 
 		//		default) it is n+3
 	CString link_ip_addr;	// IPv4 address for gateway into Flexilink network
-#define AES51_PORT	 35037	// port number
 //	UINT remote_mgt_port;
 	bool standard_format;	// IT packet headers conform to ETSI GS NIN 005
 	char our_ident[8];		// byte order as in network messages
-	int tx_timer_count;		// timer ticks until send keepalive
-	int rcv_timer_count;	// timer ticks until link times out
-//#define LINK_RCV_TIMEOUT 14		// 7 sec
-//#define LINK_KEEPALIVE_PERIOD 4	// 2 sec
-#define LINK_RCV_TIMEOUT 7		// 7 sec
-#define LINK_KEEPALIVE_PERIOD 2	// 2 sec
-	bool PollKeepalives();	// send and check for rcv
-
-		// current state: one of the following
-#define LINK_ST_BEGIN	 0	// nothing done yet
-#define LINK_ST_REQ		 1	// Link Request sent
-#define LINK_ST_ACTIVE	 2	// Link Accept has been received
-#define LINK_ST_MAX_OK	 5	// codes above this are for "failed" states
-#define LINK_ST_CLOSED	 8	// target has disconnected
-#define LINK_ST_FAILED	 9	// call to base class (Create, Connect, Send) failed
-#define LINK_ST_ERROR	10	// any kind of protocol error
+		// keepalives are sent and checked using TMR_LINK_TX and TMR_LINK_RX
+	void TimerExpired(int kind);
+
+		// current state: one of the LINK_ST_ codes in link_core.h
 	int state;
+		// enter failed state <st> and set TMR_LINK_RETRY
+	void Failed(int st);
+		// time (ms) to wait before trying again if the new socket can't be 
+		//		created (see <CMainFrame::RestartLink>); the other times are 
+		//		in link_core.h
+#define LINK_RETRY_CREATE	20000	// after failing to create the new socket
 
 		// the link partner's 64-bit identifier; valid in ACTIVE state only
 	CByteArray link_partner_id;
+
+private:
+		// buffers, allocated once so that sending and receiving don't 
+		//		involve any heap allocation
+	Datagram tx_buf;		// message being sent
+	DatagramRing rx_ring;	// messages received but not yet processed
+	void ProcessDatagram(Datagram& d);
 };
 
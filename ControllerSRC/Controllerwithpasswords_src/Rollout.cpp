@@ -0,0 +1,92 @@
+// Rollout.cpp : implementation of the Rollout class
+// Copyright (c) 2024 Nine Tiles
+
+#include "stdafx.h"
+#include "Controller.h"
+#include "ControllerDoc.h"
+
+
+Rollout::Rollout()
+{
+	active = false;
+	product_code[0] = -1;
+	budget = 0;
+	allowance = 0;
+	allowance_time = 0;
+}
+
+
+// <fn> is expected to be of the form "...product~a-b-c-d.9t3prd" (or .9t4prd)
+//		as in MgtSocket::OnIdle; if it isn't, the rollout applies to all units
+//		but they will use <fn> as their product file
+void Rollout::Start(CString fn)
+{
+	active = true;
+	product_file = fn;
+	product_code[0] = -1;
+	if (fn.IsEmpty()) return;
+
+	int i = fn.ReverseFind('~');
+	if (i < 0 || sscanf_s(fn.Mid(i + 1), "%d-%d-%d-%d", &product_code[0],
+						&product_code[1], &product_code[2], &product_code[3]) != 4) {
+		product_code[0] = -1;
+	}
+}
+
+
+bool Rollout::Includes(MgtSocket * m)
+{
+	unless (active) return false;
+	if (product_code[0] < 0) return true;
+	int i = 3;
+	do if (m->product_code[i] != product_code[i]) return false; while (--i >= 0);
+	return true;
+}
+
+
+// the units compared are those in UPD_ST_QUEUED state; a unit that isn't
+//		reachable from the link partner (e.g. because the MIB hasn't been
+//		read yet) is treated as being further away than any that is
+bool Rollout::MayStart(MgtSocket * m)
+{
+	int uploading = 0;
+	int i = (int)(theApp.units.GetCount());
+	while (--i > 0) {
+		MgtSocket * u = theApp.units.GetAt(i);
+		if (u && u != m && u->upd_state == UPD_ST_UPLOADING) uploading += 1;
+	}
+	if (uploading >= ROLLOUT_MAX_UPLOADS) return false;
+
+		// hop counts from <theApp.topology>, with units that can't be reached 
+		//		from the link partner last
+	int d = theApp.topology.Hops(m);
+	if (d == 0) return true;
+	if (d < 0) d = INT_MAX;
+
+	i = (int)(theApp.units.GetCount());
+	while (--i > 0) {
+		MgtSocket * u = theApp.units.GetAt(i);
+		unless (u && u != m && u->upd_state == UPD_ST_QUEUED) continue;
+		int h = theApp.topology.Hops(u);
+		if (h >= 0 && h < d) return false;
+	}
+	return true;
+}
+
+
+bool Rollout::TakeBudget(int n)
+{
+	if (budget <= 0) return true;
+
+	ULONGLONG now = GetTickCount64();
+	if (allowance_time == 0 || now - allowance_time >= 1000) allowance = budget;
+	else allowance += (int)(((now - allowance_time) * budget) / 1000);
+	if (allowance > budget) allowance = budget;
+	allowance_time = now;
+
+		// always allow one tranche if the allowance is full, in case
+		//		<budget> is less than a tranche
+	if (n > allowance && allowance < budget) return false;
+	allowance -= n;
+	return true;
+}
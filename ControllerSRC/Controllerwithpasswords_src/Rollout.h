@@ -0,0 +1,62 @@
+// Rollout.h : scheduling of software updates across all the units
+// Copyright (c) 2024 Nine Tiles
+
+// Each <MgtSocket> still runs its own UPD_ST_ state machine (see
+//		MgtSocket::OnIdle), but before it starts writing an image to flash it
+//		asks the <Rollout> object (<theApp.rollout>) whether it may do so;
+//		this lets several units be updated at once without them all competing
+//		for the link to the gateway unit, and the units nearest the gateway go
+//		first
+// A rollout is started with the "-rollout" command line option, optionally
+//		followed by the name of a product file; the units it applies to are
+//		all those with the product code in the filename (or all units if no
+//		file is given), and they are updated without asking the user about
+//		each one
+// The images in the files named in the product files are kept in <images>
+//		whether or not a rollout is in progress, so that units of the same
+//		product share one copy instead of each reading the file
+
+#pragma once
+#include "../common/string_extras.h"
+#include "FlashImage.h"
+#include <map>
+
+
+class Rollout
+{
+public:
+	Rollout();
+
+		// images for uploading; entries are never removed, so pointers to
+		//		them remain valid
+	ImageCache images;
+
+		// set up from the command line; <fn> is the product file, or empty
+	void Start(CString fn);
+	bool active;
+	CString product_file;	// empty if each unit uses its own
+	int product_code[4];	// from <product_file>; -1 if none
+		// whether unit <m> is included in the rollout
+	bool Includes(class MgtSocket * m);
+
+		// whether <m> may start writing to its flash now: false if there are
+		//		already ROLLOUT_MAX_UPLOADS units doing so, or if another unit
+		//		that is waiting is fewer hops from the gateway unit
+#define ROLLOUT_MAX_UPLOADS	4
+	bool MayStart(class MgtSocket * m);
+
+		// limit on the rate at which flash data is sent over the link, in
+		//		bytes per second, shared between all the units being updated;
+		//		zero for no limit (set with the "-budget" command line option,
+		//		which is in kbytes/s)
+	int budget;
+		// whether <n> bytes of flash data may be sent now; if so, they are
+		//		counted against <budget>
+		// the allowance is topped up in proportion to the time since the
+		//		previous call, up to one second's worth
+	bool TakeBudget(int n);
+
+private:
+	int allowance;			// bytes that may be sent now
+	ULONGLONG allowance_time;	// GetTickCount64() when <allowance> last topped up
+};
@@ -0,0 +1,215 @@
+// Salvo.cpp : implementation of the Salvo class
+// Copyright (c) 2024 Nine Tiles
+
+#include "stdafx.h"
+#include "Controller.h"
+#include "ControllerDoc.h"
+#include "CrosspointDoc.h"
+#include <map>
+
+
+Salvo::Salvo()
+{
+	active = false;
+	started = 0;
+}
+
+
+bool Salvo::Load(CString fn)
+{
+	if (active) {
+		AfxMessageBox("A salvo is already in progress", MB_OK | MB_ICONEXCLAMATION);
+		return false;
+	}
+	CStdioFile f;
+	unless (f.Open(fn, CFile::modeRead)) {
+		AfxMessageBox("Could not read " + fn, MB_OK | MB_ICONEXCLAMATION);
+		return false;
+	}
+
+	entries.clear();
+	CString s;
+	int line = 0;
+	while (f.ReadString(s)) {
+		line += 1;
+		s.Trim();
+		if (s.IsEmpty() || s[0] == '#') continue;
+		SalvoEntry e;
+		CString field[4];
+		int i = 0;
+		int posn = 0;
+		CString t = s.Tokenize(",\t", posn);
+		while (posn >= 0 && i < 4) {
+			field[i++] = t.Trim();
+			t = s.Tokenize(",\t", posn);
+		}
+		e.srce_unit = field[0];
+		e.srce_port = field[1];
+		e.dest_unit = field[2];
+		e.dest_port = field[3];
+		e.state = SALVO_WAITING;
+		if (i < 4 || posn >= 0) {
+				// the report shows the whole line
+			e.srce_unit = s;
+			e.srce_port.Empty();
+			e.dest_unit.Empty();
+			e.state = SALVO_FAILED;
+			e.error.Format("line %d should have 4 fields", line);
+		}
+		entries.push_back(e);
+	}
+	f.Close();
+
+	file_name = fn;
+	active = true;
+	started = GetTickCount64();
+	theApp.err_msgs.RemoveAll();
+	theApp.StartTimer(this, TMR_SALVO, SALVO_POLL_INTERVAL);
+	Next();
+	return true;
+}
+
+
+// requests that are no longer in the destination's <conn_pend> without
+//		having been reported to <Completed> have been lost, e.g. because the
+//		unit has been removed; those for units that have timed out or failed
+//		are treated as lost too
+void Salvo::Poll()
+{
+	unless (active) return;
+
+	int n = (int)entries.size();
+	while (--n >= 0) {
+		SalvoEntry& e = entries[n];
+		unless (e.state == SALVO_SENT) continue;
+		MgtSocket * m = (MgtSocket *)theApp.unit_addrs.Find(e.dest_addr);
+		bool found = false;
+		if (m && m->state <= MGT_ST_MAX_OK) {
+			std::vector<ConnReqInfo>::iterator p = m->conn_pend.begin();
+			for (; p != m->conn_pend.end(); p++) if (p->salvo_entry == n) found = true;
+		}
+		unless (found) Fail(e, "no response from unit");
+	}
+	Next();
+	if (active) theApp.StartTimer(this, TMR_SALVO, SALVO_POLL_INTERVAL);
+}
+
+
+void Salvo::Completed(int n, bool ok)
+{
+	unless (active && n >= 0 && n < (int)entries.size()) return;
+	SalvoEntry& e = entries[n];
+	unless (e.state == SALVO_SENT) return;
+	if (ok) e.state = SALVO_DONE;
+	else Fail(e, "refused request for call id");
+	Next();
+}
+
+
+// each destination has at most SALVO_WINDOW entries in SALVO_SENT state
+void Salvo::Next()
+{
+	unless (active) return;
+	std::map<MgtSocket *, int> in_flight;
+	int n = (int)entries.size();
+	int i = -1;
+	while (++i < n) {
+		SalvoEntry& e = entries[i];
+		unless (e.state == SALVO_SENT) continue;
+		MgtSocket * m = (MgtSocket *)theApp.unit_addrs.Find(e.dest_addr);
+		if (m) in_flight[m] += 1;
+	}
+
+	i = -1;
+	while (++i < n) {
+		SalvoEntry& e = entries[i];
+		unless (e.state == SALVO_WAITING) continue;
+		MgtSocket * srce = FindUnit(e.srce_unit);
+		MgtSocket * dest = FindUnit(e.dest_unit);
+		int srce_port = (srce == NULL) ? -1 : FindPort(srce, true, e.srce_port);
+		int dest_port = (dest == NULL) ? -1 : FindPort(dest, false, e.dest_port);
+		if (srce_port < 0 || dest_port < 0 || dest->state != MGT_ST_ACTIVE) {
+				// maybe the MIBs haven't been read yet
+			if (GetTickCount64() - started < SALVO_TIMEOUT) continue;
+			if (srce_port < 0) Fail(e, "source not found");
+			else if (dest_port < 0) Fail(e, "destination not found");
+			else Fail(e, "destination unit not connected");
+			continue;
+		}
+		unless (dest->MayConnect(dest_port)) {
+			Fail(e, "not permitted at this privilege level");
+			continue;
+		}
+		int& k = in_flight[dest];
+		if (k >= SALVO_WINDOW) continue;
+		unless (dest->RequestConnection(dest_port, srce, srce_port, i)) {
+			Fail(e, "could not send request");
+			continue;
+		}
+		e.state = SALVO_SENT;
+		e.dest_addr = dest->unit_TAddress;
+		k += 1;
+	}
+	CheckFinished();
+}
+
+
+MgtSocket * Salvo::FindUnit(CString s)
+{
+	int i = (int)(theApp.units.GetCount());
+	while (--i > 0) {
+		MgtSocket * m = theApp.units.GetAt(i);
+		unless (m) continue;
+		if (m->GetStringObject("1.0.62379.1.1.1.1.0").CompareNoCase(s) == 0 ||
+					m->DisplayName().CompareNoCase(s) == 0 ||
+								m->unit_address.CompareNoCase(s) == 0) return m;
+	}
+	return NULL;
+}
+
+
+int Salvo::FindPort(MgtSocket * m, bool input, CString s)
+{
+	MgtSocket::PortList& list = input ? m->input_port_list : m->output_port_list;
+	int n;
+	char c;
+	if (sscanf_s(s, "%d%c", &n, &c, 1) == 1) return (list.Find(n) != NULL) ? n : -1;
+
+	POSITION p = list.GetHeadPosition();
+	while (p != NULL) {
+		n = list.GetNext(p);
+		CString name = m->GetStringObject(MIB_COL_A_PORT_NAME, n);
+		if (name.IsEmpty()) name = m->GetStringObject(MIB_COL_V_PORT_NAME, n);
+		if (name.CompareNoCase(s) == 0) return n;
+	}
+	return -1;
+}
+
+
+void Salvo::CheckFinished()
+{
+	int done = 0;
+	int failed = 0;
+	std::vector<SalvoEntry>::iterator e = entries.begin();
+	for (; e != entries.end(); e++) {
+		if (e->state == SALVO_DONE) done += 1;
+		else if (e->state == SALVO_FAILED) failed += 1;
+		else return;
+	}
+
+		// here if all finished
+	active = false;
+	CString s;
+	s.Format("Salvo %s: %d of %d connections requested",
+								(LPCTSTR)file_name, done, done + failed);
+	theApp.err_msgs.Add(s);
+	for (e = entries.begin(); e != entries.end(); e++) {
+		unless (e->state == SALVO_FAILED) continue;
+		if (e->srce_port.IsEmpty() && e->dest_unit.IsEmpty()) s = e->srce_unit;
+		else s = e->srce_unit + " " + e->srce_port + " to " +
+										e->dest_unit + " " + e->dest_port;
+		theApp.err_msgs.Add("  " + s + ": " + e->error);
+	}
+	entries.clear();
+	if (theApp.output_list != NULL) theApp.output_list->UpdateAllViews(NULL);
+}
@@ -0,0 +1,78 @@
+// Salvo.h : routing a list of connections at once
+// Copyright (c) 2024 Nine Tiles
+
+// A salvo is a list of (source, destination) pairs read from a file, which
+//		is named with the "-salvo" command line option or chosen with
+//		File > Run Salvo
+// Each line of the file has four fields separated by commas or tabs: source
+//		unit, source port, destination unit, destination port; a unit may be
+//		given by its name, its name as shown in the crosspoint windows, or
+//		its address in hex, and a port by its name or block number; blank
+//		lines and lines starting with '#' are ignored
+// Each connection is set up in the same way as when an output is clicked in
+//		the crosspoint window (see MgtSocket::RequestConnection), but the
+//		requests to each destination unit are sent without waiting for the
+//		replies to earlier ones, up to SALVO_WINDOW at a time, and all the
+//		units are served in parallel; a single report is added to
+//		<theApp.err_msgs> when every entry has either been requested or failed
+// Entries that name units or ports we don't know about yet (e.g. because the
+//		salvo was started from the command line before the MIBs have been
+//		read) wait for up to SALVO_TIMEOUT after the salvo starts before failing
+
+#pragma once
+#include "../common/string_extras.h"
+#include <vector>
+
+
+struct SalvoEntry {
+	CString srce_unit;		// fields as in the file
+	CString srce_port;
+	CString dest_unit;
+	CString dest_port;
+	ByteString dest_addr;	// <unit_TAddress> of the destination once sent
+	int state;
+#define SALVO_WAITING	0	// not sent yet
+#define SALVO_SENT		1	// has an entry in the destination's <conn_pend>
+#define SALVO_DONE		2	// the connection has been requested
+#define SALVO_FAILED	3	// <error> says why
+	CString error;
+};
+
+
+class Salvo
+{
+public:
+	Salvo();
+
+		// read the pairs from file <fn> and start sending the requests;
+		//		returns false (having told the user) if the file can't be read
+		//		or another salvo is still in progress
+	bool Load(CString fn);
+	bool active;
+
+		// called every SALVO_POLL_INTERVAL while <active> (TMR_SALVO): checks 
+		//		for requests that have been lost and sends any that are waiting
+	void Poll();
+		// called by a <MgtSocket> when the request for entry <n> has been
+		//		acknowledged (<ok>) or refused
+	void Completed(int n, bool ok);
+
+#define SALVO_WINDOW		8		// requests in progress to each unit
+#define SALVO_TIMEOUT		60000	// ms
+#define SALVO_POLL_INTERVAL	500		// ms
+
+private:
+	std::vector<SalvoEntry> entries;
+	ULONGLONG started;		// GetTickCount64() when the salvo was started
+	CString file_name;
+
+		// send as many waiting entries as the window allows
+	void Next();
+	void Fail(SalvoEntry& e, CString why) { e.state = SALVO_FAILED; e.error = why; }
+		// the unit described by <s>, NULL if none
+	class MgtSocket * FindUnit(CString s);
+		// the input (<input>) or output port of <m> described by <s>, -1 if none
+	int FindPort(class MgtSocket * m, bool input, CString s);
+		// if all entries have finished, report and end the salvo
+	void CheckFinished();
+};
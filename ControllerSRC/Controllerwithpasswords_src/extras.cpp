@@ -15,6 +15,20 @@
  */
 #include "stdafx.h"
 #include "../Common/string_extras.cpp"
+#include "../Common/link_core.cpp"
+#include "../Common/mgt_core.cpp"
+#include "../Common/mib_store.cpp"
+#include "../Common/crosspoint_model.cpp"
+#include "../Common/mib_bus.cpp"
+#include "../Common/packet_log.cpp"
+#include "../Common/console_log.cpp"
+#include "../Common/label_registry.cpp"
+#include "../Common/addr_directory.cpp"
+#include "../Common/topology_graph.cpp"
+#include "../Common/request_table.cpp"
+#include "../Common/timer_wheel.cpp"
+#include "../Common/table_walk.cpp"
+#include "../Common/keccak.cpp"
 
 #include "extras.h"
 
@@ -4,7 +4,7 @@
 //
 #define IDD_ABOUTBOX                    100
 #define IDP_OLE_INIT_FAILED             100
-#define IDT_500MSEC                     101
+#define IDT_TIMERS                      101
 #define IDP_SOCKETS_INIT_FAILED         104
 #define IDR_MAINFRAME                   128
 #define IDR_ControllerTYPE              129
@@ -31,6 +31,8 @@
 #define IDC_EDIT8                       1010
 #define IDC_EDIT7                       1011
 #define IDC_EDIT9                       1013
+#define ID_FILE_SAVE_CAPTURE            32771
+#define ID_FILE_RUN_SALVO               32772
 //#define IDC_BUILD_INFO					1100 //Leo add build time
 
 // Next default values for new objects
@@ -38,7 +40,7 @@
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        145
-#define _APS_NEXT_COMMAND_VALUE         32771
+#define _APS_NEXT_COMMAND_VALUE         32773
 #define _APS_NEXT_CONTROL_VALUE         1007
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
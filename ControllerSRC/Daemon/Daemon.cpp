@@ -0,0 +1,687 @@
+/*
+ *  Daemon.cpp
+ *  the link to the gateway unit, the event loop, and the local API for the
+ *		headless controller
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+#include "Daemon.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+
+
+Daemon::Daemon()
+{
+	link_state = LINK_ST_BEGIN;
+	memset(our_ident, 0, 8);
+	standard_format = false;
+	units.push_back(NULL);	// entry 0 isn't used
+	link_partner = NULL;
+	bus_topology = mib_bus.Subscribe(TOPOLOGY_BITS | MIB_BIT_UNIT_STATE);
+	bus_any = mib_bus.Subscribe(MIB_BITS_ALL);
+	server_addr = INADDR_BROADCAST;
+	sig_label = 0;
+	epoll_fd = -1;
+	api_fd = -1;
+}
+
+
+Daemon::~Daemon()
+{
+	if (link_state == LINK_ST_ACTIVE) {
+			// send a Link Reject message
+		uint8_t hdr[6];
+		BuildAes51Header(hdr, AES51_TYPE_LINK_REJECT);
+		link.SendTo(hdr, 6, server_addr, AES51_PORT);
+	}
+	std::map<int, ApiClient>::iterator c = api_clients.begin();
+	while (c != api_clients.end()) close((c++)->first);
+	if (api_fd >= 0) {
+		close(api_fd);
+		unlink(api_path.c_str());
+	}
+	if (epoll_fd >= 0) close(epoll_fd);
+	size_t i = units.size();
+	while (--i > 0) delete units[i];
+}
+
+
+// open the sockets and send the first Link Request, see header
+std::string Daemon::Init(uint32_t server_addr, const char * api_path)
+{
+	struct sockaddr_un sa;
+
+	this->server_addr = server_addr;
+	this->api_path = api_path;
+	epoll_fd = epoll_create1(0);
+	if (epoll_fd < 0) return std::string("epoll_create1: ") + strerror(errno);
+
+		// local API socket; remove any left over from a previous run
+	if (strlen(api_path) >= sizeof(sa.sun_path)) return "API path too long";
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, api_path);
+	unlink(api_path);
+	api_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (api_fd < 0 || bind(api_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+						listen(api_fd, 8) < 0 || !Watch(api_fd))
+				return std::string("API socket: ") + strerror(errno);
+
+		// the timers for the link itself are started by <LinkRequest>
+	StartTimer(NULL, TMR_PRUNE, FLOW_PRUNE_INTERVAL);
+	unless (LinkRequest()) return "failed to send link request, error " +
+							ToDecimal(link.error) + ' ' + strerror(link.error);
+	return std::string();
+}
+
+
+// add <fd> to the set watched by <epoll_fd> for input
+bool Daemon::Watch(int fd)
+{
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+
+uint64_t Daemon::Now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+
+// the wait may end early if the next timer is a long way ahead (see 
+//		<TimerWheel::NextExpiry>), in which case <RunTimers> finds nothing 
+//		to do and we wait again
+int Daemon::WaitTime()
+{
+	uint64_t t = timers.NextExpiry();
+	if (t == 0) return -1;
+	uint64_t now = Now();
+	if (t <= now) return 0;
+	return (t - now > INT_MAX) ? INT_MAX : (int)(t - now);
+}
+
+
+// process events until a fatal error occurs or we are told to stop
+int Daemon::Run()
+{
+#define DAEMON_MAX_EVENTS	64
+	struct epoll_event ev[DAEMON_MAX_EVENTS];
+	int i, n;
+	while (true) {
+		n = epoll_wait(epoll_fd, ev, DAEMON_MAX_EVENTS, WaitTime());
+		if (daemon_stop) return 0;
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return 1;
+		}
+		i = 0;
+		while (i < n) {
+			int fd = ev[i].data.fd;
+			uint32_t events = ev[i++].events;
+			if (fd == link.Handle()) LinkReceive();
+			else if (fd == api_fd) ApiAccept();
+			else if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ApiReceive(fd);
+			else ApiServe(fd);		// EPOLLOUT
+		}
+		RunTimers();
+		Idle();
+	}
+}
+
+
+// --------------------------- the link to the gateway unit
+
+// open a new socket and send the Link Request; as <LinkSocket::Init> (but
+//		also including the code from <CMainFrame::OnTimer> that replaces the
+//		socket)
+bool Daemon::LinkRequest()
+{
+	int fd = link.Handle();
+	if (fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	link_state = LINK_ST_FAILED;
+	unless (link.Open(0, server_addr == INADDR_BROADCAST) &&
+										Watch(link.Handle())) return false;
+
+	uint8_t m[12];
+	BuildAes51Header(m, AES51_TYPE_LINK_REQUEST);
+	m[6]  = 0x85;	// IE selecting LinkTypeExternal
+	m[7]  = 4;
+	m[8]  = 0x11;	// standard value; legacy units ignore d7-4
+	m[9]  = 0;
+	m[10] = 0;
+	m[11] = 0;
+	unless (link.SendTo(m, 12, server_addr, AES51_PORT)) return false;
+	link_state = LINK_ST_REQ;
+	StartTimer(NULL, TMR_LINK_RETRY, LINK_ACCEPT_TIMEOUT);
+	return true;
+}
+
+
+void Daemon::LinkFailed(int st)
+{
+	link_state = st;
+	CancelTimer(NULL, TMR_LINK_RX);
+	CancelTimer(NULL, TMR_LINK_TX);
+	StartTimer(NULL, TMR_LINK_RETRY,
+					(st == LINK_ST_FAILED) ? LINK_RETRY_FAILED : LINK_RETRY_WAIT);
+}
+
+
+// send message from <b>, total size <len>, with flow label (including CRC)
+//		<flow>, or the signalling flow if <flow> is zero
+bool Daemon::TxMessage(uint8_t * b, int len, int flow)
+{
+	if (link_state != LINK_ST_ACTIVE || flow < 0 ||
+							len > LINK_DATAGRAM_SIZE - LINK_HDR_LEN) {
+		return false;
+	}
+	unless (flow) flow = sig_label;
+	BuildItHeader(tx_buf.b, len, flow, standard_format);
+	memcpy(tx_buf.b + LINK_HDR_LEN, b, len);
+	len += LINK_HDR_LEN;
+	return send(link.Handle(), tx_buf.b, len, 0) == len;
+}
+
+
+// read all the datagrams that are waiting and process them in turn
+void Daemon::LinkReceive()
+{
+	int n;
+	do {
+		n = link.ReceiveBatch(rx_ring);
+		CheckItPackets(rx_ring, rx_ring.Count(), standard_format);
+		while (rx_ring.Count() > 0) {
+			ProcessDatagram(rx_ring.OldSlot(0));
+			rx_ring.Removed(1);
+		}
+	} while (n > 0);
+	if (n < 0 && link_state != LINK_ST_FAILED) LinkFailed(LINK_ST_FAILED);
+}
+
+
+// process an incoming message; as <LinkSocket::ProcessDatagram>
+void Daemon::ProcessDatagram(Datagram& d)
+{
+	uint8_t * b = d.b;
+	int len = d.len;
+	DaemonUnit * u;
+
+	if (d.port != AES51_PORT) return;
+	if (len >= LINK_DATAGRAM_SIZE) return; // overlength UDP datagram
+	if (len < 6 || b[0] != 2) return;	// not a valid message
+
+	if (link_state == LINK_ST_REQ && server_addr == INADDR_BROADCAST) {
+			// collect the address for use with subsequent packets
+		server_addr = d.addr;
+	}
+	if (link_state == LINK_ST_REQ && !link.Connect(server_addr, AES51_PORT)) {
+		LinkFailed(LINK_ST_FAILED);
+		return;
+	}
+
+	int label;
+	int i, j;
+	uint8_t hdr[6];	// for reply messages
+	ByteString id;	// for link partner's id in Link Accept
+	switch (b[1]) {
+case AES51_TYPE_IT_PACKET:
+			// <len> has been checked by CheckItPackets(), and any padding 
+			//		removed
+		label = (b[8] << 8) | b[9];
+
+		if (label == RCV_SIG_FLOW) switch (b[10]) {	// signalling message
+	case 9:			// ClearDown request: find the call ref in the Route IE
+			i = 12 + b[11];	// first byte of variable part
+			label = -1; // call ref; initialise to "not found"
+			while (i < len) {
+				switch (b[i] & 0x7F) {
+		case 24:		// Route
+					j = i + ((b[i] & 0x80) ? 4 : 3);
+					if (memcmp(b+j, our_ident, 8) != 0) break;	// wrong owner
+					label = (b[j+10] << 8) | b[j+11];	// ls 2 bytes of call ref
+				}
+				i += (b[i+1] << 8) + b[i+2] + 3;
+			}
+
+			if (b[14] || b[13] || b[12]) {
+					// send ack
+				b[10] = 0x89;
+				b[11] = 3;
+				send(link.Handle(), b, 15, 0);
+			}
+
+			u = FindCall(label);
+			if (u) u->ClearedDown();
+	default:		// anything unrecognised: silently ignore
+			return;
+
+	case 0x88:		// ack FindRoute request
+	case 0x28:		// FindRoute response
+			if (b[11] != 13 || memcmp(b+12, our_ident, 8) != 0) return;
+			u = FindCall((b[22] << 8) | b[23]);
+			if (u) u->ReceiveSignalling(b + 10, len - 10);
+			return;
+		}
+
+			// <label> is the flow label, and is not the signalling flow
+		i = label >> 3;
+		if (label != AddHec(i)) return;	// ignore (bad CRC)
+		u = FindUnit(i);
+		if (u) u->ReceiveData(b + 10, len - 10);
+		return;
+
+
+case AES51_TYPE_LINK_ACCEPT:
+		unless (link_state == LINK_ST_REQ) return;
+		link_state = LINK_ST_ACTIVE;
+		CancelTimer(NULL, TMR_LINK_RETRY);
+		StartTimer(NULL, TMR_LINK_RX, LINK_RCV_TIMEOUT_MS);
+		StartTimer(NULL, TMR_LINK_TX, LINK_KEEPALIVE_MS);
+		label = 0;	// default if no type 83 IE
+		i = 6;
+		while (i < len) {
+			if (b[i] == 0x83) {
+					// have the signalling flow
+				if (b[i+1] < 2) {
+					if (b[i+1] == 1) label = b[i+2];
+				}
+				else label = (b[i+2] << 8) | b[i+3];
+			}
+			else if (b[i] == 0x84 && b[i+1] >= 8) {
+					// have our 64-bit ident
+				memcpy(our_ident, b+i+2, 8);
+			}
+			else if (b[i] == 0x82 && b[i+1] >= 8) {
+					// have the link partner's 64-bit ident
+				id.assign(1, 5);	// <FlAddrTypeUnitId>
+				id.insert(id.end(), b+i+2, b+i+10);
+			}
+			else if (b[i] == 0x85 && b[i+1] > 0 && b[i+2] == 0x11) {
+					// virtual link as specified in GS NIN 005
+				standard_format = true;
+			}
+			i += (b[i+1] + 2);
+		}
+		sig_label = AddHec(label);
+		NewLinkPartner(id);
+		return;
+
+
+case AES51_TYPE_LINK_REJECT:
+		LinkFailed(LINK_ST_CLOSED);
+		return;
+
+
+case AES51_TYPE_LINK_KEEPALIVE:
+		StartTimer(NULL, TMR_LINK_RX, LINK_RCV_TIMEOUT_MS);
+		BuildAes51Header(hdr, AES51_TYPE_LINK_KEEPALIVE);
+		send(link.Handle(), hdr, 6, 0);
+		StartTimer(NULL, TMR_LINK_TX, LINK_KEEPALIVE_MS);
+		return;
+	}
+
+		// here if packet type not recognised
+	LinkFailed(LINK_ST_ERROR);
+	BuildAes51Header(hdr, AES51_TYPE_LINK_REJECT);
+	send(link.Handle(), hdr, 6, 0);
+}
+
+
+// called when the Link Accept is received; as <CControllerApp::NewLinkPartner>
+void Daemon::NewLinkPartner(ByteString& id)
+{
+	mib_bus.Publish(NULL, MIB_BIT_UNIT_STATE);	// the topology has changed
+	size_t i = units.size();
+	while (--i > 0) units[i]->SendConnReq();
+
+	link_partner = (DaemonUnit *)unit_addrs.Find(id);
+	if (link_partner == NULL) link_partner = NewUnit(id);
+}
+
+
+// create a <DaemonUnit> for <call_addr>, see header
+// the flow label is the index in <units>; unlike <CControllerApp::NewUnit>,
+//		labels are never reused because units are never deleted, so they are 
+//		allocated in order
+DaemonUnit * Daemon::NewUnit(ByteString& call_addr)
+{
+	if ((int)units.size() > LABEL_MAX) return NULL;
+	DaemonUnit * u = new DaemonUnit(this, (int)units.size(), call_addr);
+	int n = labels.Allocate(u);
+	ASSERT(n == (int)units.size());
+	u->call_ref = labels.CallRef(n);
+	units.push_back(u);
+	unit_addrs.Set(call_addr, (void *)u);
+	u->SendConnReq();
+	return u;
+}
+
+
+// the owner of each kind of timer is as shown where they are defined
+void Daemon::RunTimers()
+{
+	uint64_t now = Now();
+	void * owner;
+	int kind;
+	uint8_t hdr[6];
+	while (timers.Expired(now, owner, kind)) switch (kind) {
+case TMR_LINK_RETRY:
+			// as <CMainFrame::RestartLink>; the timer is set again if the
+			//		socket can't be opened or the request can't be sent
+		if (link_state == LINK_ST_ACTIVE) break;
+		unless (LinkRequest()) LinkFailed(LINK_ST_FAILED);
+		break;
+
+case TMR_PRUNE:
+		flow_senders.Prune((uint32_t)time(NULL) - FLOW_SENDER_MAX_AGE);
+		StartTimer(NULL, TMR_PRUNE, FLOW_PRUNE_INTERVAL);
+		break;
+
+case TMR_LINK_RX:
+			// treat as Link Reject, but retry immediately; as 
+			//		<LinkSocket::TimerExpired>
+		link_state = LINK_ST_CLOSED;
+		CancelTimer(NULL, TMR_LINK_TX);
+		StartTimer(NULL, TMR_LINK_RETRY, 0);
+		break;
+
+case TMR_LINK_TX:
+		BuildAes51Header(hdr, AES51_TYPE_LINK_KEEPALIVE);
+		send(link.Handle(), hdr, 6, 0);
+		StartTimer(NULL, TMR_LINK_TX, LINK_KEEPALIVE_MS);
+		break;
+
+default:
+		((DaemonUnit *)owner)->TimerExpired(kind);
+	}
+}
+
+
+// publish changes of state, and re-trace if the topology may have changed or
+//		any units are to be retried; as the last part of <CControllerApp::OnIdle>
+void Daemon::Idle()
+{
+	size_t i = units.size();
+	while (--i > 0) {
+		DaemonUnit * u = units[i];
+		u->Idle();
+		if (u->state != u->state_seen) {
+			mib_bus.Publish(u, MIB_BIT_UNIT_STATE);
+			u->state_seen = u->state;
+		}
+	}
+
+		// the trace looks at all the units, so we don't need to know which
+		//		have changed
+	bool retrace = mib_bus.Flush(bus_topology);
+	if (mib_bus.Flush(bus_any) && !retrace) {
+		i = units.size();
+		while (--i > 0) if (units[i]->state >= MGT_ST_MIN_RETRY) retrace = true;
+	}
+	if (retrace) Trace();
+}
+
+
+// see whether there are any units we don't have sessions for yet, or which
+//		need to reconnect; as <CControllerApp::OnIdle> and <MgtSocket::Trace>
+void Daemon::Trace()
+{
+	unless (link_partner && link_partner->state == MGT_ST_ACTIVE) return;
+	size_t i = units.size();
+	while (--i > 0) units[i]->traced = false;
+
+		// breadth first, so no recursion
+	std::vector<DaemonUnit *> queue(1, link_partner);
+	link_partner->traced = true;
+	i = 0;
+	while (i < queue.size()) {
+		DaemonUnit * u = queue[i++];
+		if (u->state >= MGT_ST_MIN_RETRY) u->SendConnReq();
+		std::map<int, int>::iterator q = u->net_port_state.begin();
+		while (q != u->net_port_state.end()) {
+			if (q->second == NET_PORT_STATE_PT_PT) {
+				DaemonUnit * p = u->LinkPartner(q->first);
+				if (p && !p->traced) {
+					p->traced = true;
+					queue.push_back(p);
+				}
+			}
+			++q;
+		}
+	}
+}
+
+
+// --------------------------- the local API
+
+void Daemon::ApiAccept()
+{
+	int fd;
+	while ((fd = accept4(api_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+		unless (Watch(fd)) {
+			close(fd);
+			continue;
+		}
+		ApiClient& c = api_clients[fd];
+		c.want_out = false;
+	}
+}
+
+
+// read from a client; each complete line is a request
+void Daemon::ApiReceive(int fd)
+{
+	char buf[512];
+	ssize_t n;
+	std::map<int, ApiClient>::iterator c = api_clients.find(fd);
+	if (c == api_clients.end()) return;
+	while ((n = read(fd, buf, sizeof(buf))) > 0) c->second.in.append(buf, n);
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			// client has gone away
+		ApiClose(fd);
+		return;
+	}
+	ApiServe(fd);
+}
+
+
+// write as much of the reply as the socket will take, then answer the next
+//		request if there is one; EPOLLOUT is watched for only while there's
+//		something waiting to be written
+void Daemon::ApiServe(int fd)
+{
+	ssize_t n = 0;
+	size_t i;
+	std::map<int, ApiClient>::iterator p = api_clients.find(fd);
+	if (p == api_clients.end()) return;
+	ApiClient& c = p->second;
+	while (true) {
+		while (!c.out.empty() &&
+					(n = write(fd, c.out.data(), c.out.size())) > 0) c.out.erase(0, n);
+		unless (c.out.empty()) {
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+			ApiClose(fd);	// client has gone away
+			return;
+		}
+		i = c.in.find('\n');
+		if (i == std::string::npos) break;
+		std::string req = c.in.substr(0, i);
+		c.in.erase(0, i + 1);
+		c.out = ApiRequest(req) + ".\n";
+	}
+
+	bool want_out = !c.out.empty();
+	if (want_out == c.want_out) return;
+	struct epoll_event ev;
+	ev.events = want_out ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0) c.want_out = want_out;
+	else ApiClose(fd);
+}
+
+
+void Daemon::ApiClose(int fd)
+{
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	close(fd);
+	api_clients.erase(fd);
+}
+
+
+// process a request and return the reply, each line terminated by '\n':
+//		units				one line per unit: flow label, address, MGT_ST_
+//								and UPD_ST_ codes, name
+//		link				LINK_ST_ code
+//		mib <n> [<prefix>]	the objects in unit <n>'s MIB (optionally only
+//								those whose OID begins with <prefix>), each as
+//								OID and value
+//		xpt <n>				crosspoint state of unit <n>'s media ports
+// errors are reported as a line beginning "? "
+std::string Daemon::ApiRequest(std::string& req)
+{
+	char cmd[16];
+	char prefix[MAX_OID_TEXT];
+	int n = -1;
+	prefix[0] = 0;
+	int k = sscanf(req.c_str(), "%15s %d %127s", cmd, &n, prefix);
+	if (k < 1) return std::string();
+	std::string c(cmd);
+	if (c == "units") return ApiUnits();
+	if (c == "link") return ToDecimal(link_state) + '\n';
+	unless (c == "mib" || c == "xpt") return "? unknown request\n";
+
+	DaemonUnit * u = FindUnit(n);
+	if (u == NULL) return "? no unit " + ToDecimal(n) + '\n';
+	if (c == "mib") return ApiMib(u, prefix);
+	return ApiCrosspoint(u);
+}
+
+
+std::string Daemon::ApiUnits()
+{
+	std::string s;
+	size_t i = 0;
+	while (++i < units.size()) {
+		DaemonUnit * u = units[i];
+		s += ToDecimal(i) + ' ' + u->unit_address + ' ' + ToDecimal(u->state) +
+				' ' + ToDecimal(u->upd_state) + ' ' + u->DisplayName() + '\n';
+	}
+	return s;
+}
+
+
+// order of objects for <ApiMib>; <MibStore> keeps them in no particular order
+static bool OidBefore(MibObject * a, MibObject * b)
+{
+	return a->oid_ber < b->oid_ber;
+}
+
+
+// value of <m> as text, as <MibObject::TextValue> except that an octet
+//		string which is all printable characters is also shown as a quoted
+//		string
+static std::string ApiTextValue(MibObject * m)
+{
+	std::string s = m->TextValue();
+	int n = (int)m->size();
+	int i = 0;
+	if (m->tag != ASN1_TAG_OCTET_STRING || n == 0) return s;
+	while (i < n) {
+		uint8_t c = m->at(i++);
+		if (c < 0x20 || c > 0x7E || c == '"') return s;
+	}
+	return s + " \"" + m->StdStringValue() + '"';
+}
+
+
+std::string Daemon::ApiMib(DaemonUnit * u, const char * prefix)
+{
+	std::string s;
+	ByteString p;
+	if (*prefix) {
+		p = OidFromText(prefix);
+		if (p.empty()) return "? bad OID\n";
+	}
+	std::vector<MibObject *> list;
+	MibObject * m;
+	int i = 0;
+	while ((m = u->mib.Next(i)) != NULL) {
+		if (m->OidStartsWith(p.data(), (int)p.size())) list.push_back(m);
+	}
+	std::sort(list.begin(), list.end(), OidBefore);
+	i = 0;
+	while (i < (int)list.size()) {
+		m = list[i++];
+		s += OidToText(m->oid_ber) + " = " + ApiTextValue(m) + '\n';
+	}
+	return s;
+}
+
+
+// one line per audio or video port, as shown in the crosspoint display:
+//		"in" <block> <name> ["->" <flow id> <udState>]
+//		"out" <block> <name> ["<-" <flow id> <usState> [<sender> <port>]]
+std::string Daemon::ApiCrosspoint(DaemonUnit * u)
+{
+	std::string s;
+	std::string name;
+	std::map<int, std::string>::iterator f;
+	DaemonUnit * snd;
+	MibObject * m;
+	uint8_t col[MIB_COL_MAX_OID_LEN];
+	int a = MibColumnOid(MIB_COL_US_STATE, col);
+	int i, e;
+	std::map<int, int>::iterator p = u->media_ports.begin();
+	while (p != u->media_ports.end()) {
+		int port = p->first;
+		bool input = (p->second == DIRECTION_IN);
+		name = u->GetStringObject(MIB_COL_A_PORT_NAME, port);
+		if (name.empty()) name = u->GetStringObject(MIB_COL_V_PORT_NAME, port);
+		s += (input ? "in " : "out ") + ToDecimal(port) + " \"" + name + '"';
+		++p;
+
+		if (input) {
+			f = u->input_flows.find(port);
+			if (f == u->input_flows.end()) goto next;
+			m = u->GetObject(MIB_COL_UD_STATE, f->second);
+			if (m == NULL) goto next;
+			s += " -> " + f->second + ' ' + ToDecimal(m->IntegerValue());
+			goto next;
+		}
+
+		f = u->output_flows.find(port);
+		if (f == u->output_flows.end()) goto next;
+		m = u->GetObject(MIB_COL_US_STATE, f->second);
+		if (m == NULL) goto next;
+		s += " <- " + f->second + ' ' + ToDecimal(m->IntegerValue());
+			// find the unit transmitting the flow, and the port it's from
+			// the key in <flow_senders> is the flow id's arcs in binary,
+			//		which are in usState's OID between the column and the
+			//		last arc (the block id); as <CCrosspointView::BuildUnitRows>
+		e = (int)m->oid_ber.size() - 1;
+		while (e > a && (m->oid_ber[e-1] & 0x80)) e -= 1;
+		snd = (DaemonUnit *)flow_senders.Find(m->oid_ber.data() + a, e - a);
+		if (snd == NULL) goto next;
+		i = (int)f->second.rfind('.');
+		i = snd->GetIntegerObject(MIB_COL_UD_NET_BLOCK_ID,
+												f->second.substr(0, i));
+		s += ' ' + ToDecimal(snd->call_ref & LABEL_MAX) + ' ' + ToDecimal(i);
+next:
+		s += '\n';
+	}
+	return s;
+}
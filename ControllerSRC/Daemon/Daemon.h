@@ -0,0 +1,285 @@
+/*
+ *  Daemon.h
+ *  headless controller: manages the units in a Flexilink network in the
+ *		same way as the Windows controller, but without a user interface;
+ *		the MIBs and crosspoint state are made available to other programs
+ *		through a local (Unix domain) socket
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// Linux only (uses epoll); the packet framing, BER decoding, MIB store
+//		and change notification, OID classification, state codes and
+//		timeouts, FindRoute request, status cycle tracking, unitIdentity
+//		check, timer wheel, request table and address directories are
+//		shared with the Windows build through the files in ../Common
+// the state machines themselves are NOT shared: <Daemon> and <DaemonUnit>
+//		are a second implementation of the link and session (MGT_ST_)
+//		machines in <LinkSocket> and <MgtSocket>, driven from the same
+//		Common parts, so a change to the protocol handling in MgtSocket.cpp
+//		or ControllerDoc.cpp has to be made here as well; the update
+//		(UPD_ST_) machine isn't implemented, and there are no passwords
+//		(see <DaemonUnit>)
+// +++ moving the session machine into ../Common needs <MgtSocket>'s use of
+//		CString, the CMap classes and <theApp> to be taken out first
+// there is no project file; build with e.g.
+//		g++ -std=c++14 -O2 -o flexilinkd Daemon/*.cpp Common/string_extras.cpp
+//				Common/link_core.cpp Common/link_posix.cpp Common/mgt_core.cpp
+//				Common/label_registry.cpp Common/mib_store.cpp Common/mib_bus.cpp
+//				Common/timer_wheel.cpp Common/request_table.cpp
+//				Common/addr_directory.cpp
+
+#pragma once
+#include "../Common/link_posix.h"
+#include "../Common/mgt_core.h"
+#include "../Common/mib_store.h"
+#include "../Common/mib_bus.h"
+#include "../Common/label_registry.h"
+#include "../Common/timer_wheel.h"
+#include "../Common/request_table.h"
+#include "../Common/addr_directory.h"
+#include <time.h>
+#include <signal.h>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// the management session with one unit: the equivalent of <MgtSocket>,
+//		except that it doesn't do software updates (so <upd_state> stops at
+//		UPD_ST_NOT_MAINT) and doesn't support passwords, so the daemon only
+//		runs at listener privilege level
+// +++ the update process needs the image files and the SHA-3 hash code to
+//		be made independent of MFC first
+class DaemonUnit
+{
+public:
+	DaemonUnit(class Daemon * d, int n, ByteString& call_addr);
+
+		// send the FindRoute request; as <MgtSocket::SendConnReq>
+	void SendConnReq();
+		// process an incoming FindRoute response or ack; as
+		//		<FlexilinkSocket::ReceiveSignalling>
+	void ReceiveSignalling(uint8_t * b, int len);
+		// process an incoming data message; <b[0]> is the command byte
+	void ReceiveData(uint8_t * b, int len);
+		// the call has been cleared down
+	void ClearedDown() { Failed((state < MGT_ST_CONN_MADE) ?
+										MGT_ST_NOT_CONN : MGT_ST_CLOSED); }
+		// called when one of the unit's timers expires; as
+		//		<FlexilinkSocket::TimerExpired>
+	void TimerExpired(int kind);
+		// called after each batch of events; as <MgtSocket::OnIdle>
+	void Idle();
+
+		// objects used by the crosspoint display, indexed by the last arc
+		//		(as <MgtSocket::GetObject> etc) or by the index arcs in dotted-
+		//		decimal form
+	MibObject * GetObject(int col, int index);
+	MibObject * GetObject(int col, const std::string& index);
+		// NB these check for NULL rather than relying on the <MibObject>
+		//		members doing so (see mib_store.h)
+	int GetIntegerObject(int col, int index) {
+				MibObject * m = GetObject(col, index);
+				return m == NULL ? 0 : m->IntegerValue(); }
+	int GetIntegerObject(int col, const std::string& index) {
+				MibObject * m = GetObject(col, index);
+				return m == NULL ? 0 : m->IntegerValue(); }
+	std::string GetStringObject(int col, int index) {
+				MibObject * m = GetObject(col, index);
+				return m == NULL ? std::string() : m->StdStringValue(); }
+		// unitName if known, else "[unit n]"
+	std::string DisplayName();
+		// the unit attached to network port <p>, if any (creating its
+		//		<DaemonUnit> if necessary), else NULL; as <MgtSocket::LinkPartner>
+	DaemonUnit * LinkPartner(int p);
+
+	class Daemon * daemon;
+	int call_ref;			// as <FlexilinkSocket::call_ref>
+	int tx_flow;			// flow label for tx packets; -1 until connected
+	int state;				// MGT_ST_ code
+	int upd_state;			// UPD_ST_ code
+	ByteString unit_TAddress;	// address for FindRoute request, and key in
+								//		<Daemon::unit_addrs>
+	std::string unit_address;	// <unit_TAddress> in hex, for the API
+	bool traced;			// see <Daemon::Trace>
+	int state_seen;			// <state> when last published, as <MgtSocket::state_view>
+
+	MibStore mib;
+		// nPortState for each network port, indexed by block id
+	std::map<int, int> net_port_state;
+		// DIRECTION_ code for each audio or video port, indexed by block id
+	std::map<int, int> media_ports;
+		// flows connected to ports, indexed by block id; as the maps of the
+		//		same names in <MgtSocket>
+	std::map<int, std::string> output_flows;
+	std::map<int, std::string> input_flows;
+
+private:
+		// send the message at <b> on <tx_flow>; as <FlexilinkSocket::TxMessage>
+	void TxMessage(uint8_t * b, int len);
+		// the same, filling in the serial number in <b[1]> and recording
+		//		the request in <requests>; as <MgtSocket::TxNewMessage>
+	void TxNewMessage(uint8_t * b, int len, int kind);
+		// send a Status request; if <req_ack> it's repeated until acknowledged
+	void RequestStatus(bool req_ack);
+		// set TMR_UNIT_REQUEST for the next request that's due; as
+		//		<MgtSocket::ArmRequestTimer>
+	void ArmRequestTimer();
+		// a request has had no reply; as <MgtSocket::RequestTimedOut>
+	void RequestTimedOut(PendingRequest& r);
+		// start repeating <mgt_msg>; as <FlexilinkSocket::AwaitAck>
+	void AwaitAck();
+		// enter failed state <st> and set TMR_UNIT_RETRY; as
+		//		<FlexilinkSocket::SetStateFailed> etc and <ScheduleRetry>
+	void Failed(int st);
+		// record an object that has just been reported
+	void Store(VarBindView& v, uint8_t msg_type, int64_t now);
+		// remove objects that weren't reported in the status cycle that
+		//		has just ended
+	void EndOfCycle();
+
+		// the FindRoute request or the initial GetNext (which has serial
+		//		number 0) awaiting reply (empty if none); as <MgtSocket::mgt_msg>
+	ByteString mgt_msg;
+	int mgt_repeats;		// times <mgt_msg> has been repeated
+		// management requests awaiting a reply, keyed by serial number,
+		//		which also allocates the serial numbers; the <kind> says
+		//		what to do if there's no reply, with the same values as in
+		//		<MgtSocket> (the others aren't used here)
+	RequestTable requests;
+#define REQ_OTHER		0	// not repeated; the serial number is just reserved
+#define REQ_STATUS		4	// Status request
+	uint64_t last_rx;		// time a message was last received
+	StatusCycle cycle;		// as in <MgtSocket>
+};
+
+
+// set by the signal handler to make <Daemon::Run> return
+extern volatile sig_atomic_t daemon_stop;
+
+// the daemon: the equivalent of <CControllerApp> plus <LinkSocket>
+class Daemon
+{
+public:
+	Daemon();
+	~Daemon();
+
+		// open the sockets; <server_addr> (network byte order) is the
+		//		gateway unit's address, or INADDR_BROADCAST to find it by
+		//		broadcasting the Link Request; <api_path> is the pathname
+		//		for the local socket
+		// returns an empty string if OK, else a description of the failure
+	std::string Init(uint32_t server_addr, const char * api_path);
+		// process events until a fatal error occurs or <daemon_stop> is 
+		//		set; returns the exit code
+	int Run();
+
+		// send a message on the link; as <LinkSocket::TxMessage>
+	bool TxMessage(uint8_t * b, int len, int flow = 0);
+		// create a <DaemonUnit> for the unit at <call_addr> and send the
+		//		FindRoute request; NULL if no more flow labels
+	DaemonUnit * NewUnit(ByteString& call_addr);
+		// the unit for which <n> is the flow label, or NULL; and the unit 
+		//		with <n> in the ls 16 bits of its call reference
+	DaemonUnit * FindUnit(int n) { return (DaemonUnit *)labels.Find(n); }
+	DaemonUnit * FindCall(int n) { return (DaemonUnit *)labels.FindRef(n); }
+
+	int link_state;			// LINK_ST_ code
+	char our_ident[8];		// as <LinkSocket::our_ident>
+	bool standard_format;	// as <LinkSocket::standard_format>
+		// units; entry 0 isn't used, so the index can be the flow label
+	std::vector<DaemonUnit *> units;
+	LabelRegistry labels;	// values are <DaemonUnit *>
+
+		// timeouts for repeating messages, keepalives, reconnecting etc, as
+		//		<CControllerApp::timers>; the times are from <Now>, and
+		//		<Run> waits for events until the earliest expiry, so nothing
+		//		is done for units that have nothing due
+		// the owner of each timer is the object named below, or NULL
+	TimerWheel timers;
+#define TMR_LINK_RETRY		1	// NULL: send a new Link Request
+#define TMR_PRUNE			2	// NULL: remove old entries from <flow_senders>
+#define TMR_LINK_RX			3	// NULL: no keepalive received
+#define TMR_LINK_TX			4	// NULL: send a keepalive
+#define TMR_UNIT_SIGNAL		6	// DaemonUnit: repeat <mgt_msg>
+#define TMR_UNIT_LIVENESS	7	// DaemonUnit: check the unit is still sending
+#define TMR_UNIT_RETRY		8	// DaemonUnit: try to reconnect
+#define TMR_UNIT_REQUEST	9	// DaemonUnit: repeat or give up on <requests>
+		// (re)start a timer to expire after <ms>
+	void StartTimer(void * owner, int kind, int ms) 
+										{ timers.Set(owner, kind, Now() + ms); }
+	void CancelTimer(void * owner, int kind) { timers.Cancel(owner, kind); }
+		// ms from CLOCK_MONOTONIC, as GetTickCount64()
+	static uint64_t Now();
+		// units, keyed by <DaemonUnit::unit_TAddress> (the Flexilink
+		//		address in binary); as <CControllerApp::unit_addrs>
+	AddrDirectory unit_addrs;
+		// unit sending each flow, keyed by the flow id as BER-coded index
+		//		arcs, with the time (in seconds) it was last reported; as
+		//		<CControllerApp::flow_senders>, entries that haven't been
+		//		confirmed for FLOW_SENDER_MAX_AGE are removed every
+		//		FLOW_PRUNE_INTERVAL (see <RunTimers>)
+#define FLOW_SENDER_MAX_AGE		300		// seconds
+#define FLOW_PRUNE_INTERVAL		60000	// ms
+	AddrDirectory flow_senders;
+	DaemonUnit * link_partner;
+
+		// changes to the MIBs (and to the units' states) are published here,
+		//		and collected in <Idle>; as in <CControllerApp>
+	MibBus mib_bus;
+	int bus_topology;	// units' network ports and link partners: re-trace
+#define TOPOLOGY_BITS	(MIB_BIT(MIB_COL_N_PORT_STATE) | \
+				MIB_BIT(MIB_COL_N_PORT_ADDR_TYPE) | \
+				MIB_BIT(MIB_COL_N_PORT_PARTNER_ADDR))
+	int bus_any;		// anything: re-trace if any units are to be retried
+
+private:
+		// the link to the gateway unit
+	LinkIoPosix link;
+	uint32_t server_addr;
+	DatagramRing rx_ring;
+	Datagram tx_buf;
+	int sig_label;			// signalling flow label, including the CRC
+	bool LinkRequest();
+		// enter failed state <st> and set TMR_LINK_RETRY; as <LinkSocket::Failed>
+	void LinkFailed(int st);
+	void LinkReceive();
+	void ProcessDatagram(Datagram& d);
+	void NewLinkPartner(ByteString& id);
+		// act on the timers that have expired; as <CControllerApp::RunTimers>
+	void RunTimers();
+		// after each batch of events; as <CControllerApp::OnIdle>
+	void Idle();
+	void Trace();
+
+		// the event loop
+	int epoll_fd;
+	bool Watch(int fd);
+		// ms until the next timer is due, or -1 if none, for epoll_wait()
+	int WaitTime();
+
+		// the local API: each request is a line of text, and the reply is
+		//		zero or more lines followed by a line containing only "."
+		// a client's requests are answered in turn; the next isn't looked
+		//		at until the whole of the previous reply has been written, so
+		//		a client that doesn't read its replies only holds up itself
+#define MAX_OID_TEXT	128	// longest OID prefix accepted in a request
+	struct ApiClient {
+		std::string in;		// requests not yet answered
+		std::string out;	// reply not yet written
+		bool want_out;		// whether <epoll_fd> is watching for EPOLLOUT
+	};
+	int api_fd;
+	std::string api_path;
+	std::map<int, ApiClient> api_clients;	// indexed by socket
+	void ApiAccept();
+	void ApiReceive(int fd);
+	void ApiServe(int fd);
+	void ApiClose(int fd);
+	std::string ApiRequest(std::string& req);
+	std::string ApiUnits();
+	std::string ApiMib(DaemonUnit * u, const char * prefix);
+	std::string ApiCrosspoint(DaemonUnit * u);
+};
@@ -0,0 +1,494 @@
+/*
+ *  DaemonUnit.cpp
+ *  management session with one unit, for the headless controller
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// The protocol is as for <MgtSocket>; see the comments in MgtSocket.cpp for
+//		the reasoning behind the various steps
+
+#include "Daemon.h"
+#include <stdlib.h>
+
+// prefixes for objects that need special treatment
+static const uint8_t prefix_flash[] = 		// 1.0.62379.1.1.5
+							{ 0x28, 0x83, 0xE7, 0x2B, 1, 1, 5 };
+static const uint8_t unit_identity[] = 		// 1.0.62379.1.1.1.4.0
+							{ 0x28, 0x83, 0xE7, 0x2B, 1, 1, 1, 4, 0 };
+static const uint8_t p_addr_type_unit[] = 	// 1.0.62379.5.2.2
+							{ 0x28, 0x83, 0xE7, 0x2B, 5, 2, 2 };
+
+
+// ------------------------ class DaemonUnit
+
+DaemonUnit::DaemonUnit(Daemon * d, int n, ByteString& call_addr)
+{
+	daemon = d;
+	call_ref = n;
+	tx_flow = -1;
+	state = MGT_ST_BEGIN;
+	upd_state = UPD_ST_NO_INFO;
+	unit_TAddress = call_addr;
+	int i = 0;
+	while (i < (int)call_addr.size()) unit_address += ToHex(call_addr[i++], 2);
+	traced = false;
+	state_seen = state;
+	mgt_repeats = 0;
+	last_rx = 0;
+}
+
+
+// send the FindRoute request; as <MgtSocket::SendConnReq> except that there
+//		is never a Password IE, because the daemon runs at PRIV_LISTENER
+void DaemonUnit::SendConnReq()
+{
+	call_ref += 0x10000;	// new call reference
+	call_ref &= 0x7FFFFFFF; // in case has wrapped
+	tx_flow = -1;
+	BuildConnReq(mgt_msg, daemon->our_ident, call_ref, PRIV_LISTENER,
+													unit_TAddress, NULL);
+	if (daemon->TxMessage(mgt_msg.data(), (int)mgt_msg.size())) {
+		state = MGT_ST_CONN_REQ;
+		AwaitAck();
+			// the unit has until MGT_SILENCE_TIMEOUT after now to reply
+		last_rx = Daemon::Now();
+		daemon->StartTimer(this, TMR_UNIT_LIVENESS, MGT_SILENCE_TIMEOUT);
+		return;
+	}
+	Failed(MGT_ST_FAILED);
+}
+
+
+// process an incoming FindRoute response or ack; b[0:14] is the header and
+//		fixed part, which the caller has checked is for this unit
+void DaemonUnit::ReceiveSignalling(uint8_t * b, int len)
+{
+	switch (b[0]) {
+case 0x88:	// ack FindRoute request
+		if (state == MGT_ST_CONN_REQ) {
+			mgt_msg.clear();
+			daemon->CancelTimer(this, TMR_UNIT_SIGNAL);
+			state = MGT_ST_CONN_ACK;
+		}
+		return;
+
+case 0x28:	// FindRoute response: send ack
+		b[0] = 0xA8;
+		daemon->TxMessage(b, 15, 0);
+		if (state >= MGT_ST_CONN_MADE) return;
+
+			// collect the tx flow label
+		int i = 15;
+		while (i < len) {
+			uint16_t ie_len = (b[i+1] << 8) | b[i+2];
+			if (b[i] == 20 && ie_len >= 2) tx_flow = (b[i+3] << 8) | b[i+4];
+			i += ie_len + 3;
+		}
+		if (tx_flow < 0) {
+			Failed(MGT_ST_NOT_CONN);
+			return;
+		}
+		state = MGT_ST_CONN_MADE;
+
+			// send a "GetNext" request for up to 10 objects starting at
+			//		1.0.62379.1.1.1, as <MgtSocket::ConnectionMade>; its
+			//		serial number isn't allocated by <requests>
+		static const uint8_t get_next[] =
+					{ 0x19, 0, 6, 7, 0x28, 0x83, 0xE7, 0x2B, 1, 1, 1 };
+		mgt_msg.assign(get_next, get_next + sizeof(get_next));
+		TxMessage(mgt_msg.data(), (int)mgt_msg.size());
+		AwaitAck();
+		upd_state = UPD_ST_NO_INFO;
+			// requests sent on an earlier connection won't be answered now;
+			//		the round-trip times are kept
+		requests.Clear();
+	}
+}
+
+
+// send message from <b> on <tx_flow>; if unsuccessful, enters "failed" state
+void DaemonUnit::TxMessage(uint8_t * b, int len)
+{
+	unless (daemon->TxMessage(b, len, tx_flow)) Failed(MGT_ST_FAILED);
+}
+
+
+// as above, filling in the serial number in <b[1]> and recording the
+//		request in <requests> with kind <kind>; there is only one REQ_STATUS
+//		request at a time, so sending one replaces any earlier one
+// if there's no serial number free, the oldest request is given up on as in
+//		TimerExpired(), and if that times the session out the message isn't sent
+void DaemonUnit::TxNewMessage(uint8_t * b, int len, int kind)
+{
+	if (kind == REQ_STATUS) requests.RemoveKind(kind);
+	int serial = requests.NextSerial();
+	if (serial == 0) {
+			// all 255 serial numbers are waiting for replies; give up on
+			//		the oldest request
+		PendingRequest r = *requests.Find(requests.Oldest());
+		requests.Remove(r.m[1]);
+		RequestTimedOut(r);
+		if (state > MGT_ST_MAX_OK) return;
+		serial = requests.NextSerial();
+	}
+	b[1] = (uint8_t)serial;
+	TxMessage(b, len);
+	requests.Add(b, len, kind != REQ_OTHER, kind, 0, Daemon::Now());
+	ArmRequestTimer();
+}
+
+
+// send Status Request message; if <req_ack> it is repeated until acknowledged
+void DaemonUnit::RequestStatus(bool req_ack)
+{
+	uint8_t b2[2];
+	b2[0] = 0x20;	// "Status" request
+	TxNewMessage(b2, 2, req_ack ? REQ_STATUS : REQ_OTHER);
+}
+
+
+// the timer is only changed if it's not running or is due later
+void DaemonUnit::ArmRequestTimer()
+{
+	uint64_t t = requests.NextDue();
+	if (t == 0) return;
+	uint64_t w = daemon->timers.When(this, TMR_UNIT_REQUEST);
+	if (w == 0 || t < w) daemon->timers.Set(this, TMR_UNIT_REQUEST, t);
+}
+
+
+// requests that weren't to be repeated are just forgotten; for a Status
+//		request we assume the unit has stopped responding
+void DaemonUnit::RequestTimedOut(PendingRequest& r)
+{
+	if (r.kind == REQ_OTHER) return;
+	Failed(MGT_ST_TIMEOUT);
+}
+
+
+void DaemonUnit::AwaitAck()
+{
+	mgt_repeats = 0;
+	daemon->StartTimer(this, TMR_UNIT_SIGNAL, MGT_MSG_REPEAT);
+}
+
+
+void DaemonUnit::Failed(int st)
+{
+	state = st;
+	daemon->StartTimer(this, TMR_UNIT_RETRY,
+				(st >= MGT_ST_MIN_RETRY) ? MGT_RETRY_SOON : MGT_RETRY_WAIT);
+}
+
+
+// process an incoming data message; as <MgtSocket::ReceiveData> but without
+//		the software update and connection setup parts
+void DaemonUnit::ReceiveData(uint8_t * b, int len)
+{
+	len -= 2;				// length of VarBinds
+	if (len < 0) return;	// if message is too short
+	last_rx = Daemon::Now();	// note that we've seen a message
+
+	VarBindReader r(b + 2, len);
+	VarBindView v;
+	if (b[0] & 0x80) {
+			// reply; a "busy" reply means the request will be repeated,
+			//		else see if it's one in <requests>, matching the serial
+			//		number and the request type, as in <MgtSocket>
+		PendingRequest done;
+		if (b[0] == 0xBE) {
+			requests.Busy(b[1], Daemon::Now());
+			ArmRequestTimer();
+		}
+		else requests.Complete(b[1], b[0], Daemon::Now(), done);
+
+			// or the initial GetNext
+		if (state > MGT_ST_CONN_REQ && mgt_msg.size() > 1 &&
+					b[1] == mgt_msg[1] && ((mgt_msg[0] ^ b[0]) & 0x70) == 0) {
+			mgt_msg.clear();
+			daemon->CancelTimer(this, TMR_UNIT_SIGNAL);
+			if (state == MGT_ST_CONN_MADE) {
+					// have the response to the initial GetNext
+				RequestStatus(true);
+				state = MGT_ST_HAVE_INFO;
+			}
+		}
+	}
+
+	if ((b[0] & 0xF0) == 0xA0) {
+			// Status Response message
+		if (b[0] != 0xA0 && b[0] != 0xAF) return; // if error signalled
+		if (len == 2 && b[0] == 0xA0) return;	// OK reply to Status Request
+
+		if (cycle.Report(b[1], time(NULL)) && state == MGT_ST_HAVE_INFO)
+													state = MGT_ST_ACTIVE;
+	}
+	else if ((b[0] & 0x70) == 0x70) {
+			// console data: acknowledge it but don't record it
+		if (b[0] & 0x80) return;
+		b[0] |= 0x80;
+		daemon->TxMessage(b, 2, tx_flow);
+		return;
+	}
+	else unless (b[0] & 0x80) return; // not a response
+
+		// here to add all the objects to the MIB
+	int64_t now = time(NULL);
+	while (r.Remaining() > 0) {
+		unless (r.Next(v)) break;
+			// objects that are part of the flash map don't get recorded
+		if (v.OidStartsWith(prefix_flash, sizeof(prefix_flash))) {
+			if ((b[0] & 0xF0) != 0xA0) return;
+			continue;
+		}
+		Store(v, b[0] & 0xF0, now);
+	}
+
+		// nothing more to do unless an in-cycle status report
+	if ((b[0] & 0xF0) != 0xA0 || b[1] == 0) return;
+	if (r.Remaining() != 0) {
+			// still something left in the message but not a valid object
+		cycle.Abandon();	// no longer sure of the integrity of this cycle
+		return;
+	}
+	unless (cycle.Complete(b[0])) return;
+
+		// here if end of an OK cycle
+	RequestStatus(false);
+	EndOfCycle();
+}
+
+
+// record an object that has just been reported, in a message whose first
+//		byte was <msg_type> (in the high half), and update the lists
+void DaemonUnit::Store(VarBindView& v, uint8_t msg_type, int64_t now)
+{
+	bool value_is_new;
+	MibObject * m = mib.Add(v.oid, v.oid_len, value_is_new);
+	unless (value_is_new) value_is_new = m->ChangedFrom(v, now);
+	m->SetValue(v);
+	m->recd = now;
+	m->msg_type = msg_type;
+	mib.Reported(m, (msg_type & 0x20) != 0);
+
+	int posn;
+	int block_id;
+	size_t i;
+	std::string index;
+	ByteString flow_id;	// key for <Daemon::flow_senders>
+	std::map<int, int>::iterator q;
+	int col = ClassifyOid(v.oid, v.oid_len, posn);
+	if (value_is_new) daemon->mib_bus.Publish(this, MIB_BIT(col));
+	switch (col) {
+case MIB_COL_US_STATE:
+		if (m->value != 15) {
+				// usState, value is not "Transferred"; last arc is the block id
+			index = v.IndexString(posn);
+			i = index.rfind('.');
+			unless (i == std::string::npos)
+							output_flows[atoi(index.c_str() + i + 1)] = index;
+		}
+		return;
+
+case MIB_COL_UD_NET_BLOCK_ID:
+		if (m->tag != ASN1_TAG_INTEGER) return;
+		q = media_ports.find(m->value);
+		if (q != media_ports.end() && q->second == DIRECTION_IN) {
+				// it's an input port so remember the flow
+			index = v.IndexString(posn);
+			input_flows[m->value] = index;
+			flow_id.assign(v.oid + posn, v.oid + v.oid_len);
+			daemon->flow_senders.Set(flow_id, (void *)this, (uint32_t)now);
+		}
+		return;
+
+case MIB_COL_N_PORT_STATE:
+			// state of a network port
+		unless (value_is_new) return;
+		if (v.IndexArcs(posn, &block_id, 1) != 1 || m->value < 0) return;
+		net_port_state[block_id] = m->value;
+		return;
+
+case MIB_COL_FIRMWARE_VERSION:
+			// unitFirmwareVersion; assume we already have unitIdentity
+		if (upd_state == UPD_ST_NO_INFO) upd_state = UPD_ST_BEGIN;
+		return;
+
+case MIB_COL_A_PORT_DIRECTION:
+case MIB_COL_V_PORT_DIRECTION:
+			// direction of an audio or video port
+		if (v.IndexArcs(posn, &block_id, 1) != 1) return;
+		if (m->value == DIRECTION_IN || m->value == DIRECTION_OUT)
+											media_ports[block_id] = m->value;
+		else media_ports.erase(block_id);
+		return;
+	}
+}
+
+
+// remove anything that should have been reported during the status cycle
+//		that has just ended but wasn't; as in <MgtSocket::ReceiveData>, the
+//		aging list has the objects last reported in a Status Response or Set
+//		Response in the order they were reported, so we only need to look
+//		at the start of it
+void DaemonUnit::EndOfCycle()
+{
+	MibObject * m;
+	int posn, col, block_id;
+	while ((m = mib.Oldest()) != NULL && m->recd < cycle.start_time) {
+		col = ClassifyOid(m->oid_ber.data(), (int)m->oid_ber.size(), posn);
+		daemon->mib_bus.Publish(this, MIB_BIT(col));
+		if ((col == MIB_COL_N_PORT_STATE || col == MIB_COL_A_PORT_DIRECTION ||
+							col == MIB_COL_V_PORT_DIRECTION) &&
+					OidArcs(m->oid_ber.data() + posn, (int)m->oid_ber.size() - posn,
+												&block_id, 1) == 1) {
+			if (col == MIB_COL_N_PORT_STATE) net_port_state.erase(block_id);
+			else media_ports.erase(block_id);
+		}
+		mib.Remove(m);
+	}
+}
+
+
+// the timers are ignored while the link is down, because all the units are
+//		reconnected when it comes back up (see <Daemon::NewLinkPartner>)
+void DaemonUnit::TimerExpired(int kind)
+{
+	if (daemon->link_state != LINK_ST_ACTIVE) return;
+
+	switch (kind) {
+case TMR_UNIT_RETRY:
+		if (state > MGT_ST_MAX_OK) SendConnReq();
+		return;
+
+case TMR_UNIT_LIVENESS:
+		if (state > MGT_ST_MAX_OK) return;
+		if (Daemon::Now() - last_rx < MGT_SILENCE_TIMEOUT) {
+			daemon->timers.Set(this, TMR_UNIT_LIVENESS,
+											last_rx + MGT_SILENCE_TIMEOUT);
+			return;
+		}
+			// ought to have had several status broadcasts in that time
+		Failed(MGT_ST_TIMEOUT);
+		return;
+
+case TMR_UNIT_REQUEST:
+		if (state > MGT_ST_MAX_OK) return;
+		{
+				// repeat any requests that haven't been acknowledged within
+				//		the timeout (or for which the unit said it was busy);
+				//		the others are left alone as their replies may still
+				//		be on the way
+			uint64_t now = Daemon::Now();
+			int i;
+			while ((i = requests.Due(now)) >= 0) {
+				PendingRequest * p = requests.Find(i);
+				if (p->repeat && now - p->first_sent < REQ_GIVE_UP) {
+					TxMessage(p->m.data(), (int)p->m.size());
+					if (state > MGT_ST_MAX_OK) return;	// transmission failed
+					requests.Resent(i, now);
+					continue;
+				}
+				PendingRequest r = *p;
+				requests.Remove(i);
+				RequestTimedOut(r);
+				if (state > MGT_ST_MAX_OK) return;
+			}
+		}
+		ArmRequestTimer();
+		return;
+
+case TMR_UNIT_SIGNAL:
+		if (mgt_msg.empty() || state > MGT_ST_MAX_OK) return;
+		if (mgt_repeats >= MAX_REPEAT_COUNT) {
+			Failed(MGT_ST_TIMEOUT);
+			return;
+		}
+		mgt_repeats += 1;
+			// resend the message verbatim
+		if (state == MGT_ST_CONN_REQ) {
+				// it's a signalling message
+			unless (daemon->TxMessage(mgt_msg.data(), (int)mgt_msg.size())) {
+				Failed(MGT_ST_FAILED);
+				return;
+			}
+		}
+		else TxMessage(mgt_msg.data(), (int)mgt_msg.size());
+		daemon->StartTimer(this, TMR_UNIT_SIGNAL, MGT_MSG_REPEAT);
+		return;
+	}
+}
+
+
+// check unitIdentity once it has been collected; as the start of
+//		<MgtSocket::OnIdle>
+void DaemonUnit::Idle()
+{
+	unless (upd_state == UPD_ST_BEGIN) return;
+	MibObject * m = mib.Find(unit_identity, sizeof(unit_identity));
+	if (m == NULL) upd_state = UPD_ST_NO_INFO;
+	else upd_state = CheckUnitIdentity(m->data(), (int)m->size(), NULL);
+		// and go no further, see header
+	if (upd_state == UPD_ST_BEGIN) upd_state = UPD_ST_NOT_MAINT;
+}
+
+
+// return the object in column <col> with index <index> (a single arc), or
+//		NULL if not present
+MibObject * DaemonUnit::GetObject(int col, int index)
+{
+	uint8_t b[MIB_COL_MAX_OID_LEN + 5];
+	int n = MibColumnOid(col, b);
+	int k;
+	if (n == 0 || index < 0) return NULL;
+		// set <k> to 7 * ((bytes to add) - 1)
+	k = 0;
+	while (k < 28 && (index >> k) >= 128) k += 7;
+	while (k > 0) { b[n++] = (uint8_t)((index >> k) | 0x80); k -= 7; }
+	b[n++] = (uint8_t)(index & 0x7F);
+	return mib.Find(b, n);
+}
+
+
+// as above, with the index arcs in dotted-decimal form
+MibObject * DaemonUnit::GetObject(int col, const std::string& index)
+{
+	uint8_t b[MIB_COL_MAX_OID_LEN];
+	int n = MibColumnOid(col, b);
+	if (n == 0) return NULL;
+	ByteString oid(b, b + n);
+	ByteString arcs = OidFromText(("1.0." + index).c_str());
+	if (arcs.empty()) return NULL;
+	oid.insert(oid.end(), arcs.begin() + 1, arcs.end());	// skip "1.0"
+	return mib.Find(oid);
+}
+
+
+std::string DaemonUnit::DisplayName()
+{
+	std::string s = GetStringObject(MIB_COL_UNIT_NAME, 0);
+	unless (s.empty()) return s;
+	return "[unit " + ToDecimal(call_ref & LABEL_MAX) + ']';
+}
+
+
+// return the neighbour on network port <p>, if any, else NULL
+DaemonUnit * DaemonUnit::LinkPartner(int p)
+{
+	std::string n = ToDecimal(p);
+	ByteString oid = OidFromText(("1.0.62379.5.1.1.1.1.1.6." + n).c_str());
+	MibObject * m = mib.Find(oid);
+	if (m == NULL || m->tag != ASN1_TAG_OID ||
+			m->size() != sizeof(p_addr_type_unit) || memcmp(m->data(),
+					p_addr_type_unit, sizeof(p_addr_type_unit)) != 0) return NULL;
+	oid = OidFromText(("1.0.62379.5.1.1.1.1.1.7." + n).c_str());
+	m = mib.Find(oid);
+	if (m == NULL || m->empty()) return NULL;
+
+	DaemonUnit * u = (DaemonUnit *)daemon->unit_addrs.Find(*m);
+	if (u) return u;
+	ByteString p_addr(*m);
+	return daemon->NewUnit(p_addr);
+}
@@ -0,0 +1,65 @@
+/*
+ *  flexilinkd.cpp
+ *  headless controller: main program
+ *
+ *  Copyright 2024 Nine Tiles. All rights reserved.
+ *
+ */
+
+// usage: flexilinkd [-s server] [-a api_path]
+//		<server> is the IPv4 address of the gateway unit (as the Windows
+//			controller's "server" option); if omitted the Link Request is
+//			broadcast
+//		<api_path> is the pathname for the local API socket (see
+//			<Daemon::ApiRequest>), default /tmp/flexilinkd
+
+#include "Daemon.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <unistd.h>
+
+volatile sig_atomic_t daemon_stop = 0;
+
+static void Stop(int)
+{
+	daemon_stop = 1;
+}
+
+
+int main(int argc, char * argv[])
+{
+	uint32_t server_addr = INADDR_BROADCAST;
+	const char * api_path = "/tmp/flexilinkd";
+	struct in_addr a;
+	int c;
+	while ((c = getopt(argc, argv, "s:a:")) != -1) switch (c) {
+case 's':
+		if (inet_pton(AF_INET, optarg, &a) != 1) {
+			fprintf(stderr, "flexilinkd: bad server address %s\n", optarg);
+			return 2;
+		}
+		server_addr = a.s_addr;
+		break;
+
+case 'a':
+		api_path = optarg;
+		break;
+
+default:
+		fprintf(stderr, "usage: flexilinkd [-s server] [-a api_path]\n");
+		return 2;
+	}
+
+		// a client that goes away while we're replying mustn't kill us
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, Stop);
+	signal(SIGTERM, Stop);
+
+	Daemon d;
+	std::string err = d.Init(server_addr, api_path);
+	unless (err.empty()) {
+		fprintf(stderr, "flexilinkd: %s\n", err.c_str());
+		return 1;
+	}
+	return d.Run();
+}